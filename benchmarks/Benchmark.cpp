@@ -0,0 +1,155 @@
+#include "Benchmark.hpp"
+
+#include <envire/core/Instrumentation.hpp>
+#include <envire/tools/Parallel.hpp>
+#include <base/Time.hpp>
+
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_real.hpp>
+#include <boost/random/variate_generator.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+using namespace envire;
+using namespace envire::benchmarks;
+
+typedef boost::variate_generator<boost::mt19937, boost::uniform_real<double> > Uniform;
+
+double Result::getMin() const
+{
+    return seconds.empty() ? 0 : *std::min_element( seconds.begin(), seconds.end() );
+}
+
+double Result::getMax() const
+{
+    return seconds.empty() ? 0 : *std::max_element( seconds.begin(), seconds.end() );
+}
+
+double Result::getMean() const
+{
+    return seconds.empty() ? 0 : std::accumulate( seconds.begin(), seconds.end(), 0.0 ) / seconds.size();
+}
+
+double Result::getMedian() const
+{
+    if( seconds.empty() )
+	return 0;
+    std::vector<double> sorted( seconds );
+    std::sort( sorted.begin(), sorted.end() );
+    const size_t n = sorted.size();
+    return n % 2 ? sorted[n/2] : (sorted[n/2 - 1] + sorted[n/2]) / 2.0;
+}
+
+Result envire::benchmarks::measure( Benchmark& benchmark, const Parameters& params )
+{
+    Result result;
+    result.name = benchmark.getName();
+    result.itemName = benchmark.getItemName();
+    result.params = params;
+    result.items = 0;
+
+#ifdef ENVIRE_USE_INSTRUMENTATION
+    Instrumentation::setTraceCapacity( 0 );
+    Instrumentation::setEnabled( true );
+#endif
+
+    for( size_t i=0; i<params.repetitions; i++ )
+    {
+	benchmark.setup( params );
+#ifdef ENVIRE_USE_INSTRUMENTATION
+	Instrumentation::clear();
+#endif
+
+	const base::Time start = base::Time::now();
+	result.items = benchmark.run();
+	result.seconds.push_back( (base::Time::now() - start).toSeconds() );
+
+#ifdef ENVIRE_USE_INSTRUMENTATION
+	const Instrumentation::Report report = Instrumentation::endCycle();
+	result.counters.clear();
+	for( int c=0; c<Instrumentation::COUNTER_COUNT; c++ )
+	    result.counters.push_back( std::make_pair(
+			std::string( Instrumentation::getCounterName( static_cast<Instrumentation::Counter>(c) ) ),
+			report.counters[c] ) );
+#endif
+	benchmark.tearDown();
+    }
+
+#ifdef ENVIRE_USE_INSTRUMENTATION
+    Instrumentation::setEnabled( false );
+#endif
+
+    return result;
+}
+
+void envire::benchmarks::writeJson( std::ostream& os, const Result& result )
+{
+    const double median = result.getMedian();
+    os << "{\"benchmark\":\"" << result.name << "\""
+	<< ",\"size\":" << result.params.size
+	<< ",\"points\":" << result.params.points
+	<< ",\"scale\":" << result.params.scale
+	<< ",\"seed\":" << result.params.seed
+	<< ",\"threads\":" << getParallelThreads()
+	<< ",\"repetitions\":" << result.seconds.size()
+	<< ",\"items\":" << result.items
+	<< ",\"item_name\":\"" << result.itemName << "\""
+	<< ",\"min_s\":" << result.getMin()
+	<< ",\"median_s\":" << median
+	<< ",\"mean_s\":" << result.getMean()
+	<< ",\"max_s\":" << result.getMax()
+	<< ",\"items_per_s\":" << (median > 0 ? result.items / median : 0);
+    if( !result.counters.empty() )
+    {
+	os << ",\"counters\":{";
+	for( size_t i=0; i<result.counters.size(); i++ )
+	    os << (i ? "," : "") << "\"" << result.counters[i].first << "\":" << result.counters[i].second;
+	os << "}";
+    }
+    os << "}" << std::endl;
+}
+
+double envire::benchmarks::terrainHeight( double x, double y )
+{
+    return 0.3 * std::sin( 0.5 * x ) * std::cos( 0.3 * y ) + 0.05 * std::sin( 3.0 * x + y );
+}
+
+void envire::benchmarks::createScan( Pointcloud& pc, const Parameters& params, unsigned int seed )
+{
+    Uniform uni( boost::mt19937( seed ), boost::uniform_real<double>( 0, 1 ) );
+
+    const double extent = params.size * params.scale;
+    const double center = extent / 2.0;
+    pc.setSensorOrigin( Transform( Eigen::Affine3d( Eigen::Translation3d( center, center, 1.5 ) ) ) );
+
+    pc.vertices.clear();
+    pc.vertices.reserve( params.points );
+    for( size_t i=0; i<params.points; i++ )
+    {
+	const double r = std::sqrt( uni() ) * extent * 0.45;
+	const double a = uni() * 2.0 * M_PI;
+	const double x = center + r * std::cos( a ), y = center + r * std::sin( a );
+	const double z = terrainHeight( x, y ) + (uni() < 0.05 ? 2.0 : 0.0);
+	pc.vertices.push_back( Eigen::Vector3d( x, y, z ) );
+    }
+}
+
+void envire::benchmarks::createSurface( MLSGrid& grid, double offset, unsigned int seed )
+{
+    Uniform uni( boost::mt19937( seed ), boost::uniform_real<double>( 0, 1 ) );
+
+    grid.clear();
+    for( size_t y=0; y<grid.getCellSizeY(); y++ )
+    {
+	for( size_t x=0; x<grid.getCellSizeX(); x++ )
+	{
+	    const Eigen::Vector2d pos = grid.fromGrid( GridBase::Position( x, y ) );
+	    const double z = terrainHeight( pos.x(), pos.y() ) + offset;
+	    grid.insertHead( x, y, MLSGrid::SurfacePatch( z, 0.05 ) );
+	    if( uni() < 0.05 )
+		grid.insertHead( x, y, MLSGrid::SurfacePatch( z + 2.0, 0.05 ) );
+	}
+    }
+}
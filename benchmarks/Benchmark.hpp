@@ -0,0 +1,109 @@
+#ifndef __ENVIRE_BENCHMARKS_BENCHMARK_HPP__
+#define __ENVIRE_BENCHMARKS_BENCHMARK_HPP__
+
+#include <envire/maps/MLSGrid.hpp>
+#include <envire/maps/Pointcloud.hpp>
+
+#include <boost/cstdint.hpp>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace envire
+{
+namespace benchmarks
+{
+    /** size of the synthetic workload of a benchmark */
+    struct Parameters
+    {
+	Parameters()
+	    : size( 200 ), points( 100000 ), repetitions( 5 ), scale( 0.1 ), seed( 42 ) {}
+
+	/** number of cells of the maps in x and y */
+	size_t size;
+	/** number of points of the scans, of events for the event
+	 * benchmark, or of poses for the footprint benchmarks */
+	size_t points;
+	/** number of timed runs */
+	size_t repetitions;
+	/** size of a cell in m */
+	double scale;
+	/** seed of the random generator for the synthetic data */
+	unsigned int seed;
+    };
+
+    /**
+     * A benchmark with a synthetic workload. For each repetition, setup()
+     * is called to build the workload, which is not timed, then run(),
+     * which is timed, and then tearDown().
+     */
+    class Benchmark
+    {
+    public:
+	virtual ~Benchmark() {}
+
+	/** @return the name under which the benchmark is reported */
+	virtual std::string getName() const = 0;
+
+	/** @return what the item count of run() refers to, e.g. "points" */
+	virtual std::string getItemName() const = 0;
+
+	virtual void setup( const Parameters& params ) = 0;
+
+	/** @return the number of items that were processed */
+	virtual size_t run() = 0;
+
+	virtual void tearDown() {}
+    };
+
+    /** timing of all the repetitions of a benchmark */
+    struct Result
+    {
+	std::string name;
+	std::string itemName;
+	Parameters params;
+	/** item count of the last repetition */
+	size_t items;
+	/** time of each repetition in seconds */
+	std::vector<double> seconds;
+	/** names and values of the instrumentation counters of the last
+	 * repetition, if envire is compiled with the instrumentation */
+	std::vector<std::pair<std::string, boost::uint64_t> > counters;
+
+	double getMin() const;
+	double getMax() const;
+	double getMean() const;
+	double getMedian() const;
+    };
+
+    /** runs the repetitions of the benchmark */
+    Result measure( Benchmark& benchmark, const Parameters& params );
+
+    /** writes the result as a single line JSON object */
+    void writeJson( std::ostream& os, const Result& result );
+
+    /** height of the synthetic terrain at x, y */
+    double terrainHeight( double x, double y );
+
+    /**
+     * Fills the pointcloud with points of a scan of the terrain, as seen
+     * from a sensor 1.5m above the center of a map with the size of
+     * params. The points are spread over a disc around the sensor, and 5%
+     * of them are on a plane 2m above the terrain, which gives cells with
+     * more than one surface.
+     */
+    void createScan( Pointcloud& pc, const Parameters& params, unsigned int seed );
+
+    /**
+     * Fills the grid with one patch of the terrain per cell. 5% of the
+     * cells also get a patch 2m above the terrain.
+     */
+    void createSurface( MLSGrid& grid, double offset, unsigned int seed );
+
+    void addMapBenchmarks( std::vector<Benchmark*>& benchmarks );
+    void addEnvironmentBenchmarks( std::vector<Benchmark*>& benchmarks );
+    void addIcpBenchmarks( std::vector<Benchmark*>& benchmarks );
+}
+}
+
+#endif
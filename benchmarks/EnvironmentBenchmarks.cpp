@@ -0,0 +1,278 @@
+#include "Benchmark.hpp"
+
+#include <envire/Core.hpp>
+#include <envire/core/EventHandler.hpp>
+#include <envire/core/Serialization.hpp>
+
+#include <boost/filesystem.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <stdexcept>
+
+using namespace envire;
+using namespace envire::benchmarks;
+
+namespace fs = boost::filesystem;
+
+namespace
+{
+    /** writes an environment with an MLSGrid and a scan to disk, and reads
+     * it back */
+    class SerializationBenchmark : public Benchmark
+    {
+    public:
+	std::string getName() const { return "serialization"; }
+	std::string getItemName() const { return "bytes"; }
+
+	void setup( const Parameters& params )
+	{
+	    env.reset( new Environment() );
+	    MLSGrid* grid = new MLSGrid( params.size, params.size, params.scale, params.scale );
+	    env->attachItem( grid );
+	    env->setFrameNode( grid, env->getRootNode() );
+	    createSurface( *grid, 0.0, params.seed );
+
+	    Pointcloud* pc = new Pointcloud();
+	    env->attachItem( pc );
+	    env->setFrameNode( pc, env->getRootNode() );
+	    createScan( *pc, params, params.seed );
+
+	    path = fs::temp_directory_path() / fs::unique_path( "envire-benchmark-%%%%-%%%%-%%%%" );
+	}
+
+	size_t run()
+	{
+	    env->serialize( path.string() );
+	    boost::scoped_ptr<Environment> copy( Environment::unserialize( path.string() ) );
+	    if( !copy )
+		throw std::runtime_error( "could not read back " + path.string() );
+
+	    size_t bytes = 0;
+	    for( fs::directory_iterator it( path ); it != fs::directory_iterator(); it++ )
+		bytes += fs::file_size( it->path() );
+	    return bytes;
+	}
+
+	void tearDown()
+	{
+	    env.reset();
+	    fs::remove_all( path );
+	}
+
+    private:
+	boost::scoped_ptr<Environment> env;
+	fs::path path;
+    };
+
+    class CountingHandler : public EventHandler
+    {
+    public:
+	CountingHandler() : events( 0 ) {}
+	void handle( const Event& message ) { events++; }
+	size_t events;
+    };
+
+    class CountingSyncHandler : public SynchronizationEventHandler
+    {
+    public:
+	CountingSyncHandler() : events( 0 ) {}
+	void handle( std::vector<BinaryEvent>& msgs ) { events += msgs.size(); }
+	size_t events;
+    };
+
+    /**
+     * Adds frame nodes to the environment, modifies and removes them again,
+     * which generates five events per node: the item and its link to the
+     * parent are added and removed, and the transform is updated once.
+     * With binary set, the events are serialized by a
+     * SynchronizationEventHandler, otherwise they are only counted by a
+     * plain handler.
+     */
+    class EventBenchmark : public Benchmark
+    {
+    public:
+	explicit EventBenchmark( bool binary )
+	    : binary( binary ) {}
+
+	std::string getName() const { return binary ? "events_binary" : "events"; }
+	std::string getItemName() const { return "events"; }
+
+	void setup( const Parameters& params )
+	{
+	    env.reset( new Environment() );
+	    nodes = params.points;
+	    if( binary )
+	    {
+		syncHandler.reset( new CountingSyncHandler() );
+		env->addEventHandler( syncHandler.get() );
+		syncHandler->events = 0;
+	    }
+	    else
+	    {
+		handler.reset( new CountingHandler() );
+		env->addEventHandler( handler.get() );
+		handler->events = 0;
+	    }
+	}
+
+	size_t run()
+	{
+	    std::vector<FrameNode*> fns;
+	    fns.reserve( nodes );
+	    for( size_t i=0; i<nodes; i++ )
+	    {
+		FrameNode* fn = new FrameNode();
+		env->addChild( env->getRootNode(), fn );
+		fns.push_back( fn );
+	    }
+	    for( size_t i=0; i<nodes; i++ )
+		fns[i]->setTransform( Eigen::Affine3d( Eigen::Translation3d( i, 0, 0 ) ) );
+	    for( size_t i=0; i<nodes; i++ )
+		env->detachItem( fns[i] );
+
+	    return binary ? syncHandler->events : handler->events;
+	}
+
+	void tearDown()
+	{
+	    env.reset();
+	    handler.reset();
+	    syncHandler.reset();
+	}
+
+    private:
+	bool binary;
+	size_t nodes;
+	// the handlers need to outlive the environment
+	boost::scoped_ptr<CountingHandler> handler;
+	boost::scoped_ptr<CountingSyncHandler> syncHandler;
+	boost::scoped_ptr<Environment> env;
+    };
+
+    class CountingQueue : public EventQueue
+    {
+    public:
+	CountingQueue() : events( 0 ) {}
+	void process( const Event& message ) { events++; }
+	size_t events;
+    };
+
+    /**
+     * Marks a fixed set of 100 pointclouds as modified in turn, and
+     * flushes an EventQueue afterwards. The updates of each item are
+     * merged in the queue, so only the last one is processed.
+     */
+    class QueueBenchmark : public Benchmark
+    {
+    public:
+	std::string getName() const { return "event_queue"; }
+	std::string getItemName() const { return "updates"; }
+
+	void setup( const Parameters& params )
+	{
+	    env.reset( new Environment() );
+	    queue.reset( new CountingQueue() );
+	    env->addEventHandler( queue.get() );
+
+	    layers.clear();
+	    for( size_t i=0; i<100; i++ )
+	    {
+		layers.push_back( new Pointcloud() );
+		env->attachItem( layers.back() );
+	    }
+	    queue->flush();
+	    updates = params.points;
+	}
+
+	size_t run()
+	{
+	    for( size_t i=0; i<updates; i++ )
+		env->itemModified( layers[i % layers.size()] );
+	    queue->flush();
+	    return updates;
+	}
+
+	void tearDown()
+	{
+	    env.reset();
+	    queue.reset();
+	}
+
+    private:
+	size_t updates;
+	std::vector<Layer*> layers;
+	// the queue needs to outlive the environment
+	boost::scoped_ptr<CountingQueue> queue;
+	boost::scoped_ptr<Environment> env;
+    };
+
+    /**
+     * Builds a pose graph as a binary tree of frame nodes, with the
+     * transform of each node set after it is added, and a
+     * SynchronizationEventHandler attached. With transaction set, the tree
+     * is built in a single transaction, so that the handler gets the
+     * merged events as one batch.
+     */
+    class TransactionBenchmark : public Benchmark
+    {
+    public:
+	explicit TransactionBenchmark( bool transaction )
+	    : transaction( transaction ) {}
+
+	std::string getName() const { return transaction ? "frame_tree_transaction" : "frame_tree"; }
+	std::string getItemName() const { return "frame nodes"; }
+
+	void setup( const Parameters& params )
+	{
+	    env.reset( new Environment() );
+	    syncHandler.reset( new CountingSyncHandler() );
+	    env->addEventHandler( syncHandler.get() );
+	    // the frame nodes are detached one by one when the environment
+	    // is destroyed, which doesn't scale to the number of points
+	    nodes = params.points / 10;
+	}
+
+	size_t run()
+	{
+	    boost::scoped_ptr<Environment::Transaction> t;
+	    if( transaction )
+		t.reset( new Environment::Transaction( *env ) );
+
+	    std::vector<FrameNode*> fns;
+	    fns.reserve( nodes );
+	    for( size_t i=0; i<nodes; i++ )
+	    {
+		FrameNode* fn = new FrameNode();
+		env->addChild( fns.empty() ? env->getRootNode() : fns[(i-1)/2], fn );
+		fn->setTransform( Eigen::Affine3d( Eigen::Translation3d( 1.0, 0.0, 0.0 ) ) );
+		fns.push_back( fn );
+	    }
+
+	    if( t )
+		t->commit();
+	    return nodes;
+	}
+
+	void tearDown()
+	{
+	    env.reset();
+	    syncHandler.reset();
+	}
+
+    private:
+	bool transaction;
+	size_t nodes;
+	// the handler needs to outlive the environment
+	boost::scoped_ptr<CountingSyncHandler> syncHandler;
+	boost::scoped_ptr<Environment> env;
+    };
+}
+
+void envire::benchmarks::addEnvironmentBenchmarks( std::vector<Benchmark*>& benchmarks )
+{
+    benchmarks.push_back( new SerializationBenchmark() );
+    benchmarks.push_back( new EventBenchmark( false ) );
+    benchmarks.push_back( new EventBenchmark( true ) );
+    benchmarks.push_back( new QueueBenchmark() );
+    benchmarks.push_back( new TransactionBenchmark( false ) );
+    benchmarks.push_back( new TransactionBenchmark( true ) );
+}
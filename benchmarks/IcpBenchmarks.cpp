@@ -0,0 +1,65 @@
+#include "Benchmark.hpp"
+
+#include <envire/Core.hpp>
+#include "icp/icp.hpp"
+
+#include <boost/scoped_ptr.hpp>
+
+using namespace envire;
+using namespace envire::benchmarks;
+
+namespace
+{
+    /** aligns a scan of the terrain to a second scan of it, which is
+     * displaced by a few cm and a small rotation */
+    class IcpBenchmark : public Benchmark
+    {
+    public:
+	std::string getName() const { return "icp"; }
+	std::string getItemName() const { return "points"; }
+
+	void setup( const Parameters& params )
+	{
+	    env.reset( new Environment() );
+
+	    Pointcloud* model = new Pointcloud();
+	    env->attachItem( model );
+	    env->setFrameNode( model, env->getRootNode() );
+	    createScan( *model, params, params.seed );
+
+	    measurement = new Pointcloud();
+	    env->attachItem( measurement );
+	    FrameNode* fn = new FrameNode( Eigen::Affine3d(
+			Eigen::Translation3d( 0.05, -0.03, 0.02 )
+			* Eigen::AngleAxisd( 0.02, Eigen::Vector3d::UnitZ() ) ) );
+	    env->addChild( env->getRootNode(), fn );
+	    env->setFrameNode( measurement, fn );
+	    createScan( *measurement, params, params.seed + 1 );
+
+	    icp.reset( new icp::TrimmedKD() );
+	    icp->addToModel( icp::PointcloudAdapter( model, 1.0 ) );
+	}
+
+	size_t run()
+	{
+	    icp->align( icp::PointcloudAdapter( measurement, 1.0 ), 20, 1e-6, 1e-7, 0.95 );
+	    return measurement->vertices.size();
+	}
+
+	void tearDown()
+	{
+	    icp.reset();
+	    env.reset();
+	}
+
+    private:
+	boost::scoped_ptr<Environment> env;
+	Pointcloud* measurement;
+	boost::scoped_ptr<icp::TrimmedKD> icp;
+    };
+}
+
+void envire::benchmarks::addIcpBenchmarks( std::vector<Benchmark*>& benchmarks )
+{
+    benchmarks.push_back( new IcpBenchmark() );
+}
@@ -0,0 +1,545 @@
+#include "Benchmark.hpp"
+
+#include <envire/Core.hpp>
+#include <envire/maps/Grids.hpp>
+#include <envire/maps/ElevationGrid.hpp>
+#include <envire/maps/TraversabilityGrid.hpp>
+#include <envire/maps/TraversabilityFootprints.hpp>
+#include <envire/operators/MLSProjection.hpp>
+#include <envire/operators/MergeMLS.hpp>
+#include <envire/operators/MLSSlope.hpp>
+#include <envire/operators/MLSToGrid.hpp>
+#include <envire/operators/GridIllumination.hpp>
+#include <envire/operators/DistanceGridToPointcloud.hpp>
+#include <envire/operators/CutPointcloud.hpp>
+#include <envire/tools/GridAccess.hpp>
+#include <envire/operators/TraversabilityGrassfire.hpp>
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_real.hpp>
+#include <boost/random/variate_generator.hpp>
+#include <limits>
+
+using namespace envire;
+using namespace envire::benchmarks;
+
+namespace
+{
+    /** creates an MLSGrid in the root frame of the environment */
+    MLSGrid* createGrid( Environment& env, const Parameters& params )
+    {
+	MLSGrid* grid = new MLSGrid( params.size, params.size, params.scale, params.scale );
+	env.attachItem( grid );
+	env.setFrameNode( grid, env.getRootNode() );
+	return grid;
+    }
+
+    /** projects a scan into an MLSGrid with MLSProjection */
+    class ProjectionBenchmark : public Benchmark
+    {
+    public:
+	explicit ProjectionBenchmark( bool negativeInformation )
+	    : negativeInformation( negativeInformation ) {}
+
+	std::string getName() const { return negativeInformation ? "projection_free_space" : "projection"; }
+	std::string getItemName() const { return "points"; }
+
+	void setup( const Parameters& params )
+	{
+	    env.reset( new Environment() );
+	    MLSGrid* grid = createGrid( *env, params );
+
+	    pc = new Pointcloud();
+	    env->attachItem( pc );
+	    env->setFrameNode( pc, env->getRootNode() );
+	    createScan( *pc, params, params.seed );
+
+	    op = new MLSProjection();
+	    env->attachItem( op );
+	    op->addInput( pc );
+	    op->addOutput( grid );
+	    op->useUncertainty( false );
+	    op->useNegativeInformation( negativeInformation );
+	}
+
+	size_t run()
+	{
+	    op->updateAll();
+	    return pc->vertices.size();
+	}
+
+	void tearDown() { env.reset(); }
+
+    private:
+	bool negativeInformation;
+	boost::scoped_ptr<Environment> env;
+	Pointcloud* pc;
+	MLSProjection* op;
+    };
+
+    /** merges an MLSGrid into another one, which is slightly shifted and
+     * rotated, with MergeMLS */
+    class MergeBenchmark : public Benchmark
+    {
+    public:
+	std::string getName() const { return "mls_merge"; }
+	std::string getItemName() const { return "patches"; }
+
+	void setup( const Parameters& params )
+	{
+	    env.reset( new Environment() );
+	    MLSGrid* target = createGrid( *env, params );
+	    createSurface( *target, 0.0, params.seed );
+
+	    input = new MLSGrid( params.size, params.size, params.scale, params.scale );
+	    env->attachItem( input );
+	    FrameNode* fn = new FrameNode( Eigen::Affine3d(
+			Eigen::Translation3d( params.scale * 0.3, params.scale * 0.3, 0.02 )
+			* Eigen::AngleAxisd( 0.01, Eigen::Vector3d::UnitZ() ) ) );
+	    env->addChild( env->getRootNode(), fn );
+	    env->setFrameNode( input, fn );
+	    createSurface( *input, 0.0, params.seed + 1 );
+
+	    op = new MergeMLS();
+	    env->attachItem( op );
+	    op->addInput( input );
+	    op->addOutput( target );
+	}
+
+	size_t run()
+	{
+	    op->updateAll();
+	    return input->getCellCount();
+	}
+
+	void tearDown() { env.reset(); }
+
+    private:
+	boost::scoped_ptr<Environment> env;
+	MLSGrid* input;
+	MergeMLS* op;
+    };
+
+    /** computes the slopes of an MLSGrid with MLSSlope */
+    class SlopeBenchmark : public Benchmark
+    {
+    public:
+	std::string getName() const { return "mls_slope"; }
+	std::string getItemName() const { return "cells"; }
+
+	void setup( const Parameters& params )
+	{
+	    env.reset( new Environment() );
+	    MLSGrid* mls = createGrid( *env, params );
+	    createSurface( *mls, 0.0, params.seed );
+
+	    Grid<float>* slopes = new Grid<float>( params.size, params.size, params.scale, params.scale );
+	    env->attachItem( slopes );
+	    env->setFrameNode( slopes, env->getRootNode() );
+
+	    op = new MLSSlope();
+	    env->attachItem( op );
+	    op->addInput( mls );
+	    op->addOutput( slopes );
+	    cells = params.size * params.size;
+	}
+
+	size_t run()
+	{
+	    op->updateAll();
+	    return cells;
+	}
+
+	void tearDown() { env.reset(); }
+
+    private:
+	boost::scoped_ptr<Environment> env;
+	MLSSlope* op;
+	size_t cells;
+    };
+
+    /** extracts the elevation of an MLSGrid into an ElevationGrid with
+     * MLSToGrid */
+    class ElevationBenchmark : public Benchmark
+    {
+    public:
+	std::string getName() const { return "mls_to_grid"; }
+	std::string getItemName() const { return "cells"; }
+
+	void setup( const Parameters& params )
+	{
+	    env.reset( new Environment() );
+	    MLSGrid* mls = createGrid( *env, params );
+	    createSurface( *mls, 0.0, params.seed );
+
+	    ElevationGrid* grid = new ElevationGrid( params.size, params.size, params.scale, params.scale );
+	    env->attachItem( grid );
+	    env->setFrameNode( grid, env->getRootNode() );
+
+	    op = new MLSToGrid();
+	    env->attachItem( op );
+	    op->addInput( mls );
+	    op->setOutput( grid, ElevationGrid::ELEVATION );
+	    cells = params.size * params.size;
+	}
+
+	size_t run()
+	{
+	    op->updateAll();
+	    return cells;
+	}
+
+	void tearDown() { env.reset(); }
+
+    private:
+	boost::scoped_ptr<Environment> env;
+	MLSToGrid* op;
+	size_t cells;
+    };
+
+    /** computes the illumination of the terrain by a light source above
+     * the center of the map with GridIllumination */
+    class IlluminationBenchmark : public Benchmark
+    {
+    public:
+	std::string getName() const { return "grid_illumination"; }
+	std::string getItemName() const { return "cells"; }
+
+	void setup( const Parameters& params )
+	{
+	    env.reset( new Environment() );
+	    ElevationGrid* grid = new ElevationGrid( params.size, params.size, params.scale, params.scale );
+	    env->attachItem( grid );
+	    env->setFrameNode( grid, env->getRootNode() );
+
+	    ElevationGrid::ArrayType& elevation = grid->getGridData( ElevationGrid::ELEVATION_MAX );
+	    for( size_t y=0; y<params.size; y++ )
+		for( size_t x=0; x<params.size; x++ )
+		    elevation[y][x] = terrainHeight( (x + 0.5) * params.scale, (y + 0.5) * params.scale );
+
+	    op = new GridIllumination();
+	    env->attachItem( op );
+	    op->addOutput( grid );
+	    const double center = params.size * params.scale / 2.0;
+	    op->setLightSource( base::Vector3d( center, center, terrainHeight( center, center ) + 2.0 ), 0.5 );
+	    cells = params.size * params.size;
+	}
+
+	size_t run()
+	{
+	    op->updateAll();
+	    return cells;
+	}
+
+	void tearDown() { env.reset(); }
+
+    private:
+	boost::scoped_ptr<Environment> env;
+	GridIllumination* op;
+	size_t cells;
+    };
+
+    /** converts a DistanceGrid with a field of view of about 53 degrees
+     * into a Pointcloud with DistanceGridToPointcloud */
+    class DistanceGridBenchmark : public Benchmark
+    {
+    public:
+	std::string getName() const { return "distance_grid_to_pointcloud"; }
+	std::string getItemName() const { return "cells"; }
+
+	void setup( const Parameters& params )
+	{
+	    env.reset( new Environment() );
+	    DistanceGrid* grid = new DistanceGrid( params.size, params.size, 1.0 / params.size, 1.0 / params.size, -0.5, -0.5 );
+	    env->attachItem( grid );
+	    env->setFrameNode( grid, env->getRootNode() );
+
+	    // a slanted plane in front of the camera, with a hole in the
+	    // middle where there is no measurement
+	    DistanceGrid::ArrayType& distance = grid->getGridData( DistanceGrid::DISTANCE );
+	    for( size_t y=0; y<params.size; y++ )
+		for( size_t x=0; x<params.size; x++ )
+		{
+		    const double u = (x + 0.5) / params.size - 0.5, v = (y + 0.5) / params.size - 0.5;
+		    distance[y][x] = (u * u + v * v < 0.01) ?
+			std::numeric_limits<float>::quiet_NaN() : 5.0 + 2.0 * v;
+		}
+
+	    pc = new Pointcloud();
+	    env->attachItem( pc );
+	    env->setFrameNode( pc, env->getRootNode() );
+
+	    op = new DistanceGridToPointcloud();
+	    env->attachItem( op );
+	    op->addInput( grid );
+	    op->addOutput( pc );
+	    cells = params.size * params.size;
+	}
+
+	size_t run()
+	{
+	    op->updateAll();
+	    return cells;
+	}
+
+	void tearDown() { env.reset(); }
+
+    private:
+	boost::scoped_ptr<Environment> env;
+	Pointcloud* pc;
+	DistanceGridToPointcloud* op;
+	size_t cells;
+    };
+
+    /** classifies an MLSGrid with TraversabilityGrassfire, starting in the
+     * center of the map */
+    class TraversabilityBenchmark : public Benchmark
+    {
+    public:
+	std::string getName() const { return "traversability"; }
+	std::string getItemName() const { return "cells"; }
+
+	void setup( const Parameters& params )
+	{
+	    env.reset( new Environment() );
+	    MLSGrid* mls = createGrid( *env, params );
+	    createSurface( *mls, 0.0, params.seed );
+
+	    TraversabilityGrid* trav = new TraversabilityGrid( params.size, params.size, params.scale, params.scale );
+	    env->attachItem( trav );
+	    env->setFrameNode( trav, env->getRootNode() );
+
+	    TraversabilityGrassfire::Config config;
+	    config.maxStepHeight = 0.3;
+	    config.maxSlope = 0.6;
+	    config.robotHeight = 1.0;
+	    config.numTraversabilityClasses = 10;
+	    config.numNominalMeasurements = 1;
+
+	    op = new TraversabilityGrassfire();
+	    env->attachItem( op );
+	    op->addInput( mls );
+	    op->addOutput( trav );
+	    op->setConfig( config );
+	    const double center = params.size * params.scale / 2.0;
+	    op->setStartPosition( Eigen::Vector3d( center, center, terrainHeight( center, center ) ) );
+	}
+
+	size_t run()
+	{
+	    op->updateAll();
+	    return op->getStatistics().total;
+	}
+
+	void tearDown() { env.reset(); }
+
+    private:
+	boost::scoped_ptr<Environment> env;
+	TraversabilityGrassfire* op;
+    };
+    /** evaluates the worst traversability class of a robot footprint of
+     * 2x1m at random poses, either with TraversabilityFootprints or with
+     * the callback based
+     * TraversabilityGrid::getWorstTraversabilityClassInRectangle */
+    class FootprintBenchmark : public Benchmark
+    {
+    public:
+	explicit FootprintBenchmark( bool callback )
+	    : callback( callback ) {}
+
+	std::string getName() const { return callback ? "footprints_callback" : "footprints"; }
+	std::string getItemName() const { return "poses"; }
+
+	void setup( const Parameters& params )
+	{
+	    boost::variate_generator<boost::mt19937, boost::uniform_real<double> > 
+		uni( boost::mt19937( params.seed ), boost::uniform_real<double>( 0, 1 ) );
+
+	    grid.reset( new TraversabilityGrid( params.size, params.size, params.scale, params.scale ) );
+	    grid->setTraversabilityClass( 0, TraversabilityClass( 1.0 ) );
+	    grid->setTraversabilityClass( 1, TraversabilityClass( 0.5 ) );
+	    grid->setTraversabilityClass( 2, TraversabilityClass( 0.0 ) );
+
+	    // mostly free terrain, with some rough and some obstacle cells
+	    TraversabilityGrid::ArrayType& data( grid->getGridData( TraversabilityGrid::TRAVERSABILITY ) );
+	    for( size_t i=0; i<data.num_elements(); i++ )
+	    {
+		const double r = uni();
+		data.data()[i] = r < 0.01 ? 2 : r < 0.1 ? 1 : 0;
+	    }
+
+	    const double extent = params.size * params.scale;
+	    poses.clear();
+	    for( size_t i=0; i<params.points; i++ )
+		poses.push_back( base::Pose2D( Eigen::Vector2d( uni() * extent, uni() * extent ), 
+			    (uni() * 2.0 - 1.0) * M_PI ) );
+
+	    footprints.reset( new TraversabilityFootprints( *grid, 2.0, 1.0 ) );
+	}
+
+	size_t run()
+	{
+	    if( callback )
+	    {
+		for( size_t i=0; i<poses.size(); i++ )
+		    grid->getWorstTraversabilityClassInRectangle( poses[i], 2.0, 1.0 );
+	    }
+	    else
+		footprints->query( poses, results );
+	    return poses.size();
+	}
+
+	void tearDown() 
+	{ 
+	    footprints.reset();
+	    grid.reset(); 
+	}
+
+    private:
+	bool callback;
+	boost::scoped_ptr<TraversabilityGrid> grid;
+	boost::scoped_ptr<TraversabilityFootprints> footprints;
+	std::vector<base::Pose2D> poses;
+	std::vector<TraversabilityFootprints::Result> results;
+    };
+    /** cuts a scan with 200 boxes with CutPointcloud, one of which
+     * includes the center of the map, and the others exclude 1m cubes at
+     * random positions. The output is in a different frame than the
+     * input. */
+    class CutBenchmark : public Benchmark
+    {
+    public:
+	std::string getName() const { return "cut_pointcloud"; }
+	std::string getItemName() const { return "points"; }
+
+	void setup( const Parameters& params )
+	{
+	    boost::variate_generator<boost::mt19937, boost::uniform_real<double> > 
+		uni( boost::mt19937( params.seed ), boost::uniform_real<double>( 0, 1 ) );
+
+	    env.reset( new Environment() );
+	    pc = new Pointcloud();
+	    env->attachItem( pc );
+	    env->setFrameNode( pc, env->getRootNode() );
+	    createScan( *pc, params, params.seed );
+
+	    Pointcloud* cut = new Pointcloud();
+	    env->attachItem( cut );
+	    FrameNode* fn = new FrameNode( Eigen::Affine3d( 
+			Eigen::Translation3d( 1.0, 2.0, 0.5 ) * Eigen::AngleAxisd( 0.5, Eigen::Vector3d::UnitZ() ) ) );
+	    env->addChild( env->getRootNode(), fn );
+	    env->setFrameNode( cut, fn );
+
+	    const double extent = params.size * params.scale;
+	    boxes.resize( 200 );
+	    boxes[0].box = Eigen::AlignedBox<double,3>( 
+		    Eigen::Vector3d( extent * 0.1, extent * 0.1, -10.0 ), Eigen::Vector3d( extent * 0.9, extent * 0.9, 10.0 ) );
+	    boxes[0].exclude = false;
+	    for( size_t i=1; i<boxes.size(); i++ )
+	    {
+		const Eigen::Vector3d c( uni() * extent, uni() * extent, uni() * 2.0 - 1.0 );
+		boxes[i].box = Eigen::AlignedBox<double,3>( c, c + Eigen::Vector3d::Ones() );
+	    }
+
+	    op = new CutPointcloud();
+	    env->attachItem( op );
+	    for( size_t i=0; i<boxes.size(); i++ )
+		op->addBox( &boxes[i] );
+	    op->addInput( pc );
+	    op->addOutput( cut );
+	}
+
+	size_t run()
+	{
+	    op->updateAll();
+	    return pc->vertices.size();
+	}
+
+	void tearDown() { env.reset(); }
+
+    private:
+	boost::scoped_ptr<Environment> env;
+	// the operator keeps pointers to the boxes
+	std::vector<ExclusionBox> boxes;
+	Pointcloud* pc;
+	CutPointcloud* op;
+    };
+    /** looks up the elevation of the closest scan point in the xy plane
+     * for random positions with PointcloudAccess, either one at a time
+     * or as a batch on multiple threads */
+    class PointcloudAccessBenchmark : public Benchmark
+    {
+    public:
+	explicit PointcloudAccessBenchmark( bool batch )
+	    : batch( batch ) {}
+
+	std::string getName() const { return batch ? "pointcloud_access_batch" : "pointcloud_access"; }
+	std::string getItemName() const { return "queries"; }
+
+	void setup( const Parameters& params )
+	{
+	    boost::variate_generator<boost::mt19937, boost::uniform_real<double> > 
+		uni( boost::mt19937( params.seed ), boost::uniform_real<double>( 0, 1 ) );
+
+	    env.reset( new Environment() );
+	    Pointcloud* pc = new Pointcloud();
+	    env->attachItem( pc );
+	    env->setFrameNode( pc, env->getRootNode() );
+	    createScan( *pc, params, params.seed );
+
+	    const double extent = params.size * params.scale;
+	    positions.clear();
+	    for( size_t i=0; i<params.points; i++ )
+		positions.push_back( Eigen::Vector3d( uni() * extent, uni() * extent, 0 ) );
+
+	    // the search structure is built in the constructor
+	    access.reset( new PointcloudAccess( env.get() ) );
+	    threshold = params.scale;
+	}
+
+	size_t run()
+	{
+	    std::vector<Eigen::Vector3d> queries( positions );
+	    if( batch )
+		access->getElevations( queries, found, threshold );
+	    else
+	    {
+		for( size_t i=0; i<queries.size(); i++ )
+		    access->getElevation( queries[i], threshold );
+	    }
+	    return queries.size();
+	}
+
+	void tearDown()
+	{
+	    access.reset();
+	    env.reset();
+	}
+
+    private:
+	bool batch;
+	double threshold;
+	boost::scoped_ptr<Environment> env;
+	boost::scoped_ptr<PointcloudAccess> access;
+	std::vector<Eigen::Vector3d> positions;
+	std::vector<bool> found;
+    };
+}
+
+void envire::benchmarks::addMapBenchmarks( std::vector<Benchmark*>& benchmarks )
+{
+    benchmarks.push_back( new ProjectionBenchmark( false ) );
+    benchmarks.push_back( new ProjectionBenchmark( true ) );
+    benchmarks.push_back( new MergeBenchmark() );
+    benchmarks.push_back( new SlopeBenchmark() );
+    benchmarks.push_back( new ElevationBenchmark() );
+    benchmarks.push_back( new IlluminationBenchmark() );
+    benchmarks.push_back( new DistanceGridBenchmark() );
+    benchmarks.push_back( new TraversabilityBenchmark() );
+    benchmarks.push_back( new FootprintBenchmark( false ) );
+    benchmarks.push_back( new FootprintBenchmark( true ) );
+    benchmarks.push_back( new CutBenchmark() );
+    benchmarks.push_back( new PointcloudAccessBenchmark( false ) );
+    benchmarks.push_back( new PointcloudAccessBenchmark( true ) );
+}
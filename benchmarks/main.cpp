@@ -0,0 +1,130 @@
+#include "Benchmark.hpp"
+
+#include <boost/program_options.hpp>
+
+#include <fstream>
+#include <iostream>
+#include <set>
+
+using namespace envire::benchmarks;
+using namespace std;
+
+namespace po = boost::program_options;
+
+/**
+ * Runs the benchmarks of the map and operator hot paths on synthetic
+ * workloads, and writes a JSON object per benchmark and workload size to
+ * a line of the output. The workloads only depend on the parameters, so
+ * the results of different builds or releases can be compared.
+ *
+ * usage: envire_benchmarks [options] [benchmark...]
+ */
+int main( int argc, char* argv[] )
+{
+    Parameters defaults;
+    vector<size_t> sizes, points;
+    vector<string> names;
+    string output;
+    Parameters params;
+
+    po::options_description desc("Allowed options");
+    desc.add_options()
+	("help", "produce help message")
+	("list", "list the available benchmarks")
+	("size", po::value< vector<size_t> >(&sizes)->multitoken(), "number of cells of the maps in x and y, can be given more than once")
+	("points", po::value< vector<size_t> >(&points)->multitoken(), "number of points of the scans, or events, can be given more than once")
+	("repetitions", po::value<size_t>(&params.repetitions)->default_value(defaults.repetitions), "number of timed runs of each benchmark")
+	("scale", po::value<double>(&params.scale)->default_value(defaults.scale), "size of a cell in m")
+	("seed", po::value<unsigned int>(&params.seed)->default_value(defaults.seed), "seed of the synthetic data")
+	("output", po::value<string>(&output), "file to write the results to, instead of stdout")
+	("benchmark", po::value< vector<string> >(&names), "benchmarks to run, all if not given")
+	;
+    po::positional_options_description positional;
+    positional.add("benchmark", -1);
+
+    po::variables_map vm;
+    try
+    {
+	po::store(po::command_line_parser(argc, argv).options(desc).positional(positional).run(), vm);
+	po::notify(vm);
+    }
+    catch( const po::error& e )
+    {
+	cerr << e.what() << endl << desc << endl;
+	return 1;
+    }
+    if( vm.count("help") )
+    {
+	cout << desc << endl;
+	return 0;
+    }
+
+    vector<Benchmark*> benchmarks;
+    addMapBenchmarks( benchmarks );
+    addIcpBenchmarks( benchmarks );
+    addEnvironmentBenchmarks( benchmarks );
+
+    if( vm.count("list") )
+    {
+	for( size_t i=0; i<benchmarks.size(); i++ )
+	    cout << benchmarks[i]->getName() << endl;
+	return 0;
+    }
+
+    set<string> selected( names.begin(), names.end() );
+    for( size_t i=0; i<benchmarks.size(); i++ )
+	selected.erase( benchmarks[i]->getName() );
+    if( !selected.empty() )
+    {
+	cerr << "unknown benchmark " << *selected.begin() << endl;
+	return 1;
+    }
+    selected.insert( names.begin(), names.end() );
+
+    if( sizes.empty() )
+	sizes.push_back( defaults.size );
+    if( points.empty() )
+	points.push_back( defaults.points );
+
+    ofstream file;
+    if( !output.empty() )
+    {
+	file.open( output.c_str() );
+	if( !file )
+	{
+	    cerr << "could not open " << output << endl;
+	    return 1;
+	}
+    }
+    ostream& os( output.empty() ? cout : file );
+
+    int result = 0;
+    for( size_t i=0; i<benchmarks.size(); i++ )
+    {
+	if( !selected.empty() && !selected.count( benchmarks[i]->getName() ) )
+	    continue;
+
+	for( size_t s=0; s<sizes.size(); s++ )
+	{
+	    for( size_t p=0; p<points.size(); p++ )
+	    {
+		params.size = sizes[s];
+		params.points = points[p];
+		try
+		{
+		    writeJson( os, measure( *benchmarks[i], params ) );
+		}
+		catch( const std::exception& e )
+		{
+		    cerr << benchmarks[i]->getName() << ": " << e.what() << endl;
+		    result = 1;
+		}
+	    }
+	}
+    }
+
+    for( size_t i=0; i<benchmarks.size(); i++ )
+	delete benchmarks[i];
+
+    return result;
+}
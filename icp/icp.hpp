@@ -14,6 +14,7 @@
 #include <envire/core/EnvironmentItem.hpp>
 #include <envire/core/FrameNode.hpp>
 #include <envire/maps/Pointcloud.hpp>
+#include <envire/core/Instrumentation.hpp>
 
 #include <boost/random/linear_congruential.hpp>
 #include <boost/random/uniform_real.hpp>
@@ -101,7 +102,7 @@ class PointcloudAdapter
 public:
     PointcloudAdapter( envire::Pointcloud* model, double density )
 	: model(model), index( 0.0 ),
-	vertices( &model->vertices ), 
+	view( model->getView() ), 
 	density( density )
     {
 	envire::FrameNode* fm = model->getFrameNode();
@@ -127,14 +128,14 @@ public:
     {
 	VertexNode n;
 	const size_t idx = index;
-	n.point = C_local2globalnew * (*vertices)[idx];
+	n.point = C_local2globalnew * view.point( idx );
 	index += 1.0/density;
 	return n;
     }
     bool hasNext() const
     {
 	const size_t idx = index;
-	return idx < vertices->size();
+	return idx < view.size();
     }
     void reset() 
     {
@@ -142,7 +143,7 @@ public:
     }
     size_t size() const
     {
-	return vertices->size() * density;
+	return view.size() * density;
     }
 
     void applyTransform(const Eigen::Affine3d& C_global2globalnew)
@@ -166,7 +167,7 @@ protected:
     Eigen::Affine3d C_local2global, C_local2globalnew;
 
     double index;
-    const std::vector<Eigen::Vector3d> *vertices;
+    envire::PointcloudView view;
     double density;
 };
 
@@ -176,25 +177,21 @@ public:
     PointcloudEdgeAndNormalAdapter( envire::Pointcloud* model, double density )
 	: PointcloudAdapter( model, density ) 
     {
-	attrs = &model->getVertexData<envire::Pointcloud::vertex_attr>(envire::Pointcloud::VERTEX_ATTRIBUTES);
-	normals = &model->getVertexData<Eigen::Vector3d>(envire::Pointcloud::VERTEX_NORMAL);
-
+	// note: if the pointcloud has no normals, the points get a zero
+	// normal and are rejected by the EdgeAndNormalPairFilter
     }
 
     VertexEdgeAndNormalNode next() 
     {
 	VertexEdgeAndNormalNode n;
 	const size_t idx = index;
-	n.point = C_local2globalnew * (*vertices)[idx];
-	n.edge = (*attrs)[idx] & (1 << envire::Pointcloud::SCAN_EDGE);
-	n.normal = C_local2globalnew.linear() * (*normals)[idx];
+	n.point = C_local2globalnew * view.point( idx );
+	n.edge = view.hasAttributes() && (view.attribute( idx ) & (1 << envire::Pointcloud::SCAN_EDGE));
+	n.normal = view.hasNormals() ? 
+	    Eigen::Vector3d( C_local2globalnew.linear() * view.normal( idx ) ) : Eigen::Vector3d::Zero();
 	index += 1.0/density;
 	return n;
     }
-
-private:
-    std::vector<Eigen::Vector3d> *normals;
-    std::vector<envire::Pointcloud::vertex_attr> *attrs;
 };
 
 template <class T>
@@ -384,6 +381,7 @@ public:
      */
     void align( _Adapter measurement, size_t max_iter, double min_mse, double min_mse_diff, double alpha, double beta, double eps )
     {
+	ENVIRE_SCOPED_TIMER( "ICP::align" );
       
 	typedef Trimmed<_Adapter, _FindPairs> t;
 
@@ -412,6 +410,7 @@ public:
      */
     void align( _Adapter measurement, size_t max_iter, double min_mse, double min_mse_diff, double overlap )
     {
+	ENVIRE_SCOPED_TIMER( "ICP::align" );
 	
 	minResult = _align( measurement, max_iter, min_mse, min_mse_diff, overlap );
 	measurement.applyTransform( minResult.C_global2globalnew );
@@ -199,8 +199,7 @@ ICPResult ICPLocalization::doScanMatch(struct ICPInputData& inputData, bool save
 
     inputData.fn = fn;
     
-    // run the icp
-    base::TimeMark m1("icp");
+    // run the icp, which is timed by the instrumentation
     icp.align( envire::icp::PointcloudAdapter( pc, conf.measurement_density ),  conf.max_iterations, conf.min_mse, conf.min_mse_diff, conf.overlap );
     
     ICPResult result;
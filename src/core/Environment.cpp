@@ -3,6 +3,7 @@
 #include "EventHandler.hpp"
 #include "Serialization.hpp"
 #include "Operator.hpp"
+#include "Instrumentation.hpp"
 
 #include <algorithm>
 #include <utility>
@@ -21,8 +22,21 @@ using namespace envire;
 
 const std::string EnvironmentItem::className = "envire::EnvironmentItem";
 
-void envire::intrusive_ptr_add_ref( EnvironmentItem* item ) { item->ref_count++; }
-void envire::intrusive_ptr_release( EnvironmentItem* item ) { if(!--item->ref_count) delete item; }
+void envire::intrusive_ptr_add_ref( EnvironmentItem* item ) 
+{ 
+    item->ref_count.fetch_add( 1, boost::memory_order_relaxed ); 
+}
+
+void envire::intrusive_ptr_release( EnvironmentItem* item ) 
+{ 
+    // the release makes the writes to the item visible to the thread which
+    // deletes it
+    if( item->ref_count.fetch_sub( 1, boost::memory_order_release ) == 1 )
+    {
+	boost::atomic_thread_fence( boost::memory_order_acquire );
+	delete item; 
+    }
+}
 
 EnvironmentItem::EnvironmentItem(std::string const& unique_id)
     : ref_count(0), unique_id(unique_id), env(NULL)
@@ -126,6 +140,8 @@ void EnvironmentItem::itemModified()
 {
     if( isAttached() )
 	env->itemModified(this);
+    else
+	invalidateCaches();
 }
 
 EnvironmentItem::Ptr EnvironmentItem::detach()
@@ -136,7 +152,8 @@ EnvironmentItem::Ptr EnvironmentItem::detach()
 
 const std::string Environment::ITEM_NOT_ATTACHED = "";
 
-Environment::Environment() : last_id(0), synchronizationEventQueue(NULL),envPrefix("/")
+Environment::Environment() : last_id(0), synchronizationEventQueue(NULL),envPrefix("/"),
+    transactionDepth(0), transactionEvents(new EventBuffer(true)), frameGeneration(1), frameVersion(0)
 {
     // each environment has a root node
     rootNode = new FrameNode();
@@ -148,6 +165,10 @@ Environment::Environment() : last_id(0), synchronizationEventQueue(NULL),envPref
 
 Environment::~Environment() 
 {
+    // pending events of a transaction are not published anymore
+    transactionDepth = 0;
+    transactionEvents->clear();
+
     // perform a delete on all the owned objects
     itemListType::iterator it;
     while( (it = items.begin()) != items.end() )
@@ -171,11 +192,57 @@ void Environment::publishChilds(EventHandler *evl, FrameNode *parent)
 
 void Environment::handle( const Event& event )
 {
-    eventHandlers.handle( event );
+    if( transactionDepth > 0 )
+    {
+	// the ids are needed for merging the events
+	Event buffered( event );
+	if( buffered.a ) buffered.id_a = buffered.a->getUniqueId();
+	if( buffered.b ) buffered.id_b = buffered.b->getUniqueId();
+	transactionEvents->push( buffered );
+    }
+    else
+	eventHandlers.handle( event );
+}
+
+void Environment::beginTransaction()
+{
+    transactionDepth++;
+}
+
+void Environment::commitTransaction()
+{
+    if( transactionDepth <= 0 )
+	throw std::runtime_error("Environment: commitTransaction called without a transaction.");
+
+    if( --transactionDepth == 0 )
+	publishTransaction();
+}
+
+void Environment::abortTransaction()
+{
+    if( transactionDepth <= 0 )
+	throw std::runtime_error("Environment: abortTransaction called without a transaction.");
+
+    if( --transactionDepth == 0 )
+	transactionEvents->clear();
+}
+
+void Environment::publishTransaction()
+{
+    if( transactionEvents->empty() )
+	return;
+
+    std::vector<Event> events( transactionEvents->begin(), transactionEvents->end() );
+    transactionEvents->clear();
+    eventHandlers.handle( events );
 }
 
 void Environment::addEventHandler(EventHandler *handler) 
 {
+    // the new handler gets the current state of the environment, so the
+    // other handlers need to get the buffered events first
+    publishTransaction();
+
     //new listener was added, iterate over all items and 
     //attach them at the listener
     for(itemListType::iterator it = items.begin(); it != items.end(); it++) 
@@ -224,6 +291,8 @@ void Environment::detachChilds(FrameNode *parent, EventHandler *evl)
 
 void Environment::removeEventHandler(EventHandler *handler) 
 {
+    publishTransaction();
+
     //reverse iterate over the frame node tree and detach all children    
     detachChilds(getRootNode(), handler);
     
@@ -388,6 +457,13 @@ EnvironmentItem::Ptr Environment::detachItem(EnvironmentItem* item, bool deep)
     }
 
     handle( Event( event::ITEM, event::REMOVE, item ) );
+
+    if( FrameNode* fn = dynamic_cast<FrameNode*>( item ) )
+    {
+	boost::lock_guard<boost::mutex> lock( rootTransformMutex );
+	rootTransforms.erase( fn );
+	frameGeneration++;
+    }
     
     EnvironmentItem::Ptr itemPtr = items[ item->getUniqueId() ];
     items.erase( item->getUniqueId() );
@@ -398,6 +474,7 @@ EnvironmentItem::Ptr Environment::detachItem(EnvironmentItem* item, bool deep)
 
 void Environment::itemModified(EnvironmentItem* item) 
 {
+    item->invalidateCaches();
     handle( Event( event::ITEM, event::UPDATE, item ) );
 }
 
@@ -419,6 +496,7 @@ void Environment::addChild(FrameNode* parent, FrameNode* child)
     }
 
     frameNodeTree.insert(make_pair(child, parent));
+    invalidateFrameCache( child );
     
     handle( Event( event::FRAMENODE_TREE, event::ADD, parent, child ) );
 }
@@ -454,6 +532,7 @@ void Environment::removeChild(FrameNode* parent, FrameNode* child)
 	handle( Event( event::FRAMENODE_TREE, event::REMOVE, parent, child ) );
 
 	frameNodeTree.erase( frameNodeTree.find( child ) );
+	invalidateFrameCache( child );
     }
 }
 
@@ -732,53 +811,102 @@ void Environment::updateOperators(){
 
     for(std::vector<envire::Operator*>::iterator it=ops.begin();it!=ops.end();it++)
     {
-	(*it)->updateAll();
+	{
+	    ENVIRE_SCOPED_TIMER( (*it)->getClassName().c_str() );
+	    (*it)->updateAll();
+	}
 	
 	std::list<Layer*> outs = getOutputs(*it);
 	for (std::list<Layer*>::iterator out = outs.begin();out != outs.end();out++){
 	    itemModified(*out);
 	}
     }
-}
-
-template <class T> 
-T getTransform( const FrameNode* fn ) { return fn->getTransform(); }
 
-template <>
-TransformWithUncertainty getTransform( const FrameNode* fn ) { return fn->getTransformWithUncertainty(); }
+    ENVIRE_END_CYCLE();
+}
 
-template <class T>
-std::pair<T, const FrameNode*> relativeFrameNodeRoot( const FrameNode* from )
+const Environment::RootTransform& Environment::getRootTransform( const FrameNode* fn )
 {
-    T C_fg(envire::Transform(Eigen::Affine3d::Identity()));
+    // walk up to the first entry which has been checked since the last
+    // change, or to the root. This is iterative, since pose graphs can
+    // have very long chains.
+    std::vector<const FrameNode*> path;
+    RootTransform* parent = NULL;
+    for( const FrameNode* node = fn; ; node = node->getParent() )
+    {
+	RootTransformCache::iterator it = rootTransforms.find( node );
+	if( it != rootTransforms.end() && it->second.generation == frameGeneration )
+	{
+	    parent = &it->second;
+	    break;
+	}
+	path.push_back( node );
+	if( node->isRoot() )
+	    break;
+    }
 
-    const FrameNode *t = from;
-    while(!t->isRoot())
+    // and compose downwards, where only the entries which don't match
+    // their parent anymore are computed again. The map doesn't move its
+    // entries, so the pointer to the parent stays valid.
+    for( std::vector<const FrameNode*>::reverse_iterator it = path.rbegin(); it != path.rend(); it++ )
     {
-	C_fg = getTransform<T>(t) * C_fg;
-	t = t->getParent();
+	const FrameNode* node = *it;
+	RootTransform& entry( rootTransforms[node] );
+	if( !parent )
+	{
+	    // the root of the tree
+	    if( !entry.version )
+	    {
+		entry.transform = TransformWithUncertainty::Identity();
+		entry.root = node;
+		entry.version = ++frameVersion;
+	    }
+	}
+	else if( !entry.version || entry.parentVersion != parent->version )
+	{
+	    // the first order propagation is not exact for products with the
+	    // identity, so the children of the root take their transform as is
+	    if( parent->root == node->getParent() )
+		entry.transform = node->getTransformWithUncertainty();
+	    else
+		entry.transform = parent->transform * node->getTransformWithUncertainty();
+	    entry.root = parent->root;
+	    entry.parentVersion = parent->version;
+	    entry.version = ++frameVersion;
+	}
+	entry.generation = frameGeneration;
+	parent = &entry;
     }
-    return make_pair( C_fg, t );
+    return *parent;
 }
 
-template <class T>
-T relativeTransform(const FrameNode* from, const FrameNode* to)
+void Environment::invalidateFrameCache()
 {
-    if (from == to)
-        return T( Eigen::Affine3d::Identity() );
-
-    std::pair<T, const FrameNode*> fg = relativeFrameNodeRoot<T>(from);
-    std::pair<T, const FrameNode*> tg = relativeFrameNodeRoot<T>(to);
-
-    if( fg.second != tg.second )
-	throw std::runtime_error("relativeTransform: FrameNodes don't have a common root.");
+    boost::lock_guard<boost::mutex> lock( rootTransformMutex );
+    rootTransforms.clear();
+    frameGeneration++;
+}
 
-    return T( tg.first.inverse() * fg.first );
+void Environment::invalidateFrameCache( const FrameNode* fn )
+{
+    boost::lock_guard<boost::mutex> lock( rootTransformMutex );
+    rootTransforms.erase( fn );
+    frameGeneration++;
 }
 
 Transform Environment::relativeTransform(const FrameNode* from, const FrameNode* to)
 {
-    return ::relativeTransform<Transform>( from, to );
+    if (from == to)
+        return Transform( Eigen::Affine3d::Identity() );
+
+    boost::lock_guard<boost::mutex> lock( rootTransformMutex );
+    const RootTransform &fg( getRootTransform( from ) ), &tg( getRootTransform( to ) );
+    if( fg.root != tg.root )
+	throw std::runtime_error("relativeTransform: FrameNodes don't have a common root.");
+    if( to == tg.root )
+	return fg.transform.getTransform();
+
+    return Transform( tg.transform.getTransform().inverse() * fg.transform.getTransform() );
 }
 
 Transform Environment::relativeTransform(const CartesianMap* from, const CartesianMap* to)
@@ -788,7 +916,17 @@ Transform Environment::relativeTransform(const CartesianMap* from, const Cartesi
 
 TransformWithUncertainty Environment::relativeTransformWithUncertainty(const FrameNode* from, const FrameNode* to)
 {
-    return ::relativeTransform<TransformWithUncertainty>( from, to );
+    if (from == to)
+        return TransformWithUncertainty::Identity();
+
+    boost::lock_guard<boost::mutex> lock( rootTransformMutex );
+    const RootTransform &fg( getRootTransform( from ) ), &tg( getRootTransform( to ) );
+    if( fg.root != tg.root )
+	throw std::runtime_error("relativeTransform: FrameNodes don't have a common root.");
+    if( to == tg.root )
+	return fg.transform;
+
+    return tg.transform.inverse() * fg.transform;
 }
 
 TransformWithUncertainty Environment::relativeTransformWithUncertainty(const CartesianMap* from, const CartesianMap* to)
@@ -6,6 +6,15 @@
 #include <envire/core/Transform.hpp>
 #include "EnvironmentItem.hpp"
 
+#include <boost/thread/shared_mutex.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/unordered_map.hpp>
+
+#include <exception>
+
 namespace envire
 {
     class Environment;
@@ -15,6 +24,7 @@ namespace envire
     class Operator;
     class CartesianMap;
     class EventHandler;
+    class EventBuffer;
     class SynchronizationEventQueue;
     class Event;
     class SerializationFactory;
@@ -23,6 +33,28 @@ namespace envire
      * of these.  all dependencies between the objects are handled in the
      * environment class, and convenience methods of the individual objects are
      * available to simplify usage.
+     *
+     * The environment and its items are not synchronized internally. When
+     * they are accessed from multiple threads, the reader/writer lock of
+     * the environment (getMutex()) has to be used:
+     *
+     * - threads which only read from the environment and its items, e.g.
+     *   with relativeTransform() or the const methods of the maps, hold a
+     *   ReadLock for the duration of the access. Any number of readers can
+     *   run concurrently. The const methods of the maps don't modify any
+     *   state, in particular they never detach data which is shared with
+     *   a copy (see Layer::getData()).
+     * - the thread which modifies the structure of the environment or the
+     *   content of its items holds a WriteLock while doing so. This
+     *   includes the calls to itemModified(), and applying events with an
+     *   EventProcessor.
+     *
+     * The lock is not taken by the environment itself, so a single threaded
+     * application doesn't pay for it. Reference counting of the items is
+     * atomic, so that EnvironmentItem::Ptr can be copied and released by
+     * readers. Readers which need the data for longer can also take a
+     * copy of an item under the ReadLock, since the layer data is shared
+     * with copies until it is modified.
      */
     class Environment 
     {
@@ -35,6 +67,9 @@ namespace envire
     public:
 	static const std::string ITEM_NOT_ATTACHED;
 
+	typedef boost::shared_lock<boost::shared_mutex> ReadLock;
+	typedef boost::unique_lock<boost::shared_mutex> WriteLock;
+
     protected:
 	typedef std::map<std::string, EnvironmentItem::Ptr > itemListType;
 	typedef std::map<FrameNode*, FrameNode*> frameNodeTreeType;
@@ -57,12 +92,74 @@ namespace envire
         std::string envPrefix;
 
 	EventSource eventHandlers;
+
+	/** reader/writer lock for the environment, see the class
+	 * documentation */
+	mutable boost::shared_mutex mutex;
+
+	/** nesting depth of the transactions, and the events which have been
+	 * buffered during the transaction */
+	int transactionDepth;
+	boost::scoped_ptr<EventBuffer> transactionEvents;
+	/** passes the buffered events of the transaction to the handlers */
+	void publishTransaction();
+
+	/** transformation from a frame node to the root of its tree, which is
+	 * cached for relativeTransform().
+	 *
+	 * Each computed entry gets a new version, and stores the version of
+	 * the parent entry it was composed from. An entry is erased when its
+	 * frame or the parent of its frame changes, so the entries below it
+	 * don't match the version of their parent anymore and are composed
+	 * again. */
+	struct RootTransform
+	{
+	    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+	    RootTransform() : root( NULL ), version( 0 ), parentVersion( 0 ), generation( 0 ) {}
+
+	    TransformWithUncertainty transform;
+	    const FrameNode* root;
+	    /** 0 for an entry which has not been computed yet */
+	    unsigned long version;
+	    unsigned long parentVersion;
+	    /** the frameGeneration in which the entry was checked against
+	     * its parents the last time */
+	    unsigned long generation;
+	};
+	typedef boost::unordered_map<const FrameNode*, RootTransform, 
+		boost::hash<const FrameNode*>, std::equal_to<const FrameNode*>,
+		Eigen::aligned_allocator<std::pair<const FrameNode* const, RootTransform> > > RootTransformCache;
+	RootTransformCache rootTransforms;
+	/** incremented when a frame node or the frame tree changes. Entries
+	 * of the current generation are valid without checking their
+	 * parents. */
+	unsigned long frameGeneration;
+	/** last version given to a cache entry */
+	unsigned long frameVersion;
+	/** the cache is also filled by readers */
+	boost::mutex rootTransformMutex;
+
+	/** @return the cached transformation from fn to its root. The
+	 * entries from fn up to the first one which is known to be valid are
+	 * checked, and the invalid ones are composed from their parent.
+	 * Needs to be called with the rootTransformMutex locked. */
+	const RootTransform& getRootTransform( const FrameNode* fn );
+
 	void publishChilds(EventHandler* handler, FrameNode *parent);
 	void detachChilds(FrameNode *parent, EventHandler* handler);
 
     public:
         Environment();
 	virtual ~Environment();
+
+	/** @return the reader/writer lock which is used to synchronize the
+	 * access to the environment from multiple threads, e.g.
+	 *
+	 * @code
+	 * Environment::ReadLock lock( env->getMutex() );
+	 * @endcode
+	 */
+	boost::shared_mutex& getMutex() const { return mutex; }
         
 	/** attaches an EnvironmentItem and puts it under the control of the Environment.
 	 * Object ownership is passed to the environment in this way.
@@ -92,6 +189,20 @@ namespace envire
 	* method.
 	**/
 	void itemModified(EnvironmentItem* item);
+
+	/** 
+	 * Invalidates the cached transformations of the frame nodes to
+	 * their root, which are used by relativeTransform().
+	 */
+	void invalidateFrameCache();
+
+	/** 
+	 * Invalidates the cached transformations to the root of the frame
+	 * node and the frames below it. This is called automatically when a
+	 * frame node, or its parent in the frame tree, is modified through
+	 * the environment.
+	 */
+	void invalidateFrameCache( const FrameNode* fn );
 	
 	EnvironmentItem::Ptr getItem( const std::string& uniqueId ) const
 	{
@@ -296,10 +407,101 @@ namespace envire
 	void removeEventHandler(EventHandler *handler);
 
 	/**
-	 * will pass the @param event to the registered event handlers
+	 * will pass the @param event to the registered event handlers, or
+	 * buffer it if a transaction is active
 	 */
 	void handle( const Event& event );
 
+	/**
+	 * Starts a transaction. Until the transaction is committed, the
+	 * events of the environment are not passed to the event handlers, but
+	 * buffered and merged. Events which cancel each other (e.g. attaching
+	 * and detaching an item) are removed, and updates of items which have
+	 * been attached in the transaction are dropped.
+	 *
+	 * The modifications themselves are applied immediately, there is no
+	 * rollback. Transactions can be nested, the events are published when
+	 * the outermost transaction is committed.
+	 */
+	void beginTransaction();
+
+	/**
+	 * Commits a transaction started with beginTransaction(). For the
+	 * outermost transaction, the buffered events are passed to the event
+	 * handlers as one batch.
+	 */
+	void commitTransaction();
+
+	/**
+	 * Ends a transaction started with beginTransaction() without
+	 * publishing it. For the outermost transaction, the buffered events
+	 * are discarded. As the modifications are not rolled back, the event
+	 * handlers don't match the environment anymore, and need to be
+	 * removed and added again to get its current state.
+	 */
+	void abortTransaction();
+
+	/** @return true if a transaction is active */
+	bool inTransaction() const { return transactionDepth > 0; }
+
+	/** Transaction which is started in the constructor, and ended with
+	 * commit() or abort(). Calls after the first one are ignored.
+	 *
+	 * With std::uncaught_exceptions() (C++17), a transaction which is
+	 * still active when it goes out of scope is committed, or aborted if
+	 * the scope is left by an exception, so that no event handlers are
+	 * called during the stack unwinding. Without it, the destructor
+	 * can't tell the two cases apart, and always aborts, so that the
+	 * transaction needs to be committed explicitly.
+	 */
+	class Transaction : boost::noncopyable
+	{
+	    Environment& env;
+	    bool active;
+#ifdef __cpp_lib_uncaught_exceptions
+	    /** the number of exceptions in flight at the start */
+	    int exceptions;
+#endif
+
+	public:
+	    explicit Transaction( Environment& env )
+		: env( env ), active( true )
+#ifdef __cpp_lib_uncaught_exceptions
+		, exceptions( std::uncaught_exceptions() )
+#endif
+	    { env.beginTransaction(); }
+
+	    ~Transaction()
+	    {
+#ifdef __cpp_lib_uncaught_exceptions
+		if( std::uncaught_exceptions() > exceptions )
+		    abort();
+		else
+		    commit();
+#else
+		abort();
+#endif
+	    }
+
+	    void commit()
+	    {
+		if( active )
+		{
+		    active = false;
+		    env.commitTransaction();
+		}
+	    }
+
+	    void abort()
+	    {
+		if( active )
+		{
+		    active = false;
+		    env.abortTransaction();
+		}
+	    }
+	};
+
 	/**
 	 * returns all items of a particular type
 	 */
@@ -332,6 +534,11 @@ namespace envire
          * the frame represented by @a to. This always defines an unique
          * transformation, as the frames are sorted in a tree.
 	 *
+	 * The transformations of the frames to the root are cached, so that
+	 * after a change only the frames below the changed one are
+	 * recomputed, and each of them with a single composition. The other
+	 * frames on the path to the root are only checked.
+	 *
 	 * relativeTransform( child, child->getParent() ) is equivalent to
 	 * child->getTransform().
          */
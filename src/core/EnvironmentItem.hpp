@@ -4,6 +4,7 @@
 #include <envire/core/Transform.hpp>
 #include <envire/core/Serialization.hpp>
 #include <boost/intrusive_ptr.hpp>
+#include <boost/atomic.hpp>
 #include <string>
 
 
@@ -87,7 +88,9 @@ namespace envire
 	friend void intrusive_ptr_add_ref( EnvironmentItem* item );
 	friend void intrusive_ptr_release( EnvironmentItem* item );
 
-	long ref_count;
+	/** the reference count is atomic, so that pointers to items can be
+	 * copied and released from multiple threads */
+	boost::atomic<long> ref_count;
 
 	/** each environment item must have a unique id.
 	 */
@@ -174,6 +177,11 @@ namespace envire
 	 */
 	void itemModified();
 
+	/** drops data which is derived from the content of the item and
+	 * cached. Called when the item is marked as modified.
+	 */
+	virtual void invalidateCaches() {}
+
 	/** will detach the item from the current environment
 	 */
 	EnvironmentItem::Ptr detach();
@@ -188,7 +196,7 @@ namespace envire
 
 	/** @return how many objects have a reference on this item
 	 */
-	long getRefCount() const { return ref_count; }
+	long getRefCount() const { return ref_count.load( boost::memory_order_relaxed ); }
     };
 
     void intrusive_ptr_add_ref( EnvironmentItem* item );
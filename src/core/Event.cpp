@@ -57,7 +57,7 @@ Event::Event( event::Type type, event::Operation operation, EnvironmentItem::Ptr
 {
 }
 
-event::Result Event::merge( const Event& other )
+event::Result Event::merge( const Event& other ) const
 {
     // overwrite event if its the same 
     if(type == other.type && operation == other.operation && id_a == other.id_a && id_b == other.id_b) 
@@ -86,7 +86,9 @@ void Event::ref( bool clone )
     if( type == event::ITEM && ( operation == event::ADD || operation == event::UPDATE ) )
     {
 	// perform a copy of the EnvironmentItem in these cases
-	// and already set the unique_id to the source id
+	// and already set the unique_id to the source id. The metadata
+	// of layers is shared with the copy, and only duplicated
+	// when it is written to afterwards.
 	if( clone )
 	    a = a->clone();
 
@@ -131,6 +133,7 @@ struct ApplyEventHelper : public EventDispatcher
 	    // for the time being copy the whole item
 	    // TODO: implement partial updates
 	    item->set( event.a.get() );
+	    item->invalidateCaches();
 	}
 	else if( lenient )
 	{
@@ -33,7 +33,7 @@ struct Event
      * INVALIDATE - the current message makes the other invalid
      * CANCEL - both messages cancel each other out 
      */ 
-    event::Result merge( const Event& other );
+    event::Result merge( const Event& other ) const;
 
     /** will apply the changes this event represents to the give environment.
      * Event needs to have the ref function called before it can be applied.
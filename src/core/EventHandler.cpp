@@ -21,6 +21,30 @@ void EventHandler::receive( const Event& message )
     handle( message );
 }
 
+void EventHandler::receive( const std::vector<Event>& messages )
+{
+    if( !filter )
+    {
+	handleBatch( messages );
+	return;
+    }
+
+    std::vector<Event> filtered;
+    for( std::vector<Event>::const_iterator it = messages.begin(); it != messages.end(); it++ )
+    {
+	if( filter->filter( *it ) )
+	    filtered.push_back( *it );
+    }
+    if( !filtered.empty() )
+	handleBatch( filtered );
+}
+
+void EventHandler::handleBatch( const std::vector<Event>& messages )
+{
+    for( std::vector<Event>::const_iterator it = messages.begin(); it != messages.end(); it++ )
+	handle( *it );
+}
+
 void EventHandler::setFilter( EventFilter* filter ) 
 { 
     this->filter = filter; 
@@ -72,28 +96,32 @@ void EventDispatcher::dispatch( event::Type type, event::Operation operation, En
 	throw std::runtime_error("Event message not handled");
 }
 
-void EventQueue::handle( const Event& message )
+void EventBuffer::push( const Event& event )
 {
-    boost::lock_guard<boost::mutex> lock( queueMutex );
-    std::list<Event>::iterator it = msgQueue.begin();
-    // create a local copy of the event
-    Event event(message);
-    event.ref( m_async );
+    // only the buffered events with the same key can be affected
+    const EventKey key( event.type, std::make_pair( event.id_a, event.id_b ) );
+    std::vector<std::list<Event>::iterator>& queued( index[key] );
 
     bool valid = true;
-    while( it != msgQueue.end() )
+    for( size_t i=0; i<queued.size(); )
     {
+	// the add event will already provide the state of the item
+	if( dropUpdates && event.type == event::ITEM 
+		&& event.operation == event::UPDATE && queued[i]->operation == event::ADD )
+	    return;
+
 	event::Result res = 
-	    event.merge( *it );
+	    event.merge( *queued[i] );
 
 	// either cancel or invalidate make the old event
 	// obsolete
 	if( res == event::CANCEL || res == event::INVALIDATE )
         {
-	    it = msgQueue.erase( it );
+	    events.erase( queued[i] );
+	    queued.erase( queued.begin() + i );
         }
         else
-            ++it;
+            ++i;
 
 	// cancel will also make the current event obsolete
 	if( res == event::CANCEL )
@@ -102,14 +130,34 @@ void EventQueue::handle( const Event& message )
 
     if( valid )
     {
-	msgQueue.push_back( event );
+	queued.push_back( events.insert( events.end(), event ) );
+    }
+    else if( queued.empty() )
+    {
+	index.erase( key );
     }
 }
 
+void EventBuffer::clear()
+{
+    events.clear();
+    index.clear();
+}
+
+void EventQueue::handle( const Event& message )
+{
+    boost::lock_guard<boost::mutex> lock( queueMutex );
+    // create a local copy of the event
+    Event event(message);
+    event.ref( m_async );
+
+    msgQueue.push( event );
+}
+
 void EventQueue::flush()
 {
     boost::lock_guard<boost::mutex> lock( queueMutex );
-    for( std::list<Event>::iterator it = msgQueue.begin(); it != msgQueue.end(); it++ )
+    for( EventBuffer::const_iterator it = msgQueue.begin(); it != msgQueue.end(); it++ )
     {
 	process( *it );
     }
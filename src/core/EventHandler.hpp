@@ -2,10 +2,12 @@
 #define __ENVIRE_EVENTHANDLER__
 
 #include <list>
+#include <vector>
 
 #include <envire/core/Event.hpp>
 #include <envire/core/EventSource.hpp>
 #include <boost/thread/mutex.hpp>
+#include <boost/unordered_map.hpp>
 
 namespace envire
 {
@@ -56,6 +58,11 @@ public:
      */
     void receive( const Event& message );
 
+    /** @brief pass a batch of messages to the EventHandler, e.g. the
+     * events of an Environment transaction
+     */
+    void receive( const std::vector<Event>& messages );
+
     /** @brief set optional event filter
      */
     void setFilter( EventFilter* filter );
@@ -64,6 +71,11 @@ protected:
     /** @brief callback method for possibly filtered events
      */
     virtual void handle( const Event& message ) = 0;
+
+    /** @brief callback method for a batch of possibly filtered events. The
+     * default implementation calls handle() for each of the events.
+     */
+    virtual void handleBatch( const std::vector<Event>& messages );
     
     EventFilter* filter;
 };
@@ -104,15 +116,54 @@ public:
     void handle( const Event& message );
 };
 
+/** Buffer for events, in which each new event is merged with the buffered
+ * events (see Event::merge). The ids of the events need to be set.
+ *
+ * Events can only be merged if they have the same type and refer to the
+ * same items, so the buffered events are indexed by (type, id_a, id_b),
+ * and adding an event takes constant time. The order of the remaining
+ * events is the order in which they were added.
+ */
+class EventBuffer
+{
+public:
+    typedef std::list<Event>::const_iterator const_iterator;
+
+    /** @param dropUpdates - if true, update events for items which have a
+     * buffered add event are dropped. This is only valid if the add event
+     * still references the item, and not a copy of it.
+     */
+    explicit EventBuffer( bool dropUpdates = false ) : dropUpdates( dropUpdates ) {}
+
+    /** @brief add the event to the end of the buffer, after merging it with
+     * the buffered events
+     */
+    void push( const Event& event );
+
+    const_iterator begin() const { return events.begin(); }
+    const_iterator end() const { return events.end(); }
+    bool empty() const { return events.empty(); }
+    void clear();
+
+private:
+    typedef std::pair<int, std::pair<std::string, std::string> > EventKey;
+    typedef boost::unordered_map<EventKey, std::vector<std::list<Event>::iterator> > EventIndex;
+
+    bool dropUpdates;
+    std::list<Event> events;
+    /** the buffered events for each key, in buffer order */
+    EventIndex index;
+};
+
 class EventQueue : public EventHandler
 {
 protected:
-    std::list<Event> msgQueue;
+    EventBuffer msgQueue;
     boost::mutex queueMutex;
     bool m_async;
 
     /** Callback that is called by the environment as an event handler. You
-     * should normally not reimplement this
+     * should normally not reimplement this.
      */
     void handle( const Event& message );
 
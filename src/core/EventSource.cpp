@@ -16,6 +16,14 @@ void EventSource::handle( const Event& event )
     }
 }
 
+void EventSource::handle( const std::vector<Event>& events )
+{
+    for(std::vector<EventHandler*>::iterator it = eventHandlers.begin(); it != eventHandlers.end(); it++ )
+    {
+	(*it)->receive( events );
+    }
+}
+
 void EventSource::addEventHandler(EventHandler *handler) 
 {
     eventHandlers.push_back(handler);
@@ -31,6 +31,11 @@ public:
      * will pass the @param event to the registered event handlers
      */
     void handle( const Event& event );
+
+    /**
+     * will pass the batch of @param events to the registered event handlers
+     */
+    void handle( const std::vector<Event>& events );
 };
 
 }
@@ -115,6 +115,12 @@ void FrameNode::setTransform(TransformWithUncertainty const& transform)
     }
 }
 
+void FrameNode::invalidateCaches()
+{
+    if(isAttached())
+	env->invalidateFrameCache( this );
+}
+
 Transform FrameNode::relativeTransform( const FrameNode* to ) const
 {
     return env->relativeTransform( this, to );
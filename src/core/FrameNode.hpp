@@ -84,6 +84,10 @@ namespace envire
 	 */
 	void setTransform(TransformWithUncertainty const& transform);
 
+	/** invalidates the cached transformations of the environment, since
+	 * they depend on the transformation of this frame */
+	void invalidateCaches();
+
         /** 
 	 * @return the transformation from this frame to
          * the frame represented by @a to. This always defines an unique
@@ -0,0 +1,251 @@
+#include "Instrumentation.hpp"
+
+#include <boost/atomic.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <algorithm>
+#include <iomanip>
+#include <map>
+
+using namespace envire;
+
+namespace
+{
+    struct TraceEvent
+    {
+	std::string name;
+	boost::int64_t start, duration;
+	int thread;
+    };
+
+    struct CounterSample
+    {
+	boost::int64_t time;
+	boost::uint64_t counters[Instrumentation::COUNTER_COUNT];
+    };
+
+    /** the state of the instrumentation, which is shared by all threads */
+    struct State
+    {
+	State()
+	    : enabled( false ), traceCapacity( 1000000 ), cycle( 0 )
+	{
+	    for( int i=0; i<Instrumentation::COUNTER_COUNT; i++ )
+		counters[i] = 0;
+	}
+
+	boost::atomic<bool> enabled;
+	boost::atomic<boost::uint64_t> counters[Instrumentation::COUNTER_COUNT];
+
+	/** protects the members below */
+	boost::mutex mutex;
+	std::map<std::string, Instrumentation::Timer> timers;
+	size_t traceCapacity;
+	std::vector<TraceEvent> trace;
+	std::vector<CounterSample> samples;
+	/** small ids of the threads for the trace */
+	std::map<boost::thread::id, int> threads;
+
+	size_t cycle;
+	base::Time cycleStart;
+	Instrumentation::Report last;
+    };
+
+    State state;
+
+    void writeString( std::ostream& os, const std::string& str )
+    {
+	os << '"';
+	for( size_t i=0; i<str.size(); i++ )
+	{
+	    const char c = str[i];
+	    if( c == '"' || c == '\\' )
+		os << '\\' << c;
+	    else if( static_cast<unsigned char>(c) < 0x20 )
+		os << ' ';
+	    else
+		os << c;
+	}
+	os << '"';
+    }
+}
+
+Instrumentation::Report::Report()
+    : cycle( 0 )
+{
+    std::fill( counters, counters + COUNTER_COUNT, 0 );
+}
+
+const Instrumentation::Timer* Instrumentation::Report::getTimer( const std::string& name ) const
+{
+    for( size_t i=0; i<timers.size(); i++ )
+    {
+	if( timers[i].name == name )
+	    return &timers[i];
+    }
+    return NULL;
+}
+
+void Instrumentation::Report::write( std::ostream& os ) const
+{
+    os << "cycle " << cycle << ": " << (end - start).toSeconds() << " s" << std::endl;
+    for( size_t i=0; i<timers.size(); i++ )
+    {
+	const Timer& t( timers[i] );
+	os << "  " << std::left << std::setw( 40 ) << t.name << std::right
+	    << " calls " << std::setw( 8 ) << t.calls
+	    << " total " << std::setw( 12 ) << t.total
+	    << " max " << std::setw( 12 ) << t.max << std::endl;
+    }
+    for( int i=0; i<COUNTER_COUNT; i++ )
+	os << "  " << std::left << std::setw( 40 ) << getCounterName( static_cast<Counter>(i) ) << std::right
+	    << " " << counters[i] << std::endl;
+}
+
+void Instrumentation::setEnabled( bool enabled )
+{
+    boost::lock_guard<boost::mutex> lock( state.mutex );
+    if( enabled && !state.enabled )
+	state.cycleStart = base::Time::now();
+    state.enabled = enabled;
+}
+
+bool Instrumentation::isEnabled()
+{
+    return state.enabled.load( boost::memory_order_relaxed );
+}
+
+void Instrumentation::setTraceCapacity( size_t events )
+{
+    boost::lock_guard<boost::mutex> lock( state.mutex );
+    state.traceCapacity = events;
+}
+
+void Instrumentation::count( Counter counter, boost::uint64_t n )
+{
+    state.counters[counter].fetch_add( n, boost::memory_order_relaxed );
+}
+
+void Instrumentation::addTiming( const char* name, const base::Time& start, const base::Time& end )
+{
+    const double duration = (end - start).toSeconds();
+
+    boost::lock_guard<boost::mutex> lock( state.mutex );
+    std::map<std::string, Timer>::iterator it = state.timers.find( name );
+    if( it == state.timers.end() )
+    {
+	Timer t;
+	t.name = name;
+	t.calls = 0;
+	t.total = 0;
+	t.max = 0;
+	it = state.timers.insert( std::make_pair( t.name, t ) ).first;
+    }
+    it->second.calls++;
+    it->second.total += duration;
+    it->second.max = std::max( it->second.max, duration );
+
+    if( state.trace.size() < state.traceCapacity )
+    {
+	const boost::thread::id id = boost::this_thread::get_id();
+	std::map<boost::thread::id, int>::iterator tit = state.threads.find( id );
+	if( tit == state.threads.end() )
+	    tit = state.threads.insert( std::make_pair( id, static_cast<int>(state.threads.size()) ) ).first;
+
+	TraceEvent e;
+	e.name = name;
+	e.start = start.toMicroseconds();
+	e.duration = (end - start).toMicroseconds();
+	e.thread = tit->second;
+	state.trace.push_back( e );
+    }
+}
+
+Instrumentation::Report Instrumentation::endCycle()
+{
+    boost::lock_guard<boost::mutex> lock( state.mutex );
+
+    Report report;
+    report.cycle = state.cycle++;
+    report.start = state.cycleStart;
+    report.end = base::Time::now();
+    for( std::map<std::string, Timer>::const_iterator it = state.timers.begin(); it != state.timers.end(); it++ )
+	report.timers.push_back( it->second );
+    for( int i=0; i<COUNTER_COUNT; i++ )
+	report.counters[i] = state.counters[i].exchange( 0, boost::memory_order_relaxed );
+
+    if( state.samples.size() < state.traceCapacity )
+    {
+	CounterSample s;
+	s.time = report.end.toMicroseconds();
+	std::copy( report.counters, report.counters + COUNTER_COUNT, s.counters );
+	state.samples.push_back( s );
+    }
+
+    state.timers.clear();
+    state.cycleStart = report.end;
+    state.last = report;
+    return report;
+}
+
+Instrumentation::Report Instrumentation::getLastReport()
+{
+    boost::lock_guard<boost::mutex> lock( state.mutex );
+    return state.last;
+}
+
+void Instrumentation::writeChromeTrace( std::ostream& os )
+{
+    boost::lock_guard<boost::mutex> lock( state.mutex );
+
+    os << "{\"traceEvents\":[";
+    bool first = true;
+    for( size_t i=0; i<state.trace.size(); i++ )
+    {
+	const TraceEvent& e( state.trace[i] );
+	os << (first ? "\n" : ",\n") << "{\"name\":";
+	writeString( os, e.name );
+	os << ",\"cat\":\"envire\",\"ph\":\"X\",\"ts\":" << e.start
+	    << ",\"dur\":" << e.duration << ",\"pid\":0,\"tid\":" << e.thread << "}";
+	first = false;
+    }
+    for( size_t i=0; i<state.samples.size(); i++ )
+    {
+	const CounterSample& s( state.samples[i] );
+	os << (first ? "\n" : ",\n") << "{\"name\":\"counters\",\"ph\":\"C\",\"ts\":" << s.time
+	    << ",\"pid\":0,\"args\":{";
+	for( int c=0; c<COUNTER_COUNT; c++ )
+	    os << (c ? "," : "") << "\"" << getCounterName( static_cast<Counter>(c) ) << "\":" << s.counters[c];
+	os << "}}";
+	first = false;
+    }
+    os << "\n],\"displayTimeUnit\":\"ms\"}" << std::endl;
+}
+
+void Instrumentation::clear()
+{
+    boost::lock_guard<boost::mutex> lock( state.mutex );
+    state.timers.clear();
+    state.trace.clear();
+    state.samples.clear();
+    state.threads.clear();
+    for( int i=0; i<COUNTER_COUNT; i++ )
+	state.counters[i] = 0;
+    state.cycle = 0;
+    state.cycleStart = base::Time::now();
+    state.last = Report();
+}
+
+const char* Instrumentation::getCounterName( Counter counter )
+{
+    switch( counter )
+    {
+	case CELLS_TOUCHED: return "cells_touched";
+	case PATCHES_MERGED: return "patches_merged";
+	case POINTS_PROJECTED: return "points_projected";
+	case BYTES_SERIALIZED: return "bytes_serialized";
+	default: return "unknown";
+    }
+}
@@ -0,0 +1,161 @@
+#ifndef __ENVIRE_INSTRUMENTATION__
+#define __ENVIRE_INSTRUMENTATION__
+
+#include <base/Time.hpp>
+#include <boost/cstdint.hpp>
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace envire
+{
+    /**
+     * Timers and counters for the hot paths of envire, like the operator
+     * updates, MLSGrid::updateCell, the serialization and ICP.
+     *
+     * The hot paths are instrumented with the ENVIRE_SCOPED_TIMER and
+     * ENVIRE_COUNT macros, which only generate code if envire is compiled
+     * with ENVIRE_USE_INSTRUMENTATION (the cmake option USE_INSTRUMENTATION).
+     * Otherwise they expand to nothing, and there is no cost at all. If it
+     * is compiled in, the measurements are only taken after
+     * setEnabled(true), and a disabled instrumentation costs a single check
+     * of a flag.
+     *
+     * The measurements are accumulated per cycle. A cycle is ended by
+     * Environment::updateOperators() or by calling endCycle(), which makes
+     * the measurements of the cycle available as a Report. In addition all
+     * the timed scopes can be written as a trace in the Chrome trace event
+     * format, which can be viewed in chrome://tracing.
+     *
+     * All the methods are thread safe.
+     */
+    class Instrumentation
+    {
+    public:
+	enum Counter
+	{
+	    CELLS_TOUCHED,
+	    PATCHES_MERGED,
+	    POINTS_PROJECTED,
+	    BYTES_SERIALIZED,
+	    COUNTER_COUNT
+	};
+
+	/** accumulated time of the scopes with the same name */
+	struct Timer
+	{
+	    std::string name;
+	    size_t calls;
+	    /** total and maximum time of a call in seconds */
+	    double total, max;
+	};
+
+	/** measurements of a single cycle */
+	struct Report
+	{
+	    Report();
+
+	    /** number of the cycle, starting at 0 */
+	    size_t cycle;
+	    base::Time start, end;
+	    /** the timers, sorted by name */
+	    std::vector<Timer> timers;
+	    boost::uint64_t counters[COUNTER_COUNT];
+
+	    /** @return the timer with the given name, or NULL */
+	    const Timer* getTimer( const std::string& name ) const;
+
+	    /** writes the report as a table to the stream */
+	    void write( std::ostream& os ) const;
+	};
+
+	/** switches the collection of measurements on or off */
+	static void setEnabled( bool enabled );
+	static bool isEnabled();
+
+	/**
+	 * Sets the maximum number of scopes which are kept for the trace.
+	 * Further scopes are still accumulated in the timers, but not in the
+	 * trace. Default is 1000000, and 0 switches the trace off.
+	 */
+	static void setTraceCapacity( size_t events );
+
+	/** adds n to the counter */
+	static void count( Counter counter, boost::uint64_t n = 1 );
+
+	/** adds a timed scope with the given name to the current cycle */
+	static void addTiming( const char* name, const base::Time& start, const base::Time& end );
+
+	/**
+	 * Ends the current cycle and starts a new one.
+	 *
+	 * @return the report of the cycle that was ended
+	 */
+	static Report endCycle();
+
+	/** @return the report of the last cycle that was ended */
+	static Report getLastReport();
+
+	/**
+	 * Writes the scopes recorded since the last clear() in the Chrome
+	 * trace event format. The counters of each cycle are added as counter
+	 * events at the end of the cycle.
+	 */
+	static void writeChromeTrace( std::ostream& os );
+
+	/** removes all the measurements and the trace, and restarts the
+	 * cycle count */
+	static void clear();
+
+	static const char* getCounterName( Counter counter );
+    };
+
+    /** adds the time from construction to destruction to the instrumentation */
+    class ScopedTimer
+    {
+    public:
+	/** @param name - name of the timer, which needs to be valid for the
+	 *                lifetime of the object */
+	explicit ScopedTimer( const char* name )
+	    : name( name ), active( Instrumentation::isEnabled() )
+	{
+	    if( active )
+		start = base::Time::now();
+	}
+
+	~ScopedTimer()
+	{
+	    if( active )
+		Instrumentation::addTiming( name, start, base::Time::now() );
+	}
+
+    private:
+	const char* name;
+	bool active;
+	base::Time start;
+    };
+}
+
+#define ENVIRE_INSTRUMENTATION_CONCAT2( a, b ) a##b
+#define ENVIRE_INSTRUMENTATION_CONCAT( a, b ) ENVIRE_INSTRUMENTATION_CONCAT2( a, b )
+
+#ifdef ENVIRE_USE_INSTRUMENTATION
+/** times the rest of the enclosing scope with the given name */
+#define ENVIRE_SCOPED_TIMER( name ) \
+    envire::ScopedTimer ENVIRE_INSTRUMENTATION_CONCAT( envire_scoped_timer_, __LINE__ )( name )
+/** adds n to the counter, which is one of Instrumentation::Counter */
+#define ENVIRE_COUNT( counter, n ) \
+    do { if( envire::Instrumentation::isEnabled() ) \
+	envire::Instrumentation::count( envire::Instrumentation::counter, n ); } while( 0 )
+/** ends the current instrumentation cycle */
+#define ENVIRE_END_CYCLE() \
+    do { if( envire::Instrumentation::isEnabled() ) \
+	envire::Instrumentation::endCycle(); } while( 0 )
+#else
+#define ENVIRE_SCOPED_TIMER( name ) do {} while( 0 )
+#define ENVIRE_COUNT( counter, n ) do {} while( 0 )
+#define ENVIRE_END_CYCLE() do {} while( 0 )
+#endif
+
+#endif
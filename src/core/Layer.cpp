@@ -1,6 +1,7 @@
 #include "Core.hpp"
 #include "Serialization.hpp"
 #include "Operator.hpp"
+#include "Instrumentation.hpp"
 
 #include <stdexcept>
 #include <fstream>
@@ -14,18 +15,19 @@ namespace fs = boost::filesystem;
 const std::string Layer::className = "envire::Layer";
 
 Layer::Layer(std::string const& id) :
-    EnvironmentItem(id), immutable(false), dirty(false)
+    EnvironmentItem(id), immutable(false), dirty(false), data_generation(0)
 {
 }
 
 Layer::Layer(const Layer& other) :
     EnvironmentItem( other ),
     immutable( other.immutable ),
-    dirty( other.dirty )
+    dirty( other.dirty ),
+    data_map( other.data_map ),
+    // the holders are now shared, so the pointers which have been cached
+    // by either of the layers are not valid for writing anymore
+    data_generation( ++other.data_generation )
 {
-    // copy the data map, and clone the holders
-    for( DataMap::const_iterator it = other.data_map.begin(); it != other.data_map.end(); it++ )
-	data_map.insert( std::make_pair( it->first, it->second->clone() ) );
 }
 
 Layer& Layer::operator=(const Layer& other)
@@ -36,8 +38,8 @@ Layer& Layer::operator=(const Layer& other)
 	immutable = other.immutable;
 	dirty = other.dirty;
 	removeData();
-	for( DataMap::const_iterator it = other.data_map.begin(); it != other.data_map.end(); it++ )
-	    data_map.insert( std::make_pair( it->first, it->second->clone() ) );
+	data_map = other.data_map;
+	++other.data_generation;
     }
     return *this;
 }
@@ -120,7 +122,11 @@ Operator* Layer::getGenerator() const
 void Layer::updateFromOperator() 
 {
     if( isGenerated() && isDirty() )
-        getGenerator()->updateAll();
+    {
+        Operator* generator = getGenerator();
+        ENVIRE_SCOPED_TIMER( generator->getClassName().c_str() );
+        generator->updateAll();
+    }
 }
 
 const std::string Layer::getMapFileName() const 
@@ -153,17 +159,15 @@ void Layer::removeData(const std::string& type)
 {
     if( data_map.count( type ) )
     {
-	delete data_map[type];
 	data_map.erase( type );
+	++data_generation;
     }
 }
 
 void Layer::removeData()
 {
-    for( DataMap::iterator it = data_map.begin();it != data_map.end(); it++)
-	delete it->second;
-    
     data_map.clear();
+    ++data_generation;
 }
 
 const std::string CartesianMap::className = "envire::CartesianMap";
@@ -4,6 +4,9 @@
 #include "EnvironmentItem.hpp"
 #include "Holder.hpp"
 
+#include <boost/shared_ptr.hpp>
+#include <boost/atomic.hpp>
+
 namespace envire
 {
     class HolderBase;
@@ -19,15 +22,42 @@ namespace envire
         /** @todo explain dirty for a layer */
         bool dirty; 
 
-        typedef std::map<std::string, HolderBase*> DataMap;
-
-	/** associating key values with metadata stored in holder objects */ 
+        typedef boost::shared_ptr<HolderBase> HolderPtr;
+        /** The holders are shared copy-on-write between copies of the
+         * layer. A reference or pointer into the data which was obtained
+         * before the layer was copied must not be used to write to it
+         * afterwards, as the write would be visible in the copy. This
+         * includes the copies which a multithreaded EventQueue takes in
+         * itemModified(), so a reference must not be held across a loop
+         * of writes and itemModified() calls. It must be fetched again
+         * through the non-const getData(), which detaches the holder. Code
+         * which caches such pointers can use data_generation to tell when
+         * to fetch them again. Readers must use the const getData(), which
+         * never detaches. */
+        typedef std::map<std::string, HolderPtr> DataMap;
+
+	/** associating key values with metadata stored in holder objects. 
+	 * The holders are shared between copies of the layer, and are only
+	 * cloned on write access to the data (see getData()). */ 
 	DataMap data_map;
 
+	/** incremented whenever entries are removed from the data_map, or
+	 * the data is shared with a copy of the layer, so that pointers to
+	 * the data can be cached by derived classes. It is atomic, since
+	 * copies can be made by concurrent readers. */
+	mutable boost::atomic<unsigned long> data_generation;
+
     public:
 	static const std::string className;
 
 	/** @brief custom copy constructor required because of metadata handling.
+	 *
+	 * The metadata is not copied, but shared with other until either of
+	 * the layers requests write access to it. This makes copies of large
+	 * maps cheap, e.g. for the snapshots which are passed to the
+	 * handlers of a multithreaded EventQueue. References to the data
+	 * which have been obtained before the copy must not be used to
+	 * modify it afterwards.
 	 */
 	Layer(const Layer& other);
 
@@ -116,6 +146,14 @@ namespace envire
          */
         const std::string getMapFileName() const;
 
+	/** @return the generation of the data, which changes whenever
+	 * references to the data obtained from the non-const accessors
+	 * become invalid for writing, i.e. when the data is shared with a
+	 * copy or removed. Code which writes through such references can
+	 * assert that it is unchanged before it calls itemModified().
+	 */
+	unsigned long getDataGeneration() const { return data_generation; }
+
 	/** will return true if an entry for metadata for the given key exists
 	 */
 	bool hasData(const std::string& type) const;
@@ -133,15 +171,22 @@ namespace envire
         }
 
 	/** For a given key, return the metadata associated with it. If the data
-	 * does not exist, it will be created.
+	 * does not exist, it will be created. If the data is shared with a
+	 * copy of this layer, it is copied first.
 	 * Will throw a runtime error if the datatypes don't match.
 	 */
 	template <typename T>
 	    T& getData(const std::string& type)
 	{
-	    if( !hasData( type ) )
+	    DataMap::iterator it = data_map.find( type );
+	    if( it == data_map.end() )
+	    {
+		it = data_map.insert( std::make_pair( type, HolderPtr( new Holder<T> ) ) ).first;
+	    }
+	    else if( !it->second.unique() )
 	    {
-		data_map[type] = new Holder<T>;
+		// copy on write
+		it->second.reset( it->second->clone() );
 	    }
 
 	    /*
@@ -157,7 +202,7 @@ namespace envire
 	    }
 	    */
 
-	    return data_map[type]->get<T>();
+	    return it->second->get<T>();
 	};
 	
 	/** 
@@ -167,7 +212,7 @@ namespace envire
 	template <typename T>
 	const T& getData(const std::string& type) const
 	{
-	    std::map <std::string, envire::HolderBase* >::const_iterator it = data_map.find(type);
+	    DataMap::const_iterator it = data_map.find(type);
 	    if(it == data_map.end())
 		throw std::runtime_error("No metadata with name " + type + " available ");
 	    
@@ -11,6 +11,7 @@
 #include "Operator.hpp"
 #include "FrameNode.hpp"
 #include "Layer.hpp"
+#include "Instrumentation.hpp"
 #include <envire/Core.hpp>
 
 extern "C" {
@@ -222,6 +223,11 @@ bool Serialization::hasKey(const std::string& key) const
     return (node_index != 0);
 }
 
+bool Serialization::skipMapData() const
+{
+    return false;
+}
+
 bool Serialization::read(const std::string &key, std::string &value)
 {
     try
@@ -301,6 +307,7 @@ std::ostream& Serialization::getBinaryOutputStream(const std::string &filename)
 const std::string FileSerialization::STRUCTURE_FILE = "scene.yml";
 
 FileSerialization::FileSerialization()
+    : skipMaps( false )
 {
 }
 
@@ -313,6 +320,16 @@ const std::string FileSerialization::getMapPath() const
     return sceneDir;
 }
 
+void FileSerialization::setSkipMapData( bool skip )
+{
+    skipMaps = skip;
+}
+
+bool FileSerialization::skipMapData() const
+{
+    return skipMaps;
+}
+
 void FileSerialization::setSceneDir(const std::string dir)
 {
     sceneDir = dir;
@@ -346,6 +363,8 @@ std::ostream& FileSerialization::getBinaryOutputStream(const std::string &filena
 
 bool FileSerialization::writeToFile( Environment *env, const std::string &path )
 {
+    ENVIRE_SCOPED_TIMER( "FileSerialization::writeToFile" );
+
     yaml_emitter_initialize(&yamlSerialization->emitter);
     FILE *output = fopen(path.c_str(), "wb");
     if( !output )
@@ -459,6 +478,7 @@ bool FileSerialization::writeToFile( Environment *env, const std::string &path )
 
     yaml_emitter_delete(&yamlSerialization->emitter);
     yaml_document_delete(&yamlSerialization->document);
+    ENVIRE_COUNT( BYTES_SERIALIZED, std::max( ftell( output ), 0L ) );
     fclose( output );
     
     // close and delete ofstreams
@@ -468,6 +488,7 @@ bool FileSerialization::writeToFile( Environment *env, const std::string &path )
         {
             if((*it)->is_open())
             {
+                ENVIRE_COUNT( BYTES_SERIALIZED, std::max( static_cast<long>((*it)->tellp()), 0L ) );
                 (*it)->close();
             }
             delete *it;
@@ -493,6 +514,8 @@ static MapType* getMap(YAMLSerializationImpl* yaml, Environment* env, const char
 
 Environment* FileSerialization::readFromFile( const std::string& path )
 {
+    ENVIRE_SCOPED_TIMER( "FileSerialization::readFromFile" );
+
     Environment* env;
     
     int64_t lastID = 0;
@@ -759,6 +782,7 @@ EnvironmentItem* BinarySerialization::unserializeBinaryEvent(const EnvireBinaryE
 bool BinarySerialization::serializeBinaryEvent(EnvironmentItem* item, EnvireBinaryEvent& bin_item)
 {
     assert(item);
+    ENVIRE_SCOPED_TIMER( "BinarySerialization::serializeBinaryEvent" );
     
     bin_item.className = item->getClassName();
     bin_item.yamlProperties.clear();
@@ -801,7 +825,9 @@ bool BinarySerialization::serializeBinaryEvent(EnvironmentItem* item, EnvireBina
         std::copy(istream_iterator<uint8_t>(ostream), istream_iterator<uint8_t>(), std::back_inserter(bin_vector));
         bin_item.binaryStreamNames.push_back(it->first);
         bin_item.binaryStreams.push_back(bin_vector);
+        ENVIRE_COUNT( BYTES_SERIALIZED, bin_vector.size() );
     }
+    ENVIRE_COUNT( BYTES_SERIALIZED, bin_item.yamlProperties.size() );
 
     // clean up
     for(vector<yaml_char_t*>::iterator it=yamlSerialization->buffers.begin();it<yamlSerialization->buffers.end();it++)
@@ -839,7 +865,7 @@ void SynchronizationEventHandler::handle(const envire::Event& message)
     else
     {
 	// flush any remaining messages in the queue
-        if(msgQueue.size())
+        if(!msgQueue.empty())
             flush();
 
 	// process will add the relveant binary messages to the msg_buffer
@@ -851,6 +877,24 @@ void SynchronizationEventHandler::handle(const envire::Event& message)
     }
 }
 
+void SynchronizationEventHandler::handleBatch(const std::vector<envire::Event>& messages)
+{
+    if(m_useEventQueue)
+    {
+        EventQueue::handleBatch(messages);
+        return;
+    }
+
+    if(!msgQueue.empty())
+        flush();
+
+    for(std::vector<envire::Event>::const_iterator it = messages.begin(); it != messages.end(); it++)
+        process(*it);
+
+    handle(msg_buffer);
+    msg_buffer.clear();
+}
+
 void SynchronizationEventHandler::process(const envire::Event& message)
 {
     // add the event to the binary buffer 
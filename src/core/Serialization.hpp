@@ -98,6 +98,12 @@ namespace envire
          * @return true if the key is available in the current map node
          */
         virtual bool hasKey(std::string const& key) const;
+
+        /**
+         * @return true if the items should only read their properties, but
+         * not their map data. False by default.
+         */
+        virtual bool skipMapData() const;
         
         /**
          * Exception thrown when getBinaryInputStream is called with stream
@@ -150,6 +156,7 @@ namespace envire
         std::string sceneDir;
         std::vector<std::ifstream*> ifstreams;
         std::vector<std::ofstream*> ofstreams;
+        bool skipMaps;
         
     public:
         /* name of the yaml file */
@@ -191,6 +198,15 @@ namespace envire
          */
         void setSceneDir(const std::string dir);
         
+        /**
+         * When enabled, readFromFile() only reads the structure of the
+         * environment and the properties of the items, and the map files
+         * are not loaded. This allows to process the maps of a large
+         * environment one at a time.
+         */
+        void setSkipMapData( bool skip );
+        virtual bool skipMapData() const;
+
         /**
          * This is used from envire::Grid, because 
          * GDAL serialization cannot handle streams.
@@ -307,6 +323,11 @@ namespace envire
 	/** @brief gets called by the environment when new events appear
 	 */
         virtual void handle( const Event& message );
+	/** @brief gets called by the environment with the events of a
+	 * transaction, which are passed on as a single batch of binary
+	 * events
+	 */
+        virtual void handleBatch( const std::vector<Event>& messages );
 	/** @brief callback to process the events into binary form
 	 */
         virtual void process( const Event& message );
@@ -255,20 +255,54 @@ TransformWithUncertainty TransformWithUncertainty::operator*( const TransformWit
 
 PointWithUncertainty TransformWithUncertainty::operator*( const PointWithUncertainty& point ) const
 {
-    Eigen::Matrix3d R( getTransform().linear() );
-    Eigen::Quaterniond q( R );
-    Eigen::Matrix<double,3,6> J;
-    J << drx_by_dr( q, point.getPoint() ), Eigen::Matrix3d::Identity();
+    return PointUncertaintyPropagator( *this ) * point;
+}
+
+PointUncertaintyPropagator::PointUncertaintyPropagator( const TransformWithUncertainty& t )
+    : trans( t.getTransform() ), R( t.getTransform().linear() )
+{
+    // same as in drx_by_dr, but without the dependency on the point
+    const Eigen::Vector3d r( q_to_r( Eigen::Quaterniond( R ) ) );
+    const double theta = r.norm();
+    const double alpha = 1.0 - theta*theta/6.0;
+    const double beta = 0.5 - theta*theta/24.0;
+    const double gamma = 1.0 / 3.0 - theta*theta/30.0;
+    const double delta = -1.0 / 12.0 + theta*theta/180.0;
+
+    Sr = skew_symmetric( r );
+    A = gamma*r*r.transpose() - beta*Sr + alpha*Eigen::Matrix3d::Identity();
+    B = delta*r*r.transpose() + 2.0*beta*Eigen::Matrix3d::Identity();
 
-    Eigen::Matrix<double,3,3> cov = J*getCovariance()*J.transpose();
+    const TransformWithUncertainty::Covariance& cov( t.getCovariance() );
+    Crr = cov.topLeftCorner<3,3>();
+    Crt = cov.topRightCorner<3,3>();
+    Ctt = cov.bottomRightCorner<3,3>();
+}
+
+PointWithUncertainty PointUncertaintyPropagator::operator*( const PointWithUncertainty& point ) const
+{
+    // J = [D I] with D = drx_by_dr( q, x ), and the covariance J*C*J^T is
+    // expanded into the 3x3 blocks of C
+    const Eigen::Matrix3d Sx( skew_symmetric( point.getPoint() ) );
+    const Eigen::Matrix3d D( -Sx*A - Sr*Sx*B );
+    const Eigen::Matrix3d DCrt( D*Crt );
+
+    Eigen::Matrix3d cov = D*Crr*D.transpose() + DCrt + DCrt.transpose() + Ctt;
     if( point.hasUncertainty() )
 	cov += R*point.getCovariance()*R.transpose();
-    
+
     return PointWithUncertainty( 
-	    getTransform() * point.getPoint(),
+	    trans * point.getPoint(),
 	    cov );
 }
 
+void PointUncertaintyPropagator::transform( const std::vector<PointWithUncertainty>& points, std::vector<PointWithUncertainty>& result ) const
+{
+    result.resize( points.size() );
+    for( size_t i=0; i<points.size(); i++ )
+	result[i] = *this * points[i];
+}
+
 TransformWithUncertainty TransformWithUncertainty::inverse() const
 {
     // short path if there is no uncertainty 
@@ -3,6 +3,7 @@
 
 #include <Eigen/Core>
 #include <base/samples/RigidBodyState.hpp>
+#include <vector>
 
 namespace envire
 {
@@ -109,6 +110,36 @@ namespace envire
 	bool uncertain;
     };
     
+    /**
+     * Transforms points with a TransformWithUncertainty, and propagates the
+     * uncertainty of the transform to the points. This gives the same
+     * result as TransformWithUncertainty::operator*( PointWithUncertainty ),
+     * but the parts of the Jacobian which only depend on the transform are
+     * computed once in the constructor. Use it when many points are
+     * transformed with the same transform.
+     */
+    class PointUncertaintyPropagator
+    {
+    public:
+	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+	explicit PointUncertaintyPropagator( const TransformWithUncertainty& trans );
+
+	PointWithUncertainty operator*( const PointWithUncertainty& point ) const;
+
+	/** transforms all the points, result is resized to the number of
+	 * points */
+	void transform( const std::vector<PointWithUncertainty>& points, std::vector<PointWithUncertainty>& result ) const;
+
+    protected:
+	Transform trans;
+	Eigen::Matrix3d R;
+	/** matrices for the Jacobian of the rotated point with respect to the
+	 * rotation, which is -[x]*A - [r]*[x]*B for the point x */
+	Eigen::Matrix3d A, B, Sr;
+	/** blocks of the covariance of the transform */
+	Eigen::Matrix3d Crr, Crt, Ctt;
+    };
+
     /** Default std::cout function
      */
     std::ostream & operator<<(std::ostream &out, const  TransformWithUncertainty& trans);
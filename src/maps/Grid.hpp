@@ -21,8 +21,10 @@
 #include <boost/multi_array.hpp>
 
 #include <vector>
+#include <algorithm>
 #include <stdexcept>
 #include <base/Logging.hpp>
+#include <boost/lexical_cast.hpp>
 
 namespace envire 
 {
@@ -53,6 +55,25 @@ namespace envire
 	    : GridBase( cellSizeX, cellSizeY, scalex, scaley, offsetx, offsety, id ) {}
 	virtual void createBand( const std::string& key ) = 0;
         virtual ~BandedGrid(){};
+
+	/** options for writing the bands of a grid to GeoTiff files */
+	struct GeoTiffOptions
+	{
+	    GeoTiffOptions() : tiled( true ), blockSize( 256 ), compression( "DEFLATE" ) {}
+
+	    /** store the data in square blocks instead of lines, which allows
+	     * efficient reading of windows. Only used for grids which are
+	     * larger than a block in both directions. */
+	    bool tiled;
+	    /** size of a block in cells, needs to be a multiple of 16 */
+	    int blockSize;
+	    /** compression method of the GDAL GTiff driver, e.g. DEFLATE, LZW
+	     * or NONE */
+	    std::string compression;
+	};
+
+	/** @return the options which are used by writeGridData for all grids */
+	static GeoTiffOptions& getGeoTiffOptions();
     };
 
     /** Generic handling of a multi-layer grid
@@ -290,6 +311,23 @@ namespace envire
          * of the GDAL-readable file at \c path into the listed bands of this map
          */
 	void readGridData(const std::vector<std::string> &bands,const std::string& path,int base_band = 1, boost::enable_if< boost::is_fundamental<T> >* enabler = 0);
+
+	/** Reads the window [x, x + width[ x [y, y + height[ of the bands
+	 *      [base_band, base_band + bands.size[
+	 * of the GDAL-readable file at \c path into the listed bands of this
+	 * map. Only the data of the window is read from the file, so that
+	 * parts of rasters that don't fit into memory can be loaded.
+	 *
+	 * The window is given in the cell coordinates of the full raster, with
+	 * the same orientation as readGridData would produce. The cell (0, 0)
+	 * of this map corresponds to the cell (x, y) of the full raster. A
+	 * width or height of 0 extends the window to the end of the raster.
+	 */
+	void readGridWindow(const std::vector<std::string> &bands,const std::string& path,
+		size_t x, size_t y, size_t width = 0, size_t height = 0, int base_band = 1);
+	/** @overload for a single band */
+	void readGridWindow(const std::string &band,const std::string& path,
+		size_t x, size_t y, size_t width = 0, size_t height = 0, int base_band = 1);
 	/** Helper method for deserialization
          *
          * Reads the data contained in the given stream into the provided band
@@ -390,6 +428,9 @@ namespace envire
         // load old maps the old way
         FileSerialization* fso = dynamic_cast<FileSerialization*>(&so);
 
+	if( so.skipMapData() )
+	    return;
+
 	if (so.hasKey("map_count"))
 	{
 	    // read in the layer names 
@@ -522,11 +563,26 @@ namespace envire
 	poDriver = GetGDALDriverManager()->GetDriverByName(pszFormat);
 	if( poDriver == NULL )
 	    throw std::runtime_error("GDALDriver not found.");
+
+	// write tiled and compressed files, so that large grids can be read
+	// in parts later on
+	const GeoTiffOptions& options( getGeoTiffOptions() );
+	if( options.tiled && cellSizeX >= (size_t)options.blockSize && cellSizeY >= (size_t)options.blockSize )
+	{
+	    const std::string blockSize = boost::lexical_cast<std::string>( options.blockSize );
+	    papszOptions = CSLSetNameValue( papszOptions, "TILED", "YES" );
+	    papszOptions = CSLSetNameValue( papszOptions, "BLOCKXSIZE", blockSize.c_str() );
+	    papszOptions = CSLSetNameValue( papszOptions, "BLOCKYSIZE", blockSize.c_str() );
+	}
+	if( !options.compression.empty() && options.compression != "NONE" )
+	    papszOptions = CSLSetNameValue( papszOptions, "COMPRESS", options.compression.c_str() );
+	papszOptions = CSLSetNameValue( papszOptions, "BIGTIFF", "IF_SAFER" );
         
         GDALDataType data_type = getGDALDataTypeOfArray();
 	poDstDS = poDriver->Create( path.c_str(), cellSizeX, cellSizeY,
                 keys.size(), data_type, 
 		papszOptions );
+	CSLDestroy( papszOptions );
 
         if (!poDstDS)
             throw std::runtime_error("failed to create file " + path);
@@ -594,6 +650,12 @@ namespace envire
     }
       
     template<class T>void Grid<T>::readGridData(const std::vector<std::string> &keys,const std::string& path, int base_band, boost::enable_if< boost::is_fundamental<T> >* enabler)
+    {
+      readGridWindow(keys, path, 0, 0, 0, 0, base_band);
+    }
+
+    template<class T>void Grid<T>::readGridWindow(const std::vector<std::string> &keys,const std::string& path,
+	    size_t x, size_t y, size_t width, size_t height, int base_band)
     {
       LOG_DEBUG_S << "reading file "<< path;
       GDALDataset  *poDataset;
@@ -602,14 +664,29 @@ namespace envire
       if( poDataset == NULL )
 	  throw std::runtime_error("can not open file " + path);
       
-      double file_cellSizeX =  poDataset->GetRasterXSize();
-      double file_cellSizeY =  poDataset->GetRasterYSize();  
-      if (cellSizeX != 0 && file_cellSizeX != cellSizeX)
+      const size_t file_cellSizeX =  poDataset->GetRasterXSize();
+      const size_t file_cellSizeY =  poDataset->GetRasterYSize();  
+      if (width == 0 && x <= file_cellSizeX)
+	  width = file_cellSizeX - x;
+      if (height == 0 && y <= file_cellSizeY)
+	  height = file_cellSizeY - y;
+      if (x + width > file_cellSizeX || y + height > file_cellSizeY)
+      {
+	  GDALClose(poDataset);
+	  throw std::runtime_error("window is outside of the raster in file " + path);
+      }
+      if (cellSizeX != 0 && width != cellSizeX)
+      {
+	  GDALClose(poDataset);
           throw std::runtime_error("file and map sizes differ along the X direction");
-      if (cellSizeY != 0 && file_cellSizeY != cellSizeY)
+      }
+      if (cellSizeY != 0 && height != cellSizeY)
+      {
+	  GDALClose(poDataset);
           throw std::runtime_error("file and map sizes differ along the Y direction");
-      cellSizeX = file_cellSizeX;
-      cellSizeY = file_cellSizeY;
+      }
+      cellSizeX = width;
+      cellSizeY = height;
       
       // If the map does not yet have a scale, allow reading it from file
       //
@@ -629,7 +706,7 @@ namespace envire
 
           scalex = fabs(adfGeoTransform[1]);
           scaley = fabs(adfGeoTransform[5]);
-          if (fabs(adfGeoTransform[4] * cellSizeY) > scaley * 1e-2  || fabs(adfGeoTransform[2]) > scalex * 1e-2)
+          if (fabs(adfGeoTransform[4] * file_cellSizeY) > scaley * 1e-2  || fabs(adfGeoTransform[2]) > scalex * 1e-2)
               throw std::runtime_error("cannot load rotated raster files");
 
           if (adfGeoTransform[1] < 0)
@@ -638,6 +715,11 @@ namespace envire
               yDir = -1;
       }
 
+      // position of the window in the file, which is mirrored if the
+      // axis directions are reversed
+      const size_t file_x = xDir == -1 ? file_cellSizeX - x - width : x;
+      const size_t file_y = yDir == -1 ? file_cellSizeY - y - height : y;
+
       GDALRasterBand  *poBand;
       if((unsigned int )(poDataset->GetRasterCount()-base_band+1) < keys.size())
       {
@@ -663,40 +745,45 @@ namespace envire
 	//writing data into the grid object
 	boost::multi_array<T,2> &data(getGridData(*iter));
 
-        T* data_ptr = &data[0][0];
-        // I did not manage to make GDAL invert the data for us, so I do it
-        // manually. To avoid swapping values around, I allocate an additional
-        // line and move the data line-by-line
-        if (xDir == -1)
-        {
-            data.resize( boost::extents[cellSizeY + 1][cellSizeX] );
-            data_ptr = &data[1][0];
-        }
+        // the y direction is inverted by GDAL, using a negative line
+        // spacing, starting at the last line
+        T* data_ptr = data.data();
+        int line_space = 0;
         if (yDir == -1)
+        {
             data_ptr += cellSizeX * (cellSizeY - 1);
+            line_space = -static_cast<int>(sizeof(T) * cellSizeX);
+        }
 
         int has_nodata = 0;
         double nodata = poBand->GetNoDataValue(&has_nodata);
         if (has_nodata)
             setNoData(*iter, T(nodata));
 	poBand->RasterIO(GF_Read,
-                0,0,cellSizeX,cellSizeY,
+                file_x,file_y,cellSizeX,cellSizeY,
                 data_ptr, cellSizeX, cellSizeY,
                 getGDALDataTypeOfArray(),
-                0, yDir * sizeof(T) * cellSizeX);
+                0, line_space);
 
-        // See comment above as to why we do this manually
+        // GDAL can not invert the x direction, so the lines are reversed
+        // afterwards
         if (xDir == -1)
         {
             for (size_t yi = 0; yi < cellSizeY; ++yi)
-                for (size_t xi = 0; xi < cellSizeX; ++xi)
-                    data[yi][xi] = data[yi + 1][cellSizeX - 1 - xi];
-            data.resize( boost::extents[cellSizeY][cellSizeX] );
+                std::reverse(&data[yi][0], &data[yi][0] + cellSizeX);
         }
       }
       GDALClose(poDataset);
     }
     
+    template<class T>void Grid<T>::readGridWindow(const std::string &key,const std::string& path,
+	    size_t x, size_t y, size_t width, size_t height, int base_band)
+    {
+	std::vector<std::string> string_vector;
+	string_vector.push_back(key);
+	readGridWindow(string_vector,path,x,y,width,height,base_band);
+    }
+
     template<class T>void Grid<T>::readGridData(const std::string &key,const std::string& path, int base_band, boost::enable_if< boost::is_fundamental<T> >* enabler)
     {
 	std::vector<std::string> string_vector;
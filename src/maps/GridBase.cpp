@@ -495,14 +495,21 @@ GridBase::CellExtents GridBase::getCellExtents() const
 }
 
 template<typename T>
-static GridBase::Ptr readGridFromGdalHelper(std::string const& path, std::string const& band_name, int band)
+static GridBase::Ptr readGridFromGdalHelper(std::string const& path, std::string const& band_name, int band,
+        size_t x, size_t y, size_t width, size_t height)
 {
     typename envire::Grid<T>::Ptr result = new Grid<T>();
-    result->readGridData(band_name, path, band);
+    result->readGridWindow(band_name, path, x, y, width, height, band);
     return result;
 }
 
 std::pair<GridBase::Ptr, envire::Transform> GridBase::readGridFromGdal(std::string const& path, std::string const& band_name, int band)
+{
+    return readGridWindowFromGdal(path, band_name, 0, 0, 0, 0, band);
+}
+
+std::pair<GridBase::Ptr, envire::Transform> GridBase::readGridWindowFromGdal(std::string const& path, std::string const& band_name,
+        size_t x, size_t y, size_t width, size_t height, int band)
 {
     GDALDataset  *poDataset;
     GDALAllRegister();
@@ -525,39 +532,43 @@ std::pair<GridBase::Ptr, envire::Transform> GridBase::readGridFromGdal(std::stri
     poDataset->GetGeoTransform(adfGeoTransform);  
     double offsetx = adfGeoTransform[0];
     double offsety = adfGeoTransform[3];
+    const size_t file_cellSizeX = poDataset->GetRasterXSize();
+    const size_t file_cellSizeY = poDataset->GetRasterYSize();
 
     GridBase::Ptr map;
     switch(poBand->GetRasterDataType())
     {
     case  GDT_Byte:
-        map =  readGridFromGdalHelper<uint8_t>(path, band_name, band);
+        map =  readGridFromGdalHelper<uint8_t>(path, band_name, band, x, y, width, height);
         break;
     case GDT_Int16:
-        map =  readGridFromGdalHelper<int16_t>(path, band_name, band);
+        map =  readGridFromGdalHelper<int16_t>(path, band_name, band, x, y, width, height);
         break;
     case GDT_UInt16:
-        map =  readGridFromGdalHelper<uint16_t>(path, band_name, band);
+        map =  readGridFromGdalHelper<uint16_t>(path, band_name, band, x, y, width, height);
         break;
     case GDT_Int32:
-        map =  readGridFromGdalHelper<int32_t>(path, band_name, band);
+        map =  readGridFromGdalHelper<int32_t>(path, band_name, band, x, y, width, height);
         break;
     case GDT_UInt32:
-        map =  readGridFromGdalHelper<uint32_t>(path, band_name, band);
+        map =  readGridFromGdalHelper<uint32_t>(path, band_name, band, x, y, width, height);
         break;
     case GDT_Float32:
-        map =  readGridFromGdalHelper<float>(path, band_name, band);
+        map =  readGridFromGdalHelper<float>(path, band_name, band, x, y, width, height);
         break;
     case GDT_Float64:
-        map =  readGridFromGdalHelper<double>(path, band_name, band);
+        map =  readGridFromGdalHelper<double>(path, band_name, band, x, y, width, height);
         break;
     default:
         throw std::runtime_error("enview::Grid<T>: GDT type is not supported.");  
     }
 
     if (adfGeoTransform[1] < 0)
-        offsetx -= map->getCellSizeX() * map->getScaleX();
+        offsetx -= file_cellSizeX * map->getScaleX();
     if (adfGeoTransform[5] < 0)
-        offsety -= map->getCellSizeY() * map->getScaleY();
+        offsety -= file_cellSizeY * map->getScaleY();
+    offsetx += x * map->getScaleX();
+    offsety += y * map->getScaleY();
 
     Transform transform =
         Transform(Eigen::Translation<double, 3>(offsetx, offsety, 0));
@@ -257,6 +257,14 @@ namespace envire
          */
         static std::pair<GridBase::Ptr, Transform> readGridFromGdal(std::string const& path, std::string const& band_name, int band = 1);
 
+        /** Like readGridFromGdal, but only reads the window of \c width x \c
+         * height cells starting at the cell (x, y) of the raster (see
+         * Grid::readGridWindow). The returned transform is the position of
+         * the window.
+         */
+        static std::pair<GridBase::Ptr, Transform> readGridWindowFromGdal(std::string const& path, std::string const& band_name,
+                size_t x, size_t y, size_t width, size_t height, int band = 1);
+
         /** Copies the specified band in this grid map
          *
          * @arg target_name the name of the new band. If omitted, uses \c band_name
@@ -8,6 +8,12 @@ bool envire::fileExists(std::string const& path)
     return boost::filesystem::exists(path);
 }
 
+BandedGrid::GeoTiffOptions& BandedGrid::getGeoTiffOptions()
+{
+    static GeoTiffOptions options;
+    return options;
+}
+
 template class Grid<double>;
 template class Grid<float>;
 template class Grid<uint8_t>;
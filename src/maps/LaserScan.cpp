@@ -38,7 +38,8 @@ void LaserScan::unserialize(Serialization& so)
 {
     CartesianMap::unserialize(so);
     
-    readScan( so.getBinaryInputStream(getMapFileName()) );
+    if( !so.skipMapData() )
+	readScan( so.getBinaryInputStream(getMapFileName()) );
 }
 
 void LaserScan::addScanLine( double tilt_angle, const base::samples::LaserScan& scan )
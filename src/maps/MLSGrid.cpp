@@ -1,4 +1,5 @@
 #include "MLSGrid.hpp"
+#include <envire/core/Instrumentation.hpp>
 #include <fstream>
 #include <limits>
 #include <algorithm>
@@ -13,6 +14,7 @@ static SerializationPlugin<MLSGrid> factory("MultiLevelSurfaceGrid");
 
 MLSGrid::MLSGrid()
     : GridBase()
+    , cells( new Cells() )
     , cellcount( 0 )
 {
     clear();
@@ -20,15 +22,26 @@ MLSGrid::MLSGrid()
 
 MLSGrid::MLSGrid(size_t cellSizeX, size_t cellSizeY, double scalex, double scaley, double offsetx, double offsety)
     : GridBase( cellSizeX, cellSizeY, scalex, scaley, offsetx, offsety )
-    , cells( cellSizeX, cellSizeY )
+    , cells( new Cells( cellSizeX, cellSizeY ) )
     , cellcount( 0 )
 {
     clear();
 }
 
+MLSGrid::Cells& MLSGrid::getCells()
+{
+    if( !cells.unique() )
+	cells.reset( new Cells( *cells ) );
+    return *cells;
+}
+
 void MLSGrid::clear()
 {
-    cells.clear();
+    // a shared storage is not copied just to be cleared
+    if( cells.unique() )
+	cells->clear();
+    else
+	cells.reset( new Cells( cellSizeX, cellSizeY ) );
     cellcount = 0;
     if(index) index->reset();
     extents = CellExtents();
@@ -166,7 +179,13 @@ void MLSGrid::unserialize(Serialization& so)
     else
 	config.useColor = false;
 
-    cells.resize( cellSizeX, cellSizeY );
+    if( cells.unique() )
+	cells->resize( cellSizeX, cellSizeY );
+    else
+	cells.reset( new Cells( cellSizeX, cellSizeY ) );
+
+    if( so.skipMapData() )
+	return;
 
     // this is a workaround to make the MLS generatable by 
     // the GridBase::create method, which sets the map_count
@@ -378,39 +397,40 @@ void MLSGrid::readMap(std::istream& is)
 
 MLSGrid::iterator MLSGrid::beginCell( size_t xi, size_t yi )
 {
-    return cells.beginCell( xi, yi );
+    return getCells().beginCell( xi, yi );
 }
 
 MLSGrid::const_iterator MLSGrid::beginCell( size_t xi, size_t yi ) const
 {
-    return cells.beginCell( xi, yi );
+    const Cells& c( *cells );
+    return c.beginCell( xi, yi );
 }
 
 MLSGrid::iterator MLSGrid::endCell()
 {
-    return cells.endCell();
+    return iterator();
 }
 
 MLSGrid::const_iterator MLSGrid::endCell() const
 {
-    return cells.endCell();
+    return const_iterator();
 }
 
 void MLSGrid::insertHead( size_t xi, size_t yi, const SurfacePatch& value )
 {
-    cells.insertHead( xi, yi, value );
+    getCells().insertHead( xi, yi, value );
     addCell( Position( xi, yi ) );
 }
 
 void MLSGrid::insertTail( size_t xi, size_t yi, const SurfacePatch& value )
 {
-    cells.insertTail( xi, yi, value );
+    getCells().insertTail( xi, yi, value );
     addCell( Position( xi, yi ) );
 }
 
 MLSGrid::iterator MLSGrid::erase( iterator position )
 {
-    iterator res = cells.erase( position );
+    iterator res = getCells().erase( position );
     cellcount--;
     return res; 
 }
@@ -493,6 +513,9 @@ void MLSGrid::updateCell( size_t xi, size_t yi, const SurfacePatch& co )
 	    merged.push_back( it );
     }
 
+    ENVIRE_COUNT( CELLS_TOUCHED, 1 );
+    ENVIRE_COUNT( PATCHES_MERGED, merged.size() );
+
     if( merged.empty() )
     {
 	// insert the patch since we didn't merge it with any other
@@ -737,6 +760,21 @@ void MLSGrid::addCell( const Position& pos )
     extents.extend( Eigen::Vector2i( pos.x, pos.y ) );
 }
 
+void MLSGrid::addCells( size_t count, const CellExtents& cellExtents )
+{
+    if( !count )
+	return;
+
+    cellcount += count;
+    extents.extend( cellExtents );
+
+    if( index )
+    {
+	index->reset();
+	generateIndex( index );
+    }
+}
+
 void MLSGrid::generateIndex(boost::shared_ptr<Index> gindex) const
 {
     for(size_t x = 0; x < getCellSizeX(); x++)
@@ -761,6 +799,6 @@ void MLSGrid::initIndex()
 
 void MLSGrid::move(int x, int y)
 {
-    cells.move(x, y);
+    getCells().move(x, y);
 }
 
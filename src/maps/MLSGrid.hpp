@@ -12,6 +12,7 @@
 #include <base/geometry/Spline.hpp>
 
 #include <algorithm>
+#include <cassert>
 #include <set>
 
 #include <base/Eigen.hpp>
@@ -66,7 +67,21 @@ namespace envire
 	};
 
     protected:
-	ListGrid<SurfacePatch> cells;
+	typedef ListGrid<SurfacePatch> Cells;
+
+	/** the patches of the grid. The storage is shared between copies of
+	 * the grid, and only copied when either of them requests write
+	 * access through one of the non-const methods (see getCells()). This
+	 * makes snapshots of large grids cheap, e.g. for the handlers of a
+	 * multithreaded EventQueue. Like for the data of a Layer, iterators
+	 * and patch pointers which have been obtained before a copy, which
+	 * includes the copy taken by itemModified(), must not be used to
+	 * modify the grid afterwards. A copy changes getDataGeneration(). */
+	boost::shared_ptr<Cells> cells;
+
+	/** @return the cells for write access, which are copied first if
+	 * they are shared with a copy of the grid */
+	Cells& getCells();
 
     public:
 	typedef	ListGrid<SurfacePatch>::iterator iterator;
@@ -145,6 +160,31 @@ namespace envire
         /** Removes the patch pointed-to by \c position */
 	iterator erase( iterator position );
 
+	typedef ListGrid<SurfacePatch>::Block PatchBlock;
+
+        /** Allocates n patches as one block, for the bulk initialization
+         * of empty cells with setCellPatch(). This is the write access for
+         * the following setCellPatch() calls.
+         */
+	PatchBlock allocatePatches( size_t n ) { return getCells().allocate( n ); }
+
+        /** Sets the empty cell at \c xi and \c yi to the single patch i of
+         * the block, without any merging. This can be called concurrently
+         * for different cells. The cell count, extents and index are not
+         * updated, addCells() needs to be called afterwards.
+         */
+	void setCellPatch( size_t xi, size_t yi, const PatchBlock& block, size_t i, const SurfacePatch& patch )
+	{ 
+	    // the grid must not have been copied since allocatePatches()
+	    assert( cells.unique() );
+	    cells->setCell( xi, yi, block, i, patch ); 
+	}
+
+        /** Updates the cell count, extents and index after count patches
+         * have been set with setCellPatch() in the given cell extents.
+         */
+	void addCells( size_t count, const CellExtents& cellExtents );
+
         /** Finds a surface patch at \c (position.x, position.y) that matches
          * the Z information contained in \c patch (patch is used to get mean
          * and sigma Z).
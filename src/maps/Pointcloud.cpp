@@ -1,8 +1,16 @@
 #include "Core.hpp"
 #include "maps/Pointcloud.hpp"
 #include "tools/PlyFile.hpp"
+#include "tools/NumberParser.hpp"
+#include "tools/Parallel.hpp"
+#include "tools/PointTransform.hpp"
 
 #include <fstream>
+#include <iterator>
+
+#include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
 
 using namespace envire;
 
@@ -13,11 +21,11 @@ const std::string Pointcloud::VERTEX_NORMAL = "vertex_normal";
 const std::string Pointcloud::VERTEX_VARIANCE = "vertex_variance";
 const std::string Pointcloud::VERTEX_ATTRIBUTES = "vertex_attributes";
 
-Pointcloud::Pointcloud() : sensor_origin(Eigen::Affine3d::Identity())
+Pointcloud::Pointcloud() : sensor_origin(Eigen::Affine3d::Identity()), revision(0)
 {
 }
 
-Pointcloud::Pointcloud(const base::samples::Pointcloud &pointcloud) : sensor_origin(Eigen::Affine3d::Identity())
+Pointcloud::Pointcloud(const base::samples::Pointcloud &pointcloud) : sensor_origin(Eigen::Affine3d::Identity()), revision(0)
 {
     copyFrom(pointcloud);
 }
@@ -51,7 +59,7 @@ void Pointcloud::unserialize(Serialization& so, bool handleMap)
     else
         sensor_origin = Eigen::Affine3d::Identity();
 
-    if(handleMap)
+    if(handleMap && !so.skipMapData())
     {
     if( !readPly( getMapFileName() + ".ply", so.getBinaryInputStream(getMapFileName() + ".ply") ) )
         readText( so.getBinaryInputStream(getMapFileName() + ".txt") );
@@ -67,6 +75,7 @@ bool Pointcloud::writePly(const std::string& filename, std::ostream& os, bool co
 bool Pointcloud::readPly(const std::string& filename, std::istream& is)
 {
     PlyFile ply(filename);
+    invalidateCaches();
     return ply.unserialize( this, is );
 }
 
@@ -80,33 +89,166 @@ bool Pointcloud::writeText(std::ostream& os)
     return true;
 }
 
-bool Pointcloud::readText(std::istream& is, int sample, TextFormat format)
+namespace
 {
-    const int max_line_length = 255;
-    std::vector<Eigen::Vector3d> *color = 0;
-    if(format == XYZR )
-        color = &getVertexData<Eigen::Vector3d>( VERTEX_COLOR );
-    while( !is.eof() )
+    /** a block of lines of a text pointcloud */
+    struct TextBlock
     {
-	if( sample == 1 || (rand() % sample == 0) )
+	TextBlock( const char* begin, const char* end )
+	    : begin( begin ), end( end ), irregular( false ) {}
+
+	const char* begin;
+	const char* end;
+	std::vector<Eigen::Vector3d> vertices;
+	std::vector<Eigen::Vector3d> colors;
+	/** set if a point spans multiple lines, or a line is longer than what
+	 * is ignored in one go. In this case the block boundaries can not be
+	 * used and the data has to be parsed sequentially. */
+	bool irregular;
+    };
+
+    /** parses a block in the same way as reading the values with
+     * operator>> and then ignoring the rest of the line (see
+     * Pointcloud::readText) */
+    void parseTextBlock( TextBlock& block, int sample, bool withColor )
+    {
+	const int max_line_length = 255;
+	const int values = withColor ? 4 : 3;
+	const char* p = block.begin;
+	const char* end = block.end;
+	while( p != end )
 	{
-	    double x, y, z, c;
-	    is >> x >> y >> z;
-	    if( format == XYZR && color )
+	    if( sample == 1 || (rand() % sample == 0) )
 	    {
-		is >> c;
-		color->push_back( Eigen::Vector3d::Identity() * c / 255.0 );
+		skipSpace( p, end );
+		if( p == end )
+		    break;
+
+		double v[4];
+		for( int i=0; i<values; i++ )
+		{
+		    while( p != end && isSpace( *p ) )
+		    {
+			if( *p == '\n' )
+			    block.irregular = true;
+			++p;
+		    }
+		    if( !parseDouble( p, end, v[i] ) )
+			throw std::runtime_error("could not parse number in pointcloud text data.");
+		}
+
+		if( withColor )
+		    block.colors.push_back( Eigen::Vector3d::Identity() * v[3] / 255.0 );
+		block.vertices.push_back( Eigen::Vector3d( v[0], v[1], v[2] ) );
+	    }
+
+	    // same as is.ignore( max_line_length, '\n' )
+	    const char* limit = p + std::min<std::ptrdiff_t>( max_line_length, end - p );
+	    const char* nl = std::find( p, limit, '\n' );
+	    if( nl != limit )
+		p = nl + 1;
+	    else
+	    {
+		if( limit != end )
+		    block.irregular = true;
+		p = limit;
 	    }
-	
-	    vertices.push_back( Eigen::Vector3d( x,y,z ) );
-	    is.ignore( max_line_length, '\n' );
 	}
-	else
-	    is.ignore( max_line_length, '\n' );
-        // check for eof bit, to avoid a copy of the last sample
-        is.peek();
     }
 
+    struct ParseTextBlocks
+    {
+	std::vector<TextBlock>* blocks;
+	bool withColor;
+
+	void operator()( size_t begin, size_t end )
+	{
+	    for( size_t i=begin; i<end; i++ )
+		parseTextBlock( (*blocks)[i], 1, withColor );
+	}
+    };
+}
+
+bool Pointcloud::readText(std::istream& is, int sample, TextFormat format)
+{
+    // read the remainder of the stream into memory and parse from there
+    std::vector<char> data;
+    std::streampos pos = is.tellg();
+    if( pos != std::streampos(-1) )
+    {
+	is.seekg( 0, std::ios::end );
+	std::streamoff size = is.tellg() - pos;
+	is.seekg( pos );
+	data.resize( size );
+	if( size > 0 )
+	    is.read( &data[0], size );
+	data.resize( is.gcount() );
+    }
+    else
+    {
+	data.assign( std::istreambuf_iterator<char>( is ), std::istreambuf_iterator<char>() );
+    }
+
+    if( data.empty() )
+	return readText( NULL, NULL, sample, format );
+    return readText( &data[0], &data[0] + data.size(), sample, format );
+}
+
+bool Pointcloud::readText(const char* begin, const char* end, int sample, TextFormat format)
+{
+    std::vector<Eigen::Vector3d> *color = 0;
+    if(format == XYZR )
+        color = &getVertexData<Eigen::Vector3d>( VERTEX_COLOR );
+
+    // split into blocks at line boundaries, each of which is at least 1MB.
+    // Sampling uses a sequence of random numbers, so it can only be done on
+    // a single block.
+    const size_t minBlockSize = 1 << 20;
+    std::vector<TextBlock> blocks;
+    const size_t count = sample == 1 ? 
+	std::min( getParallelThreads(), std::max( size_t(end - begin) / minBlockSize, size_t(1) ) ) : 1;
+    const char* blockBegin = begin;
+    for( size_t i=1; i<=count && blockBegin != end; i++ )
+    {
+	const char* blockEnd = begin + (end - begin) * i / count;
+	blockEnd = std::find( std::max( blockBegin, blockEnd ), end, '\n' );
+	if( blockEnd != end )
+	    blockEnd++;
+	blocks.push_back( TextBlock( blockBegin, blockEnd ) );
+	blockBegin = blockEnd;
+    }
+
+    ParseTextBlocks parse;
+    parse.blocks = &blocks;
+    parse.withColor = (color != NULL);
+    parallelFor( 0, blocks.size(), parse );
+
+    bool irregular = false;
+    for( size_t i=0; i<blocks.size(); i++ )
+	irregular |= blocks[i].irregular;
+    if( irregular && blocks.size() > 1 )
+    {
+	// fall back to parsing everything in one go
+	blocks.clear();
+	blocks.push_back( TextBlock( begin, end ) );
+	parseTextBlock( blocks.front(), sample, color );
+    }
+
+    size_t total = 0;
+    for( size_t i=0; i<blocks.size(); i++ )
+	total += blocks[i].vertices.size();
+
+    vertices.reserve( vertices.size() + total );
+    if( color )
+	color->reserve( color->size() + total );
+    for( size_t i=0; i<blocks.size(); i++ )
+    {
+	vertices.insert( vertices.end(), blocks[i].vertices.begin(), blocks[i].vertices.end() );
+	if( color )
+	    color->insert( color->end(), blocks[i].colors.begin(), blocks[i].colors.end() );
+    }
+    invalidateCaches();
+
     return true;
 }
 
@@ -117,10 +259,20 @@ Pointcloud* Pointcloud::importCsv(const std::string& file, FrameNode* fn, int sa
     {
         throw std::runtime_error("Could not open file '" + file + "'.");
     }
-    Pointcloud* pc = new Pointcloud();
-    pc->readText( data, sample, format );
     data.close();
 
+    // map the file into memory, which avoids copying the data
+    Pointcloud* pc = new Pointcloud();
+    if( boost::filesystem::file_size( file ) > 0 )
+    {
+	boost::interprocess::file_mapping mapping( file.c_str(), boost::interprocess::read_only );
+	boost::interprocess::mapped_region region( mapping, boost::interprocess::read_only );
+	const char* begin = static_cast<const char*>( region.get_address() );
+	pc->readText( begin, begin + region.get_size(), sample, format );
+    }
+    else
+	pc->readText( NULL, NULL, sample, format );
+
     Environment* env = fn->getEnvironment();
     env->attachItem(pc);
     pc->setFrameNode(fn);
@@ -143,8 +295,9 @@ void Pointcloud::copyFrom( Pointcloud* source, bool transform )
     }
     else
     {
-	for( std::vector<Eigen::Vector3d>::iterator it = source->vertices.begin(); it != source->vertices.end(); it ++ )
-	    vertices.push_back( t * *it );
+	vertices.resize( source->vertices.size() );
+	if( !vertices.empty() )
+	    transformPoints( t, &source->vertices[0], vertices.size(), &vertices[0] );
     }
 }
 
@@ -162,15 +315,114 @@ void Pointcloud::copyFrom(const base::samples::Pointcloud& source)
         colors.push_back(Eigen::Vector3d((*iter)(0),(*iter)(1),(*iter)(2)));
 }
 
+namespace
+{
+    /** computes the extents of blocks of vertices */
+    struct ExtentsBlock
+    {
+	const std::vector<Eigen::Vector3d>* vertices;
+	std::vector<Pointcloud::Extents>* extents;
+	size_t blockSize;
+
+	void operator()( size_t begin, size_t end )
+	{
+	    for( size_t b=begin; b<end; b++ )
+	    {
+		const size_t last = std::min( (b + 1) * blockSize, vertices->size() );
+		Pointcloud::Extents& res( (*extents)[b] );
+		for( size_t i=b * blockSize; i<last; i++ )
+		    res.extend( (*vertices)[i] );
+	    }
+	}
+    };
+}
+
+void Pointcloud::invalidateCaches()
+{
+    revision++;
+}
+
+void Pointcloud::validateCache() const
+{
+    const Eigen::Vector3d* data = vertices.empty() ? NULL : &vertices[0];
+    if( vertexCache.revision != revision || vertexCache.data != data || vertexCache.size != vertices.size() )
+    {
+	vertexCache.reset();
+	vertexCache.revision = revision;
+	vertexCache.data = data;
+	vertexCache.size = vertices.size();
+    }
+}
+
 Pointcloud::Extents Pointcloud::getExtents() const
 {
-    //TODO: Implement some sort of caching
-    Extents res;
-    for(size_t i=0;i<vertices.size();i++)
+    boost::mutex::scoped_lock lock( vertexCache.mutex );
+    validateCache();
+    if( !vertexCache.hasExtents )
+    {
+	const size_t blockSize = 64 * 1024;
+	ExtentsBlock blocks;
+	std::vector<Extents> extents( (vertices.size() + blockSize - 1) / blockSize );
+	blocks.vertices = &vertices;
+	blocks.extents = &extents;
+	blocks.blockSize = blockSize;
+	parallelFor( 0, extents.size(), blocks );
+
+	Extents res;
+	for( size_t i=0; i<extents.size(); i++ )
+	    res.extend( extents[i] );
+	vertexCache.extents = res;
+	vertexCache.hasExtents = true;
+    }
+    return vertexCache.extents;
+}
+
+boost::shared_ptr<const PointBVH> Pointcloud::getBVH() const
+{
+    boost::mutex::scoped_lock lock( vertexCache.mutex );
+    validateCache();
+    if( !vertexCache.bvh )
+    {
+	boost::shared_ptr<PointBVH> bvh( new PointBVH() );
+	bvh->build( vertices );
+	vertexCache.bvh = bvh;
+    }
+    return vertexCache.bvh;
+}
+
+namespace
+{
+    template <typename T>
+    const std::vector<T>* findVertexData( const Pointcloud& pc, const std::string& key )
     {
-	res.extend( vertices[i] );
+	if( !pc.hasData<std::vector<T> >( key ) )
+	    return NULL;
+	const std::vector<T>& data( pc.getData<std::vector<T> >( key ) );
+	return data.size() == pc.vertices.size() ? &data : NULL;
     }
-    return res; 
+}
+
+PointcloudView Pointcloud::getView() const
+{
+    PointcloudView view( PointcloudView::column( vertices ), vertices.size() );
+
+    const std::vector<Eigen::Vector3d> *colors = findVertexData<Eigen::Vector3d>( *this, VERTEX_COLOR );
+    if( colors )
+	view.colors = PointcloudView::column( *colors );
+
+    const std::vector<Eigen::Vector3d> *normals = findVertexData<Eigen::Vector3d>( *this, VERTEX_NORMAL );
+    if( normals )
+	view.normals = PointcloudView::column( *normals );
+
+    const std::vector<double> *variances = findVertexData<double>( *this, VERTEX_VARIANCE );
+    if( variances && !variances->empty() )
+	view.variances = &variances->front();
+
+    const std::vector<vertex_attr> *attributes = findVertexData<vertex_attr>( *this, VERTEX_ATTRIBUTES );
+    if( attributes && !attributes->empty() )
+	view.attributes = &attributes->front();
+
+    return view;
 }
 
 void Pointcloud::setSensorOrigin(const Transform& origin)
@@ -3,8 +3,12 @@
 
 #include <envire/Core.hpp>
 #include <envire/core/Serialization.hpp>
+#include <envire/maps/PointcloudView.hpp>
+#include <envire/tools/PointBVH.hpp>
 #include <Eigen/Core>
 #include <base/samples/Pointcloud.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
 
 namespace envire {
     class Pointcloud : public Map<3> 
@@ -52,8 +56,29 @@ namespace envire {
 	    return data;
 	};
 
+	/** 
+	 * Typed access to the standard per vertex data. These return the same
+	 * arrays as getVertexData() with the respective key, and create them
+	 * if they don't exist. The lookup is only performed on the first call,
+	 * and after the data has been shared with a copy of the pointcloud.
+	 * Otherwise the access is O(1).
+	 */
+	std::vector<Eigen::Vector3d>& getVertexColors() { return getSlot( VERTEX_COLOR, slots.colors ); }
+	std::vector<Eigen::Vector3d>& getVertexNormals() { return getSlot( VERTEX_NORMAL, slots.normals ); }
+	std::vector<double>& getVertexVariances() { return getSlot( VERTEX_VARIANCE, slots.variances ); }
+	std::vector<vertex_attr>& getVertexAttributes() { return getSlot( VERTEX_ATTRIBUTES, slots.attributes ); }
+
+	/** 
+	 * @return a view on the vertices and the standard per vertex data,
+	 * which does not copy any data. Data which is not available, or does
+	 * not have the same size as the vertices, is not part of the view. 
+	 * The view becomes invalid when the pointcloud is changed.
+	 */
+	PointcloudView getView() const;
+
 	void clear()
 	{
+	    invalidateCaches();
 	    vertices.clear();
 	    if( hasData( VERTEX_COLOR ) ) getVertexData<Eigen::Vector3d>( VERTEX_COLOR ).clear();
 	    if( hasData( VERTEX_NORMAL ) ) getVertexData<Eigen::Vector3d>( VERTEX_NORMAL ).clear();
@@ -75,13 +100,102 @@ namespace envire {
 	bool writeText(std::ostream& os);
 	bool readText(std::istream& is, int sample = 1, TextFormat = XYZR );
 
+	/** reads text data from the memory region [begin, end) in the same
+	 * format as readText(std::istream&). Large regions are split into
+	 * blocks of lines, which are parsed in parallel. */
+	bool readText(const char* begin, const char* end, int sample = 1, TextFormat = XYZR );
+
 	bool writePly(const std::string& filename, std::ostream& os, bool const doublePrecision = true);
 	bool readPly(const std::string& filename, std::istream& is);
 
+	/** 
+	 * @return the bounding box of the vertices. The extents are cached,
+	 * and recomputed after the vertices changed. Changes through the
+	 * methods of the pointcloud, and changes of the number of vertices
+	 * are detected. Code which changes the vertices in place needs to call
+	 * itemModified() or invalidateCaches() afterwards.
+	 */
 	Extents getExtents() const;
 
+	/** 
+	 * @return a bounding volume hierarchy over the vertices, which can be
+	 * used for crop, nearest point and culling queries. It is built on the
+	 * first call and cached in the same way as the extents. The returned
+	 * hierarchy stays valid when the pointcloud changes, but does not
+	 * reflect the changes.
+	 */
+	boost::shared_ptr<const PointBVH> getBVH() const;
+
+	void invalidateCaches();
+
     void setSensorOrigin(const Transform& origin);
     const Transform& getSensorOrigin() const;
+
+    private:
+	/** cached pointers to the standard per vertex data. The cache is not
+	 * copied with the pointcloud, and invalidated when data is removed. */
+	struct SlotCache
+	{
+	    SlotCache() { reset( 0 ); }
+	    SlotCache( const SlotCache& ) { reset( 0 ); }
+	    SlotCache& operator=( const SlotCache& ) { reset( 0 ); return *this; }
+
+	    void reset( unsigned long gen )
+	    {
+		generation = gen;
+		colors = normals = NULL;
+		variances = NULL;
+		attributes = NULL;
+	    }
+
+	    unsigned long generation;
+	    std::vector<Eigen::Vector3d> *colors, *normals;
+	    std::vector<double> *variances;
+	    std::vector<vertex_attr> *attributes;
+	};
+	SlotCache slots;
+
+	/** cached data which is derived from the vertices. It is valid as
+	 * long as the revision and the vertex array are the same. */
+	struct VertexCache
+	{
+	    VertexCache() { reset(); }
+	    VertexCache( const VertexCache& ) { reset(); }
+	    VertexCache& operator=( const VertexCache& ) { reset(); return *this; }
+
+	    void reset()
+	    {
+		revision = 0;
+		data = NULL;
+		size = 0;
+		hasExtents = false;
+		bvh.reset();
+	    }
+
+	    boost::mutex mutex;
+	    unsigned long revision;
+	    const Eigen::Vector3d* data;
+	    size_t size;
+	    bool hasExtents;
+	    Extents extents;
+	    boost::shared_ptr<const PointBVH> bvh;
+	};
+	mutable VertexCache vertexCache;
+	unsigned long revision;
+
+	/** resets the cache if it doesn't match the vertices. Needs to be
+	 * called with the cache mutex locked. */
+	void validateCache() const;
+
+	template <typename T>
+	    std::vector<T>& getSlot( const std::string& key, std::vector<T>*& slot )
+	{
+	    if( slots.generation != data_generation )
+		slots.reset( data_generation );
+	    if( !slot )
+		slot = &getVertexData<T>( key );
+	    return *slot;
+	}
     };
 }
 
@@ -0,0 +1,192 @@
+#ifndef __ENVIRE_POINTCLOUDSTORAGE_HPP__
+#define __ENVIRE_POINTCLOUDSTORAGE_HPP__
+
+#include <envire/maps/Pointcloud.hpp>
+#include <envire/maps/PointcloudView.hpp>
+
+#include <Eigen/Core>
+#include <vector>
+
+namespace envire
+{
+    /**
+     * Owning, column oriented storage for point data, with the scalar type
+     * as a parameter. Each of the standard vertex data has a fixed column,
+     * which is only allocated when it is enabled. With float, a point
+     * takes 12 bytes instead of the 24 of the vertices of a Pointcloud.
+     *
+     * The storage is meant for point data which does not need to be an
+     * item of the environment, e.g. the scans of a sensor before they are
+     * projected. getView() gives a view on the data without copying, which
+     * can be passed to the consumers of views like
+     * MLSProjection::projectView(). assign() and copyTo() convert from and
+     * to a Pointcloud.
+     */
+    template <class Scalar>
+    class PointcloudStorageT
+    {
+    public:
+	typedef Scalar scalar_type;
+	typedef Eigen::Matrix<Scalar, 3, 1> Vector3;
+	typedef Eigen::Map<Vector3, Eigen::Unaligned> Vector3Map;
+	typedef PointcloudViewT<Scalar> View;
+
+	/** flags for the columns in addition to the points */
+	enum Column
+	{
+	    COLORS = 1,
+	    NORMALS = 2,
+	    VARIANCES = 4,
+	    ATTRIBUTES = 8
+	};
+
+	explicit PointcloudStorageT( int columns = 0 )
+	    : columns( columns ), count( 0 ) {}
+
+	int getColumns() const { return columns; }
+	bool hasColumn( Column column ) const { return columns & column; }
+
+	/** enables the given columns and disables the others. The data of
+	 * newly enabled columns is zero. */
+	void setColumns( int columns )
+	{
+	    this->columns = columns;
+	    resizeColumns( count );
+	}
+
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+
+	void reserve( size_t n )
+	{
+	    points.reserve( 3 * n );
+	    if( hasColumn( COLORS ) ) colors.reserve( 3 * n );
+	    if( hasColumn( NORMALS ) ) normals.reserve( 3 * n );
+	    if( hasColumn( VARIANCES ) ) variances.reserve( n );
+	    if( hasColumn( ATTRIBUTES ) ) attributes.reserve( n );
+	}
+
+	/** resizes all enabled columns. New data is zero. */
+	void resize( size_t n )
+	{
+	    points.resize( 3 * n );
+	    resizeColumns( n );
+	    count = n;
+	}
+
+	void clear() { resize( 0 ); }
+
+	/** appends a point, the data of the other columns is zero
+	 * @return the index of the point */
+	size_t push_back( const Vector3& p )
+	{
+	    resize( count + 1 );
+	    point( count - 1 ) = p;
+	    return count - 1;
+	}
+
+	Vector3Map point( size_t i ) { return Vector3Map( &points[3 * i] ); }
+	Vector3Map color( size_t i ) { return Vector3Map( &colors[3 * i] ); }
+	Vector3Map normal( size_t i ) { return Vector3Map( &normals[3 * i] ); }
+	Scalar& variance( size_t i ) { return variances[i]; }
+	int& attribute( size_t i ) { return attributes[i]; }
+
+	/** @return a view on the points and the enabled columns, which is
+	 * valid until the storage is resized */
+	View getView() const
+	{
+	    View view( count ? &points[0] : NULL, count );
+	    if( count && hasColumn( COLORS ) ) view.colors = &colors[0];
+	    if( count && hasColumn( NORMALS ) ) view.normals = &normals[0];
+	    if( count && hasColumn( VARIANCES ) ) view.variances = &variances[0];
+	    if( count && hasColumn( ATTRIBUTES ) ) view.attributes = &attributes[0];
+	    return view;
+	}
+
+	/** replaces the data with the one of the view, which can have a
+	 * different scalar type. The columns are the ones of the view. */
+	template <class S>
+	void assign( const PointcloudViewT<S>& view )
+	{
+	    columns = (view.hasColors() ? COLORS : 0)
+		| (view.hasNormals() ? NORMALS : 0)
+		| (view.hasVariances() ? VARIANCES : 0)
+		| (view.hasAttributes() ? ATTRIBUTES : 0);
+	    resize( view.size() );
+	    for( size_t i=0; i<count; i++ )
+	    {
+		point( i ) = view.point( i ).template cast<Scalar>();
+		if( view.hasColors() ) color( i ) = view.color( i ).template cast<Scalar>();
+		if( view.hasNormals() ) normal( i ) = view.normal( i ).template cast<Scalar>();
+		if( view.hasVariances() ) variances[i] = view.variance( i );
+		if( view.hasAttributes() ) attributes[i] = view.attribute( i );
+	    }
+	}
+
+	/** replaces the data with the vertices of the pointcloud and the
+	 * standard vertex data which has the size of the vertices */
+	void assign( const Pointcloud& pc ) { assign( pc.getView() ); }
+
+	/** replaces the vertices and the standard vertex data of the
+	 * pointcloud with the points and the enabled columns. The standard
+	 * vertex data of the other columns is removed. */
+	void copyTo( Pointcloud& pc ) const
+	{
+	    pc.vertices.resize( count );
+	    std::vector<Eigen::Vector3d> *pcColors = NULL, *pcNormals = NULL;
+	    if( hasColumn( COLORS ) )
+	    {
+		pcColors = &pc.getVertexColors();
+		pcColors->resize( count );
+	    }
+	    else if( pc.hasData( Pointcloud::VERTEX_COLOR ) )
+		pc.removeData( Pointcloud::VERTEX_COLOR );
+
+	    if( hasColumn( NORMALS ) )
+	    {
+		pcNormals = &pc.getVertexNormals();
+		pcNormals->resize( count );
+	    }
+	    else if( pc.hasData( Pointcloud::VERTEX_NORMAL ) )
+		pc.removeData( Pointcloud::VERTEX_NORMAL );
+
+	    if( hasColumn( VARIANCES ) )
+		pc.getVertexVariances().assign( variances.begin(), variances.end() );
+	    else if( pc.hasData( Pointcloud::VERTEX_VARIANCE ) )
+		pc.removeData( Pointcloud::VERTEX_VARIANCE );
+
+	    if( hasColumn( ATTRIBUTES ) )
+		pc.getVertexAttributes().assign( attributes.begin(), attributes.end() );
+	    else if( pc.hasData( Pointcloud::VERTEX_ATTRIBUTES ) )
+		pc.removeData( Pointcloud::VERTEX_ATTRIBUTES );
+
+	    const View view( getView() );
+	    for( size_t i=0; i<count; i++ )
+	    {
+		pc.vertices[i] = view.point( i ).template cast<double>();
+		if( pcColors ) (*pcColors)[i] = view.color( i ).template cast<double>();
+		if( pcNormals ) (*pcNormals)[i] = view.normal( i ).template cast<double>();
+	    }
+	    pc.invalidateCaches();
+	}
+
+    private:
+	void resizeColumns( size_t n )
+	{
+	    colors.resize( hasColumn( COLORS ) ? 3 * n : 0 );
+	    normals.resize( hasColumn( NORMALS ) ? 3 * n : 0 );
+	    variances.resize( hasColumn( VARIANCES ) ? n : 0 );
+	    attributes.resize( hasColumn( ATTRIBUTES ) ? n : 0 );
+	}
+
+	int columns;
+	size_t count;
+	std::vector<Scalar> points, colors, normals, variances;
+	std::vector<int> attributes;
+    };
+
+    typedef PointcloudStorageT<double> PointcloudStorage;
+    typedef PointcloudStorageT<float> PointcloudStoragef;
+}
+
+#endif
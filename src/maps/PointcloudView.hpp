@@ -0,0 +1,98 @@
+#ifndef __ENVIRE_POINTCLOUDVIEW_HPP__
+#define __ENVIRE_POINTCLOUDVIEW_HPP__
+
+#include <Eigen/Core>
+#include <vector>
+
+namespace envire
+{
+    /**
+     * Non-owning, column oriented view on the data of a pointcloud.
+     *
+     * The view stores pointers to the first element of each column together
+     * with the stride between two elements (in number of scalars), so it can
+     * be created without copying from a Pointcloud, from a vector of
+     * Eigen::Vector3d or from any other buffer of interleaved or planar
+     * float or double data, e.g. as delivered by a sensor driver.
+     *
+     * Columns which are not available are NULL. The view is only valid as
+     * long as the underlying data is not changed or resized.
+     */
+    template <class Scalar>
+    struct PointcloudViewT
+    {
+	typedef Scalar scalar_type;
+	typedef Eigen::Matrix<Scalar, 3, 1> Vector3;
+	typedef Eigen::Map<const Vector3, Eigen::Unaligned, Eigen::InnerStride<> > ConstVector3;
+
+	PointcloudViewT()
+	    : count( 0 ),
+	    points( NULL ), pointStride( 3 ),
+	    colors( NULL ), colorStride( 3 ),
+	    normals( NULL ), normalStride( 3 ),
+	    variances( NULL ), varianceStride( 1 ),
+	    attributes( NULL ) {}
+
+	/** view on the given points, without any attributes */
+	PointcloudViewT( const Scalar* points, size_t count, size_t pointStride = 3 )
+	    : count( count ),
+	    points( points ), pointStride( pointStride ),
+	    colors( NULL ), colorStride( 3 ),
+	    normals( NULL ), normalStride( 3 ),
+	    variances( NULL ), varianceStride( 1 ),
+	    attributes( NULL ) {}
+
+	/** number of points in the view */
+	size_t count;
+
+	const Scalar* points;
+	size_t pointStride;
+	const Scalar* colors;
+	size_t colorStride;
+	const Scalar* normals;
+	size_t normalStride;
+	const Scalar* variances;
+	size_t varianceStride;
+	const int* attributes;
+
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+
+	bool hasColors() const { return colors; }
+	bool hasNormals() const { return normals; }
+	bool hasVariances() const { return variances; }
+	bool hasAttributes() const { return attributes; }
+
+	/** @return the point with the given index. Note, that this is a
+	 * map on the data and not a copy */
+	ConstVector3 point( size_t i ) const
+	{
+	    return ConstVector3( points + i * pointStride, Eigen::InnerStride<>( 1 ) );
+	}
+
+	ConstVector3 color( size_t i ) const
+	{
+	    return ConstVector3( colors + i * colorStride, Eigen::InnerStride<>( 1 ) );
+	}
+
+	ConstVector3 normal( size_t i ) const
+	{
+	    return ConstVector3( normals + i * normalStride, Eigen::InnerStride<>( 1 ) );
+	}
+
+	Scalar variance( size_t i ) const { return variances[i * varianceStride]; }
+
+	int attribute( size_t i ) const { return attributes[i]; }
+
+	/** helper to get the column pointer of a vector of 3d vectors */
+	static const Scalar* column( const std::vector<Vector3>& v )
+	{
+	    return v.empty() ? NULL : v.front().data();
+	}
+    };
+
+    typedef PointcloudViewT<double> PointcloudView;
+    typedef PointcloudViewT<float> PointcloudViewf;
+}
+
+#endif
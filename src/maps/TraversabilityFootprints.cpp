@@ -0,0 +1,173 @@
+#include "TraversabilityFootprints.hpp"
+#include <envire/tools/Parallel.hpp>
+
+#include <Eigen/Geometry>
+#include <cmath>
+#include <limits>
+
+using namespace envire;
+
+TraversabilityFootprints::TraversabilityFootprints(const TraversabilityGrid &grid, double sizeX, double sizeY, size_t headings)
+    : grid(grid), width(grid.getCellSizeX()), height(grid.getCellSizeY())
+{
+    if(headings == 0)
+        throw std::runtime_error("TraversabilityFootprints: need at least one heading");
+    if(!grid.hasBand(TraversabilityGrid::TRAVERSABILITY))
+        throw std::runtime_error("TraversabilityFootprints: grid has no traversability band");
+
+    // unregistered values are treated like empty placeholder classes
+    const std::vector<TraversabilityClass> &classes(grid.getTraversabilityClasses());
+    for(size_t i = 0; i < 256; i++)
+        drivability[i] = i < classes.size() ? classes[i].getDrivability() : TraversabilityClass().getDrivability();
+
+    // rasterize the rectangle for each heading. The rectangle is convex, so
+    // each line of the mask is a single span.
+    const double scaleX = grid.getScaleX();
+    const double scaleY = grid.getScaleY();
+    const double radius = sqrt(sizeX * sizeX + sizeY * sizeY) / 2.0;
+    const int rx = ceil(radius / scaleX) + 1;
+    const int ry = ceil(radius / scaleY) + 1;
+    const double halfX = sizeX / 2.0;
+    const double halfY = sizeY / 2.0;
+
+    masks.resize(headings);
+    for(size_t h = 0; h < headings; h++)
+    {
+        const Eigen::Rotation2D<double> inverse(-2.0 * M_PI * h / headings);
+        for(int dy = -ry; dy <= ry; dy++)
+        {
+            Span span;
+            span.dy = dy;
+            span.x0 = std::numeric_limits<int>::max();
+            span.x1 = std::numeric_limits<int>::min();
+            for(int dx = -rx; dx <= rx; dx++)
+            {
+                const Eigen::Vector2d p = inverse * Eigen::Vector2d(dx * scaleX, dy * scaleY);
+                if((fabs(p.x()) <= halfX && fabs(p.y()) <= halfY) || (dx == 0 && dy == 0))
+                {
+                    span.x0 = std::min(span.x0, dx);
+                    span.x1 = std::max(span.x1, dx);
+                }
+            }
+            if(span.x0 <= span.x1)
+                masks[h].push_back(span);
+        }
+    }
+}
+
+size_t TraversabilityFootprints::getHeadingIndex(double orientation) const
+{
+    const double step = 2.0 * M_PI / masks.size();
+    long idx = floor(orientation / step + 0.5);
+    idx %= (long)masks.size();
+    if(idx < 0)
+        idx += masks.size();
+    return idx;
+}
+
+namespace
+{
+    struct WorstKernel
+    {
+        const double *drivability;
+        TraversabilityFootprints::Result result;
+
+        explicit WorstKernel(const double *drivability) : drivability(drivability) {}
+
+        inline void operator()(const uint8_t *traversability, const uint8_t *probability, size_t x0, size_t x1, size_t)
+        {
+            for(size_t x = x0; x <= x1; x++)
+            {
+                const uint8_t klass = traversability[x];
+                if(drivability[klass] < result.worstDrivability || !result.cells)
+                {
+                    result.worstClass = klass;
+                    result.worstDrivability = drivability[klass];
+                }
+            }
+
+            if(probability)
+            {
+                uint8_t worst = std::numeric_limits<uint8_t>::max();
+                for(size_t x = x0; x <= x1; x++)
+                    worst = std::min(worst, probability[x]);
+                result.worstProbability = std::min(result.worstProbability,
+                        (double)worst / std::numeric_limits<uint8_t>::max());
+            }
+
+            result.cells += x1 - x0 + 1;
+        }
+    };
+
+    struct HistogramKernel
+    {
+        size_t *histogram;
+
+        inline void operator()(const uint8_t *traversability, const uint8_t *, size_t x0, size_t x1, size_t)
+        {
+            for(size_t x = x0; x <= x1; x++)
+                histogram[traversability[x]]++;
+        }
+    };
+
+    struct QueryBatch
+    {
+        const TraversabilityFootprints *footprints;
+        const std::vector<base::Pose2D> *poses;
+        std::vector<TraversabilityFootprints::Result> *results;
+
+        void operator()(size_t begin, size_t end)
+        {
+            for(size_t i = begin; i < end; i++)
+                (*results)[i] = footprints->query((*poses)[i]);
+        }
+    };
+
+    struct HistogramBatch
+    {
+        const TraversabilityFootprints *footprints;
+        const std::vector<base::Pose2D> *poses;
+        std::vector<std::vector<size_t> > *histograms;
+
+        void operator()(size_t begin, size_t end)
+        {
+            for(size_t i = begin; i < end; i++)
+                footprints->getHistogram((*poses)[i], (*histograms)[i]);
+        }
+    };
+}
+
+TraversabilityFootprints::Result TraversabilityFootprints::query(const base::Pose2D &pose) const
+{
+    WorstKernel kernel(drivability);
+    kernel.result.valid = forEachSpan(pose, kernel);
+    return kernel.result;
+}
+
+void TraversabilityFootprints::query(const std::vector<base::Pose2D> &poses, std::vector<Result> &results, size_t threads) const
+{
+    results.resize(poses.size());
+    QueryBatch batch;
+    batch.footprints = this;
+    batch.poses = &poses;
+    batch.results = &results;
+    parallelFor(0, poses.size(), batch, 64, threads);
+}
+
+bool TraversabilityFootprints::getHistogram(const base::Pose2D &pose, std::vector<size_t> &histogram) const
+{
+    histogram.assign(256, 0);
+    HistogramKernel kernel;
+    kernel.histogram = &histogram[0];
+    return forEachSpan(pose, kernel);
+}
+
+void TraversabilityFootprints::getHistograms(const std::vector<base::Pose2D> &poses, std::vector<std::vector<size_t> > &histograms, size_t threads) const
+{
+    histograms.resize(poses.size());
+    HistogramBatch batch;
+    batch.footprints = this;
+    batch.poses = &poses;
+    batch.histograms = &histograms;
+    parallelFor(0, poses.size(), batch, 64, threads);
+}
@@ -0,0 +1,151 @@
+#ifndef ENVIRE_TRAVERSABILITYFOOTPRINTS_H
+#define ENVIRE_TRAVERSABILITYFOOTPRINTS_H
+
+#include <envire/maps/TraversabilityGrid.hpp>
+#include <base/Pose.hpp>
+
+#include <vector>
+
+namespace envire
+{
+
+/**
+ * Evaluates rectangular robot footprints on a TraversabilityGrid.
+ *
+ * The footprint is rasterized once for a fixed number of discrete
+ * headings. A cell belongs to the footprint if its center is inside the
+ * rectangle, when the rectangle is centered on the cell which contains
+ * the pose position. The orientation of a pose is rounded to the nearest
+ * heading. Each mask is stored as a list of line spans, so that a query
+ * only iterates over the covered cells without any callbacks.
+ *
+ * Cells of the footprint which are outside the grid are ignored. The
+ * worst class is the one with the lowest drivability, like in
+ * TraversabilityGrid::getWorstTraversabilityClassInRectangle. Class values
+ * which are not registered in the grid are treated like empty placeholder
+ * classes.
+ *
+ * All the queries are const and don't modify the grid, so they can be
+ * called from multiple threads as long as the grid is not changed. The
+ * footprints need to be recreated if the size of the grid, the scale or
+ * the traversability classes change.
+ */
+class TraversabilityFootprints
+{
+public:
+    struct Result
+    {
+        Result() : valid(false), worstClass(0), worstDrivability(1.0), worstProbability(1.0), cells(0) {}
+
+        /** false if the center of the pose is outside of the grid */
+        bool valid;
+        /** class with the lowest drivability */
+        uint8_t worstClass;
+        double worstDrivability;
+        /** lowest probability value, see TraversabilityGrid::getProbability */
+        double worstProbability;
+        /** number of grid cells covered by the footprint */
+        size_t cells;
+    };
+
+    /**
+     * @param grid - grid to evaluate. A reference to the grid is kept.
+     * @param sizeX - size of the rectangle along the heading
+     * @param sizeY - size of the rectangle perpendicular to the heading
+     * @param headings - number of discrete headings in [0, 2*pi[
+     */
+    TraversabilityFootprints(const TraversabilityGrid &grid, double sizeX, double sizeY, size_t headings = 64);
+
+    /** evaluates the worst class and probability for a single pose */
+    Result query(const base::Pose2D &pose) const;
+
+    /** evaluates a batch of poses, using multiple threads.
+     * @param threads - number of threads, 0 for all hardware threads
+     */
+    void query(const std::vector<base::Pose2D> &poses, std::vector<Result> &results, size_t threads = 0) const;
+
+    /** computes the number of cells for each class value in the
+     * footprint. histogram is resized to 256 entries.
+     * @return false if the center of the pose is outside of the grid */
+    bool getHistogram(const base::Pose2D &pose, std::vector<size_t> &histogram) const;
+
+    /** evaluates the class histograms for a batch of poses */
+    void getHistograms(const std::vector<base::Pose2D> &poses, std::vector<std::vector<size_t> > &histograms, size_t threads = 0) const;
+
+    /** @return the index of the discrete heading used for the given
+     * orientation */
+    size_t getHeadingIndex(double orientation) const;
+
+    size_t getHeadingCount() const { return masks.size(); }
+
+    /** calls f(x, y) for each cell of the footprint at the given pose, in
+     * the same way as the queries iterate the cells.
+     * @return false if the center of the pose is outside of the grid */
+    template <class F>
+    bool forEachCell(const base::Pose2D &pose, F &f) const
+    {
+        SpanCells<F> op(f);
+        return forEachSpan(pose, op);
+    }
+
+private:
+    /** the cells [x0, x1] in the line dy, relative to the center cell */
+    struct Span
+    {
+        int dy, x0, x1;
+    };
+
+    template <class F>
+    struct SpanCells
+    {
+        F &f;
+        explicit SpanCells(F &f) : f(f) {}
+        void operator()(const uint8_t*, const uint8_t*, size_t x0, size_t x1, size_t y)
+        {
+            for(size_t x = x0; x <= x1; x++)
+                f(x, y);
+        }
+    };
+
+    /** calls op(traversabilityRow, probabilityRow, x0, x1, y) for each
+     * span of the footprint, clipped to the grid */
+    template <class Op>
+    bool forEachSpan(const base::Pose2D &pose, Op &op) const
+    {
+        size_t cx, cy;
+        if(!grid.toGrid(pose.position.x(), pose.position.y(), cx, cy))
+            return false;
+
+        // the bands are looked up for each query, since the grid may
+        // detach them from a copy when it is written to
+        if(!grid.hasBand(TraversabilityGrid::TRAVERSABILITY))
+            return false;
+        const uint8_t *traversability = grid.getGridData(TraversabilityGrid::TRAVERSABILITY).data();
+        const uint8_t *probability = grid.hasBand(TraversabilityGrid::PROBABILITY) ?
+            grid.getGridData(TraversabilityGrid::PROBABILITY).data() : NULL;
+
+        const std::vector<Span> &mask(masks[getHeadingIndex(pose.orientation)]);
+        for(std::vector<Span>::const_iterator it = mask.begin(); it != mask.end(); it++)
+        {
+            const long y = (long)cy + it->dy;
+            if(y < 0 || y >= (long)height)
+                continue;
+            const long x0 = std::max((long)cx + it->x0, 0L);
+            const long x1 = std::min((long)cx + it->x1, (long)width - 1);
+            if(x0 > x1)
+                continue;
+            op(traversability + y * width, probability ? probability + y * width : NULL, x0, x1, y);
+        }
+        return true;
+    }
+
+    const TraversabilityGrid &grid;
+    size_t width, height;
+    /** drivability for each class value */
+    double drivability[256];
+
+    std::vector<std::vector<Span> > masks;
+};
+
+}
+#endif
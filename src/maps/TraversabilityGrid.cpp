@@ -1,5 +1,6 @@
 #include "TraversabilityGrid.hpp"
 #include <boost/bind.hpp>
+#include <boost/thread/tss.hpp>
 #include <tools/RadialLookUpTable.hpp>
 #include <tools/BoxLookUpTable.hpp>
 #include <Eigen/Geometry>
@@ -25,8 +26,10 @@ const std::vector<std::string> &TraversabilityGrid::bands = initTraversabilityBa
 
 class StatisticHelper
 {
-    static RadialLookUpTable *lut;
-    static BoxLookUpTable *boxLut;
+    // the tables are recomputed for every query, so each thread needs its
+    // own copy
+    static boost::thread_specific_ptr<RadialLookUpTable> lut;
+    static boost::thread_specific_ptr<BoxLookUpTable> boxLut;
     const base::Pose2D &pose;
     Eigen::Rotation2D<double> inverseOrientation;
     const TraversabilityGrid &grid;
@@ -43,12 +46,12 @@ public:
     inverseOrientation(Eigen::Rotation2D<double>(pose.orientation).inverse()), grid(grid), gridData(grid.getGridData(TraversabilityGrid::TRAVERSABILITY))
     , scaleX(grid.getScaleX()), scaleY(grid.getScaleY())
     {
-        if(!lut)
-            lut = new RadialLookUpTable();
+        if(!lut.get())
+            lut.reset(new RadialLookUpTable());
         lut->recompute(grid.getScaleX(), std::max(sizeX, sizeY));
         
-        if(!boxLut)
-            boxLut = new BoxLookUpTable();
+        if(!boxLut.get())
+            boxLut.reset(new BoxLookUpTable());
         //note the scale should be higher than the grid scale because 
         //of the roation. Else we get aliasing problems.
         boxLut->recompute(scaleX / 10.0, sizeX, sizeY, borderWidth * 2);
@@ -80,8 +83,8 @@ public:
     }
 };
 
-RadialLookUpTable *StatisticHelper::lut;
-BoxLookUpTable *StatisticHelper::boxLut;
+boost::thread_specific_ptr<RadialLookUpTable> StatisticHelper::lut;
+boost::thread_specific_ptr<BoxLookUpTable> StatisticHelper::boxLut;
 
 void addVal(size_t x, size_t y, std::vector<uint8_t> &stats, const TraversabilityGrid::ArrayType &gridData)
 {
@@ -176,8 +179,9 @@ void TraversabilityGrid::setTraversability(uint8_t klass, size_t x, size_t y)
 
 const TraversabilityClass& TraversabilityGrid::getTraversability(size_t x, size_t y) const
 {
-    setTraversabilityArray();
-    return traversabilityClasses[(*traversabilityArray)[y][x]];
+    // the const read must neither detach the shared band nor touch the
+    // cached pointers, so that it is safe for concurrent readers
+    return traversabilityClasses[getGridData(TRAVERSABILITY)[y][x]];
 }
 
 bool TraversabilityGrid::registerNewTraversabilityClass(uint8_t& retId, const TraversabilityClass& klass)
@@ -210,6 +214,12 @@ const TraversabilityClass& TraversabilityGrid::getTraversabilityClass(uint8_t kl
 
 void TraversabilityGrid::setProbabilityArray()
 {
+    if(arrayGeneration != data_generation)
+    {
+        probabilityArray = traversabilityArray = NULL;
+        arrayGeneration = data_generation;
+    }
+
     if(!probabilityArray)
     {
         probabilityArray = &(getData<ArrayType>(PROBABILITY));
@@ -220,6 +230,12 @@ void TraversabilityGrid::setProbabilityArray()
 
 void TraversabilityGrid::setTraversabilityArray()
 {
+    if(arrayGeneration != data_generation)
+    {
+        probabilityArray = traversabilityArray = NULL;
+        arrayGeneration = data_generation;
+    }
+
     if(!traversabilityArray)
     {
         traversabilityArray = &(getData<ArrayType>(TRAVERSABILITY));
@@ -228,32 +244,21 @@ void TraversabilityGrid::setTraversabilityArray()
 }
 
 
-void TraversabilityGrid::setProbabilityArray() const
-{
-    TraversabilityGrid *nonConst = const_cast<TraversabilityGrid *>(this);
-    nonConst->setProbabilityArray();
-}
-
-void TraversabilityGrid::setTraversabilityArray() const
+uint8_t TraversabilityGrid::toProbabilityValue(double probability)
 {
-    TraversabilityGrid *nonConst = const_cast<TraversabilityGrid *>(this);
-    nonConst->setTraversabilityArray();
+    return std::max<uint32_t>(std::numeric_limits< uint8_t >::max(), probability * std::numeric_limits< uint8_t >::max());
 }
 
 void TraversabilityGrid::setProbability(double probability, size_t x, size_t y) 
 {
     setProbabilityArray();
     
-    const uint8_t probVal = std::max<uint32_t>(std::numeric_limits< uint8_t >::max(), probability * std::numeric_limits< uint8_t >::max());
-    
-    (*probabilityArray)[y][x] = probVal;
+    (*probabilityArray)[y][x] = toProbabilityValue(probability);
 }
 
 double TraversabilityGrid::getProbability(size_t x, size_t y) const
 {
-    const_cast<TraversabilityGrid *>(this)->setProbabilityArray();
-    
-    return ((double) (*probabilityArray)[y][x]) / std::numeric_limits< uint8_t >::max();
+    return ((double) getGridData(PROBABILITY)[y][x]) / std::numeric_limits< uint8_t >::max();
 }
 
 void TraversabilityGrid::serialize(Serialization& so)
@@ -134,22 +134,32 @@ private:
     std::vector<TraversabilityClass> traversabilityClasses;
     ArrayType *probabilityArray;
     ArrayType *traversabilityArray;
+    /** data_generation for which the array pointers are valid. The
+     * pointers are only used on the write path, the const getters read
+     * the bands through the const getGridData(), which never detaches. */
+    unsigned long arrayGeneration;
     
     void probabilityCallback(size_t x, size_t y, double &worst) const; 
-    void setProbabilityArray() const;
-    void setTraversabilityArray() const;
     void setProbabilityArray();
     void setTraversabilityArray();
+    /** creates both bands, so that the const getters always find them */
+    void createBands()
+    {
+        getGridData(TRAVERSABILITY);
+        getGridData(PROBABILITY);
+    }
 public:
-    TraversabilityGrid() : Grid<uint8_t>(), probabilityArray(NULL), traversabilityArray(NULL)
+    TraversabilityGrid() : Grid<uint8_t>(), probabilityArray(NULL), traversabilityArray(NULL), arrayGeneration(0)
     {
+        createBands();
     };
     TraversabilityGrid(size_t cellSizeX, size_t cellSizeY, 
                         double scalex, double scaley, 
                         double offsetx = 0.0, double offsety = 0.0,
                         std::string const& id = Environment::ITEM_NOT_ATTACHED):Grid<uint8_t>::Grid(cellSizeX,cellSizeY,scalex,scaley,offsetx, offsety, id), 
-                        probabilityArray(NULL), traversabilityArray(NULL)
+                        probabilityArray(NULL), traversabilityArray(NULL), arrayGeneration(0)
     {
+        createBands();
     };
     
     ~TraversabilityGrid(){};
@@ -197,6 +207,10 @@ public:
      * for a given point in the map. 
      * */
     void setProbability(double probability, size_t x, size_t y);
+
+    /** @return the value which setProbability() stores in the
+     * probability band for the given probability */
+    static uint8_t toProbabilityValue(double probability);
     double getProbability(size_t x, size_t y) const;
     double getWorstProbabilityInRectangle(const base::Pose2D &pose, double sizeX, double sizeY) const;
 
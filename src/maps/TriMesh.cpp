@@ -1,7 +1,9 @@
 #include "Core.hpp"
 #include "TriMesh.hpp"
+#include <envire/tools/MeshNormals.hpp>
 
 #include <stdexcept>
+#include <algorithm>
 
 using namespace envire;
 
@@ -22,46 +24,46 @@ void TriMesh::unserialize(Serialization& so)
 {
     Pointcloud::unserialize(so, false);
     
-    readPly( getMapFileName() + ".ply", so.getBinaryInputStream(getMapFileName() + ".ply") );
+    if( !so.skipMapData() )
+	readPly( getMapFileName() + ".ply", so.getBinaryInputStream(getMapFileName() + ".ply") );
 }
 
-void TriMesh::calcVertexNormals()
+void TriMesh::calcVertexNormals( size_t firstFace )
 {
-    // calculate the Triangle normals first
     std::vector<Eigen::Vector3d>& point_normal(getVertexData<Eigen::Vector3d>(TriMesh::VERTEX_NORMAL));
-    point_normal.resize( vertices.size(), Eigen::Vector3d::Zero() );
-    std::fill( point_normal.begin(), point_normal.end(), Eigen::Vector3d::Zero() );
+    const size_t firstVertex = firstFace > 0 ? std::min( point_normal.size(), vertices.size() ) : 0;
 
-    // go through all the faces and compute the normals 
-    for(size_t i=0;i<faces.size();i++)
-    {
-	size_t tri[3] = {
-            static_cast<size_t>(faces[i].get<0>()),
-            static_cast<size_t>(faces[i].get<1>()),
-            static_cast<size_t>(faces[i].get<2>())
-        };
-	Eigen::Vector3d a[3];
-	for(int n=0;n<3;n++)
-	    a[n] = vertices[ tri[n] ];
-
-	// get the surface normal
-	Eigen::Vector3d normal = (a[0]-a[1]).cross(a[2]-a[1]).normalized();
+    // the adjacency of the previous call can be extended if it covers
+    // exactly the faces before the new ones
+    if( firstVertex == 0 
+	    || normalAdjacency.getMeshFaceCount() != firstFace 
+	    || normalAdjacency.getVertexCount() > vertices.size() )
+	normalAdjacency.build( vertices.size(), faces );
+    else
+	normalAdjacency.extend( vertices.size(), faces );
 
-	for(int n=0;n<3;n++)
-	    point_normal[tri[n]] = normal;
+    if( firstVertex == 0 )
+    {
+	normalAdjacency.compute( vertices, faces, point_normal );
+	return;
     }
-    
-    // normalize the normals and set vertices without normals to defined value
-    for(size_t i=0;i<point_normal.size();i++)
+
+    // when updating, only the vertices touched by the new faces and the
+    // new vertices need to be recalculated, using all of their faces
+    std::vector<size_t> touched;
+    for(size_t i=firstFace;i<faces.size();i++)
     {
-	if( point_normal[i].isApprox( Eigen::Vector3d::Zero(), 1e-5 ) )
-	{
-	    point_normal[i] = Eigen::Vector3d::Zero();
-	}
-	else 
-	{
-	    point_normal[i].normalize();
-	}
+	const int tri[3] = { faces[i].get<0>(), faces[i].get<1>(), faces[i].get<2>() };
+	for(int n=0;n<3;n++)
+	    if( static_cast<size_t>(tri[n]) < firstVertex )
+		touched.push_back( tri[n] );
     }
-}
 
+    std::sort( touched.begin(), touched.end() );
+    touched.erase( std::unique( touched.begin(), touched.end() ), touched.end() );
+    for(size_t i=firstVertex;i<vertices.size();i++)
+	touched.push_back( i );
+
+    point_normal.resize( vertices.size() );
+    normalAdjacency.compute( vertices, faces, touched, point_normal );
+}
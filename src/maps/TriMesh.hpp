@@ -4,6 +4,7 @@
 #include <envire/Core.hpp>
 #include <envire/maps/Pointcloud.hpp>
 #include <envire/core/Serialization.hpp>
+#include <envire/tools/MeshNormals.hpp>
 
 #include <boost/tuple/tuple.hpp>
 #include <Eigen/Core>
@@ -36,7 +37,31 @@ namespace envire {
 	void serialize(Serialization& so);
     void unserialize(Serialization& so);
 
-	void calcVertexNormals( void );
+	/** calculate the vertex normals from the faces.
+	 *
+	 * @param firstFace - only the faces starting from this index are
+	 *        used, and the normals of all the vertices not referenced by
+	 *        these faces are kept. This allows to update the normals after
+	 *        faces have been appended to the mesh.
+	 */
+	void calcVertexNormals( size_t firstFace = 0 );
+
+    private:
+	/** vertex to face adjacency of the last calcVertexNormals(). An
+	 * incremental call extends it by the new faces, instead of building
+	 * it for all the faces again. The adjacency is a cache, which is
+	 * not copied with the mesh. */
+	struct NormalAdjacency : public MeshNormals
+	{
+	    NormalAdjacency() {}
+	    NormalAdjacency( const NormalAdjacency& ) {}
+	    NormalAdjacency& operator=( const NormalAdjacency& ) 
+	    {
+		MeshNormals::operator=( MeshNormals() );
+		return *this;
+	    }
+	};
+	NormalAdjacency normalAdjacency;
     };
 }
 
@@ -1,4 +1,8 @@
 #include "CutPointcloud.hpp"
+#include <envire/tools/PointBVH.hpp>
+#include <envire/tools/PointTransform.hpp>
+
+#include <algorithm>
 
 namespace envire {
 
@@ -68,6 +72,281 @@ bool CutPointcloud::isIncluded(const Eigen::Vector3d &vector)
     return true;
 }
 
+namespace
+{
+    typedef Eigen::AlignedBox<double,3> Box;
+
+    /**
+     * Evaluates a set of exclusion boxes for many points. A point is
+     * included, if it is inside of all including boxes and outside of all
+     * excluding boxes. The including boxes are intersected into a single
+     * box, and the excluding boxes are stored in a bounding volume
+     * hierarchy, so that the test is not linear in the number of boxes.
+     *
+     * The filter is also a visitor for PointBVH::traverse(), which marks
+     * the included points. Nodes of the point hierarchy which are
+     * completely included or excluded are handled without testing their
+     * points.
+     */
+    class BoxFilter
+    {
+    public:
+	explicit BoxFilter( const std::list<ExclusionBox*>& boxes )
+	    : included( NULL ), hasInclude( false )
+	{
+	    for( std::list<ExclusionBox*>::const_iterator it = boxes.begin(); it != boxes.end(); it++ )
+	    {
+		if( (*it)->includes() )
+		{
+		    include = hasInclude ? include.intersection( (*it)->box ) : (*it)->box;
+		    hasInclude = true;
+		}
+		else if( !(*it)->box.isEmpty() )
+		    exclude.push_back( (*it)->box );
+	    }
+
+	    if( !exclude.empty() )
+	    {
+		nodes.resize( 1 );
+		build( 0, 0, exclude.size() );
+	    }
+	}
+
+	/** @return INSIDE if all points in bounds are included, OUTSIDE if
+	 * none is, and INTERSECTS otherwise */
+	PointBVH::Overlap visit( const Box& bounds ) const
+	{
+	    if( hasInclude )
+	    {
+		if( !overlaps( include, bounds ) )
+		    return PointBVH::OUTSIDE;
+		if( !include.contains( bounds ) )
+		    return PointBVH::INTERSECTS;
+	    }
+	    if( nodes.empty() )
+		return PointBVH::INSIDE;
+
+	    PointBVH::Overlap result = PointBVH::INSIDE;
+	    int stack[64];
+	    int top = 0;
+	    stack[top++] = 0;
+	    while( top )
+	    {
+		const Node& node( nodes[stack[--top]] );
+		if( !overlaps( node.bounds, bounds ) )
+		    continue;
+		if( node.left < 0 )
+		{
+		    for( size_t i=node.first; i<node.first+node.count; i++ )
+		    {
+			if( !overlaps( exclude[i], bounds ) )
+			    continue;
+			if( exclude[i].contains( bounds ) )
+			    return PointBVH::OUTSIDE;
+			result = PointBVH::INTERSECTS;
+		    }
+		}
+		else
+		{
+		    stack[top++] = node.left;
+		    stack[top++] = node.left + 1;
+		}
+	    }
+	    return result;
+	}
+
+	bool test( const Eigen::Vector3d& p ) const { return isIncluded( p ); }
+
+	void operator()( size_t index, const Eigen::Vector3d& p ) { included[index] = 1; }
+
+	/** flags of the included points, which are set by the traversal */
+	char* included;
+
+	bool isIncluded( const Eigen::Vector3d& p ) const
+	{
+	    if( hasInclude && !include.contains( p ) )
+		return false;
+	    if( nodes.empty() )
+		return true;
+
+	    int stack[64];
+	    int top = 0;
+	    stack[top++] = 0;
+	    while( top )
+	    {
+		const Node& node( nodes[stack[--top]] );
+		if( !node.bounds.contains( p ) )
+		    continue;
+		if( node.left < 0 )
+		{
+		    for( size_t i=node.first; i<node.first+node.count; i++ )
+			if( exclude[i].contains( p ) )
+			    return false;
+		}
+		else
+		{
+		    stack[top++] = node.left;
+		    stack[top++] = node.left + 1;
+		}
+	    }
+	    return true;
+	}
+
+    private:
+	/** true if the closed boxes have a common point */
+	static bool overlaps( const Box& a, const Box& b )
+	{
+	    return (a.min().array() <= b.max().array()).all() 
+		&& (b.min().array() <= a.max().array()).all();
+	}
+
+	struct Node
+	{
+	    Box bounds;
+	    /** index of the first child, the second child follows it. -1
+	     * for leaves. */
+	    int left;
+	    size_t first, count;
+	};
+
+	struct CenterLess
+	{
+	    int axis;
+	    bool operator()( const Box& a, const Box& b ) const
+	    {
+		return a.min()[axis] + a.max()[axis] < b.min()[axis] + b.max()[axis];
+	    }
+	};
+
+	/** fills the node idx with the boxes [first, last) and splits it
+	 * if there are too many boxes */
+	void build( int idx, size_t first, size_t last )
+	{
+	    Box bounds;
+	    for( size_t i=first; i<last; i++ )
+		bounds.extend( exclude[i] );
+	    nodes[idx].bounds = bounds;
+	    nodes[idx].first = first;
+	    nodes[idx].count = last - first;
+	    nodes[idx].left = -1;
+
+	    if( last - first <= 4 )
+		return;
+
+	    // split at the median of the box centers along the largest axis
+	    Eigen::Vector3d::Index axis;
+	    bounds.sizes().maxCoeff( &axis );
+	    CenterLess less;
+	    less.axis = axis;
+	    const size_t mid = (first + last) / 2;
+	    std::nth_element( exclude.begin() + first, exclude.begin() + mid, exclude.begin() + last, less );
+
+	    const int left = nodes.size();
+	    nodes.resize( left + 2 );
+	    nodes[idx].left = left;
+	    build( left, first, mid );
+	    build( left + 1, mid, last );
+	}
+
+	bool hasInclude;
+	Box include;
+	std::vector<Box> exclude;
+	std::vector<Node> nodes;
+    };
+
+    /** per vertex data which is copied along with the vertices */
+    template <class T>
+    struct Channel
+    {
+	Channel() : source( NULL ), target( NULL ), sourceSize( 0 ), targetSize( 0 ) {}
+	const T* source;
+	T* target;
+	size_t sourceSize, targetSize;
+    };
+
+    /**
+     * Processes a block of points of the source cloud. Without copy, the
+     * included points of the block are counted. With copy, the included
+     * points and their data are copied to the target, and transformed in
+     * place.
+     */
+    struct CutBlock
+    {
+	static const size_t blockSize = 16 * 1024;
+
+	const Eigen::Vector3d* vertices;
+	size_t size;
+	char* included;
+	size_t* offsets;
+
+	bool copy;
+	Eigen::Vector3d* target;
+	Channel<Eigen::Vector3d> normals, colors;
+	Channel<Pointcloud::attr_flag> attributes;
+	Channel<double> variances;
+	detail::TransformPoints transform, rotation;
+
+	CutBlock() : copy( false ) {}
+
+	/** sets up the channel and resizes the target data to the number of
+	 * included points which have data in the source */
+	template <class T>
+	void setChannel( Channel<T>& channel, std::vector<T>* source, std::vector<T>* target ) const
+	{
+	    if( !source )
+		return;
+
+	    channel.sourceSize = std::min( source->size(), size );
+	    const size_t b = channel.sourceSize / blockSize;
+	    channel.targetSize = offsets[b] + std::count( included + b * blockSize, included + channel.sourceSize, 1 );
+	    target->resize( channel.targetSize );
+	    if( channel.targetSize )
+	    {
+		channel.source = &(*source)[0];
+		channel.target = &(*target)[0];
+	    }
+	}
+
+	template <class T>
+	static void copyData( const Channel<T>& channel, size_t i, size_t j )
+	{
+	    if( i < channel.sourceSize )
+		channel.target[j] = channel.source[i];
+	}
+
+	void operator()( size_t begin, size_t end )
+	{
+	    for( size_t b=begin; b<end; b++ )
+	    {
+		const size_t first = b * blockSize;
+		const size_t last = std::min( first + blockSize, size );
+		if( !copy )
+		{
+		    // offsets are turned into a prefix sum later
+		    offsets[b + 1] = std::count( included + first, included + last, 1 );
+		    continue;
+		}
+
+		size_t j = offsets[b];
+		for( size_t i=first; i<last; i++ )
+		{
+		    if( !included[i] )
+			continue;
+		    target[j] = vertices[i];
+		    copyData( normals, i, j );
+		    copyData( colors, i, j );
+		    copyData( attributes, i, j );
+		    copyData( variances, i, j );
+		    j++;
+		}
+		transform( offsets[b], j );
+		if( normals.target )
+		    rotation( offsets[b], std::min( j, normals.targetSize ) );
+	    }
+	}
+    };
+}
+
 bool CutPointcloud::updateAll(){
     Pointcloud* targetcloud = dynamic_cast<envire::Pointcloud*>(env->getOutputs(this).front());
     assert( targetcloud );
@@ -106,29 +385,58 @@ bool CutPointcloud::updateAll(){
         source_vertex_variance_data = &sourcecloud->getVertexData<double>( Pointcloud::VERTEX_VARIANCE );
         target_vertex_variance_data = &targetcloud->getVertexData<double>( Pointcloud::VERTEX_VARIANCE );
     }
+    const unsigned long generation = targetcloud->getDataGeneration();
     
     // get transformation
     Transform trans = 
         env->relativeTransform( sourcecloud->getFrameNode(), targetcloud->getFrameNode() );
     Eigen::Quaterniond normal_rot(trans.linear());
 
-    for (unsigned i = 0; i < sourcecloud->vertices.size(); i++)
-    {
-        if(isIncluded(sourcecloud->vertices[i]))
-        {
-            targetcloud->vertices.push_back(trans * sourcecloud->vertices[i]);
-            
-            if(source_vertex_normal_data && source_vertex_normal_data->size() > i)
-                target_vertex_normal_data->push_back( normal_rot * source_vertex_normal_data->at(i) );
-            if(source_vertex_color_data && source_vertex_color_data->size() > i)
-                target_vertex_color_data->push_back( source_vertex_color_data->at(i) );
-            if(source_vertex_attributes_data && source_vertex_variance_data->size() > i)
-                target_vertex_attributes_data->push_back( source_vertex_attributes_data->at(i) );
-            if(source_vertex_variance_data && source_vertex_variance_data->size() > i)
-                target_vertex_variance_data->push_back( source_vertex_variance_data->at(i) );
-        }
-    }
+    // the included points are marked with the bounding volume hierarchy
+    // of the source, which is shared with the other users of the
+    // pointcloud, and only built for the first of them
+    const size_t size = sourcecloud->vertices.size();
+    std::vector<char> included( size );
+    BoxFilter filter( exclusion_boxes );
+    filter.included = size ? &included[0] : NULL;
+    sourcecloud->getBVH()->traverse( filter );
+
+    // the points are processed in blocks. The first pass counts the
+    // included points of each block, so that the output can be sized once
+    // and every block knows where to write its points.
+    std::vector<size_t> offsets( (size + CutBlock::blockSize - 1) / CutBlock::blockSize + 1 );
+
+    CutBlock cut;
+    cut.vertices = size ? &sourcecloud->vertices[0] : NULL;
+    cut.size = size;
+    cut.included = size ? &included[0] : NULL;
+    cut.offsets = &offsets[0];
+    parallelFor( 0, offsets.size() - 1, cut );
+
+    for( size_t i=1; i<offsets.size(); i++ )
+        offsets[i] += offsets[i-1];
+    const size_t count = offsets.back();
+
+    // per vertex data is only copied for the vertices which have it
+    targetcloud->vertices.resize( count );
+    cut.setChannel( cut.normals, source_vertex_normal_data, target_vertex_normal_data );
+    cut.setChannel( cut.colors, source_vertex_color_data, target_vertex_color_data );
+    cut.setChannel( cut.attributes, source_vertex_attributes_data, target_vertex_attributes_data );
+    cut.setChannel( cut.variances, source_vertex_variance_data, target_vertex_variance_data );
+
+    cut.copy = true;
+    cut.target = count ? &targetcloud->vertices[0] : NULL;
+    cut.transform.linear = trans.linear();
+    cut.transform.translation = trans.translation();
+    cut.transform.translate = true;
+    cut.transform.in = cut.transform.out = cut.target;
+    cut.rotation.linear = normal_rot.toRotationMatrix();
+    cut.rotation.translate = false;
+    cut.rotation.in = cut.rotation.out = cut.normals.target;
+    parallelFor( 0, offsets.size() - 1, cut );
 
+    // the data must not have been shared while it was written
+    assert( targetcloud->getDataGeneration() == generation );
     env->itemModified( targetcloud );
     return true;
 }
@@ -2,6 +2,7 @@
 
 #include <envire/maps/Grids.hpp>
 #include <envire/maps/Pointcloud.hpp>
+#include <envire/tools/GridKernel.hpp>
 
 #include <boost/math/special_functions/fpclassify.hpp>
 
@@ -9,6 +10,59 @@ using namespace envire;
 
 ENVIRONMENT_ITEM_DEF( DistanceGridToPointcloud )
 
+namespace
+{
+    /** reverses the projection of a single cell and appends the point to
+     * the pointcloud */
+    struct CellToPoint
+    {
+	const DistanceGrid* distanceGrid;
+	const DistanceGrid::ArrayType* distance;
+	const ImageRGB24::ArrayType *ir, *ig, *ib;
+	Pointcloud* pointcloud;
+	std::vector<double>* uncertainty;
+	std::vector<Eigen::Vector3d>* color;
+	const Transform* t;
+	bool needsTransform;
+	double maxDistance;
+	double uncertaintyFactor;
+
+	void operator()( size_t x, size_t y )
+	{
+	    // only process vector if distance value is not NaN or inf
+	    const float d = (*distance)[y][x];
+	    if( boost::math::isnormal( d ) && d < maxDistance ) 
+	    {
+		// construct (p_x,p_y,1.0) vector
+		Eigen::Vector3d r;
+		r << distanceGrid->fromGrid( DistanceGrid::Position( x, y ) ), 1.0;
+
+		// scale the vector
+		r *= d;
+
+		// only transform to target if needed
+		if( needsTransform )
+		    r = *t * r;
+
+		// add point to target pointcloud
+		pointcloud->vertices.push_back( r );
+
+		// add uncertainty
+		uncertainty->push_back( d * uncertaintyFactor );
+
+		// add texture color information if image is there
+		if( color )
+		{
+		    // get color value from image
+		    const double f = 1.0/255.0;
+		    Eigen::Vector3d c( (*ir)[y][x] * f, (*ig)[y][x] * f, (*ib)[y][x] * f );
+		    color->push_back( c );
+		}
+	    }
+	}
+    };
+}
+
 bool DistanceGridToPointcloud::updateAll()
 {
     //if( env->getInputs(this).size() != 1 || env->getOutputs(this).size() != 1 )
@@ -55,45 +109,27 @@ bool DistanceGridToPointcloud::updateAll()
 
     // clear target
     pointcloud.clear();
+    const unsigned long generation = pointcloud.getDataGeneration();
     
-    typedef DistanceGrid::Position Position;
-    for(size_t x=0; x<distanceGrid.getWidth(); x++)
-    {
-	for(size_t y=0; y<distanceGrid.getHeight(); y++)
-	{
-	    // only process vector if distance value is not NaN or inf
-	    const float d = distance[y][x];
-	    if( boost::math::isnormal( d ) && d < maxDistance ) 
-	    {
-		// construct (p_x,p_y,1.0) vector
-		Eigen::Vector3d r;
-		r << distanceGrid.fromGrid( Position( x, y ) ), 1.0;
-
-		// scale the vector
-		r *= d;
-
-		// only transform to target if needed
-		if( needsTransform )
-		    r = t * r;
-
-		// add point to target pointcloud
-		pointcloud.vertices.push_back( r );
-
-		// add uncertainty
-		uncertainty.push_back( d * uncertaintyFactor );
-
-		// add texture color information if image is there
-		if( image )
-		{
-		    // get color value from image
-		    const double f = 1.0/255.0;
-		    Eigen::Vector3d c( (*ir)[y][x] * f, (*ig)[y][x] * f, (*ib)[y][x] * f );
-		    color->push_back( c );
-		}
-	    }
-	}
-    }
-
+    // the points are appended in the order of the cells, so this runs on
+    // a single thread
+    CellToPoint cellToPoint;
+    cellToPoint.distanceGrid = &distanceGrid;
+    cellToPoint.distance = &distance;
+    cellToPoint.ir = ir;
+    cellToPoint.ig = ig;
+    cellToPoint.ib = ib;
+    cellToPoint.pointcloud = &pointcloud;
+    cellToPoint.uncertainty = &uncertainty;
+    cellToPoint.color = color;
+    cellToPoint.t = &t;
+    cellToPoint.needsTransform = needsTransform;
+    cellToPoint.maxDistance = maxDistance;
+    cellToPoint.uncertaintyFactor = uncertaintyFactor;
+    forEachCell( distance, cellToPoint );
+
+    // the data must not have been shared while it was written
+    assert( pointcloud.getDataGeneration() == generation );
     pointcloud.itemModified();
     return true;
 }
@@ -3,6 +3,7 @@
 
 #include "../core/Operator.hpp"
 #include "../maps/Grid.hpp"
+#include "../tools/GridFilter.hpp"
 
 namespace envire {
 
@@ -34,7 +35,7 @@ public:
                 size_t yr = ys + y;
                 
                 //no negative check needed, will overflow if negative
-                if(xr > maxX || yr > maxY)
+                if(xr >= maxX || yr >= maxY)
                     continue;
                 
                 cnt++;
@@ -68,13 +69,19 @@ public:
         maxX = inputGrid->getCellSizeX();
         maxY = inputGrid->getCellSizeY();
         
-        for(size_t y = 0;y < maxY; y++)
+        // same window as in fold(), but computed with running sums, so
+        // that the cost does not depend on the neighbourhood size
+        const int nHalf = ceil(neighbourhood / 2.0);
+        std::pair<T, bool> nodata = inputGrid->getNoData();
+        if (&inputData == &outputData)
         {
-            for(size_t x = 0;x < maxX; x++)
-            {
-                fold(inputData, outputData, x, y);
-            }
+            const typename envire::Grid<T>::ArrayType copy(inputData);
+            boxFilter(copy, outputData, nHalf, nHalf - 1, nodata.second ? &nodata.first : NULL);
         }
+        else
+            boxFilter(inputData, outputData, nHalf, nHalf - 1, nodata.second ? &nodata.first : NULL);
+        if (nodata.second)
+            outputGrid->setNoData(outputGrid->getBands().front(), nodata.first);
         
         return true;
     }
@@ -1,4 +1,5 @@
 #include <envire/operators/GridFloatToMLS.hpp>
+#include <envire/tools/Parallel.hpp>
 
 using namespace envire;
 
@@ -46,6 +47,70 @@ void GridFloatToMLS::setOutput( MLSGrid* mls )
     Operator::addOutput(mls);
 }
 
+namespace
+{
+    /** maps the cells of the mls to the cells of the source grid, and
+     * converts them in bands of rows */
+    template<typename T>
+    struct ConvertBands
+    {
+        const Grid<T>* grid;
+        const boost::multi_array<T, 2>* grid_data;
+        std::pair<T, bool> nodata;
+        MLSGrid* mls;
+        Transform mls2grid;
+        size_t bandRows;
+
+        /** number of patches in each band, and the extents of them */
+        std::vector<size_t>* counts;
+        std::vector<GridBase::CellExtents>* extents;
+        /** if set, the patches are written to the block, starting at the
+         * offset of the band */
+        const MLSGrid::PatchBlock* block;
+        const std::vector<size_t>* offsets;
+
+        bool getValue(size_t xi, size_t yi, T& value) const
+        {
+            double x = mls->getScaleX() * xi + mls->getOffsetX();
+            double y = mls->getScaleY() * yi + mls->getOffsetY();
+            Eigen::Vector3d src_p = mls2grid * Eigen::Vector3d(x, y, 0);
+            size_t src_xi, src_yi;
+            if (!grid->toGrid(src_p.x(), src_p.y(), src_xi, src_yi))
+                return false;
+
+            value = (*grid_data)[src_yi][src_xi];
+            return value == value && !(nodata.second && value == nodata.first);
+        }
+
+        void operator()(size_t begin, size_t end)
+        {
+            for (size_t band = begin; band < end; ++band)
+            {
+                const size_t y0 = band * bandRows;
+                const size_t y1 = std::min(y0 + bandRows, mls->getCellSizeY());
+                size_t count = 0;
+                for (size_t yi = y0; yi < y1; ++yi)
+                {
+                    for (size_t xi = 0; xi < mls->getCellSizeX(); ++xi)
+                    {
+                        T value;
+                        if (!getValue(xi, yi, value))
+                            continue;
+
+                        if (block)
+                            mls->setCellPatch(xi, yi, *block, (*offsets)[band] + count, MLSGrid::SurfacePatch(value, 0));
+                        else
+                            (*extents)[band].extend(Eigen::Vector2i(xi, yi));
+                        count++;
+                    }
+                }
+                if (!block)
+                    (*counts)[band] = count;
+            }
+        }
+    };
+}
+
 template<typename T>
 static void convert(Grid<T>* grid, std::string const& band_name, MLSGrid* mls)
 {
@@ -57,21 +122,54 @@ static void convert(Grid<T>* grid, std::string const& band_name, MLSGrid* mls)
     else
         grid_data = &grid->getGridData(band_name);
 
-    for (size_t yi = 0; yi < mls->getCellSizeY(); ++yi)
+    ConvertBands<T> kernel;
+    kernel.grid = grid;
+    kernel.grid_data = grid_data;
+    kernel.nodata = grid->getNoData(band_name.empty() ? grid->getBands().front() : band_name);
+    kernel.mls = mls;
+    kernel.mls2grid = mls2grid;
+    kernel.bandRows = 64;
+
+    if (!mls->empty())
     {
-        double y = mls->getScaleY() * yi + mls->getOffsetY();
-        for (size_t xi = 0; xi < mls->getCellSizeX(); ++xi)
+        // the cells need to be merged with the existing patches
+        for (size_t yi = 0; yi < mls->getCellSizeY(); ++yi)
         {
-            double x = mls->getScaleX() * xi + mls->getOffsetX();
-            Eigen::Vector3d src_p = mls2grid * Eigen::Vector3d(x, y, 0);
-            size_t src_xi, src_yi;
-            if (!grid->toGrid(src_p.x(), src_p.y(), src_xi, src_yi))
-                continue;
-
-            T value = (*grid_data)[src_yi][src_xi];
-            mls->updateCell(xi, yi, value, 0);
+            for (size_t xi = 0; xi < mls->getCellSizeX(); ++xi)
+            {
+                T value;
+                if (kernel.getValue(xi, yi, value))
+                    mls->updateCell(xi, yi, value, 0);
+            }
         }
+        return;
     }
+
+    // for an empty mls, each cell gets a single patch, so the patches can
+    // be allocated up front and written directly by multiple threads. The
+    // first pass counts the patches in each band of rows.
+    const size_t bands = (mls->getCellSizeY() + kernel.bandRows - 1) / kernel.bandRows;
+    std::vector<size_t> counts(bands);
+    std::vector<GridBase::CellExtents> extents(bands);
+    kernel.counts = &counts;
+    kernel.extents = &extents;
+    kernel.block = NULL;
+    parallelFor(0, bands, kernel);
+
+    std::vector<size_t> offsets(bands + 1, 0);
+    GridBase::CellExtents cellExtents;
+    for (size_t i = 0; i < bands; ++i)
+    {
+        offsets[i + 1] = offsets[i] + counts[i];
+        cellExtents.extend(extents[i]);
+    }
+
+    MLSGrid::PatchBlock block = mls->allocatePatches(offsets.back());
+    kernel.block = &block;
+    kernel.offsets = &offsets;
+    parallelFor(0, bands, kernel);
+
+    mls->addCells(offsets.back(), cellExtents);
 }
 
 bool GridFloatToMLS::updateAll()
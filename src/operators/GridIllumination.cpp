@@ -1,36 +1,31 @@
 #include "GridIllumination.hpp"
 #include <envire/maps/ElevationGrid.hpp>
+#include <envire/tools/GridKernel.hpp>
 
 using namespace envire;
 using namespace Eigen;
 
 ENVIRONMENT_ITEM_DEF( GridIllumination )
 
-GridIllumination::GridIllumination()
-    : lightSource( base::Vector3d::Zero() ), lightDiameter( 0.0 ), band( ElevationGrid::ILLUMINATION )
-{
-}
-
-bool GridIllumination::updateAll()
+namespace
 {
-    // get output grid
-    ElevationGrid* grid = getOutput<envire::ElevationGrid*>();
-
-    // and get the array
-    ElevationGrid::ArrayType &harray = grid->getGridData( ElevationGrid::ELEVATION_MAX );
-    ElevationGrid::ArrayType &iarray = grid->getGridData( band );
-
-    // get the position of the light source
-    ElevationGrid::Position lightPos;
-    bool lightInGrid = grid->toGrid( lightSource, lightPos.x, lightPos.y );
-
-    for( size_t x = 0; x < grid->getCellSizeX(); x++ )
+    /** computes the illumination of a single cell, by following the ray
+     * towards the light source */
+    struct IlluminateCell
     {
-	for( size_t y = 0; y < grid->getCellSizeY(); y++ )
+	const ElevationGrid* grid;
+	const ElevationGrid::ArrayType* harray;
+	ElevationGrid::ArrayType* iarray;
+	Vector3d lightSource;
+	double lightDiameter;
+	ElevationGrid::Position lightPos;
+	bool lightInGrid;
+
+	void operator()( size_t x, size_t y )
 	{
 	    Vector3d cell = grid->fromGrid( x, y );
 	    // get z-value from array
-	    cell.z() = harray[y][x];
+	    cell.z() = (*harray)[y][x];
 	    Vector3d dir3 = lightSource - cell;
 	    // the direction to the light source in 2d
 	    Vector2d dir = dir3.head<2>();
@@ -92,16 +87,46 @@ bool GridIllumination::updateAll()
 
 		// now get the elevationvalue from the grid relative to the
 		// current cell
-		double zDiff = harray[cy][cx] - cell.z();
+		double zDiff = (*harray)[cy][cx] - cell.z();
 		// z height normalized to dist and mapped to min/max light
 		double zRel = (zDiff / dist - lightMin ) / (lightMax - lightMin); 
 		maxLight = std::max( maxLight, zRel );
 	    }
 
 	    // set the light value in the illumination band
-	    iarray[y][x] = 1.0 - std::min( maxLight, 1.0 );
+	    (*iarray)[y][x] = 1.0 - std::min( maxLight, 1.0 );
 	}
-    }
+    };
+}
+
+GridIllumination::GridIllumination()
+    : lightSource( base::Vector3d::Zero() ), lightDiameter( 0.0 ), band( ElevationGrid::ILLUMINATION )
+{
+}
+
+bool GridIllumination::updateAll()
+{
+    // get output grid
+    ElevationGrid* grid = getOutput<envire::ElevationGrid*>();
+
+    // and get the array
+    ElevationGrid::ArrayType &harray = grid->getGridData( ElevationGrid::ELEVATION_MAX );
+    ElevationGrid::ArrayType &iarray = grid->getGridData( band );
+
+    // get the position of the light source
+    ElevationGrid::Position lightPos;
+    bool lightInGrid = grid->toGrid( lightSource, lightPos.x, lightPos.y );
+
+    // the cells only read the elevation band, so they are independent
+    IlluminateCell illuminate;
+    illuminate.grid = grid;
+    illuminate.harray = &harray;
+    illuminate.iarray = &iarray;
+    illuminate.lightSource = lightSource;
+    illuminate.lightDiameter = lightDiameter;
+    illuminate.lightPos = lightPos;
+    illuminate.lightInGrid = lightInGrid;
+    forEachCell( grid->getCellSizeX(), grid->getCellSizeY(), illuminate, 0 );
 
     return true;
 }
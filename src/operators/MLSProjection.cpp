@@ -2,7 +2,10 @@
 #include <set>
 #include <Eigen/LU>
 
-#include <envire/tools/BresenhamLine.hpp>
+#include <envire/tools/MLSFreeSpace.hpp>
+#include <envire/core/Instrumentation.hpp>
+
+#include <boost/scoped_ptr.hpp>
 
 using namespace envire;
 
@@ -70,6 +73,8 @@ void MLSProjection::projectPointcloudWithUncertainty( envire::MultiLevelSurfaceG
     projectPointcloud( t_grid.get(), pc );
 
     Eigen::Affine3d C_g2m( C_m2g.getTransform().inverse( Eigen::Isometry ) );
+    // the same transform is used for all the cells
+    const PointUncertaintyPropagator C_m2g_points( C_m2g );
 
     // get the origin of the poincloud as a map cell
     Eigen::Vector3d origin_m = C_m2g.getTransform() * pc->getSensorOrigin().translation();
@@ -78,6 +83,12 @@ void MLSProjection::projectPointcloudWithUncertainty( envire::MultiLevelSurfaceG
 	if( m_negativeInformation )
 	    throw std::runtime_error( "origin of pointcloud needs to be within grid." );
 
+    // the negative information is collected for all cells and inserted
+    // into the grid at the end
+    boost::scoped_ptr<MLSFreeSpace> freeSpace;
+    if( m_negativeInformation )
+	freeSpace.reset( new MLSFreeSpace( *grid, origin, origin_m.z() ) );
+
     // go through all the cells that have been touched
     typedef MultiLevelSurfaceGrid::Position position;
     const std::set<position> &cells = t_grid->getIndex()->cells;
@@ -105,7 +116,7 @@ void MLSProjection::projectPointcloudWithUncertainty( envire::MultiLevelSurfaceG
 
 		// use the cells stdev for the point, this is not quite exact, but should do 
 		const double p_var = cit->stdev * cit->stdev;
-		PointWithUncertainty p = C_m2g * PointWithUncertainty( cellcenter, Eigen::Matrix3d::Zero() );
+		PointWithUncertainty p = C_m2g_points * PointWithUncertainty( cellcenter, Eigen::Matrix3d::Zero() );
 
 		// write the transformed uncertainty back
 		cit->stdev = sqrt(p_var + p.getCovariance()(2,2));
@@ -117,89 +128,47 @@ void MLSProjection::projectPointcloudWithUncertainty( envire::MultiLevelSurfaceG
 	    // variance we might have some patches that actually belong together.
 	    if( t_grid != grid )
 		grid->updateCell( xi, yi, *cit );
-
-	    if( m_negativeInformation )
-	    {
-		// in order to handle negative information (e.g. knowledge that
-		// a cell is free), we use bresenhams line algorithm to find the cells
-		// from each known cells to the origin. For each of these cells, 
-		// we add absence information
-		
-		// this is the distance on the x/y plane from origin to 
-		// the current cell
-		const double plane_dist = (grid->fromGrid( origin ) - grid->fromGrid( *it )).norm();
-
-		// this is the height difference between the origin and the cell
-		const double plane_z = origin_m.z() - cit->mean;
-
-		// this is the maximum height of the negative cell,
-		// which joins the height of the cell, and how high it
-		// is perceived from the origin point of view
-		double height = 0; //cit->height;
-		if( plane_dist * plane_z != 0 )
-		    height += grid->getScaleX() / plane_dist * plane_z;
-
-		std::vector<GridBase::Position> line_cells;
-		lineBresenham( *it, origin, line_cells );
-
-		int xdiff = it->x - origin.x;
-		int ydiff = it->y - origin.y;
-		bool xdir = abs( xdiff ) >= abs( ydiff );
-
-		for( size_t li = 0; li < line_cells.size(); li++ )
-		{
-		    double factor = 1.0;
-		    if( xdir && xdiff )
-			factor = (int)(line_cells[li].x - origin.x) / (double)xdiff;
-		    else if( ydiff )
-			factor = (int)(line_cells[li].y - origin.y) / (double)ydiff;
-
-		    const double p_height = fabs((cit->height + height) * factor);
-		    const double z_mean = cit->mean + height * factor + plane_z * (1.0 - factor);
-		    const double z_stdev = cit->stdev * factor; 
-
-		    MLSGrid::SurfacePatch np( z_mean, z_stdev, p_height, MLSGrid::SurfacePatch::NEGATIVE );
-
-		    // for now don't put anything into the cell with the
-		    // positive information. This could be changed later
-		    // for partial information
-		    if( factor < 1.0 )
-			grid->updateCell( line_cells[li], np );
-		}
-	    }
 	}
+
+	// in order to handle negative information (e.g. knowledge that a
+	// cell is free), we follow the line from each known cell to the
+	// origin. For each of these cells, we add absence information
+	if( m_negativeInformation )
+	    freeSpace->addCell( *t_grid, *it );
     }
+
+    if( m_negativeInformation )
+	freeSpace->apply();
 }
 
 void MLSProjection::projectPointcloud( envire::MultiLevelSurfaceGrid* grid, envire::Pointcloud* pc )
+{
+    projectView( grid, pc->getView(), C_m2g.getTransform() );
+}
+
+template <class Scalar>
+void MLSProjection::projectView( envire::MultiLevelSurfaceGrid* grid, const PointcloudViewT<Scalar>& view, const Eigen::Affine3d& transform )
 {
     // note: the grid might actually be a local copy and not attached to an
     // environment
-    std::vector<Eigen::Vector3d>& points(pc->vertices);
-    std::vector<double>& uncertainty(pc->getVertexData<double>(Pointcloud::VERTEX_VARIANCE));
-    std::vector<Eigen::Vector3d> *color = NULL;
-    if( pc->hasData( Pointcloud::VERTEX_COLOR ) )
-    {
-	color = &pc->getVertexData<Eigen::Vector3d>(Pointcloud::VERTEX_COLOR);
-	assert( color->size() == points.size() );
+    if( view.hasColors() )
 	grid->setHasCellColor( true );
-    }
-    bool hasUncertainty = points.size() == uncertainty.size();
 
-    for(size_t i=0;i<points.size();i++)
-    {
-	const double p_var = hasUncertainty? uncertainty[i] : defaultUncertainty;
-	Point p = C_m2g.getTransform() * points[i];
+    ENVIRE_SCOPED_TIMER( "MLSProjection::projectView" );
+    ENVIRE_COUNT( POINTS_PROJECTED, view.size() );
 
-	const Eigen::Vector3d &mean( p );
+    for(size_t i=0;i<view.size();i++)
+    {
+	const double p_var = view.hasVariances() ? view.variance( i ) : defaultUncertainty;
+	const Eigen::Vector3d mean = transform * view.point( i ).template cast<double>();
 
         if(use_boundary_box && !boundary_box.contains(mean))
             continue;
 
         // create patch to update
         MLSGrid::SurfacePatch patch( mean.z(), sqrt(p_var) );
-        if( color )
-            patch.setColor( (*color)[i] );
+        if( view.hasColors() )
+            patch.setColor( view.color( i ).template cast<double>() );
 
         // and use the update method of the mls to determine
         // which cell and update model to use
@@ -207,6 +176,9 @@ void MLSProjection::projectPointcloud( envire::MultiLevelSurfaceGrid* grid, envi
     }
 }
 
+template void MLSProjection::projectView<double>( envire::MultiLevelSurfaceGrid*, const PointcloudView&, const Eigen::Affine3d& );
+template void MLSProjection::projectView<float>( envire::MultiLevelSurfaceGrid*, const PointcloudViewf&, const Eigen::Affine3d& );
+
 bool MLSProjection::updateAll() 
 {
     std::list<Layer*> outputs = env->getOutputs(this);
@@ -4,6 +4,7 @@
 #include <envire/Core.hpp>
 #include <envire/maps/TriMesh.hpp>
 #include <envire/maps/MLSGrid.hpp>
+#include <envire/maps/PointcloudView.hpp>
 
 #include <Eigen/Core>
 #include <envire/core/Operator.hpp>
@@ -36,6 +37,19 @@ namespace envire {
         void setAreaOfInterest(double min_x, double max_x, double min_y, double max_y, double min_z, double max_z);
         void unsetAreaOfInterest();
 
+	/**
+	 * Projects the points of the view into the grid, without taking the
+	 * uncertainty of the transform into account. This can be used to
+	 * directly project point data which is not stored in a Pointcloud,
+	 * e.g. float data from a sensor.
+	 *
+	 * Instantiated for PointcloudView and PointcloudViewf.
+	 *
+	 * @param transform - transformation from the points to the grid frame
+	 */
+	template <class Scalar>
+	void projectView( envire::MultiLevelSurfaceGrid* grid, const PointcloudViewT<Scalar>& view, const Eigen::Affine3d& transform );
+
     protected:
 	void projectPointcloudWithUncertainty( envire::MultiLevelSurfaceGrid* grid, envire::Pointcloud* pc );
 	void projectPointcloud( envire::MultiLevelSurfaceGrid* grid, envire::Pointcloud* pc );
@@ -3,6 +3,7 @@
 #include <envire/maps/Grids.hpp>
 #include <boost/multi_array.hpp>
 #include <numeric/PlaneFitting.hpp>
+#include <envire/tools/GridKernel.hpp>
 
 using namespace envire;
 using namespace Eigen;
@@ -63,6 +64,44 @@ static void updateGradient(MLSGrid const& mls,
     }
 }
 
+/** computes the maximum steps of a cell from the differences to its
+ * neighbours */
+struct MaxStepKernel
+{
+    const boost::multi_array<float,3>* diffs;
+    const boost::multi_array<int,2>* counts;
+    boost::multi_array<float,2>* max_steps;
+    boost::multi_array<float,2>* corrected_max_steps;
+    double corrected_step_threshold;
+
+    void operator()(size_t x, size_t y)
+    {
+        int count = (*counts)[y][x];
+        if (count < 5)
+        {
+            (*max_steps)[y][x] = UNKNOWN;
+            (*corrected_max_steps)[y][x] = UNKNOWN;
+            return;
+        }
+
+        double max_step = UNKNOWN;
+        double corrected_max_step = UNKNOWN;
+        for (int i = 0; i < 8; i += 2)
+        {
+            double step0 = (*diffs)[y][x][i];
+            double step1 = (*diffs)[y][x][i + 1];
+            max_step = std::max(max_step, step0);
+            max_step = std::max(max_step, step1);
+            corrected_max_step = std::max(corrected_max_step, step0 - (step0 + step1) / 4);
+            corrected_max_step = std::max(corrected_max_step, step0 - (step0 + step1) * 3 / 4);
+        }
+        (*max_steps)[y][x] = max_step;
+        if (max_step < corrected_step_threshold)
+            (*corrected_max_steps)[y][x] = corrected_max_step;
+        else
+            (*corrected_max_steps)[y][x] = max_step;
+    }
+};
 
 bool MLSSlope::updateAll() 
 {
@@ -127,9 +166,12 @@ bool MLSSlope::updateAll()
         BOTTOM_RIGHT = 6,
         TOP_LEFT = 7;
 
-    for(size_t x=1;x<width;x++)
+    // the cells update the differences of their neighbours as well, so
+    // this pass runs on a single thread. The result doesn't depend on the
+    // order of the cells.
+    for(size_t y=1;y<height-1;y++)
     {
-        for(size_t y=1;y<height-1;y++)
+        for(size_t x=1;x<width;x++)
         {
             MLSGrid::const_iterator this_cell = 
                 std::max_element( mls.beginCell(x,y), mls.endCell() );
@@ -206,37 +248,14 @@ bool MLSSlope::updateAll()
     }
 
     // Right now, the angles grid contains gradients. Convert to angles
-    for(size_t x=1;x<(width - 1);x++)
-    {
-        for(size_t y=1;y<(height - 1);y++)
-        {
-            int count = counts[y][x];
-            if (count < 5)
-            {
-                max_steps[y][x] = UNKNOWN;
-                corrected_max_steps[y][x] = UNKNOWN;
-                continue;
-            }
-
+    MaxStepKernel maxStep;
+    maxStep.diffs = &diffs;
+    maxStep.counts = &counts;
+    maxStep.max_steps = &max_steps;
+    maxStep.corrected_max_steps = &corrected_max_steps;
+    maxStep.corrected_step_threshold = corrected_step_threshold;
+    forEachCell(1, 1, width - 1, height - 1, maxStep, 0);
 
-            double max_step = UNKNOWN;
-            double corrected_max_step = UNKNOWN;
-            for (int i = 0; i < 8; i += 2)
-            {
-                double step0 = diffs[y][x][i];
-                double step1 = diffs[y][x][i + 1];
-                max_step = std::max(max_step, step0);
-                max_step = std::max(max_step, step1);
-                corrected_max_step = std::max(corrected_max_step, step0 - (step0 + step1) / 4);
-                corrected_max_step = std::max(corrected_max_step, step0 - (step0 + step1) * 3 / 4);
-            }
-            max_steps[y][x] = max_step;
-            if (max_step < corrected_step_threshold)
-                corrected_max_steps[y][x] = corrected_max_step;
-            else
-                corrected_max_steps[y][x] = max_step;
-        }
-    }
     // ... and mark the remaining of the border as UNKNOWN
     for(size_t x=0; x < width; ++x)
     {
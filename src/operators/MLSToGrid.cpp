@@ -9,7 +9,9 @@ ENVIRONMENT_ITEM_DEF( MLSToGrid )
 
 MLSToGrid::MLSToGrid()
     : Operator(1, 1)
-    , mOutLayerName(ElevationGrid::ELEVATION) {}
+    , mOutLayerName(ElevationGrid::ELEVATION)
+    , mSelection(MLSExtraction::TOP_PATCH)
+    , mMinUpdateIdx(0) {}
 
 MLSToGrid::~MLSToGrid() {}
 
@@ -17,12 +19,18 @@ void MLSToGrid::serialize( Serialization &so )
 {
     Operator::serialize(so);
     so.write("out_layer_name", mOutLayerName);
+    so.write("patch_selection", (int)mSelection);
+    so.write<size_t>("min_update_idx", mMinUpdateIdx);
 }
 
 void MLSToGrid::unserialize( Serialization &so )
 {
     Operator::unserialize(so);
     so.read("out_layer_name", mOutLayerName);
+    if( so.hasKey("patch_selection") )
+        mSelection = (MLSExtraction::PatchSelection)so.read<int>("patch_selection");
+    if( so.hasKey("min_update_idx") )
+        so.read<size_t>("min_update_idx", mMinUpdateIdx);
 }
 
 void MLSToGrid::setOutput(Grid<double>* map, std::string const& layer_name)
@@ -41,24 +49,13 @@ bool MLSToGrid::updateAll()
     if( mls.getScaleX() != travGrid.getScaleX() && mls.getScaleY() != travGrid.getScaleY() )
         throw std::runtime_error("mismatching cell scale between MLSGradient input and output");
 
-    // init traversibility grid
-    size_t width = mls.getWidth(); 
-    size_t height = mls.getHeight(); 
-
     boost::multi_array<double, 2>& out_data = travGrid.getGridData(mOutLayerName);
 
-    for(size_t x=0;x<width;x++)
-    {
-        for(size_t y=0;y<height;y++)
-        {
-            MLSGrid::const_iterator this_cell = 
-                std::max_element( mls.beginCell(x,y), mls.endCell() );
-            if (this_cell == mls.endCell())
-                continue;
-
-            out_data[y][x] = this_cell->mean;
-        }
-    }
+    // the tiles are independent, so they are processed in parallel
+    MLSExtraction extraction(mls);
+    extraction.setPatchSelection(mSelection);
+    extraction.setMinUpdateIndex(mMinUpdateIdx);
+    extraction.extractElevation(out_data);
 
     return true;
 }
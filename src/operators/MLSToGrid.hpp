@@ -3,6 +3,7 @@
 
 #include <envire/Core.hpp>
 #include <envire/maps/Grid.hpp>
+#include <envire/tools/MLSExtraction.hpp>
 
 namespace envire
 {
@@ -16,6 +17,8 @@ namespace envire
 	ENVIRONMENT_ITEM( MLSToGrid )
 
         std::string mOutLayerName;
+        MLSExtraction::PatchSelection mSelection;
+        size_t mMinUpdateIdx;
 
     public:
         MLSToGrid();
@@ -25,6 +28,15 @@ namespace envire
 	void unserialize( Serialization &so );
 
         void setOutput(Grid<double>* grid, std::string const& name);
+
+        /** with HORIZONTAL_PATCHES the highest horizontal patch is used
+         * instead of the highest patch */
+        void setPatchSelection(MLSExtraction::PatchSelection selection) { mSelection = selection; }
+
+        /** if not 0, only the tiles which contain patches with an
+         * update_idx of at least idx are updated */
+        void setMinUpdateIndex(size_t idx) { mMinUpdateIdx = idx; }
+
 	bool updateAll();
     };
 }
@@ -5,7 +5,7 @@ using namespace envire;
 
 ENVIRONMENT_ITEM_DEF( MLSToPointCloud )
 
-MLSToPointCloud::MLSToPointCloud(): Operator(1, 1)
+MLSToPointCloud::MLSToPointCloud(): Operator(1, 1), selection(MLSExtraction::ALL_PATCHES), minUpdateIdx(0), lastGrid(NULL)
 {
 
 }
@@ -26,48 +26,47 @@ void MLSToPointCloud::setOutput(Pointcloud* pointcloud)
 }
 
 
+void MLSToPointCloud::setPatchSelection(MLSExtraction::PatchSelection selection)
+{
+    this->selection = selection;
+    tileOffsets.clear();
+}
+
+void MLSToPointCloud::setMinUpdateIndex(size_t idx)
+{
+    minUpdateIdx = idx;
+}
+
 bool MLSToPointCloud::updateAll()
 {
     
     Pointcloud* pointcloud = dynamic_cast<Pointcloud*>(env->getOutput<Pointcloud*>(this));    
     MLSGrid* mls_grid = dynamic_cast<MLSGrid*>(env->getInput<MLSGrid*>(this));
     
+    // keep the old points, so that clean tiles don't need to be converted
+    std::vector<Eigen::Vector3d> points;
+    points.swap(pointcloud->vertices);
     pointcloud->clear();
 
     float vertical_distance = (mls_grid->getScaleX() + mls_grid->getScaleY()) * 0.5;
     if(vertical_distance <= 0.0)
 	vertical_distance = 0.1;
     
+    // the points of the clean tiles are in the root frame, so they can
+    // only be reused for the same grid in the same pose
+    const Transform gridToRoot = env->relativeTransform(mls_grid->getFrameNode(), env->getRootNode());
+    if(mls_grid != lastGrid || gridToRoot.matrix() != lastTransform.matrix())
+	tileOffsets.clear();
+    lastGrid = mls_grid;
+    lastTransform = gridToRoot;
+
     // create pointcloud from mls
-    for(size_t x=0;x<mls_grid->getCellSizeX();x++)
-    {
-	for(size_t y=0;y<mls_grid->getCellSizeY();y++)
-	{
-	    for( MLSGrid::iterator cit = mls_grid->beginCell(x,y); cit != mls_grid->endCell(); cit++ )
-	    {
-		MLSGrid::SurfacePatch p( *cit );
-		Eigen::Vector3d cellPosWorld = mls_grid->fromGrid(x, y, mls_grid->getEnvironment()->getRootNode());
-		Eigen::Vector3d point(cellPosWorld);
-		
-		if(p.isHorizontal())
-		{
-		    point[2] = cellPosWorld.z() + p.mean;
-		    pointcloud->vertices.push_back(point);
-		    
-		}
-		else if(p.isVertical())
-		{
-		    float min_z = (float)p.getMinZ(0);
-		    float max_z = (float)p.getMaxZ(0);
-		    for(float z = min_z; z <= max_z; z += vertical_distance)
-		    {
-			point[2] = cellPosWorld.z() + z;
-			pointcloud->vertices.push_back(point);
-		    }
-		}
-	    }
-	}
-    }
+    MLSExtraction extraction(*mls_grid);
+    extraction.setPatchSelection(selection);
+    extraction.setVerticalDistance(vertical_distance);
+    extraction.setMinUpdateIndex(minUpdateIdx);
+    extraction.extractPoints(gridToRoot, points, tileOffsets);
+    pointcloud->vertices.swap(points);
     
     pointcloud->itemModified();
     return true;
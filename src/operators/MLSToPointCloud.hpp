@@ -4,6 +4,7 @@
 #include <envire/Core.hpp>
 #include <envire/maps/MLSGrid.hpp>
 #include <envire/maps/Pointcloud.hpp>
+#include <envire/tools/MLSExtraction.hpp>
 
 
 namespace envire 
@@ -12,6 +13,9 @@ namespace envire
 	 * This operator generates a Pointcloud from a MLSGrid
 	 * 
 	 * It can only have one input and one output
+	 *
+	 * The grid is processed in tiles on multiple threads, see
+	 * MLSExtraction.
 	 */
 	
     class MLSToPointCloud : public Operator
@@ -22,13 +26,36 @@ namespace envire
 		using Operator::addInput;
 		using Operator::addOutput;
 		
+		MLSExtraction::PatchSelection selection;
+		size_t minUpdateIdx;
+		/** start of the points of each tile in the output of the last
+		 * update */
+		std::vector<size_t> tileOffsets;
+		/** the grid and the transformation of the grid into the root
+		 * frame which have been used for the points of the last
+		 * update. The points of clean tiles are only reused if
+		 * neither has changed. */
+		const MLSGrid* lastGrid;
+		Transform lastTransform;
+		
 	public:
+		EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
 		MLSToPointCloud();
 		virtual ~MLSToPointCloud();
 		
 		void setInput(MLSGrid* mls_grid);
 		void setOutput(Pointcloud* pointcloud);
 		
+		/** selects the patches which are converted, ALL_PATCHES by
+		 * default */
+		void setPatchSelection(MLSExtraction::PatchSelection selection);
+		
+		/** if not 0, only tiles which contain patches with an
+		 * update_idx of at least idx are converted again, and the
+		 * points of the other tiles are kept from the last update. */
+		void setMinUpdateIndex(size_t idx);
+		
 		bool updateAll();
     };
 }
@@ -6,6 +6,7 @@
  */
 
 #include "MergePointcloud.hpp"
+#include <envire/tools/PointTransform.hpp>
 #include <Eigen/LU>
 #include <iostream>
 
@@ -48,6 +49,48 @@ void MergePointcloud::setClearOutput( bool clear )
     m_clearOutput = clear;
 }
 
+namespace
+{
+    /** copies the vertices and per vertex data of a block of points from
+     * one cloud to the target. All channels of a point are processed in
+     * the same pass. */
+    struct MergeBlock
+    {
+	detail::TransformPoints vertices;
+	detail::TransformPoints normals;
+	bool hasNormal;
+	const Eigen::Vector3d *sourceColors;
+	Eigen::Vector3d *targetColors;
+	const double *sourceVariances;
+	double *targetVariances;
+	const Pointcloud::vertex_attr *sourceAttributes;
+	Pointcloud::vertex_attr *targetAttributes;
+
+	void operator()( size_t begin, size_t end )
+	{
+	    for( size_t i=begin; i<end; i+=detail::pointTransformBlockSize )
+	    {
+		const size_t blockEnd = std::min( i + detail::pointTransformBlockSize, end );
+		vertices( i, blockEnd );
+		if( hasNormal )
+		    normals( i, blockEnd );
+		if( sourceColors )
+		    std::copy( sourceColors + i, sourceColors + blockEnd, targetColors + i );
+		if( sourceVariances )
+		    std::copy( sourceVariances + i, sourceVariances + blockEnd, targetVariances + i );
+		if( sourceAttributes )
+		    std::copy( sourceAttributes + i, sourceAttributes + blockEnd, targetAttributes + i );
+	    }
+	}
+    };
+
+    void checkVertexData( Pointcloud* cloud, const std::string& key, size_t size )
+    {
+	if( size != cloud->vertices.size() )
+	    throw std::runtime_error("merge needs to have " + key + " data for every vertex");
+    }
+}
+
 bool MergePointcloud::updateAll(){
     Pointcloud* targetcloud = dynamic_cast<envire::Pointcloud*>(*env->getOutputs(this).begin());
     assert( targetcloud );
@@ -56,63 +99,129 @@ bool MergePointcloud::updateAll(){
 
     std::list<Layer*> inputs = env->getInputs(this);
 
-    // check for additional data 
+    // check for additional data. Normals and colors need to be on all inputs
+    // if they are on one of them, variances and attributes are only merged
+    // if all inputs have them.
     bool hasNormal = false, hasColor = false;
+    bool hasVariance = !inputs.empty(), hasAttributes = !inputs.empty();
+    size_t count = 0;
 
     for( std::list<Layer*>::iterator it = inputs.begin(); it != inputs.end(); it++ ){
 	Pointcloud* cloud = dynamic_cast<envire::Pointcloud*>(*it);
 	hasNormal = hasNormal || cloud->hasData( Pointcloud::VERTEX_NORMAL );
 	hasColor = hasColor || cloud->hasData( Pointcloud::VERTEX_COLOR );
+	hasVariance = hasVariance && cloud->hasData( Pointcloud::VERTEX_VARIANCE );
+	hasAttributes = hasAttributes && cloud->hasData( Pointcloud::VERTEX_ATTRIBUTES );
+	count += cloud->vertices.size();
 
 	assert( cloud != targetcloud );
     }
 
+    // check the data before the target is changed
+    for( std::list<Layer*>::iterator it = inputs.begin(); it != inputs.end(); it++ ){
+	Pointcloud* cloud = dynamic_cast<envire::Pointcloud*>(*it);
+	if( (hasNormal && !cloud->hasData( Pointcloud::VERTEX_NORMAL )) ||
+		(hasColor && !cloud->hasData( Pointcloud::VERTEX_COLOR )) )
+	    throw std::runtime_error("merge currently needs to have the same metadata on all inputs");
+
+	if( hasNormal )
+	    checkVertexData( cloud, Pointcloud::VERTEX_NORMAL, cloud->getVertexNormals().size() );
+	if( hasColor )
+	    checkVertexData( cloud, Pointcloud::VERTEX_COLOR, cloud->getVertexColors().size() );
+	if( hasVariance )
+	    checkVertexData( cloud, Pointcloud::VERTEX_VARIANCE, cloud->getVertexVariances().size() );
+	if( hasAttributes )
+	    checkVertexData( cloud, Pointcloud::VERTEX_ATTRIBUTES, cloud->getVertexAttributes().size() );
+    }
+
+    // resize the target once, the data of the inputs is written to
+    // consecutive ranges
+    size_t offset = targetcloud->vertices.size();
+    targetcloud->vertices.resize( offset + count );
+    std::vector<Eigen::Vector3d> *targetNormals = NULL, *targetColors = NULL;
+    std::vector<double> *targetVariances = NULL;
+    std::vector<Pointcloud::vertex_attr> *targetAttributes = NULL;
+    if( hasNormal )
+    {
+	targetNormals = &targetcloud->getVertexNormals();
+	targetNormals->resize( offset + count );
+    }
+    if( hasColor )
+    {
+	targetColors = &targetcloud->getVertexColors();
+	targetColors->resize( offset + count );
+    }
+    if( hasVariance )
+    {
+	targetVariances = &targetcloud->getVertexVariances();
+	targetVariances->resize( offset + count );
+    }
+    if( hasAttributes )
+    {
+	targetAttributes = &targetcloud->getVertexAttributes();
+	targetAttributes->resize( offset + count );
+    }
+    const unsigned long generation = targetcloud->getDataGeneration();
+
     //for every cloud
     for( std::list<Layer*>::iterator it = inputs.begin(); it != inputs.end(); it++ ){
 	Pointcloud* cloud = dynamic_cast<envire::Pointcloud*>(*it);
 	assert(cloud);
 
+	const size_t size = cloud->vertices.size();
+	if( size == 0 )
+	    continue;
+
 	Transform trans = 
 	    env->relativeTransform( cloud->getFrameNode(), targetcloud->getFrameNode() );
 
-
-	for (std::vector<Eigen::Vector3d>::iterator p = cloud->vertices.begin();p<cloud->vertices.end();p++)
-	{
-	    targetcloud->vertices.push_back(trans * *p);
-	}
+	MergeBlock merge;
+	merge.vertices.linear = trans.linear();
+	merge.vertices.translation = trans.translation();
+	merge.vertices.translate = true;
+	merge.vertices.in = &cloud->vertices[0];
+	merge.vertices.out = &targetcloud->vertices[offset];
+	merge.hasNormal = hasNormal;
+	merge.sourceColors = NULL;
+	merge.sourceVariances = NULL;
+	merge.sourceAttributes = NULL;
 
 	if( hasNormal )
 	{
-	    if( !cloud->hasData( Pointcloud::VERTEX_NORMAL ) )
-		throw std::runtime_error("merge currently needs to have the same metadata on all inputs");
-
-	    Eigen::Quaterniond rot(trans.linear());
-
-	    std::vector<Eigen::Vector3d> &source_data( cloud->getVertexData<Eigen::Vector3d>( Pointcloud::VERTEX_NORMAL ) );
-	    std::vector<Eigen::Vector3d> &target_data( targetcloud->getVertexData<Eigen::Vector3d>( Pointcloud::VERTEX_NORMAL ) );
-
-	    //std::cout << source_data.size() << std::endl;
-	    for (std::vector<Eigen::Vector3d>::iterator p = source_data.begin();p!=source_data.end();p++)
-	    {
-		target_data.push_back( rot * *p );
-	    }
+	    std::vector<Eigen::Vector3d> &source_data( cloud->getVertexNormals() );
+	    merge.normals.linear = Eigen::Quaterniond(trans.linear()).toRotationMatrix();
+	    merge.normals.translate = false;
+	    merge.normals.in = &source_data[0];
+	    merge.normals.out = &(*targetNormals)[offset];
 	}
 
 	if( hasColor )
 	{
-	    if( !cloud->hasData( Pointcloud::VERTEX_COLOR ) )
-		throw std::runtime_error("merge currently needs to have the same metadata on all inputs");
+	    std::vector<Eigen::Vector3d> &source_data( cloud->getVertexColors() );
+	    merge.sourceColors = &source_data[0];
+	    merge.targetColors = &(*targetColors)[offset];
+	}
 
-	    std::vector<Eigen::Vector3d> &source_data( cloud->getVertexData<Eigen::Vector3d>( Pointcloud::VERTEX_COLOR ) );
-	    std::vector<Eigen::Vector3d> &target_data( targetcloud->getVertexData<Eigen::Vector3d>( Pointcloud::VERTEX_COLOR ) );
+	if( hasVariance )
+	{
+	    std::vector<double> &source_data( cloud->getVertexVariances() );
+	    merge.sourceVariances = &source_data[0];
+	    merge.targetVariances = &(*targetVariances)[offset];
+	}
 
-	    for (std::vector<Eigen::Vector3d>::iterator p = source_data.begin();p!=source_data.end();p++)
-	    {
-		target_data.push_back( *p );
-	    }
+	if( hasAttributes )
+	{
+	    std::vector<Pointcloud::vertex_attr> &source_data( cloud->getVertexAttributes() );
+	    merge.sourceAttributes = &source_data[0];
+	    merge.targetAttributes = &(*targetAttributes)[offset];
 	}
+
+	parallelFor( 0, size, merge, 64 * 1024 );
+	offset += size;
     }
 
+    // the data must not have been shared while it was written
+    assert( targetcloud->getDataGeneration() == generation );
     env->itemModified( targetcloud );
     return true;
 }
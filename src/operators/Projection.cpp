@@ -2,6 +2,8 @@
 #include <stdexcept>
 #include <stdint.h>
 #include <limits>
+#include <algorithm>
+#include <vector>
 #include "boost/multi_array.hpp"
 
 #include <CGAL/Exact_predicates_inexact_constructions_kernel.h>
@@ -9,6 +11,7 @@
 #include <CGAL/Delaunay_triangulation_2.h>
 
 #include <Eigen/LU>
+#include <envire/tools/Parallel.hpp>
 
 using namespace envire;
 using namespace std;
@@ -88,7 +91,92 @@ bool Projection::updateElevationMap()
     return true;
 }
 
-bool Projection::interpolateMap(const std::string& type)
+namespace
+{
+    /** face of the triangulation, with the plane through its vertices */
+    struct Triangle
+    {
+	double x[3], y[3];
+	Eigen::Vector3d plane;
+	double minX, maxX;
+    };
+
+    /** fills the empty cells of blocks of rows with the planes of the
+     * triangles which cover them. The triangles are binned by the blocks
+     * they overlap, so that each block only goes through its own
+     * triangles. The blocks don't overlap, so they can be processed in
+     * parallel. */
+    struct RasterizeTriangles
+    {
+	const std::vector<Triangle>* triangles;
+	/** the triangles of block b are bins[binStart[b]] to
+	 * bins[binStart[b+1]-1], in the order of the triangles */
+	const std::vector<size_t>* binStart;
+	const std::vector<size_t>* bins;
+	size_t blockLines;
+	ElevationGrid::ArrayType* data;
+	size_t minX, maxX, minY, maxY;
+
+	void operator()( size_t begin, size_t end )
+	{
+	    for( size_t b=begin; b<end; b++ )
+	    {
+		const long first = minX + b * blockLines;
+		const long last = (long)std::min( first + blockLines, maxX ) - 1;
+		for( size_t i=(*binStart)[b]; i<(*binStart)[b+1]; i++ )
+		    rasterize( (*triangles)[(*bins)[i]], first, last );
+	    }
+	}
+
+	/** fills the empty cells of the triangle in the lines [first, last] */
+	void rasterize( const Triangle& t, long first, long last )
+	{
+	    // the vertices are on integer positions, so a small tolerance is
+	    // enough to include the cells on the edges
+	    const double eps = 1e-9;
+	    const long x0 = std::max( first, (long)ceil( t.minX - eps ) );
+	    const long x1 = std::min( last, (long)floor( t.maxX + eps ) );
+	    for( long x=x0; x<=x1; x++ )
+	    {
+		// extent of the triangle in this line
+		double ymin = std::numeric_limits<double>::infinity();
+		double ymax = -std::numeric_limits<double>::infinity();
+		for( int i=0; i<3; i++ )
+		{
+		    const int j = (i+1) % 3;
+		    const double xa = t.x[i], xb = t.x[j];
+		    if( x < std::min( xa, xb ) - eps || x > std::max( xa, xb ) + eps )
+			continue;
+
+		    if( xa == xb )
+		    {
+			ymin = std::min( ymin, std::min( t.y[i], t.y[j] ) );
+			ymax = std::max( ymax, std::max( t.y[i], t.y[j] ) );
+		    }
+		    else
+		    {
+			const double y = t.y[i] + (x - xa) * (t.y[j] - t.y[i]) / (xb - xa);
+			ymin = std::min( ymin, y );
+			ymax = std::max( ymax, y );
+		    }
+		}
+
+		if( ymin > ymax )
+		    continue;
+		const long y0 = std::max( (long)minY, (long)ceil( ymin - eps ) );
+		const long y1 = std::min( (long)maxY - 1, (long)floor( ymax + eps ) );
+		double* row = &(*data)[x][0];
+		for( long y=y0; y<=y1; y++ )
+		{
+		    if( fabs( row[y] ) == std::numeric_limits<double>::infinity() )
+			row[y] = Eigen::Vector3d(x,y,1).dot( t.plane );
+		}
+	    }
+	}
+    };
+}
+
+bool Projection::interpolateMap(const std::string& type, size_t threads)
 {
     // TODO add checking of connections
     ElevationGrid* grid = static_cast<envire::ElevationGrid*>(*env->getOutputs(this).begin());
@@ -131,35 +219,81 @@ bool Projection::interpolateMap(const std::string& type)
 	}
     }
 
-    for(size_t x=min_width;x<max_width;x++)
+    // Instead of locating the face for each empty cell, each face is
+    // rasterized once. The plane through the three vertices is the same
+    // interpolation as before. Cells outside of the convex hull of the
+    // data points are left empty.
+    std::vector<Triangle> triangles;
+    triangles.reserve( dt.number_of_faces() );
+    for( Delaunay::Finite_faces_iterator face = dt.finite_faces_begin(); face != dt.finite_faces_end(); face++ )
     {
-	for(size_t y=min_height;y<max_height;y++)
+	// Solve linear equation system to find plane that is spanned by
+	// the three points
+	Eigen::Matrix3d A;
+	Eigen::Vector3d b;
+
+	Triangle t;
+	for(int i=0;i<3;i++)
 	{
-	    if( fabs( data[x][y] ) == std::numeric_limits<double>::infinity() )
-	    {
-		// no data point in grid, so value needs to be interpolated
-
-		// Solve linear equation system to find plane that is spanned by
-		// the three points
-		Eigen::Matrix3d A;
-		Eigen::Vector3d b;
-		
-		Delaunay::Face_handle face = dt.locate( Point(x,y,0) );
-		if( face == NULL || face->vertex(0) == NULL || face->vertex(1) == NULL || face->vertex(2) == NULL)
-		    continue;
+	    const Point &p(face->vertex(i)->point());
+	    A.block<1,3>(i,0) = Eigen::Vector3d(p.x(), p.y(), 1);
+	    b(i) = p.z();
+	    t.x[i] = p.x();
+	    t.y[i] = p.y();
+	}
+	t.plane = A.inverse() * b;
+	t.minX = std::min( t.x[0], std::min( t.x[1], t.x[2] ) );
+	t.maxX = std::max( t.x[0], std::max( t.x[1], t.x[2] ) );
+	triangles.push_back( t );
+    }
 
-		for(int i=0;i<3;i++)
-		{
-		    Point &p(face->vertex(i)->point());
-		    A.block<1,3>(i,0) = Eigen::Vector3d(p.x(), p.y(), 1);
-		    b(i) = p.z();
-		}
+    if( triangles.empty() || max_width <= min_width )
+	return true;
 
-		// evaluate the point at x, y
-		data[x][y] = Eigen::Vector3d(x,y,1).dot( A.inverse() * b );
-	    }
+    // split the lines into a few blocks per thread, and bin the triangles
+    // by the blocks they overlap, counting first and then filling
+    if( threads == 0 )
+	threads = getParallelThreads();
+    const size_t lines = max_width - min_width;
+    const size_t blockLines = std::max( lines / (threads * 4), (size_t)1 );
+    const size_t blocks = (lines + blockLines - 1) / blockLines;
+
+    std::vector<size_t> binStart( blocks + 1 );
+    std::vector<std::pair<size_t, size_t> > ranges( triangles.size() );
+    for( size_t i=0; i<triangles.size(); i++ )
+    {
+	const double eps = 1e-9;
+	const long x0 = std::max( (long)min_width, (long)ceil( triangles[i].minX - eps ) );
+	const long x1 = std::min( (long)max_width - 1, (long)floor( triangles[i].maxX + eps ) );
+	if( x0 > x1 )
+	{
+	    ranges[i] = std::make_pair( 1, 0 );
+	    continue;
 	}
+	ranges[i] = std::make_pair( (x0 - min_width) / blockLines, (x1 - min_width) / blockLines );
+	for( size_t b=ranges[i].first; b<=ranges[i].second; b++ )
+	    binStart[b+1]++;
     }
+    for( size_t b=0; b<blocks; b++ )
+	binStart[b+1] += binStart[b];
+
+    std::vector<size_t> bins( binStart.back() );
+    std::vector<size_t> fill( binStart.begin(), binStart.end() - 1 );
+    for( size_t i=0; i<triangles.size(); i++ )
+	for( size_t b=ranges[i].first; b<=ranges[i].second; b++ )
+	    bins[fill[b]++] = i;
+
+    RasterizeTriangles rasterize;
+    rasterize.triangles = &triangles;
+    rasterize.binStart = &binStart;
+    rasterize.bins = &bins;
+    rasterize.blockLines = blockLines;
+    rasterize.data = &data;
+    rasterize.minX = min_width;
+    rasterize.maxX = max_width;
+    rasterize.minY = min_height;
+    rasterize.maxY = max_height;
+    parallelFor( 0, blocks, rasterize, 1, threads );
 
     return true;
 }
@@ -25,7 +25,11 @@ namespace envire {
 
 	bool updateTraversibilityMap();
 	bool updateElevationMap();
-	bool interpolateMap(const std::string& type);
+	/** fills the empty cells of the band inside of the convex hull of
+	 * the cells with data, with the planes of a Delaunay triangulation.
+	 * @param threads - number of threads to use, 0 for all hardware threads
+	 */
+	bool interpolateMap(const std::string& type, size_t threads = 0);
     };
 }
 #endif
@@ -1,6 +1,10 @@
 #include "ScanMeshing.hpp"
 #include <stdexcept>
 #include <iostream>
+#include <algorithm>
+
+#include <boost/unordered_map.hpp>
+#include <boost/cstdint.hpp>
 
 using namespace envire;
 using namespace std;
@@ -22,6 +26,7 @@ void ScanMeshing::setDefaultConfiguration()
     maxRange = 1e9;
     extractMarkers = false;
     _useRemission = false;
+    incremental = false;
 }
 
 void ScanMeshing::serialize(Serialization& so)
@@ -84,30 +89,168 @@ void ScanMeshing::setRemissionMarkerThreshold( long value )
     remissionMarkerThreshold = value;
 }
 
-struct Marker
+void ScanMeshing::setExtractMarkers( bool value ) 
 {
-    Eigen::Vector3d center;
-    std::vector<Eigen::Vector3d> points;
-    void calcCenter()
+    extractMarkers = value;
+}
+
+void ScanMeshing::setIncremental( bool value ) 
+{
+    incremental = value;
+    state.reset();
+}
+
+namespace
+{
+    struct Marker
     {
-	center = Eigen::Vector3d::Zero();
-	for(size_t i=0;i<points.size();i++)
+	Eigen::Vector3d center;
+	Eigen::Vector3d sum;
+	size_t count;
+
+	Marker() : center( Eigen::Vector3d::Zero() ), sum( Eigen::Vector3d::Zero() ), count( 0 ) {}
+
+	void addPoint(const Eigen::Vector3d &point)
 	{
-	    center += points[i];
+	    sum += point;
+	    count++;
+	    center = sum / count;
+	}
+
+	double dist(const Eigen::Vector3d &point) const
+	{
+	    return (point - center).norm();
 	}
-	center /= points.size();
     };
 
-    void addPoint(const Eigen::Vector3d &point)
+    /** 
+     * clusters marker points. Points are added to all the markers whose
+     * center is within maxDist, or create a new marker otherwise. The
+     * marker centers are stored in a spatial hash with a cell size of
+     * maxDist, so that only the neighbouring cells need to be searched.
+     */
+    class MarkerClusters
     {
-	points.push_back( point );
-	calcCenter();
+	typedef boost::unordered_map<boost::uint64_t, std::vector<size_t> > Hash;
+
+	double maxDist;
+	std::vector<Marker> markers;
+	Hash hash;
+
+	boost::uint64_t key( int x, int y, int z ) const
+	{
+	    // 21 bits per coordinate
+	    const boost::uint64_t mask = (1 << 21) - 1;
+	    return ((boost::uint64_t)(x & mask) << 42) | ((boost::uint64_t)(y & mask) << 21) | (boost::uint64_t)(z & mask);
+	}
+
+	boost::uint64_t key( const Eigen::Vector3d& p ) const
+	{
+	    return key( floor( p.x() / maxDist ), floor( p.y() / maxDist ), floor( p.z() / maxDist ) );
+	}
+
+	void remove( size_t idx )
+	{
+	    std::vector<size_t>& cell( hash[key( markers[idx].center )] );
+	    cell.erase( std::find( cell.begin(), cell.end(), idx ) );
+	}
+
+    public:
+	MarkerClusters( double maxDist ) : maxDist( maxDist ) {}
+
+	void addPoint( const Eigen::Vector3d& p )
+	{
+	    // collect the markers close to the point first, since
+	    // adding the point changes their position in the hash
+	    std::vector<size_t> close;
+	    const int cx = floor( p.x() / maxDist );
+	    const int cy = floor( p.y() / maxDist );
+	    const int cz = floor( p.z() / maxDist );
+	    for( int x=cx-1; x<=cx+1; x++ )
+		for( int y=cy-1; y<=cy+1; y++ )
+		    for( int z=cz-1; z<=cz+1; z++ )
+		    {
+			Hash::const_iterator it = hash.find( key( x, y, z ) );
+			if( it == hash.end() )
+			    continue;
+			for( size_t i=0; i<it->second.size(); i++ )
+			    if( markers[it->second[i]].dist( p ) < maxDist )
+				close.push_back( it->second[i] );
+		    }
+
+	    if( close.empty() )
+	    {
+		close.push_back( markers.size() );
+		markers.push_back( Marker() );
+	    }
+	    else
+		std::sort( close.begin(), close.end() );
+
+	    for( size_t i=0; i<close.size(); i++ )
+	    {
+		Marker& m( markers[close[i]] );
+		if( m.count )
+		    remove( close[i] );
+		m.addPoint( p );
+		hash[key( m.center )].push_back( close[i] );
+	    }
+	}
+
+	const std::vector<Marker>& getMarkers() const { return markers; }
+    };
+}
+
+/** 
+ * state of the meshing which is kept between the calls to updateAll in
+ * incremental mode.
+ */
+struct ScanMeshing::MeshingState
+{
+    MeshingState() : scan( NULL ), mesh( NULL ), lines( 0 ), vertices( 0 ), faces( 0 ), 
+	delta_psi( 0 ), origin_psi( 0 ), markers( 0.05 ) {}
+
+    const LaserScan* scan;
+    const TriMesh* mesh;
+
+    /** number of lines, vertices and faces after the last update */
+    size_t lines;
+    size_t vertices;
+    size_t faces;
+
+    /** vertex indices of the last scan line which was processed */
+    std::vector<int> lastLine;
+
+    /** lookup tables for the beam angles */
+    float delta_psi;
+    float origin_psi;
+    std::vector<float> psi;
+    std::vector<float> cosPsi;
+    std::vector<float> sinPsi;
+
+    // TODO make max distance configurable
+    MarkerClusters markers;
+
+    bool isValid( const LaserScan& s, const TriMesh& m ) const
+    {
+	return scan == &s && mesh == &m 
+	    && s.lines.size() >= lines
+	    && m.vertices.size() == vertices && m.faces.size() == faces
+	    && s.delta_psi == delta_psi && s.origin_psi == origin_psi;
     }
 
-    double dist(const Eigen::Vector3d &point)
+    void updateTables( size_t size )
     {
-	return (point - center).norm();
-    };
+	// psi is accumulated, so that the angles are exactly the same as
+	// when incrementing for every point
+	float p = psi.empty() ? origin_psi : psi.back() + delta_psi;
+	for( size_t i=psi.size(); i<size; i++ )
+	{
+	    psi.push_back( p );
+	    cosPsi.push_back( std::cos( p ) );
+	    sinPsi.push_back( std::sin( p ) );
+	    p += delta_psi;
+	}
+    }
 };
 
 bool ScanMeshing::updateAll() 
@@ -123,72 +266,124 @@ bool ScanMeshing::updateAll()
     std::vector<Eigen::Vector3d>& colors(meshPtr->getVertexData<Eigen::Vector3d>(TriMesh::VERTEX_COLOR));
     std::vector<TriMesh::vertex_attr>& point_attrs(meshPtr->getVertexData<TriMesh::vertex_attr>(TriMesh::VERTEX_ATTRIBUTES));
     std::vector<double>& uncertainty(meshPtr->getVertexData<double>(Pointcloud::VERTEX_VARIANCE));
+    const unsigned long generation = meshPtr->getDataGeneration();
 
     typedef TriMesh::triangle_t triangle_t;
     std::vector< triangle_t >& faces(meshPtr->faces);
     
-    std::vector<Marker> markers;
+    envire::LaserScan& scan(*scanPtr);
+
+    // in incremental mode, we continue from the last processed line if the
+    // state is still valid. Otherwise the strategy is to clear everything
+    // and redo
+    if( !incremental || !state || !state->isValid( scan, *meshPtr ) )
+    {
+	state.reset( new MeshingState() );
+	state->scan = scanPtr;
+	state->mesh = meshPtr;
+	state->delta_psi = scan.delta_psi;
+	state->origin_psi = scan.origin_psi;
+
+	points.clear();
+	colors.clear();
+	point_attrs.clear();
+	faces.clear();
+	uncertainty.clear();
+    }
+    MeshingState& st( *state );
+    const size_t firstLine = st.lines;
+    const size_t firstFace = faces.size();
 
-    // our "update" strategy is to clear everything and redo
-    points.clear();
-    colors.clear();
-    point_attrs.clear();
-    faces.clear();
-    uncertainty.clear();
+    // the last line of the previous update is copied into the line
+    // buffers as well, and may be longer than the new ones
+    size_t maxPoints = std::max( (size_t)scan.points_per_line, st.lastLine.size() );
+    for(size_t line_num=firstLine;line_num<scan.lines.size();line_num++)
+	maxPoints = std::max( maxPoints, scan.lines[line_num].ranges.size() );
+    st.updateTables( maxPoints );
 
-    envire::LaserScan& scan(*scanPtr);
+    std::vector<int> line1( maxPoints, -1 ), line2( maxPoints, -1 );
+    int *idx_line=&line1[0], *prev_idx_line=&line2[0];
+
+    if( firstLine > 0 )
+    {
+	std::copy( st.lastLine.begin(), st.lastLine.end(), prev_idx_line );
+
+	// the last line of the previous update is not on the edge of the scan
+	// anymore, if there are new lines
+	const size_t last = firstLine - 1;
+	const LaserScan::scanline_t& line( scan.lines[last] );
+	for(size_t point_num=0;point_num<st.lastLine.size() && firstLine < scan.lines.size();point_num++)
+	{
+	    if( st.lastLine[point_num] < 0 )
+		continue;
+	    bool edge = 
+		point_num == 0 
+		|| point_num == (line.ranges.size()-1) 
+		|| last == 0;
+	    point_attrs[st.lastLine[point_num]] = edge << TriMesh::SCAN_EDGE;
+	}
+    }
 
-    int line1[scan.points_per_line], line2[scan.points_per_line];
-    int *idx_line=line1, *prev_idx_line=line2;
+    // the edge angle between two points is 
+    // acos( (r^2 - n^2 + c^2) / (2 r c) ) with c^2 = r^2 + n^2 - 2 r n cos(2 dpsi)
+    // and the check fabs( edgeAngle - pi/2 ) < maxEdgeAngle is equivalent 
+    // to fabs( r - n cos(2 dpsi) ) < sin( maxEdgeAngle ) * c
+    const double cosDelta = cos( 2*scan.delta_psi );
+    const double sinMaxEdgeAngle = maxEdgeAngle < M_PI*0.5 ? sin( maxEdgeAngle ) : 1.0;
 
-    for(size_t line_num=0;line_num<scan.lines.size();line_num++) {
+    for(size_t line_num=firstLine;line_num<scan.lines.size();line_num++) {
         const LaserScan::scanline_t& line(scan.lines[line_num]);
 
-        float phi = scan.origin_phi + line.delta_phi;
-        float psi = scan.origin_psi;
+        const float phi = scan.origin_phi + line.delta_phi;
+	const float cosPhi = std::cos( phi );
+	const float sinPhi = std::sin( phi );
+
+	// center offset compensation is the same for the whole line
+	const Eigen::Vector3d offset = Eigen::AngleAxisd(phi, Eigen::Vector3d::UnitX()) * scan.center_offset;
 
 	bool has_rem = (line.ranges.size() == line.remissions.size());
 
-	float prev_edgeAngle = M_PI*0.5;
+	bool prev_edgePass = true;
         for(size_t point_num=0;point_num<line.ranges.size();point_num++) {
+	    const float psi = st.psi[point_num];
+
 	    // check distance derivative over angle to filter ghost
 	    // readings on edges
 	    float range = line.ranges[point_num] / 1000.0;
-	    float edgeAngle = M_PI*0.5;
+	    bool edgePass = true;
 	    if( point_num < (line.ranges.size() - 1) )
 	    {
-		float next_range = line.ranges[point_num+1] / 1000.0;
-		float c = sqrt( pow(range,2) + pow(next_range,2) - 2*range*next_range*cos( 2*scan.delta_psi ) );
-		edgeAngle = acos( (pow(range,2) - pow(next_range,2) + pow(c,2) ) / ( 2*range*c ) );
+		double next_range = line.ranges[point_num+1] / 1000.0;
+		double c = sqrt( range*range + next_range*next_range - 2*range*next_range*cosDelta );
+		edgePass = range > 0 && c > 0 
+		    && fabs( range - next_range * cosDelta ) < sinMaxEdgeAngle * c;
 	    }
-	    bool pass = fabs(edgeAngle-M_PI*0.5) < maxEdgeAngle &&
-		fabs(prev_edgeAngle-M_PI*0.5) < maxEdgeAngle;
-	    prev_edgeAngle = edgeAngle;
+	    bool pass = edgePass && prev_edgePass;
+	    prev_edgePass = edgePass;
 
             if( range > minRange && range < maxRange && pass ) 
 	    {
-                float xx = std::cos( psi ) * range;
+                float xx = st.cosPsi[point_num] * range;
 
                 Eigen::Vector3d point;
 		if( scan.x_forward )
 		{
 		    // x-forward
 		    point = Eigen::Vector3d( 
-			    std::cos( phi ) * xx,
-			    std::sin( psi ) * range,
-			    std::sin( phi ) * xx );
+			    cosPhi * xx,
+			    st.sinPsi[point_num] * range,
+			    sinPhi * xx );
 		}
 		else
 		{
 		    // y-forward
 		    point = Eigen::Vector3d( 
-			    -std::sin( psi ) * range,
-			    std::cos( phi ) * xx,
-			    std::sin( phi ) * xx );
+			    -st.sinPsi[point_num] * range,
+			    cosPhi * xx,
+			    sinPhi * xx );
 		}
 
                 // perform center offset compensation
-                Eigen::Vector3d offset = Eigen::AngleAxisd(phi, Eigen::Vector3d::UnitX()) * scan.center_offset;
                 Eigen::Vector3d opoint = point + offset;
 
                 points.push_back(opoint); 
@@ -208,30 +403,9 @@ bool ScanMeshing::updateAll()
 
 		    colors.push_back( Eigen::Vector3d::Ones() * cval );
 
-		    if( extractMarkers )
-		    {
-			// TODO maybe move into separate function
-			// see if remission value is above threshold for marker
-			if( line.remissions[point_num] > remissionMarkerThreshold )
-			{
-			    bool newMarker = true;
-			    for(size_t i=0;i<markers.size();i++)
-			    {
-				// TODO make max distance configurable
-				if( markers[i].dist( opoint ) < 0.05 )
-				{
-				    newMarker = false;
-				    markers[i].addPoint( opoint );
-				}
-			    }
-			    if( newMarker )
-			    {
-				Marker m;
-				m.addPoint( opoint );
-				markers.push_back( m );
-			    }
-			}
-		    }
+		    // see if remission value is above threshold for marker
+		    if( extractMarkers && line.remissions[point_num] > remissionMarkerThreshold )
+			st.markers.addPoint( opoint );
 		}
 
 		// see if the the scanpoint is actually on the edge of the scan
@@ -291,23 +465,37 @@ bool ScanMeshing::updateAll()
                     }
                 }
             }
-                
-            psi += scan.delta_psi;
         }
 
+	// mark the rest of the line as invalid, in case the next line is
+	// longer
+	std::fill( idx_line + line.ranges.size(), idx_line + maxPoints, -1 );
+
         // swap line and previous line
         int *tmp = idx_line;
         idx_line = prev_idx_line;
         prev_idx_line = tmp;
     }
 
+    // remember where to continue
+    if( scan.lines.size() > firstLine )
+	st.lastLine.assign( prev_idx_line, prev_idx_line + scan.lines.back().ranges.size() );
+    st.lines = scan.lines.size();
+    st.vertices = points.size();
+    st.faces = faces.size();
+
+    const std::vector<Marker>& markers( st.markers.getMarkers() );
     for(size_t i=0;i<markers.size();i++)
     {
-	std::cout << "marker " << i << " center: " << markers[i].center.transpose() << " pixel: " << markers[i].points.size() << std::endl;
+	std::cout << "marker " << i << " center: " << markers[i].center.transpose() << " pixel: " << markers[i].count << std::endl;
     }
 
-    // calculate vertex normals
-    meshPtr->calcVertexNormals();
+    // calculate vertex normals, only for the new faces if this is an
+    // incremental update
+    meshPtr->calcVertexNormals( firstFace );
+
+    // the data must not have been shared while it was written
+    assert( meshPtr->getDataGeneration() == generation );
 
     // remove colors if empty 
     assert( colors.empty() || colors.size() == points.size() );
@@ -319,4 +507,3 @@ bool ScanMeshing::updateAll()
 
     return true;
 }
-
@@ -5,6 +5,7 @@
 #include <envire/core/Operator.hpp>
 #include <envire/maps/LaserScan.hpp>
 #include <envire/maps/TriMesh.hpp>
+#include <boost/shared_ptr.hpp>
 
 namespace envire 
 {
@@ -21,6 +22,10 @@ namespace envire
 	bool _useRemission;
 
 	bool extractMarkers;
+	bool incremental;
+
+	struct MeshingState;
+	boost::shared_ptr<MeshingState> state;
 
     public:
 	ScanMeshing();
@@ -38,6 +43,12 @@ namespace envire
 	void setMinRange( double value );
 	void setMaxRange( double value );
 	void setExtractMarkers( bool value );
+
+	/** if set, updateAll will only process the scan lines which have been
+	 * added to the input since the last call, and append the result to the
+	 * output mesh. If the input scan parameters or the output mesh have
+	 * been changed otherwise in between, the mesh is rebuilt. */
+	void setIncremental( bool value );
 	bool updateAll();
 
 	void setDefaultConfiguration();
@@ -1,46 +1,84 @@
 #include "TraversabilityGrassfire.hpp"
 #include <maps/MLSGrid.hpp>
+#include <envire/tools/Parallel.hpp>
+
+#include <boost/math/special_functions/fpclassify.hpp>
+#include <limits>
 
 using namespace envire;
 using envire::Grid;
 
 ENVIRONMENT_ITEM_DEF( TraversabilityGrassfire );
 
-int slopeTooHigh = 0;
-int stepTooHigh = 0;
-int totalCnt = 0;
-int drivable = 0;
+namespace envire
+{
+    /** classifies blocks of rows of the grid */
+    struct TraversabilityGrassfireKernel
+    {
+        TraversabilityGrassfire *grassfire;
+        /** cells to classify, or NULL for all */
+        const boost::dynamic_bitset<> *dirty;
+        boost::mutex *mutex;
+
+        void operator()(size_t begin, size_t end)
+        {
+            TraversabilityGrassfire::Statistics stats;
+            const size_t width = grassfire->mlsGrid->getCellSizeX();
+            for(size_t y = begin; y < end; y++)
+            {
+                for(size_t x = 0; x < width; x++)
+                {
+                    if(dirty && !dirty->test(y * width + x))
+                        continue;
+                    grassfire->setTraversability(x, y, stats);
+                    grassfire->setProbability(x, y);
+                }
+            }
+
+            boost::lock_guard<boost::mutex> lock(*mutex);
+            grassfire->statistics.total += stats.total;
+            grassfire->statistics.stepTooHigh += stats.stepTooHigh;
+            grassfire->statistics.slopeTooHigh += stats.slopeTooHigh;
+            grassfire->statistics.drivable += stats.drivable;
+        }
+    };
+}
+
+TraversabilityGrassfire::TraversabilityGrassfire()
+    : lastGrid(NULL), lastCells(0), incremental(false)
+{
+}
 
 void TraversabilityGrassfire::setProbability(size_t x, size_t y)
 {
-    SurfacePatch *currentPatch = bestPatchMap[y][x];
-    if(!currentPatch)
+    const size_t idx = y * mlsGrid->getCellSizeX() + x;
+    if(boost::math::isnan(heights[idx]))
     {
-        trGrid->setProbability(0.0, x, y);
+        (*probData)[y][x] = TraversabilityGrid::toProbabilityValue(0.0);
         (*trData)[y][x] = UNKNOWN;
         return;
     }
 
-    float numScanPoints = currentPatch->getMeasurementCount();
+    float numScanPoints = measurements[idx];
     
     if(numScanPoints > config.numNominalMeasurements)
     {
-        trGrid->setProbability(1.0, x, y);        
+        (*probData)[y][x] = TraversabilityGrid::toProbabilityValue(1.0);
     }
     else
     {
-        trGrid->setProbability(numScanPoints / config.numNominalMeasurements, x, y);
+        (*probData)[y][x] = TraversabilityGrid::toProbabilityValue(numScanPoints / config.numNominalMeasurements);
     }
 }
 
 
-void TraversabilityGrassfire::setTraversability(size_t x, size_t y)
+void TraversabilityGrassfire::setTraversability(size_t x, size_t y, Statistics &stats)
 {
     bool debug = false;
-    totalCnt++;
+    stats.total++;
 
-    SurfacePatch *currentPatch = bestPatchMap[y][x];
-    if(!currentPatch)
+    const size_t width = mlsGrid->getCellSizeX();
+    if(boost::math::isnan(heights[y * width + x]))
     {
         (*trData)[y][x] = UNKNOWN;
         return;
@@ -49,14 +87,14 @@ void TraversabilityGrassfire::setTraversability(size_t x, size_t y)
     numeric::PlaneFitting<double> fitter;
     int count = 0;
     
-    double thisHeight = currentPatch->getMean() + currentPatch->getStdev();
+    double thisHeight = heights[y * width + x];
 
     const double scaleX =mlsGrid->getScaleX();
     const double scaleY = mlsGrid->getScaleY();
 
     if(debug)
     {
-        std::cout << "x " << x << " y " << y << " height " << thisHeight << " mean " << currentPatch->getMean() << " stdev " << currentPatch->getStdev() << std::endl;
+        std::cout << "x " << x << " y " << y << " height " << thisHeight << std::endl;
     }
     
     for(int yi = -1; yi <= 1; yi++)
@@ -68,18 +106,17 @@ void TraversabilityGrassfire::setTraversability(size_t x, size_t y)
             
             size_t newX = x + xi;
             size_t newY = y + yi;
-            if(newX < mlsGrid->getCellSizeX() && newY < mlsGrid->getCellSizeY())
+            if(newX < width && newY < mlsGrid->getCellSizeY())
             {
 
-                SurfacePatch *neighbourPatch = bestPatchMap[newY][newX];
-                if(neighbourPatch)
+                double neighbourHeight = heights[newY * width + newX];
+                if(!boost::math::isnan(neighbourHeight))
                 {
                     count++;
-                    double neighbourHeight = neighbourPatch->getMean() + neighbourPatch->getStdev();
                     
                     if(debug)
                     {
-                        std::cout << "Nx " << newX << " Ny " << newY << " height " << neighbourHeight << " mean " << neighbourPatch->getMean() << " stdev " << neighbourPatch->getStdev() << std::endl;
+                        std::cout << "Nx " << newX << " Ny " << newY << " height " << neighbourHeight << std::endl;
                     }
 
                     if(fabs(neighbourHeight - thisHeight) > config.maxStepHeight)
@@ -88,7 +125,7 @@ void TraversabilityGrassfire::setTraversability(size_t x, size_t y)
                         {
                             std::cout << "Step do hight" << std::endl;
                         }
-                        stepTooHigh++;
+                        stats.stepTooHigh++;
                         (*trData)[y][x] = OBSTACLE;
                         return;
                     }
@@ -141,7 +178,7 @@ void TraversabilityGrassfire::setTraversability(size_t x, size_t y)
             std::cout << "slope is to hight " << std::endl;
         }
 
-        slopeTooHigh++;
+        stats.slopeTooHigh++;
         (*trData)[y][x] = OBSTACLE;
         return;
     }
@@ -156,7 +193,7 @@ void TraversabilityGrassfire::setTraversability(size_t x, size_t y)
         std::cout << "Setting tr class " << ceil((drivability - 0.00001) * config.numTraversabilityClasses) << std::endl;
     }
 
-    drivable++;
+    stats.drivable++;
 }
 
 double TraversabilityGrassfire::getStepHeight(SurfacePatch* from, SurfacePatch* to)
@@ -166,13 +203,6 @@ double TraversabilityGrassfire::getStepHeight(SurfacePatch* from, SurfacePatch*
 
 void TraversabilityGrassfire::checkRecursive(size_t x, size_t y, SurfacePatch* origin)
 {
-    if(visited[y][x])
-    {
-        return;
-    }
-    
-    visited[y][x] = true;
-    
     bool isKnownObstacle;
     
     SurfacePatch *bestMatchingPatch = getNearestPatchWhereRobotFits(x, y, origin->getMean() + origin->getStdev(), isKnownObstacle);
@@ -182,7 +212,6 @@ void TraversabilityGrassfire::checkRecursive(size_t x, size_t y, SurfacePatch* o
         if(isKnownObstacle)
         {
             bestPatchMap[y][x] = bestMatchingPatch;
-            visited[y][x] = true;
         }
         else
         {
@@ -198,8 +227,9 @@ void TraversabilityGrassfire::checkRecursive(size_t x, size_t y, SurfacePatch* o
 
 void TraversabilityGrassfire::addNeightboursToSearchList(size_t x, size_t y, SurfacePatch* patch)
 {
+    const size_t width = mlsGrid->getCellSizeX();
     bestPatchMap[y][x] = patch;
-    visited[y][x] = true;
+    visited.set(y * width + x);
 
     for(int yi = -1; yi <= 1; yi++)
     {
@@ -210,8 +240,11 @@ void TraversabilityGrassfire::addNeightboursToSearchList(size_t x, size_t y, Sur
             
             size_t newX = x + xi;
             size_t newY = y + yi;
-            if(newX < mlsGrid->getCellSizeX() && newY < mlsGrid->getCellSizeY())
+            // the first origin which reaches a cell is used for it, so
+            // cells are only added once
+            if(newX < width && newY < mlsGrid->getCellSizeY() && !visited.test(newY * width + newX))
             {
+                visited.set(newY * width + newX);
                 searchList.push(SearchItem(newX, newY, patch));
             }
         }
@@ -228,20 +261,17 @@ bool TraversabilityGrassfire::determineDrivePlane(base::Vector3d startPos, bool
 
     
     //make shure temp maps have correct size
+    const size_t cells = mlsGrid->getCellSizeX() * mlsGrid->getCellSizeY();
     bestPatchMap.resize(boost::extents[mlsGrid->getCellSizeY()][mlsGrid->getCellSizeX()]);
-    visited.resize(boost::extents[mlsGrid->getCellSizeY()][mlsGrid->getCellSizeX()]);
     trData->resize(boost::extents[mlsGrid->getCellSizeY()][mlsGrid->getCellSizeX()]);
 
     //fill them with defautl values
     SurfacePatch *emptyPatch = NULL;
     //Note passing directly NULL to fill makes the compiler cry....
     std::fill(bestPatchMap.data(), bestPatchMap.data() + bestPatchMap.num_elements(), emptyPatch);
-    std::fill(visited.data(), visited.data() + visited.num_elements(), false);
-    std::fill(trData->data(), trData->data() + trData->num_elements(), UNKNOWN);
-    
-    //init probability with zero
-    TraversabilityGrid::ArrayType *probabilityArray = &(trGrid->getGridData(TraversabilityGrid::PROBABILITY));
-    std::fill(probabilityArray->data(), probabilityArray->data() + probabilityArray->num_elements(), 0);  
+    visited.clear();
+    visited.resize(cells, false);
+    searchList.clear(8 * (mlsGrid->getCellSizeX() + mlsGrid->getCellSizeY()));
     
     double bestHeightDiff = std::numeric_limits< double >::max();
     SurfacePatch *bestMatchingPatch = NULL;
@@ -401,27 +431,19 @@ void TraversabilityGrassfire::setStartPosition(Eigen::Vector3d startPos)
     this->startPos = startPos;
 }
 
-void TraversabilityGrassfire::computeTraversability()
+void TraversabilityGrassfire::computeTraversability(const boost::dynamic_bitset<> *dirty)
 {
-    size_t maxX = mlsGrid->getCellSizeX();
-    size_t maxY = mlsGrid->getCellSizeY();
-    
-    for(size_t y = 0;y < maxY; y++)
-    {
-        for(size_t x = 0;x < maxX; x++)
-        {
-            setTraversability(x, y);
-            setProbability(x, y);
-        }
-    }
+    boost::mutex mutex;
+    TraversabilityGrassfireKernel kernel;
+    kernel.grassfire = this;
+    kernel.dirty = dirty;
+    kernel.mutex = &mutex;
+    parallelFor(0, mlsGrid->getCellSizeY(), kernel, 16);
 }
 
 bool envire::TraversabilityGrassfire::updateAll()
 {
-    slopeTooHigh = 0;
-    stepTooHigh = 0;
-    totalCnt = 0;
-    drivable = 0;
+    statistics = Statistics();
 
     mlsGrid = getInput<envire::MLSGrid *>();
     if(!mlsGrid)
@@ -432,7 +454,11 @@ bool envire::TraversabilityGrassfire::updateAll()
         throw std::runtime_error("TraversabilityGrassfire: no output band set");
 
     
+    // the bands are fetched (and detached from copies of the grid) once,
+    // since the rows are written on multiple threads
     trData = &(trGrid->getGridData(TraversabilityGrid::TRAVERSABILITY));
+    probData = &(trGrid->getGridData(TraversabilityGrid::PROBABILITY));
+    const unsigned long generation = trGrid->getDataGeneration();
 
     //register classes in traversability map
     trGrid->setTraversabilityClass(UNKNOWN, TraversabilityClass(1.0));
@@ -446,24 +472,69 @@ bool envire::TraversabilityGrassfire::updateAll()
     if(!determineDrivePlane(startPos))
     {
         std::cout << "TraversabilityGrassfire::Warning, could not find plane robot is driving on" << std::endl;
+        std::fill(trData->data(), trData->data() + trData->num_elements(), UNKNOWN);
+        std::fill(probData->data(), probData->data() + probData->num_elements(), 0);  
+        lastCells = 0;
         return false;
     }
     
     while(!searchList.empty())
     {
-        SearchItem next = searchList.front();
-        searchList.pop();
-        
+        SearchItem next = searchList.pop();
         checkRecursive(next.x, next.y, next.origin);
-        
     }
-    
-    computeTraversability();
-/*    
-    std::cout << "stepTooHigh " << stepTooHigh << std::endl;
-    std::cout << "slopeTooHigh " << slopeTooHigh << std::endl;
-    std::cout << "totalCnt " << totalCnt << std::endl;
-    std::cout << "drivable " << drivable << std::endl;*/
+
+    // raster of the surface found by the grassfire, which is all the
+    // classification needs from the patches
+    const size_t width = mlsGrid->getCellSizeX();
+    const size_t height = mlsGrid->getCellSizeY();
+    const size_t cells = width * height;
+    heights.swap(lastHeights);
+    measurements.swap(lastMeasurements);
+    heights.resize(cells);
+    measurements.resize(cells);
+    for(size_t y = 0; y < height; y++)
+    {
+        for(size_t x = 0; x < width; x++)
+        {
+            const SurfacePatch *patch = bestPatchMap[y][x];
+            heights[y * width + x] = patch ? patch->getMean() + patch->getStdev() : std::numeric_limits<float>::quiet_NaN();
+            measurements[y * width + x] = patch ? patch->getMeasurementCount() : 0;
+        }
+    }
+
+    if(incremental && lastCells == cells && lastGrid == trGrid)
+    {
+        // reclassify the neighbourhood of the cells which have changed
+        boost::dynamic_bitset<> dirty(cells);
+        for(size_t y = 0; y < height; y++)
+        {
+            for(size_t x = 0; x < width; x++)
+            {
+                const size_t idx = y * width + x;
+                const bool wasKnown = !boost::math::isnan(lastHeights[idx]);
+                const bool isKnown = !boost::math::isnan(heights[idx]);
+                if(wasKnown == isKnown && (!isKnown || 
+                            (heights[idx] == lastHeights[idx] && measurements[idx] == lastMeasurements[idx])))
+                    continue;
+
+                for(size_t yi = y > 0 ? y - 1 : 0; yi <= y + 1 && yi < height; yi++)
+                    for(size_t xi = x > 0 ? x - 1 : 0; xi <= x + 1 && xi < width; xi++)
+                        dirty.set(yi * width + xi);
+            }
+        }
+        computeTraversability(&dirty);
+    }
+    else
+    {
+        computeTraversability(NULL);
+    }
+
+    lastGrid = trGrid;
+    lastCells = cells;
+
+    // the bands must not have been shared while they were written
+    assert(trGrid->getDataGeneration() == generation);
         
     return envire::Operator::updateAll();
 }
@@ -7,7 +7,10 @@
 #include <envire/maps/TraversabilityGrid.hpp>
 #include <envire/maps/MLSGrid.hpp>
 #include <envire/maps/MLSPatch.hpp>
-#include <queue>
+
+#include <boost/dynamic_bitset.hpp>
+#include <algorithm>
+#include <vector>
 
 namespace envire {
 
@@ -32,6 +35,18 @@ public:
         int outliertFilterMinMeasurements;
         double outliertFilterMaxStdDev;
     };
+
+    /** number of cells classified in the last update */
+    struct Statistics
+    {
+        Statistics() : total(0), stepTooHigh(0), slopeTooHigh(0), drivable(0) {}
+        size_t total;
+        size_t stepTooHigh;
+        size_t slopeTooHigh;
+        size_t drivable;
+    };
+
+    TraversabilityGrassfire();
     
     virtual bool updateAll();
 
@@ -39,7 +54,18 @@ public:
     void setConfig(const Config &config)
     {
         this->config = config;
+        lastCells = 0;
     }
+
+    /**
+     * In incremental mode, the classification of the previous update is
+     * kept for all cells for which the surface of the 3x3 neighbourhood
+     * found by the grassfire has not changed. The output grid should not
+     * be modified between the updates in this mode.
+     */
+    void setIncremental(bool incremental) { this->incremental = incremental; }
+
+    const Statistics& getStatistics() const { return statistics; }
     
 private:
     SurfacePatch *getNearestPatchWhereRobotFits(size_t x, size_t y, double height, bool& isObstace);
@@ -55,6 +81,7 @@ private:
     Config config;
     envire::TraversabilityGrid *trGrid;
     TraversabilityGrid::ArrayType *trData;
+    TraversabilityGrid::ArrayType *probData;
     MLSGrid *mlsGrid;
     
     TraversabilityClass classUnknown;
@@ -72,13 +99,84 @@ private:
         envire::SurfacePatch* origin;
     };
     
-    std::queue<SearchItem> searchList;
+    /**
+     * FIFO of the cells waiting for the grassfire, as a ring buffer. Only
+     * the frontier of the grassfire is queued, which is about the
+     * perimeter of the area reached so far, so the buffer starts at a
+     * multiple of the grid perimeter and only grows if a frontier is
+     * larger than that.
+     */
+    class SearchQueue
+    {
+    public:
+        SearchQueue() : head(0), count(0) {}
+
+        /** empties the queue, with room for at least capacity items */
+        void clear(size_t capacity)
+        {
+            size_t size = 16;
+            while(size < capacity)
+                size *= 2;
+            if(buffer.size() < size)
+                buffer.resize(size, SearchItem(0, 0, NULL));
+            head = count = 0;
+        }
+
+        bool empty() const { return count == 0; }
+
+        void push(const SearchItem &item)
+        {
+            if(count == buffer.size())
+                grow();
+            buffer[(head + count) & (buffer.size() - 1)] = item;
+            count++;
+        }
+
+        SearchItem pop()
+        {
+            const SearchItem item = buffer[head];
+            head = (head + 1) & (buffer.size() - 1);
+            count--;
+            return item;
+        }
+
+    private:
+        /** doubles the buffer, keeping the order of the items */
+        void grow()
+        {
+            std::vector<SearchItem> larger(std::max<size_t>(2 * buffer.size(), 16), SearchItem(0, 0, NULL));
+            for(size_t i = 0; i < count; i++)
+                larger[i] = buffer[(head + i) & (buffer.size() - 1)];
+            buffer.swap(larger);
+            head = 0;
+        }
+
+        /** the size is a power of two */
+        std::vector<SearchItem> buffer;
+        size_t head;
+        size_t count;
+    };
+    SearchQueue searchList;
     
-    boost::multi_array<bool, 2> visited;
+    /** cells which were added to the search list, indexed by y * width + x */
+    boost::dynamic_bitset<> visited;
     boost::multi_array<envire::SurfacePatch *, 2> bestPatchMap;
 
-    void computeTraversability();
-    void setTraversability(size_t x, size_t y);
+    /** top of the patches in bestPatchMap and their measurement count,
+     * with NaN heights for cells without patch. The values of the
+     * previous update are kept for the incremental mode. */
+    std::vector<float> heights, lastHeights;
+    std::vector<float> measurements, lastMeasurements;
+    const TraversabilityGrid *lastGrid;
+    size_t lastCells;
+
+    bool incremental;
+    Statistics statistics;
+
+    friend struct TraversabilityGrassfireKernel;
+
+    void computeTraversability(const boost::dynamic_bitset<> *dirty);
+    void setTraversability(size_t x, size_t y, Statistics &stats);
     void setProbability(size_t x, size_t y);
     void checkRecursive(size_t x, size_t y, envire::SurfacePatch* origin);
     bool determineDrivePlane(base::Vector3d startPos, bool searchSourunding = true);
@@ -1,11 +1,16 @@
 #include "tools/GridAccess.hpp"
+#include "tools/RasterTileCache.hpp"
+#include "tools/PointBVH.hpp"
+#include "tools/Parallel.hpp"
 
 #include "maps/ElevationGrid.hpp"
 #include "maps/Pointcloud.hpp"
 #include "maps/MLSGrid.hpp"
 #include <Eigen/LU>
+#include <boost/thread/mutex.hpp>
 
-#include<kdtree++/kdtree.hpp>
+#include <algorithm>
+#include <cmath>
 
 using namespace envire;
 
@@ -13,65 +18,244 @@ struct GridAccess::GridAccessImpl
 {
     Environment* env;
 
-    GridAccessImpl(Environment* env) : env(env), grid(NULL) {};
+    GridAccessImpl(Environment* env) : env(env), initialized(false), interpolate(true) {};
 
-    std::vector<ElevationGrid*> grids;
+    struct Grid
+    {
+	/** the band is looked up for each query through the const
+	 * getGridData(), since a pointer to it would go stale when the grid
+	 * detaches the band from a copy */
+	const ElevationGrid* grid;
+	/** transforms from the root frame into the grid frame */
+	Transform t;
+	/** z row of the transform from the grid frame into the root frame */
+	Eigen::Vector4d zRow;
+	std::pair<double, bool> nodata;
+	/** bounding box of the grid in the xy plane of the root frame */
+	Eigen::AlignedBox<double, 2> footprint;
+    };
+    std::vector<Grid> grids;
 
-    ElevationGrid* grid;
-    ElevationGrid::ArrayType* gridData;
-    Transform t;
-    double z_offset;
+    /** uniform buckets over the footprints of the grids. The grids which
+     * overlap bucket i are bucketGrids[bucketStart[i]..bucketStart[i+1]),
+     * in the order of the environment. */
+    Eigen::AlignedBox<double, 2> bounds;
+    double bucketSize;
+    size_t bucketsX, bucketsY;
+    std::vector<size_t> bucketStart;
+    std::vector<size_t> bucketGrids;
 
-    bool evalGridPoint(Eigen::Vector3d& position)
+    bool initialized;
+    bool interpolate;
+
+    void addGrid(ElevationGrid* lgrid)
     {
-	Eigen::Vector3d local( t * position );
-	size_t x, y;
-	if( grid->toGrid(local.x(), local.y(), x, y) )
+	Grid g;
+	g.grid = lgrid;
+	g.t = env->relativeTransform( 
+		env->getRootNode(),
+		lgrid->getFrameNode() );
+	const Transform inv = g.t.inverse(Eigen::Isometry);
+	g.zRow = inv.matrix().row(2);
+	g.nodata = lgrid->getNoData(ElevationGrid::ELEVATION);
+
+	const double x0 = lgrid->getOffsetX(), y0 = lgrid->getOffsetY();
+	const double x1 = x0 + lgrid->getCellSizeX() * lgrid->getScaleX();
+	const double y1 = y0 + lgrid->getCellSizeY() * lgrid->getScaleY();
+	for(int i=0;i<4;i++)
 	{
-	    position.z() = (*gridData)[y][x] + z_offset;
-	    return true;
+	    const Eigen::Vector3d corner( i & 1 ? x1 : x0, i & 2 ? y1 : y0, 0 );
+	    g.footprint.extend( (inv * corner).head<2>() );
 	}
-	return false;
+	grids.push_back( g );
     }
 
-    bool getElevation(Eigen::Vector3d& position)
+    void init()
     {
-	// to make this fast, we store the last grid and transform
-	// and see try that one first on the next call
-	if( grid )
+	std::vector<ElevationGrid*> items = env->getItems<ElevationGrid>();
+	for(std::vector<ElevationGrid*>::iterator it = items.begin();it != items.end();it++)
 	{
-	    if( evalGridPoint( position ) )
-		return true;
+	    if( !(*it)->hasBand( ElevationGrid::ELEVATION ) )
+		continue;
+	    addGrid( *it );
+	    bounds.extend( grids.back().footprint );
+	}
 
-	    // this is a shortcut, which will only allow one
-	    // grid to ever be evaluated. 
-	    // TODO: remove this 
-	    return false;
+	// use about four buckets per grid, which keeps the lists short for
+	// maps which are tiled into grids of similar size
+	bucketsX = bucketsY = 0;
+	if( !grids.empty() )
+	{
+	    const Eigen::Vector2d size = bounds.sizes();
+	    bucketSize = std::max( sqrt( size.x() * size.y() / (4.0 * grids.size()) ),
+		    std::max( size.x(), size.y() ) / 1024.0 );
+	    if( bucketSize <= 0 )
+		bucketSize = 1.0;
+	    bucketsX = std::max( (size_t)ceil( size.x() / bucketSize ), (size_t)1 );
+	    bucketsY = std::max( (size_t)ceil( size.y() / bucketSize ), (size_t)1 );
 	}
 
-	if( grids.size() == 0 )
-	    grids = env->getItems<ElevationGrid>();
+	std::vector<std::vector<size_t> > buckets( bucketsX * bucketsY );
+	for(size_t i=0;i<grids.size();i++)
+	{
+	    size_t bx0, by0, bx1, by1;
+	    toBucket( grids[i].footprint.min(), bx0, by0 );
+	    toBucket( grids[i].footprint.max(), bx1, by1 );
+	    for(size_t by=by0;by<=by1;by++)
+		for(size_t bx=bx0;bx<=bx1;bx++)
+		    buckets[by * bucketsX + bx].push_back( i );
+	}
 
-	for(std::vector<ElevationGrid*>::iterator it = grids.begin();it != grids.end();it++)
+	bucketStart.resize( buckets.size() + 1 );
+	bucketStart[0] = 0;
+	for(size_t i=0;i<buckets.size();i++)
 	{
-	    ElevationGrid* lgrid = *it;
-	    Transform lt =
-		env->relativeTransform( 
-			env->getRootNode(),
-			lgrid->getFrameNode() );
+	    bucketGrids.insert( bucketGrids.end(), buckets[i].begin(), buckets[i].end() );
+	    bucketStart[i+1] = bucketGrids.size();
+	}
 
-	    grid = lgrid;
-	    gridData = &grid->getGridData(ElevationGrid::ELEVATION);
-	    t = lt;
-	    z_offset = t.inverse(Eigen::Isometry)(2,3);
+	initialized = true;
+    }
+
+    void toBucket(const Eigen::Vector2d& p, size_t& bx, size_t& by) const
+    {
+	const Eigen::Vector2d b = (p - bounds.min()) / bucketSize;
+	bx = std::min( (size_t)std::max( b.x(), 0.0 ), bucketsX - 1 );
+	by = std::min( (size_t)std::max( b.y(), 0.0 ), bucketsY - 1 );
+    }
+
+    bool isNoData(const Grid& g, double value) const
+    {
+	return g.nodata.second && value == g.nodata.first;
+    }
 
-	    if( evalGridPoint( position ) )
+    bool evalGridPoint(const Grid& g, Eigen::Vector3d& position) const
+    {
+	const Eigen::Vector3d local( g.t * position );
+	const ElevationGrid& grid( *g.grid );
+	const ElevationGrid::ArrayType& data( grid.getGridData( ElevationGrid::ELEVATION ) );
+	size_t x, y;
+	if( !grid.toGrid(local.x(), local.y(), x, y) )
+	    return false;
+
+	double h = data[y][x];
+	if( isNoData( g, h ) )
+	    return false;
+
+	if( interpolate )
+	{
+	    // bilinear interpolation between the cell centers, which falls
+	    // back to the value of the cell if a neighbour has no data
+	    const size_t w = grid.getCellSizeX(), hgt = grid.getCellSizeY();
+	    const double fx = std::min( std::max( (local.x() - grid.getOffsetX()) / grid.getScaleX() - 0.5, 0.0 ), w - 1.0 );
+	    const double fy = std::min( std::max( (local.y() - grid.getOffsetY()) / grid.getScaleY() - 0.5, 0.0 ), hgt - 1.0 );
+	    const size_t x0 = std::min( (size_t)fx, w - 1 ), y0 = std::min( (size_t)fy, hgt - 1 );
+	    const size_t x1 = std::min( x0 + 1, w - 1 ), y1 = std::min( y0 + 1, hgt - 1 );
+	    const double ax = fx - x0, ay = fy - y0;
+	    const double h00 = data[y0][x0], h10 = data[y0][x1], h01 = data[y1][x0], h11 = data[y1][x1];
+	    if( !isNoData( g, h00 ) && !isNoData( g, h10 ) && !isNoData( g, h01 ) && !isNoData( g, h11 ) )
+		h = (1.0 - ay) * ((1.0 - ax) * h00 + ax * h10) + ay * ((1.0 - ax) * h01 + ax * h11);
+	}
+
+	position.z() = g.zRow.dot( Eigen::Vector4d( local.x(), local.y(), h, 1.0 ) );
+	return true;
+    }
+
+    bool evalGrids(Eigen::Vector3d& position) const
+    {
+	if( grids.empty() || !bounds.contains( (Eigen::Vector2d)position.head<2>() ) )
+	    return false;
+
+	size_t bx, by;
+	toBucket( position.head<2>(), bx, by );
+	const size_t bucket = by * bucketsX + bx;
+	for(size_t i=bucketStart[bucket];i<bucketStart[bucket+1];i++)
+	{
+	    const Grid& g( grids[bucketGrids[i]] );
+	    if( g.footprint.contains( (Eigen::Vector2d)position.head<2>() ) && evalGridPoint( g, position ) )
 		return true;
 	}
+	return false;
+    }
 
+    struct Raster
+    {
+	boost::shared_ptr<RasterTileCache> cache;
+	Transform t;
+    };
+    std::vector<Raster> rasters;
+    /** the tile caches are modified by the queries */
+    boost::mutex rasterMutex;
+
+    void addRaster(const std::string& path, int band, size_t memoryBudget)
+    {
+	Raster raster;
+	raster.cache.reset( new RasterTileCache( path, band, memoryBudget ) );
+	raster.t = raster.cache->getTransform().inverse( Eigen::Isometry );
+	rasters.push_back( raster );
+    }
+
+    bool evalRasters(Eigen::Vector3d& position)
+    {
+	if( rasters.empty() )
+	    return false;
+
+	boost::mutex::scoped_lock lock( rasterMutex );
+	for(std::vector<Raster>::iterator it = rasters.begin(); it != rasters.end(); it++)
+	{
+	    Eigen::Vector3d local( it->t * position );
+	    size_t x, y;
+	    if( it->cache->toGrid( local.x(), local.y(), x, y ) )
+	    {
+		const double value = it->cache->get( x, y );
+		double nodata;
+		if( it->cache->getNoData( nodata ) && value == nodata )
+		    continue;
+		position.z() = value;
+		return true;
+	    }
+	}
 	return false;
     }
 
+    bool getElevation(Eigen::Vector3d& position)
+    {
+	if( !initialized )
+	    init();
+
+	return evalGrids( position ) || evalRasters( position );
+    }
+
+    struct ElevationBatch
+    {
+	GridAccessImpl* impl;
+	std::vector<Eigen::Vector3d>* positions;
+	std::vector<char>* found;
+
+	void operator()( size_t begin, size_t end )
+	{
+	    for( size_t i=begin; i<end; i++ )
+		(*found)[i] = impl->evalGrids( (*positions)[i] ) || impl->evalRasters( (*positions)[i] );
+	}
+    };
+
+    size_t getElevations(std::vector<Eigen::Vector3d>& positions, std::vector<bool>& found)
+    {
+	if( !initialized )
+	    init();
+
+	// the threads write to separate bytes, since the elements of
+	// vector<bool> share memory
+	std::vector<char> result( positions.size() );
+	ElevationBatch batch;
+	batch.impl = this;
+	batch.positions = &positions;
+	batch.found = &result;
+	parallelFor( 0, positions.size(), batch, 256 );
+
+	found.assign( result.begin(), result.end() );
+	return std::count( result.begin(), result.end(), 1 );
+    }
 };
 
 GridAccess::GridAccess(Environment* env)
@@ -84,87 +268,180 @@ bool GridAccess::getElevation(Eigen::Vector3d& position)
     return impl->getElevation( position );
 }
 
+size_t GridAccess::getElevations(std::vector<Eigen::Vector3d>& positions, std::vector<bool>& found)
+{
+    return impl->getElevations( positions, found );
+}
+
+void GridAccess::setInterpolation(bool enable)
+{
+    impl->interpolate = enable;
+}
+
+void GridAccess::addRaster(const std::string& path, int band, size_t memoryBudget)
+{
+    impl->addRaster( path, band, memoryBudget );
+}
+
 
 
 struct PointcloudAccess::PointcloudAccessImpl
 {
     Environment* env;
 
-    struct TreeNode
+    /** the bounding volume hierarchy of a pointcloud, which is shared with
+     * the other users of the pointcloud, and the transformation of the
+     * pointcloud into the root frame */
+    struct Cloud
     {
-	typedef double value_type;
-
-	TreeNode(const Eigen::Vector3d& point) : point(point) {};
-	Eigen::Vector3d point;
-
-	inline value_type operator[](size_t n) const
-	{
-	    return point[n];
-	}
+	boost::shared_ptr<const PointBVH> bvh;
+	Transform t;
     };
-
-    typedef KDTree::KDTree<2, TreeNode> tree_type;
-
-    tree_type kdtree;
+    std::vector<Cloud, Eigen::aligned_allocator<Cloud> > clouds;
 
     PointcloudAccessImpl(Environment* env) 
 	: env(env)
     {
-	fillTree(env);
-	std::cout << "kdtree inserted points: " << kdtree.size() << std::endl;
+	size_t points = fillClouds(env);
+	std::cout << "bvh inserted points: " << points << std::endl;
     };
 
-    void fillTree(Environment* env)
+    /** gets the hierarchies of all pointclouds, which are built here if
+     * they are not cached yet, so that the queries don't modify the
+     * pointclouds. 
+     * @return the number of points */
+    size_t fillClouds(Environment* env)
     {
+	size_t points = 0;
 	std::vector<Pointcloud*> pcs = env->getItems<Pointcloud>();
 	for(std::vector<Pointcloud*>::iterator it=pcs.begin();it!=pcs.end();it++)
 	{
-	    fillTree( *it );
+	    Pointcloud* pc = *it;
+	    if( pc->vertices.empty() )
+		continue;
+
+	    Cloud cloud;
+	    cloud.bvh = pc->getBVH();
+	    cloud.t =
+		env->relativeTransform( 
+			pc->getFrameNode(),
+			env->getRootNode() );
+	    clouds.push_back( cloud );
+	    points += cloud.bvh->size();
 	}
-	kdtree.optimize();
+	return points;
     }
 
-    void fillTree(Pointcloud* pc)
+    /** bounding box in the xy plane of the root frame of a box in the
+     * frame of the pointcloud */
+    static Eigen::AlignedBox<double, 2> rootFootprint( const Transform& t, const PointBVH::Box& box )
     {
-	Transform t =
-	    env->relativeTransform( 
-		    pc->getFrameNode(),
-		    env->getRootNode() );
+	const Eigen::Vector2d center = (t * box.center()).head<2>();
+	const Eigen::Vector2d half = (t.linear().cwiseAbs() * box.sizes() * 0.5).head<2>();
+	return Eigen::AlignedBox<double, 2>( center - half, center + half );
+    }
+
+    /** finds the closest point in the xy plane of the root frame, which is
+     * closer than the current best distance */
+    struct NearestVisitor
+    {
+	const Transform* t;
+	Eigen::Vector2d q;
+	double best;
+	bool found;
+	Eigen::Vector3d candidate, result;
 
-	for(std::vector<Eigen::Vector3d>::iterator it=pc->vertices.begin();it!=pc->vertices.end();it++)
+	PointBVH::Overlap visit( const PointBVH::Box& box ) const
 	{
-	    kdtree.insert( TreeNode(t * (*it)) );
+	    return rootFootprint( *t, box ).squaredExteriorDistance( q ) >= best ? 
+		PointBVH::OUTSIDE : PointBVH::INTERSECTS;
 	}
-    }
 
-    bool getElevation(Eigen::Vector3d& position, double xythresh, double zpos, double zthresh  )
+	bool test( const Eigen::Vector3d& point )
+	{
+	    candidate = *t * point;
+	    return (candidate.head<2>() - q).squaredNorm() < best;
+	}
+
+	void operator()( size_t index, const Eigen::Vector3d& point )
+	{
+	    best = (candidate.head<2>() - q).squaredNorm();
+	    result = candidate;
+	    found = true;
+	}
+    };
+
+    /** finds the first point in the xy range of the root frame, which is
+     * within zthresh of zpos */
+    struct FirstInRangeVisitor
     {
-	std::vector<TreeNode> nodes;
+	const Transform* t;
+	Eigen::AlignedBox<double, 2> range;
+	double zpos, zthresh;
+	bool found;
+	Eigen::Vector3d candidate, result;
 
-	kdtree.find_within_range( TreeNode( position ), xythresh, std::back_insert_iterator<std::vector<TreeNode> >(nodes) );
-	for(std::vector<TreeNode>::iterator it=nodes.begin();it!=nodes.end();it++)
+	PointBVH::Overlap visit( const PointBVH::Box& box ) const
 	{
-	    TreeNode &node(*it);
-	    if( abs(node.point.z() - zpos) < zthresh )
-	    {
-		// for now return the first node found in range
-		position = node.point;
+	    return found || rootFootprint( *t, box ).intersection( range ).isEmpty() ? 
+		PointBVH::OUTSIDE : PointBVH::INTERSECTS;
+	}
 
-		return true;
-	    }
+	bool test( const Eigen::Vector3d& point )
+	{
+	    if( found )
+		return false;
+	    candidate = *t * point;
+	    return range.contains( candidate.head<2>() ) && fabs(candidate.z() - zpos) < zthresh;
+	}
+
+	void operator()( size_t index, const Eigen::Vector3d& point )
+	{
+	    result = candidate;
+	    found = true;
+	}
+    };
+
+    bool getElevation(Eigen::Vector3d& position, double xythresh, double zpos, double zthresh  ) const
+    {
+	FirstInRangeVisitor first;
+	first.range = Eigen::AlignedBox<double, 2>( 
+		position.head<2>() - Eigen::Vector2d::Constant( xythresh ),
+		position.head<2>() + Eigen::Vector2d::Constant( xythresh ) );
+	first.zpos = zpos;
+	first.zthresh = zthresh;
+	first.found = false;
+	for( size_t i=0; i<clouds.size() && !first.found; i++ )
+	{
+	    first.t = &clouds[i].t;
+	    clouds[i].bvh->traverse( first );
+	}
+
+	if( first.found )
+	{
+	    // for now return the first node found in range
+	    position = first.result;
+	    return true;
 	}
 
 	return false;
     }
 
-    bool getElevation(Eigen::Vector3d& position, double threshold )
+    bool getElevation(Eigen::Vector3d& position, double threshold ) const
     {
-	std::pair<tree_type::const_iterator,double> found 
-	    = kdtree.find_nearest( TreeNode( position ), threshold );
+	NearestVisitor nearest;
+	nearest.q = position.head<2>();
+	nearest.best = threshold * threshold;
+	nearest.found = false;
+	for( size_t i=0; i<clouds.size(); i++ )
+	{
+	    nearest.t = &clouds[i].t;
+	    clouds[i].bvh->traverse( nearest );
+	}
 
-	if( found.first != kdtree.end() )
+	if( nearest.found )
 	{
-	    position.z() = (found.first)->point.z();
+	    position.z() = nearest.result.z();
 	    return true;
 	}
 	else 
@@ -172,6 +449,36 @@ struct PointcloudAccess::PointcloudAccessImpl
 	    return false;
 	}
     }
+
+    struct ElevationBatch
+    {
+	const PointcloudAccessImpl* impl;
+	std::vector<Eigen::Vector3d>* positions;
+	std::vector<char>* found;
+	double threshold;
+
+	void operator()( size_t begin, size_t end )
+	{
+	    for( size_t i=begin; i<end; i++ )
+		(*found)[i] = impl->getElevation( (*positions)[i], threshold );
+	}
+    };
+
+    size_t getElevations(std::vector<Eigen::Vector3d>& positions, std::vector<bool>& found, double threshold ) const
+    {
+	// the threads write to separate bytes, since the elements of
+	// vector<bool> share memory
+	std::vector<char> result( positions.size() );
+	ElevationBatch batch;
+	batch.impl = this;
+	batch.positions = &positions;
+	batch.found = &result;
+	batch.threshold = threshold;
+	parallelFor( 0, positions.size(), batch, 256 );
+
+	found.assign( result.begin(), result.end() );
+	return std::count( result.begin(), result.end(), 1 );
+    }
 };
 
 PointcloudAccess::PointcloudAccess(Environment* env)
@@ -189,6 +496,11 @@ bool PointcloudAccess::getElevation(Eigen::Vector3d& position, double xythresh,
     return impl->getElevation( position, xythresh, zpos, zthresh );
 }
 
+size_t PointcloudAccess::getElevations(std::vector<Eigen::Vector3d>& positions, std::vector<bool>& found, double threshold)
+{
+    return impl->getElevations( positions, found, threshold );
+}
+
 
 
 struct MLSAccess::MLSAccessImpl
@@ -16,9 +16,37 @@ namespace envire
 	 * map found at the relevant coordinates.  This method does some
 	 * caching of the envire structure. The current implementation and
 	 * hence will not work well with dynamically changing environment.
+	 *
+	 * All elevation grids are considered, and if several grids cover the
+	 * position, the first one in the environment which has data is used.
+	 * The grids are looked up through a uniform index over their
+	 * footprints in the root frame.
 	 */
 	bool getElevation(Eigen::Vector3d& position);
 
+	/** batched version of getElevation, which processes the positions on
+	 * multiple threads. found[i] is set to true if positions[i] was
+	 * updated.
+	 *
+	 * @return the number of positions which were found
+	 */
+	size_t getElevations(std::vector<Eigen::Vector3d>& positions, std::vector<bool>& found);
+
+	/** if enabled (the default), the elevation is interpolated bilinearly
+	 * between the cell centers. Otherwise the value of the cell which
+	 * contains the position is used. */
+	void setInterpolation(bool enable);
+
+	/** add an elevation raster file, which is used for positions that are
+	 * not covered by the grids in the environment. The file is read lazily
+	 * in tiles (see RasterTileCache), so it does not need to fit into
+	 * memory. The raster is positioned in the root frame using its
+	 * geotransform.
+	 *
+	 * @param memoryBudget - maximum memory in bytes used for caching tiles
+	 */
+	void addRaster(const std::string& path, int band = 1, size_t memoryBudget = 256 * 1024 * 1024);
+
     private:
 	struct GridAccessImpl;
 	boost::shared_ptr<GridAccessImpl> impl;
@@ -32,6 +60,14 @@ namespace envire
 	bool getElevation(Eigen::Vector3d& position, double threshold = 0.05);
 	bool getElevation(Eigen::Vector3d& position, double xythresh, double zpos, double zthresh  );
 
+	/** batched version of getElevation( position, threshold ), which
+	 * processes the positions on multiple threads. found[i] is set to true
+	 * if positions[i] was updated.
+	 *
+	 * @return the number of positions which were found
+	 */
+	size_t getElevations(std::vector<Eigen::Vector3d>& positions, std::vector<bool>& found, double threshold = 0.05);
+
     private:
 	struct PointcloudAccessImpl;
 	boost::shared_ptr<PointcloudAccessImpl> impl;
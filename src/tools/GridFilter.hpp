@@ -0,0 +1,193 @@
+#ifndef __ENVIRE_TOOLS_GRIDFILTER_HPP__
+#define __ENVIRE_TOOLS_GRIDFILTER_HPP__
+
+#include <envire/tools/Parallel.hpp>
+
+#include <boost/multi_array.hpp>
+#include <boost/cstdint.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+// filters on 2d grid data, which run in O(cells) independent of the
+// filter size
+
+namespace envire
+{
+    namespace detail
+    {
+	/** horizontal pass of the box filter, which computes the sums and
+	 * the number of valid cells in the row windows using prefix sums */
+	template <class T>
+	struct BoxFilterRows
+	{
+	    const boost::multi_array<T,2>* input;
+	    std::vector<double>* sums;
+	    std::vector<boost::uint32_t>* counts;
+	    int before, after;
+	    const T* nodata;
+
+	    void operator()( size_t begin, size_t end )
+	    {
+		const int width = input->shape()[1];
+		std::vector<double> psum( width + 1 );
+		std::vector<boost::uint32_t> pcount( width + 1 );
+		for( size_t y=begin; y<end; y++ )
+		{
+		    const T* row = input->data() + y * width;
+		    psum[0] = 0; pcount[0] = 0;
+		    for( int x=0; x<width; x++ )
+		    {
+			const bool valid = !nodata || row[x] != *nodata;
+			psum[x+1] = psum[x] + (valid ? static_cast<double>( row[x] ) : 0.0);
+			pcount[x+1] = pcount[x] + valid;
+		    }
+
+		    double* s = &(*sums)[y * width];
+		    boost::uint32_t* c = &(*counts)[y * width];
+		    for( int x=0; x<width; x++ )
+		    {
+			const int lo = std::min( std::max( x - before, 0 ), width );
+			const int hi = std::max( std::min( x + after + 1, width ), lo );
+			s[x] = psum[hi] - psum[lo];
+			c[x] = pcount[hi] - pcount[lo];
+		    }
+		}
+	    }
+	};
+
+	/** vertical pass of the box filter, which slides a window of row sums
+	 * over each block of rows */
+	template <class T>
+	struct BoxFilterColumns
+	{
+	    const boost::multi_array<T,2>* input;
+	    boost::multi_array<T,2>* output;
+	    const std::vector<double>* sums;
+	    const std::vector<boost::uint32_t>* counts;
+	    int before, after;
+	    const T* nodata;
+
+	    void addRow( int y, std::vector<double>& colSum, std::vector<boost::int64_t>& colCount, int sign ) const
+	    {
+		const size_t width = colSum.size();
+		const double* s = &(*sums)[y * width];
+		const boost::uint32_t* c = &(*counts)[y * width];
+		for( size_t x=0; x<width; x++ )
+		{
+		    colSum[x] += sign * s[x];
+		    colCount[x] += sign * static_cast<boost::int64_t>( c[x] );
+		}
+	    }
+
+	    void operator()( size_t begin, size_t end )
+	    {
+		const int height = input->shape()[0];
+		const size_t width = input->shape()[1];
+		std::vector<double> colSum( width );
+		std::vector<boost::int64_t> colCount( width );
+
+		// the window of the first row in the block
+		const int first = begin;
+		for( int y=std::max( first - before, 0 ); y<std::min( first + after + 1, height ); y++ )
+		    addRow( y, colSum, colCount, 1 );
+
+		for( int y=begin; y<(int)end; y++ )
+		{
+		    if( y > first )
+		    {
+			if( y + after >= 0 && y + after < height )
+			    addRow( y + after, colSum, colCount, 1 );
+			if( y - before - 1 >= 0 && y - before - 1 < height )
+			    addRow( y - before - 1, colSum, colCount, -1 );
+		    }
+
+		    const T* in = input->data() + y * width;
+		    T* out = output->data() + y * width;
+		    for( size_t x=0; x<width; x++ )
+		    {
+			if( nodata && in[x] == *nodata )
+			    out[x] = *nodata;
+			else if( colCount[x] > 0 )
+			    out[x] = static_cast<T>( colSum[x] / colCount[x] );
+			else
+			    out[x] = nodata ? *nodata : T();
+		    }
+		}
+	    }
+	};
+    }
+
+    /**
+     * Mean filter over a rectangular window. The output cell (x, y) is the
+     * mean of the input cells in [x - before, x + after] x [y - before, y +
+     * after], where only cells inside the grid are used.
+     *
+     * The filter is separated into a horizontal and a vertical pass of
+     * running sums, so that the cost is independent of the window size.
+     * Both passes are processed on multiple threads.
+     *
+     * If nodata is given, cells with that value are not part of the mean,
+     * and stay nodata in the output. Cells which have no valid cells in
+     * their window are set to nodata, or T() otherwise.
+     *
+     * Input and output need to have the same shape, but must not be the
+     * same array.
+     */
+    template <class T>
+    void boxFilter( const boost::multi_array<T,2>& input, boost::multi_array<T,2>& output,
+	    int before, int after, const T* nodata = NULL )
+    {
+	if( input.shape()[0] != output.shape()[0] || input.shape()[1] != output.shape()[1] )
+	    throw std::runtime_error("boxFilter: input and output have different sizes.");
+	if( &input == &output )
+	    throw std::runtime_error("boxFilter: input and output can not be the same.");
+
+	const size_t height = input.shape()[0];
+	const size_t width = input.shape()[1];
+
+	// empty window
+	if( before + after < 0 )
+	{
+	    std::fill( output.data(), output.data() + output.num_elements(), nodata ? *nodata : T() );
+	    return;
+	}
+
+	const size_t minRows = std::max( (size_t)(64 * 1024) / std::max( width, (size_t)1 ), (size_t)1 );
+
+	std::vector<double> sums( width * height );
+	std::vector<boost::uint32_t> counts( width * height );
+
+	detail::BoxFilterRows<T> rows;
+	rows.input = &input;
+	rows.sums = &sums;
+	rows.counts = &counts;
+	rows.before = before;
+	rows.after = after;
+	rows.nodata = nodata;
+	parallelFor( 0, height, rows, minRows );
+
+	detail::BoxFilterColumns<T> columns;
+	columns.input = &input;
+	columns.output = &output;
+	columns.sums = &sums;
+	columns.counts = &counts;
+	columns.before = before;
+	columns.after = after;
+	columns.nodata = nodata;
+	parallelFor( 0, height, columns, minRows );
+    }
+
+    /** symmetric mean filter with a window of size x size cells, where size
+     * should be odd */
+    template <class T>
+    void meanFilter( const boost::multi_array<T,2>& input, boost::multi_array<T,2>& output,
+	    size_t size, const T* nodata = NULL )
+    {
+	const int half = size / 2;
+	boxFilter( input, output, half, half, nodata );
+    }
+}
+
+#endif
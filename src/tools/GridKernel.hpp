@@ -0,0 +1,167 @@
+#ifndef __ENVIRE_TOOLS_GRIDKERNEL_HPP__
+#define __ENVIRE_TOOLS_GRIDKERNEL_HPP__
+
+#include <envire/tools/Parallel.hpp>
+
+#include <boost/multi_array.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+// loops over the cells of 2d grid data. The grid bands are stored as
+// [y][x], so all the loops run with x in the inner loop. The rows are
+// split into blocks, which can be processed on multiple threads.
+//
+// The loops are not tiled: the kernels either touch only their own cell,
+// or, like MLSSlope, the cells of the neighbouring rows. In row order each
+// cache line is loaded once, and the three rows of a 3x3 neighbourhood
+// stay in the cache (96KB for 4096 doubles), so tiles would only add
+// blocks with partial rows without saving any memory traffic. The rays of
+// GridIllumination cross the whole grid towards the light, which tiles
+// would not keep local either.
+
+namespace envire
+{
+    namespace detail
+    {
+	/** minimum number of cells in a block of rows, so that small grids
+	 * are not split up */
+	inline size_t getGridKernelMinRows( size_t width )
+	{
+	    return std::max( (size_t)(64 * 1024) / std::max( width, (size_t)1 ), (size_t)1 );
+	}
+
+	template <class F>
+	struct CellKernel
+	{
+	    F* f;
+	    size_t x0, x1;
+
+	    void operator()( size_t begin, size_t end )
+	    {
+		for( size_t y=begin; y<end; y++ )
+		    for( size_t x=x0; x<x1; x++ )
+			(*f)( x, y );
+	    }
+	};
+
+	template <class T, class U, class F>
+	struct TransformKernel
+	{
+	    const boost::multi_array<T,2>* input;
+	    boost::multi_array<U,2>* output;
+	    F* f;
+
+	    void operator()( size_t begin, size_t end )
+	    {
+		const size_t width = input->shape()[1];
+		const T* in = input->data() + begin * width;
+		U* out = output->data() + begin * width;
+		const size_t n = (end - begin) * width;
+		for( size_t i=0; i<n; i++ )
+		    out[i] = (*f)( in[i] );
+	    }
+	};
+
+	template <class T, class U, class V, class F>
+	struct ZipKernel
+	{
+	    const boost::multi_array<T,2>* a;
+	    const boost::multi_array<U,2>* b;
+	    boost::multi_array<V,2>* output;
+	    F* f;
+
+	    void operator()( size_t begin, size_t end )
+	    {
+		const size_t width = a->shape()[1];
+		const T* ia = a->data() + begin * width;
+		const U* ib = b->data() + begin * width;
+		V* out = output->data() + begin * width;
+		const size_t n = (end - begin) * width;
+		for( size_t i=0; i<n; i++ )
+		    out[i] = (*f)( ia[i], ib[i] );
+	    }
+	};
+
+	template <class T, class U>
+	void checkSameShape( const boost::multi_array<T,2>& a, const boost::multi_array<U,2>& b, const char* name )
+	{
+	    if( a.shape()[0] != b.shape()[0] || a.shape()[1] != b.shape()[1] )
+		throw std::runtime_error(std::string(name) + ": grids have different sizes.");
+	}
+    }
+
+    /**
+     * Calls f( x, y ) for each cell in [x0, x1) x [y0, y1), row by row.
+     *
+     * With threads != 1, blocks of rows are processed concurrently on the
+     * same f, so f must be safe to call from multiple threads for different
+     * cells. The order of the calls is only defined for a single thread.
+     *
+     * @param threads - number of threads to use, 0 for getParallelThreads()
+     */
+    template <class F>
+    void forEachCell( size_t x0, size_t y0, size_t x1, size_t y1, F& f, size_t threads = 1 )
+    {
+	if( x1 <= x0 || y1 <= y0 )
+	    return;
+
+	detail::CellKernel<F> kernel;
+	kernel.f = &f;
+	kernel.x0 = x0;
+	kernel.x1 = x1;
+	parallelFor( y0, y1, kernel, detail::getGridKernelMinRows( x1 - x0 ), threads );
+    }
+
+    /** calls f( x, y ) for all cells of a width x height grid */
+    template <class F>
+    void forEachCell( size_t width, size_t height, F& f, size_t threads = 1 )
+    {
+	forEachCell( 0, 0, width, height, f, threads );
+    }
+
+    /** calls f( x, y ) for all cells of the given band */
+    template <class T, class F>
+    void forEachCell( const boost::multi_array<T,2>& data, F& f, size_t threads = 1 )
+    {
+	forEachCell( data.shape()[1], data.shape()[0], f, threads );
+    }
+
+    /**
+     * Sets output[y][x] = f( input[y][x] ) for all cells. Input and output
+     * may be the same array.
+     */
+    template <class T, class U, class F>
+    void transformCells( const boost::multi_array<T,2>& input, boost::multi_array<U,2>& output, F f, size_t threads = 1 )
+    {
+	detail::checkSameShape( input, output, "transformCells" );
+
+	detail::TransformKernel<T,U,F> kernel;
+	kernel.input = &input;
+	kernel.output = &output;
+	kernel.f = &f;
+	parallelFor( 0, input.shape()[0], kernel, detail::getGridKernelMinRows( input.shape()[1] ), threads );
+    }
+
+    /**
+     * Sets output[y][x] = f( a[y][x], b[y][x] ) for all cells. The output
+     * may be the same array as one of the inputs.
+     */
+    template <class T, class U, class V, class F>
+    void zipCells( const boost::multi_array<T,2>& a, const boost::multi_array<U,2>& b,
+	    boost::multi_array<V,2>& output, F f, size_t threads = 1 )
+    {
+	detail::checkSameShape( a, b, "zipCells" );
+	detail::checkSameShape( a, output, "zipCells" );
+
+	detail::ZipKernel<T,U,V,F> kernel;
+	kernel.a = &a;
+	kernel.b = &b;
+	kernel.output = &output;
+	kernel.f = &f;
+	parallelFor( 0, a.shape()[0], kernel, detail::getGridKernelMinRows( a.shape()[1] ), threads );
+    }
+}
+
+#endif
@@ -6,6 +6,7 @@
 #include <boost/iterator/iterator_facade.hpp>
 #include <boost/pool/object_pool.hpp>
 #include <boost/array.hpp>
+#include <new>
 
 namespace envire
 {
@@ -26,6 +27,19 @@ class ListGrid
 	Item** pthis;
     };
 
+    struct ItemPool : public boost::object_pool<Item>
+    {
+	/** allocates n consecutive items, which can be freed individually
+	 * with destroy(). The items are not constructed. */
+	Item* mallocBlock( size_t n )
+	{
+	    Item* items = static_cast<Item*>( this->store().ordered_malloc( n ) );
+	    if( !items )
+		throw std::bad_alloc();
+	    return items;
+	}
+    };
+
 public:
     template <class T, class TV>
     class iterator_base : public boost::iterator_facade<
@@ -64,11 +78,11 @@ public:
     typedef iterator_base<const Item, const C> const_iterator;
 
 public:
-    ListGrid():mem_pool(new boost::object_pool<Item>()){}
+    ListGrid():mem_pool(new ItemPool()){}
 
     ListGrid( size_t sizeX, size_t sizeY )
 	: cells( boost::extents[sizeX][sizeY]),
-	  mem_pool(new boost::object_pool<Item>())
+	  mem_pool(new ItemPool())
     {
     }
 
@@ -77,6 +91,7 @@ public:
     }
 
     ListGrid( const ListGrid<C>& other )
+	: mem_pool(new ItemPool())
     {
 	// use the assignment operator
 	this->operator=( other );
@@ -156,7 +171,7 @@ public:
                     {
                         Item *cur = p;
                         p = cur->next;
-                        mem_pool->free(cur);
+                        mem_pool->destroy(cur);
                     }
                 }
                 else
@@ -207,8 +222,7 @@ public:
      */
     void insertHead( size_t xi, size_t yi, const C& value )
     {
-	Item* n_item = mem_pool->malloc();
-	static_cast<C&>(*n_item).operator=(value);
+	Item* n_item = construct( mem_pool->malloc(), value );
 	n_item->next = cells[xi][yi];
 	n_item->pthis = &cells[xi][yi];
 	if( n_item->next )
@@ -230,8 +244,7 @@ public:
 	    it++;
 	}
 
-	Item* n_item = mem_pool->malloc();
-	static_cast<C&>(*n_item).operator=(value);
+	Item* n_item = construct( mem_pool->malloc(), value );
 	n_item->next = NULL;
 
 	if( last != endCell() )
@@ -246,6 +259,40 @@ public:
 	}
     }
 
+    /** Consecutive elements, which are allocated with allocate() */
+    class Block
+    {
+	friend class ListGrid<C>;
+	Item* items;
+    public:
+	Block() : items( NULL ) {}
+    };
+
+    /** Allocates n consecutive elements, which can be used with setCell()
+     * to fill empty cells. The elements belong to the grid, and can be
+     * removed individually with erase(). Each of the elements needs to be
+     * set with setCell() before the grid is cleared or destroyed.
+     */
+    Block allocate( size_t n )
+    {
+	Block block;
+	if( n )
+	    block.items = mem_pool->mallocBlock( n );
+	return block;
+    }
+
+    /** Sets the list of the empty cell at \c xi and \c yi to element i of
+     * the block, which is set to value. Different cells may be set
+     * concurrently.
+     */
+    void setCell( size_t xi, size_t yi, const Block& block, size_t i, const C& value )
+    {
+	Item* item = construct( block.items + i, value );
+	item->next = NULL;
+	item->pthis = &cells[xi][yi];
+	cells[xi][yi] = item;
+    }
+
     /** Removes the patch pointed-to by \c position */
     iterator erase( iterator position )
     {
@@ -256,7 +303,7 @@ public:
 	if( p->next )
 	    p->next->pthis = p->pthis; 
 
-	mem_pool->free(p);
+	mem_pool->destroy(p);
 
 	return res; 
     }
@@ -265,16 +312,25 @@ public:
     {
 
     	if (mem_pool) delete mem_pool;
-    	mem_pool = new boost::object_pool<Item>();
+    	mem_pool = new ItemPool();
 
     	memset(cells.origin(), 0,sizeof(Item*)*cells.num_elements());
 
     }
 
 protected:
+    /** constructs the item in memory from the pool, which is destroyed
+     * together with the pool or with destroy() */
+    static Item* construct( Item* item, const C& value )
+    {
+	if( !item )
+	    throw std::bad_alloc();
+	return new (item) Item( value );
+    }
+
     typedef boost::multi_array<Item*,2> ArrayType; 
     ArrayType cells;
-    boost::object_pool<Item>* mem_pool;
+    ItemPool* mem_pool;
 };
 
 }
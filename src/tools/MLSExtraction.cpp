@@ -0,0 +1,225 @@
+#include "MLSExtraction.hpp"
+#include "Parallel.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace envire;
+
+namespace envire
+{
+    /** processes blocks of tiles for one of the passes */
+    struct MLSExtractionKernel
+    {
+	enum Pass { COUNT, FILL, ELEVATION };
+
+	Pass pass;
+	const MLSExtraction* extraction;
+	const Eigen::Affine3d* gridToFrame;
+
+	/** dirty flag of each tile, set in the COUNT pass */
+	std::vector<char>* dirty;
+	/** number of points of each tile, set in the COUNT pass */
+	std::vector<size_t>* counts;
+
+	const std::vector<Eigen::Vector3d>* oldPoints;
+	const std::vector<size_t>* oldOffsets;
+	std::vector<Eigen::Vector3d>* points;
+	const std::vector<size_t>* offsets;
+
+	boost::multi_array<double, 2>* elevation;
+
+	void operator()( size_t begin, size_t end )
+	{
+	    for( size_t tile=begin; tile<end; tile++ )
+	    {
+		switch( pass )
+		{
+		    case COUNT:
+			(*dirty)[tile] = !oldOffsets || extraction->isDirty( tile );
+			(*counts)[tile] = (*dirty)[tile] ?
+			    extraction->getTilePoints( tile, *gridToFrame, NULL ) :
+			    (*oldOffsets)[tile+1] - (*oldOffsets)[tile];
+			break;
+
+		    case FILL:
+			if( (*offsets)[tile] == (*offsets)[tile+1] )
+			    break;
+			if( (*dirty)[tile] )
+			    extraction->getTilePoints( tile, *gridToFrame, &(*points)[(*offsets)[tile]] );
+			else
+			    std::copy( oldPoints->begin() + (*oldOffsets)[tile],
+				    oldPoints->begin() + (*oldOffsets)[tile+1],
+				    points->begin() + (*offsets)[tile] );
+			break;
+
+		    case ELEVATION:
+			if( extraction->isDirty( tile ) )
+			{
+			    size_t x0, y0, x1, y1;
+			    extraction->getTileCells( tile, x0, y0, x1, y1 );
+			    for( size_t y=y0; y<y1; y++ )
+			    {
+				for( size_t x=x0; x<x1; x++ )
+				{
+				    const SurfacePatch* patch = extraction->getElevationPatch( x, y );
+				    if( patch )
+					(*elevation)[y][x] = patch->mean;
+				}
+			    }
+			}
+			break;
+		}
+	    }
+	}
+    };
+}
+
+MLSExtraction::MLSExtraction( const MLSGrid& grid, size_t tileCells )
+    : grid( grid ), tileCells( std::max( tileCells, (size_t)1 ) ),
+    selection( ALL_PATCHES ), verticalDistance( 0.1 ), minUpdateIdx( 0 )
+{
+    tilesX = (grid.getCellSizeX() + this->tileCells - 1) / this->tileCells;
+    tilesY = (grid.getCellSizeY() + this->tileCells - 1) / this->tileCells;
+}
+
+void MLSExtraction::getTileCells( size_t tile, size_t& x0, size_t& y0, size_t& x1, size_t& y1 ) const
+{
+    x0 = (tile % tilesX) * tileCells;
+    y0 = (tile / tilesX) * tileCells;
+    x1 = std::min( x0 + tileCells, grid.getCellSizeX() );
+    y1 = std::min( y0 + tileCells, grid.getCellSizeY() );
+}
+
+bool MLSExtraction::isDirty( size_t tile ) const
+{
+    if( minUpdateIdx == 0 )
+	return true;
+
+    size_t x0, y0, x1, y1;
+    getTileCells( tile, x0, y0, x1, y1 );
+    for( size_t y=y0; y<y1; y++ )
+	for( size_t x=x0; x<x1; x++ )
+	    for( MLSGrid::const_iterator it = grid.beginCell( x, y ); it != grid.endCell(); it++ )
+		if( it->update_idx >= minUpdateIdx )
+		    return true;
+
+    return false;
+}
+
+const SurfacePatch* MLSExtraction::getElevationPatch( size_t x, size_t y ) const
+{
+    const SurfacePatch* top = NULL;
+    for( MLSGrid::const_iterator it = grid.beginCell( x, y ); it != grid.endCell(); it++ )
+    {
+	if( selection == HORIZONTAL_PATCHES && !it->isHorizontal() )
+	    continue;
+	if( !top || *top < *it )
+	    top = &(*it);
+    }
+    return top;
+}
+
+size_t MLSExtraction::getTilePoints( size_t tile, const Eigen::Affine3d& gridToFrame, Eigen::Vector3d* out ) const
+{
+    const float vertical_distance = verticalDistance;
+
+    size_t x0, y0, x1, y1;
+    getTileCells( tile, x0, y0, x1, y1 );
+
+    size_t count = 0;
+    for( size_t y=y0; y<y1; y++ )
+    {
+	for( size_t x=x0; x<x1; x++ )
+	{
+	    MLSGrid::const_iterator begin = grid.beginCell( x, y ), end = grid.endCell();
+	    if( begin == end )
+		continue;
+	    if( selection == TOP_PATCH )
+	    {
+		begin = std::max_element( begin, end );
+		end = begin;
+		end++;
+	    }
+
+	    Eigen::Vector3d cellPos;
+	    if( out )
+	    {
+		double cx, cy;
+		grid.fromGrid( x, y, cx, cy );
+		cellPos = gridToFrame * Eigen::Vector3d( cx, cy, 0 );
+	    }
+
+	    for( MLSGrid::const_iterator cit = begin; cit != end; cit++ )
+	    {
+		const SurfacePatch& p( *cit );
+		if( p.isHorizontal() )
+		{
+		    if( out )
+			out[count] = Eigen::Vector3d( cellPos.x(), cellPos.y(), cellPos.z() + p.mean );
+		    count++;
+		}
+		else if( p.isVertical() && selection != HORIZONTAL_PATCHES )
+		{
+		    float min_z = (float)p.getMinZ(0);
+		    float max_z = (float)p.getMaxZ(0);
+		    for(float z = min_z; z <= max_z; z += vertical_distance)
+		    {
+			if( out )
+			    out[count] = Eigen::Vector3d( cellPos.x(), cellPos.y(), cellPos.z() + z );
+			count++;
+		    }
+		}
+	    }
+	}
+    }
+    return count;
+}
+
+void MLSExtraction::extractPoints( const Eigen::Affine3d& gridToFrame,
+	std::vector<Eigen::Vector3d>& points, std::vector<size_t>& tileOffsets ) const
+{
+    if( verticalDistance <= 0 )
+	throw std::runtime_error("MLSExtraction: the vertical distance needs to be positive.");
+
+    const size_t tiles = getTileCount();
+    const bool reuse = minUpdateIdx > 0 && tileOffsets.size() == tiles + 1 && tileOffsets.back() == points.size();
+
+    std::vector<char> dirty( tiles );
+    std::vector<size_t> counts( tiles );
+    MLSExtractionKernel kernel;
+    kernel.pass = MLSExtractionKernel::COUNT;
+    kernel.extraction = this;
+    kernel.gridToFrame = &gridToFrame;
+    kernel.dirty = &dirty;
+    kernel.counts = &counts;
+    kernel.oldPoints = &points;
+    kernel.oldOffsets = reuse ? &tileOffsets : NULL;
+    parallelFor( 0, tiles, kernel );
+
+    std::vector<size_t> offsets( tiles + 1 );
+    offsets[0] = 0;
+    for( size_t i=0; i<tiles; i++ )
+	offsets[i+1] = offsets[i] + counts[i];
+
+    std::vector<Eigen::Vector3d> result( offsets.back() );
+    kernel.pass = MLSExtractionKernel::FILL;
+    kernel.points = &result;
+    kernel.offsets = &offsets;
+    parallelFor( 0, tiles, kernel );
+
+    points.swap( result );
+    tileOffsets.swap( offsets );
+}
+
+void MLSExtraction::extractElevation( boost::multi_array<double, 2>& elevation ) const
+{
+    if( elevation.shape()[0] < grid.getCellSizeY() || elevation.shape()[1] < grid.getCellSizeX() )
+	throw std::runtime_error("MLSExtraction: the elevation array is smaller than the grid.");
+
+    MLSExtractionKernel kernel;
+    kernel.pass = MLSExtractionKernel::ELEVATION;
+    kernel.extraction = this;
+    kernel.elevation = &elevation;
+    parallelFor( 0, getTileCount(), kernel );
+}
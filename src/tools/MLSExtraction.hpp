@@ -0,0 +1,108 @@
+#ifndef __ENVIRE_TOOLS_MLSEXTRACTION_HPP__
+#define __ENVIRE_TOOLS_MLSEXTRACTION_HPP__
+
+#include <envire/maps/MLSGrid.hpp>
+
+#include <boost/multi_array.hpp>
+#include <Eigen/Geometry>
+
+#include <vector>
+
+namespace envire
+{
+    /**
+     * Extracts points or elevations from the patches of an MLSGrid.
+     *
+     * The grid is split into square tiles, which are processed
+     * independently on multiple threads. Point output is generated in two
+     * passes: the first pass counts the points of each tile, and the second
+     * pass writes them into a preallocated array at the offset of the tile.
+     *
+     * Optionally, only the dirty tiles are processed. A tile is dirty if it
+     * contains a patch with an update_idx of at least the value given in
+     * setMinUpdateIndex(). Note that tiles in which patches have only been
+     * removed are not detected as dirty.
+     */
+    class MLSExtraction
+    {
+    public:
+	enum PatchSelection
+	{
+	    /** only the highest patch of each cell */
+	    TOP_PATCH,
+	    /** all horizontal and vertical patches */
+	    ALL_PATCHES,
+	    /** only horizontal patches */
+	    HORIZONTAL_PATCHES
+	};
+
+	/**
+	 * @param grid - the grid to extract from
+	 * @param tileCells - number of cells in x and y for each tile
+	 */
+	MLSExtraction( const MLSGrid& grid, size_t tileCells = 64 );
+
+	void setPatchSelection( PatchSelection selection ) { this->selection = selection; }
+	PatchSelection getPatchSelection() const { return selection; }
+
+	/** distance between the points which are generated for vertical
+	 * patches */
+	void setVerticalDistance( double distance ) { verticalDistance = distance; }
+
+	/** only process tiles which contain a patch with update_idx >= idx.
+	 * With 0 (the default) all the tiles are processed. */
+	void setMinUpdateIndex( size_t idx ) { minUpdateIdx = idx; }
+
+	size_t getTileCount() const { return tilesX * tilesY; }
+
+	/** @return true if the tile needs to be processed */
+	bool isDirty( size_t tile ) const;
+
+	/**
+	 * Generates points for the selected patches. Horizontal patches give
+	 * a point at the patch mean, vertical patches a column of points
+	 * between the minimum and maximum z. The cell position is transformed
+	 * with gridToFrame, and the patch height is added to the z
+	 * coordinate.
+	 *
+	 * The points are ordered by tiles, and tileOffsets is set to the start
+	 * of each tile in points, followed by the number of points. If
+	 * setMinUpdateIndex() is used, the points of clean tiles are copied
+	 * from points using the tileOffsets of the previous call, which
+	 * need to be valid for the same grid.
+	 */
+	void extractPoints( const Eigen::Affine3d& gridToFrame,
+		std::vector<Eigen::Vector3d>& points, std::vector<size_t>& tileOffsets ) const;
+
+	/**
+	 * Sets the cells of elevation to the mean of the selected patch. For
+	 * ALL_PATCHES the highest patch is used, for HORIZONTAL_PATCHES the
+	 * highest horizontal patch. Cells without a matching patch, and the
+	 * cells of clean tiles are not changed.
+	 */
+	void extractElevation( boost::multi_array<double, 2>& elevation ) const;
+
+    private:
+	const MLSGrid& grid;
+	size_t tileCells;
+	size_t tilesX, tilesY;
+	PatchSelection selection;
+	double verticalDistance;
+	size_t minUpdateIdx;
+
+	friend struct MLSExtractionKernel;
+
+	/** cell range of a tile */
+	void getTileCells( size_t tile, size_t& x0, size_t& y0, size_t& x1, size_t& y1 ) const;
+
+	/** @return the selected patch of the cell for the elevation output,
+	 * or NULL */
+	const SurfacePatch* getElevationPatch( size_t x, size_t y ) const;
+
+	/** generates the points of a tile. If out is NULL, the points are
+	 * only counted. */
+	size_t getTilePoints( size_t tile, const Eigen::Affine3d& gridToFrame, Eigen::Vector3d* out ) const;
+    };
+}
+
+#endif
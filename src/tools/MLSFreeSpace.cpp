@@ -0,0 +1,117 @@
+#include "MLSFreeSpace.hpp"
+
+#include <cmath>
+#include <cstdlib>
+
+using namespace envire;
+
+MLSFreeSpace::MLSFreeSpace( MLSGrid& grid, const GridBase::Position& origin, double originZ )
+    : grid( grid ), origin( origin ), originZ( originZ ), bresenham( origin, origin )
+{
+}
+
+void MLSFreeSpace::addCell( const MLSGrid& source, const GridBase::Position& cell )
+{
+    if( cell == origin )
+	return;
+
+    // this is the distance on the x/y plane from origin to the cell
+    const double plane_dist = (grid.fromGrid( origin ) - grid.fromGrid( cell )).norm();
+
+    sources.clear();
+    for( MLSGrid::const_iterator cit = source.beginCell( cell.x, cell.y ); cit != source.endCell(); cit++ )
+    {
+	Source s;
+	s.mean = cit->mean;
+	s.stdev = cit->stdev;
+	s.height = cit->height;
+	// this is the height difference between the origin and the cell
+	s.z = originZ - cit->mean;
+
+	// this is the maximum height of the negative cell, which joins the
+	// height of the cell, and how high it is perceived from the origin
+	// point of view
+	s.viewHeight = 0;
+	if( plane_dist * s.z != 0 )
+	    s.viewHeight += grid.getScaleX() / plane_dist * s.z;
+
+	sources.push_back( s );
+    }
+    if( sources.empty() )
+	return;
+
+    const int xdiff = cell.x - origin.x;
+    const int ydiff = cell.y - origin.y;
+    const bool xdir = std::abs( xdiff ) >= std::abs( ydiff );
+    const size_t width = grid.getCellSizeX();
+
+    bresenham.init( cell, origin );
+    GridBase::Position pos;
+    while( bresenham.getNextPoint( pos ) )
+    {
+	double factor = 1.0;
+	if( xdir && xdiff )
+	    factor = (int)(pos.x - origin.x) / (double)xdiff;
+	else if( ydiff )
+	    factor = (int)(pos.y - origin.y) / (double)ydiff;
+
+	// for now don't put anything into the cell with the positive
+	// information. This could be changed later for partial information
+	if( factor >= 1.0 )
+	    continue;
+
+	std::vector<SurfacePatch>& target( negatives[pos.y * width + pos.x] );
+	for( size_t i=0; i<sources.size(); i++ )
+	{
+	    const Source& s( sources[i] );
+	    const double p_height = fabs( (s.height + s.viewHeight) * factor );
+	    const double z_mean = s.mean + s.viewHeight * factor + s.z * (1.0 - factor);
+	    const double z_stdev = s.stdev * factor;
+
+	    mergeInto( target, SurfacePatch( z_mean, z_stdev, p_height, SurfacePatch::NEGATIVE ) );
+	}
+    }
+}
+
+void MLSFreeSpace::mergeInto( std::vector<SurfacePatch>& cell, const SurfacePatch& patch ) const
+{
+    const MLSConfiguration& config( grid.getConfig() );
+    SurfacePatch o( patch );
+
+    // merge with all the patches which overlap, and then merge these
+    // until only one of them is left
+    bool merged = false;
+    size_t first = 0;
+    for( size_t i=0; i<cell.size(); )
+    {
+	if( cell[i].merge( o, config.thickness, config.gapSize, config.updateModel ) )
+	{
+	    if( !merged )
+	    {
+		merged = true;
+		first = i;
+	    }
+	    else if( cell[first].merge( cell[i], config.thickness, config.gapSize, config.updateModel ) )
+	    {
+		cell.erase( cell.begin() + i );
+		continue;
+	    }
+	}
+	i++;
+    }
+
+    if( !merged )
+	cell.push_back( o );
+}
+
+void MLSFreeSpace::apply()
+{
+    const size_t width = grid.getCellSizeX();
+    for( CellMap::const_iterator it = negatives.begin(); it != negatives.end(); it++ )
+    {
+	const size_t x = it->first % width, y = it->first / width;
+	for( size_t i=0; i<it->second.size(); i++ )
+	    grid.updateCell( x, y, it->second[i] );
+    }
+    negatives.clear();
+}
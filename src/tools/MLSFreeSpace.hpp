@@ -0,0 +1,77 @@
+#ifndef __ENVIRE_TOOLS_MLSFREESPACE_HPP__
+#define __ENVIRE_TOOLS_MLSFREESPACE_HPP__
+
+#include <envire/maps/MLSGrid.hpp>
+#include <envire/tools/BresenhamLine.hpp>
+
+#include <boost/unordered_map.hpp>
+#include <vector>
+
+namespace envire
+{
+    /**
+     * Adds negative information (the knowledge that space is free) to an
+     * MLSGrid, for the rays from the patches of a set of cells to the
+     * sensor origin.
+     *
+     * The ray of a cell is marched with a Bresenham iterator, once for all
+     * the patches in the cell and without allocating the cells of the ray.
+     * The negative patches are not inserted into the grid directly, but
+     * are collected per target cell, where patches which overlap are
+     * merged. Rays which share cells, e.g. close to the origin, therefore
+     * only leave a few patches per cell, which are inserted into the grid
+     * in apply().
+     */
+    class MLSFreeSpace
+    {
+    public:
+	/**
+	 * @param grid - the grid to update
+	 * @param origin - cell of the sensor origin
+	 * @param originZ - height of the sensor origin in the grid frame
+	 */
+	MLSFreeSpace( MLSGrid& grid, const GridBase::Position& origin, double originZ );
+
+	/**
+	 * Collects the negative information of the rays from the patches
+	 * of a cell in source to the origin. The ray ends before the source
+	 * cell, so the cell itself is not changed. source needs to have the
+	 * same layout as the grid, and can be the grid itself.
+	 */
+	void addCell( const MLSGrid& source, const GridBase::Position& cell );
+
+	/** @return number of cells with collected negative information */
+	size_t getCellCount() const { return negatives.size(); }
+
+	/** inserts the collected patches into the grid, and clears them */
+	void apply();
+
+    private:
+	typedef MLSGrid::SurfacePatch SurfacePatch;
+
+	MLSGrid& grid;
+	GridBase::Position origin;
+	double originZ;
+	Bresenham bresenham;
+
+	/** properties of the patches of the current cell, which are reused
+	 * along the ray */
+	struct Source
+	{
+	    double mean, stdev, height;
+	    /** height difference to the origin */
+	    double z;
+	    /** height of the patch as seen from the origin */
+	    double viewHeight;
+	};
+	std::vector<Source> sources;
+
+	typedef boost::unordered_map<size_t, std::vector<SurfacePatch> > CellMap;
+	CellMap negatives;
+
+	/** merges the patch with the ones in the cell, like MLSGrid::updateCell */
+	void mergeInto( std::vector<SurfacePatch>& cell, const SurfacePatch& patch ) const;
+    };
+}
+
+#endif
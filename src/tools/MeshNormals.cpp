@@ -0,0 +1,170 @@
+#include "MeshNormals.hpp"
+#include "Parallel.hpp"
+
+#include <Eigen/Geometry>
+
+#include <stdexcept>
+
+using namespace envire;
+
+namespace envire
+{
+    /** sums the face normals for a range of vertices */
+    struct MeshNormalsKernel
+    {
+	const MeshNormals* adjacency;
+	const std::vector<Eigen::Vector3d>* vertices;
+	const std::vector<MeshNormals::Face>* faces;
+	/** vertices to process, or NULL for all */
+	const std::vector<size_t>* selection;
+	std::vector<Eigen::Vector3d>* normals;
+
+	void add( Eigen::Vector3d& sum, const MeshNormals::Face& f ) const
+	{
+	    const std::vector<Eigen::Vector3d>& v( *vertices );
+	    const Eigen::Vector3d& b( v[f.get<1>()] );
+	    sum += (v[f.get<0>()] - b).cross( v[f.get<2>()] - b );
+	}
+
+	void operator()( size_t begin, size_t end )
+	{
+	    for( size_t i=begin; i<end; i++ )
+	    {
+		const size_t vertex = selection ? (*selection)[i] : i;
+		Eigen::Vector3d sum = Eigen::Vector3d::Zero();
+		if( vertex + 1 < adjacency->offsets.size() )
+		{
+		    for( size_t j=adjacency->offsets[vertex]; j<adjacency->offsets[vertex+1]; j++ )
+			add( sum, (*faces)[adjacency->adjacentFaces[j]] );
+		}
+		for( size_t l=adjacency->linkHead[vertex]; l != MeshNormals::NONE; l=adjacency->links[l].next )
+		    add( sum, (*faces)[adjacency->links[l].face] );
+
+		// set vertices without normals to a defined value
+		const double norm = sum.norm();
+		(*normals)[vertex] = norm > 0 ? Eigen::Vector3d( sum / norm ) : Eigen::Vector3d::Zero();
+	    }
+	}
+    };
+}
+
+const size_t MeshNormals::NONE;
+
+MeshNormals::MeshNormals()
+    : vertexCount( 0 ), faceCount( 0 )
+{
+}
+
+void MeshNormals::checkFace( const Face& face ) const
+{
+    const int idx[3] = { face.get<0>(), face.get<1>(), face.get<2>() };
+    for( int n=0; n<3; n++ )
+	if( idx[n] < 0 || static_cast<size_t>(idx[n]) >= vertexCount )
+	    throw std::runtime_error("MeshNormals: face references an invalid vertex.");
+}
+
+void MeshNormals::build( size_t vertexCount, const std::vector<Face>& faces )
+{
+    this->vertexCount = vertexCount;
+    faceCount = 0;
+    links.clear();
+    linkHead.assign( vertexCount, NONE );
+    linkTail.assign( vertexCount, NONE );
+
+    // count the faces of each vertex, and then fill them in at the offsets,
+    // which keeps the faces of a vertex sorted by index
+    offsets.assign( vertexCount + 1, 0 );
+    for( size_t i=0; i<faces.size(); i++ )
+    {
+	checkFace( faces[i] );
+	offsets[faces[i].get<0>()+1]++;
+	offsets[faces[i].get<1>()+1]++;
+	offsets[faces[i].get<2>()+1]++;
+    }
+    for( size_t i=0; i<vertexCount; i++ )
+	offsets[i+1] += offsets[i];
+
+    adjacentFaces.resize( offsets.back() );
+    std::vector<size_t> next( offsets.begin(), offsets.end() - 1 );
+    for( size_t i=0; i<faces.size(); i++ )
+    {
+	adjacentFaces[next[faces[i].get<0>()]++] = i;
+	adjacentFaces[next[faces[i].get<1>()]++] = i;
+	adjacentFaces[next[faces[i].get<2>()]++] = i;
+    }
+    faceCount = faces.size();
+}
+
+void MeshNormals::extend( size_t vertexCount, const std::vector<Face>& faces )
+{
+    if( vertexCount < this->vertexCount || faces.size() < faceCount )
+	throw std::runtime_error("MeshNormals: the mesh has shrunk since the adjacency was built.");
+
+    // keep the lists shorter than the compressed rows, so that the
+    // rebuilds are amortized over the extensions
+    if( links.size() + 3 * (faces.size() - faceCount) > adjacentFaces.size() )
+    {
+	build( vertexCount, faces );
+	return;
+    }
+
+    this->vertexCount = vertexCount;
+    linkHead.resize( vertexCount, NONE );
+    linkTail.resize( vertexCount, NONE );
+    for( size_t i=faceCount; i<faces.size(); i++ )
+    {
+	checkFace( faces[i] );
+	const int idx[3] = { faces[i].get<0>(), faces[i].get<1>(), faces[i].get<2>() };
+	for( int n=0; n<3; n++ )
+	{
+	    const Link link = { i, NONE };
+	    const size_t l = links.size();
+	    links.push_back( link );
+	    if( linkTail[idx[n]] == NONE )
+		linkHead[idx[n]] = l;
+	    else
+		links[linkTail[idx[n]]].next = l;
+	    linkTail[idx[n]] = l;
+	}
+    }
+    faceCount = faces.size();
+}
+
+size_t MeshNormals::getFaceCount( size_t vertex ) const
+{
+    size_t count = vertex + 1 < offsets.size() ? offsets[vertex+1] - offsets[vertex] : 0;
+    for( size_t l=linkHead[vertex]; l != NONE; l=links[l].next )
+	count++;
+    return count;
+}
+
+void MeshNormals::compute( const std::vector<Eigen::Vector3d>& vertices, const std::vector<Face>& faces,
+	std::vector<Eigen::Vector3d>& normals, size_t threads ) const
+{
+    if( vertexCount != vertices.size() )
+	throw std::runtime_error("MeshNormals: adjacency does not match the vertices.");
+
+    normals.resize( vertices.size() );
+    MeshNormalsKernel kernel;
+    kernel.adjacency = this;
+    kernel.vertices = &vertices;
+    kernel.faces = &faces;
+    kernel.selection = NULL;
+    kernel.normals = &normals;
+    parallelFor( 0, vertices.size(), kernel, 4096, threads );
+}
+
+void MeshNormals::compute( const std::vector<Eigen::Vector3d>& vertices, const std::vector<Face>& faces,
+	const std::vector<size_t>& selection, std::vector<Eigen::Vector3d>& normals, size_t threads ) const
+{
+    if( vertexCount != vertices.size() || normals.size() != vertices.size() )
+	throw std::runtime_error("MeshNormals: adjacency does not match the vertices.");
+
+    MeshNormalsKernel kernel;
+    kernel.adjacency = this;
+    kernel.vertices = &vertices;
+    kernel.faces = &faces;
+    kernel.selection = &selection;
+    kernel.normals = &normals;
+    parallelFor( 0, selection.size(), kernel, 4096, threads );
+}
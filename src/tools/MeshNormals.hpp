@@ -0,0 +1,109 @@
+#ifndef __ENVIRE_TOOLS_MESHNORMALS_HPP__
+#define __ENVIRE_TOOLS_MESHNORMALS_HPP__
+
+#include <boost/tuple/tuple.hpp>
+#include <Eigen/Core>
+
+#include <vector>
+
+namespace envire
+{
+    /**
+     * Computes area weighted vertex normals of a triangle mesh.
+     *
+     * The faces adjacent to each vertex are stored in compressed row
+     * format: the faces of vertex i are the entries [offsets[i],
+     * offsets[i+1]) of the face array, in the order of the face indices.
+     * Each vertex sums the normals of its faces in this order, so the
+     * vertices can be processed on multiple threads, and the result does
+     * not depend on the number of threads.
+     *
+     * Faces which are appended to the mesh later can be added with
+     * extend(), which only goes over the new faces. Their adjacency is
+     * kept in per vertex lists after the compressed rows, in the order of
+     * the face indices as well, so the result is the same as after a
+     * build() with all the faces.
+     *
+     * The normal of a face (a, b, c) is (a-b) x (c-b), and its length is
+     * twice the area of the face, which gives the weighting.
+     */
+    class MeshNormals
+    {
+    public:
+	typedef boost::tuple<int, int, int> Face;
+
+	MeshNormals();
+
+	/**
+	 * Builds the vertex to face adjacency for the given faces.
+	 *
+	 * @throw std::runtime_error if a face references a vertex outside
+	 *        of [0, vertexCount)
+	 */
+	void build( size_t vertexCount, const std::vector<Face>& faces );
+
+	/**
+	 * Adds the faces after the ones of the last build() or extend() to
+	 * the adjacency. The faces before them must not have changed, and
+	 * vertexCount must not be smaller than the one of the last call. The
+	 * compressed rows are rebuilt if the added faces outnumber the ones
+	 * in them.
+	 *
+	 * @throw std::runtime_error if a face references a vertex outside
+	 *        of [0, vertexCount)
+	 */
+	void extend( size_t vertexCount, const std::vector<Face>& faces );
+
+	/** @return number of faces adjacent to the vertex */
+	size_t getFaceCount( size_t vertex ) const;
+
+	/** @return number of vertices of the adjacency */
+	size_t getVertexCount() const { return vertexCount; }
+
+	/** @return number of mesh faces in the adjacency */
+	size_t getMeshFaceCount() const { return faceCount; }
+
+	/**
+	 * Computes the normals of all vertices. Vertices without faces, or
+	 * with degenerated faces only, get a zero normal.
+	 *
+	 * @param vertices, faces - the mesh used for build()
+	 * @param threads - number of threads to use, 0 for the default
+	 */
+	void compute( const std::vector<Eigen::Vector3d>& vertices, const std::vector<Face>& faces,
+		std::vector<Eigen::Vector3d>& normals, size_t threads = 0 ) const;
+
+	/**
+	 * Like compute(), but only updates the normals of the given
+	 * vertices, which must not contain duplicates. All the other normals
+	 * are kept, and normals needs to have the size of vertices.
+	 */
+	void compute( const std::vector<Eigen::Vector3d>& vertices, const std::vector<Face>& faces,
+		const std::vector<size_t>& selection, std::vector<Eigen::Vector3d>& normals, size_t threads = 0 ) const;
+
+    private:
+	size_t vertexCount;
+	size_t faceCount;
+
+	/** compressed rows of the faces of the last build(), for the
+	 * vertices of the last build() */
+	std::vector<size_t> offsets;
+	std::vector<size_t> adjacentFaces;
+
+	/** faces added by extend(), as a list for each vertex */
+	struct Link
+	{
+	    size_t face;
+	    size_t next;
+	};
+	std::vector<Link> links;
+	std::vector<size_t> linkHead, linkTail;
+	static const size_t NONE = static_cast<size_t>(-1);
+
+	void checkFace( const Face& face ) const;
+
+	friend struct MeshNormalsKernel;
+    };
+}
+
+#endif
@@ -0,0 +1,140 @@
+#ifndef __ENVIRE_TOOLS_NUMBERPARSER_HPP__
+#define __ENVIRE_TOOLS_NUMBERPARSER_HPP__
+
+#include <boost/cstdint.hpp>
+#include <locale>
+#include <sstream>
+#include <string>
+
+// locale independent parsing of numbers from character buffers
+
+namespace envire
+{
+    inline bool isSpace( char c )
+    {
+	return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+    }
+
+    /** advances p to the first non whitespace character, or end */
+    inline void skipSpace( const char*& p, const char* end )
+    {
+	while( p != end && isSpace( *p ) )
+	    ++p;
+    }
+
+    /**
+     * Parses a floating point number in decimal notation starting at p, and
+     * advances p past the number. Leading whitespace is not skipped.
+     *
+     * The result is the same as reading the number from a std::istream in
+     * the classic locale: numbers with up to 15 significant digits and small
+     * exponents are converted directly, which is exact since both the
+     * mantissa and the power of ten are representable as doubles. All other
+     * numbers are passed to the stream conversion.
+     *
+     * @return false if there is no valid number at p, p is not advanced
+     * in that case
+     */
+    inline bool parseDouble( const char*& p, const char* end, double& value )
+    {
+	static const double pow10[] = {
+	    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+	const char* start = p;
+	const char* s = p;
+	bool negative = false;
+	if( s != end && (*s == '-' || *s == '+') )
+	{
+	    negative = *s == '-';
+	    ++s;
+	}
+
+	boost::uint64_t mantissa = 0;
+	int digits = 0;
+	int exponent = 0;
+	bool anyDigit = false;
+
+	while( s != end && *s >= '0' && *s <= '9' )
+	{
+	    anyDigit = true;
+	    if( mantissa || *s != '0' )
+	    {
+		if( digits < 19 )
+		    mantissa = mantissa * 10 + (*s - '0');
+		else
+		    exponent++;
+		digits++;
+	    }
+	    ++s;
+	}
+	if( s != end && *s == '.' )
+	{
+	    ++s;
+	    while( s != end && *s >= '0' && *s <= '9' )
+	    {
+		anyDigit = true;
+		if( mantissa || *s != '0' )
+		{
+		    if( digits < 19 )
+		    {
+			mantissa = mantissa * 10 + (*s - '0');
+			exponent--;
+		    }
+		    digits++;
+		}
+		else
+		    exponent--;
+		++s;
+	    }
+	}
+	if( !anyDigit )
+	    return false;
+
+	if( s != end && (*s == 'e' || *s == 'E') )
+	{
+	    const char* e = s + 1;
+	    bool expNegative = false;
+	    if( e != end && (*e == '-' || *e == '+') )
+	    {
+		expNegative = *e == '-';
+		++e;
+	    }
+	    if( e != end && *e >= '0' && *e <= '9' )
+	    {
+		int exp = 0;
+		while( e != end && *e >= '0' && *e <= '9' )
+		{
+		    if( exp < 100000 )
+			exp = exp * 10 + (*e - '0');
+		    ++e;
+		}
+		exponent += expNegative ? -exp : exp;
+		s = e;
+	    }
+	    else
+		// an exponent marker without digits, like "1e" or "1e+"
+		return false;
+	}
+	p = s;
+
+	if( digits <= 15 && exponent >= -22 && exponent <= 22 )
+	{
+	    double v = static_cast<double>( mantissa );
+	    if( exponent < 0 )
+		v /= pow10[-exponent];
+	    else
+		v *= pow10[exponent];
+	    value = negative ? -v : v;
+	    return true;
+	}
+
+	// slow path, which gives correct rounding in all cases
+	std::istringstream is( std::string( start, s ) );
+	is.imbue( std::locale::classic() );
+	is >> value;
+	return !is.fail();
+    }
+}
+
+#endif
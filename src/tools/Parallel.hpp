@@ -0,0 +1,96 @@
+#ifndef __ENVIRE_TOOLS_PARALLEL_HPP__
+#define __ENVIRE_TOOLS_PARALLEL_HPP__
+
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// small helpers for running loops on multiple threads
+
+namespace envire
+{
+    /** @return the number of threads used by default for parallel
+     * operations, which is the number of hardware threads available. */
+    inline size_t getParallelThreads()
+    {
+	const unsigned int n = boost::thread::hardware_concurrency();
+	return n ? n : 1;
+    }
+
+    namespace detail
+    {
+	template <class F>
+	void parallelForBlock( F* f, size_t begin, size_t end, std::string* error )
+	{
+	    try
+	    {
+		(*f)( begin, end );
+	    }
+	    catch( const std::exception& e )
+	    {
+		*error = e.what();
+		if( error->empty() )
+		    *error = "unknown error";
+	    }
+	    catch( ... )
+	    {
+		*error = "unknown error";
+	    }
+	}
+    }
+
+    /**
+     * Splits the range [begin, end) into contiguous blocks and calls
+     * f( blockBegin, blockEnd ) for each of them on a separate thread. The
+     * blocks have at least minBlockSize elements, so that small ranges are
+     * processed in the calling thread only.
+     *
+     * The calls to f are made concurrently, so f must be safe to call from
+     * multiple threads as long as the ranges don't overlap. Exceptions thrown
+     * in f are rethrown as std::runtime_error after all blocks are finished.
+     *
+     * @param threads - number of threads to use, 0 for getParallelThreads()
+     */
+    template <class F>
+    void parallelFor( size_t begin, size_t end, F f, size_t minBlockSize = 1, size_t threads = 0 )
+    {
+	if( end <= begin )
+	    return;
+
+	if( threads == 0 )
+	    threads = getParallelThreads();
+
+	const size_t count = end - begin;
+	const size_t blocks = std::min( threads, std::max( count / std::max( minBlockSize, size_t(1) ), size_t(1) ) );
+	if( blocks <= 1 )
+	{
+	    f( begin, end );
+	    return;
+	}
+
+	std::vector<std::string> errors( blocks );
+	boost::thread_group group;
+	size_t blockBegin = begin;
+	for( size_t i=0; i<blocks; i++ )
+	{
+	    const size_t blockEnd = begin + count * (i + 1) / blocks;
+	    // the last block is processed in the calling thread
+	    if( i + 1 < blocks )
+		group.create_thread( boost::bind( &detail::parallelForBlock<F>, &f, blockBegin, blockEnd, &errors[i] ) );
+	    else
+		detail::parallelForBlock<F>( &f, blockBegin, blockEnd, &errors[i] );
+	    blockBegin = blockEnd;
+	}
+	group.join_all();
+
+	for( size_t i=0; i<blocks; i++ )
+	    if( !errors[i].empty() )
+		throw std::runtime_error( errors[i] );
+    }
+}
+
+#endif
@@ -1,7 +1,12 @@
 #include "PlyFile.hpp"
 #include <fstream>
+#include <sstream>
 #include <tr1/functional>
 
+#include <boost/algorithm/string/trim.hpp>
+#include <boost/static_assert.hpp>
+#include <boost/cstdint.hpp>
+
 using namespace envire;
 using namespace std::tr1::placeholders;
 
@@ -312,10 +317,212 @@ bool PlyFile::serialize(Pointcloud *pointcloud, std::ostream& data , bool const
     return true;
 }
 
+namespace
+{
+    struct PlyElement
+    {
+	std::string name;
+	size_t count;
+	std::vector<std::string> types;
+	std::vector<std::string> names;
+	bool list;
+    };
+
+    bool isVectorElement( const PlyElement& e, const char* n1, const char* n2, const char* n3 )
+    {
+	return !e.list && e.names.size() == 3 
+	    && e.names[0] == n1 && e.names[1] == n2 && e.names[2] == n3
+	    && e.types[0] == e.types[1] && e.types[0] == e.types[2];
+    }
+
+    bool isFloat( const std::string& type )
+    {
+	return type == "float" || type == "float32";
+    }
+
+    bool isDouble( const std::string& type )
+    {
+	return type == "double" || type == "float64";
+    }
+
+    /** reads count 3d vectors stored as float or double into the end of
+     * the given list */
+    bool readVectorBlock( std::istream& is, std::vector<Eigen::Vector3d>& list, size_t count, bool doublePrecision )
+    {
+	BOOST_STATIC_ASSERT( sizeof( Eigen::Vector3d ) == 3 * sizeof( double ) );
+
+	const size_t offset = list.size();
+	list.resize( offset + count );
+	if( count == 0 )
+	    return true;
+
+	if( doublePrecision )
+	{
+	    is.read( reinterpret_cast<char*>( list[offset].data() ), count * sizeof( Eigen::Vector3d ) );
+	    return static_cast<size_t>( is.gcount() ) == count * sizeof( Eigen::Vector3d );
+	}
+
+	const size_t blockSize = 1 << 16;
+	std::vector<float> buffer( 3 * std::min( count, blockSize ) );
+	for( size_t i=0; i<count; i+=blockSize )
+	{
+	    const size_t n = std::min( count - i, blockSize );
+	    is.read( reinterpret_cast<char*>( &buffer[0] ), n * 3 * sizeof( float ) );
+	    if( static_cast<size_t>( is.gcount() ) != n * 3 * sizeof( float ) )
+		return false;
+	    for( size_t j=0; j<n; j++ )
+		list[offset + i + j] = Eigen::Vector3d( buffer[j*3], buffer[j*3+1], buffer[j*3+2] );
+	}
+	return true;
+    }
+}
+
+bool PlyFile::unserializeBinary( std::istream& data )
+{
+    const std::streampos start = data.tellg();
+    if( start == std::streampos(-1) )
+	return false;
+
+    const int one = 1;
+    const std::string hostFormat = *reinterpret_cast<const char*>( &one ) == 1 ? 
+	"binary_little_endian" : "binary_big_endian";
+
+    // read the header and check if all elements are in a format that can be
+    // read directly
+    std::vector<PlyElement> elements;
+    std::string line;
+    bool supported = true, endHeader = false, magic = false;
+    while( supported && !endHeader && std::getline( data, line ) )
+    {
+	boost::algorithm::trim( line );
+	std::istringstream ls( line );
+	std::string keyword;
+	ls >> keyword;
+	if( !magic )
+	    supported = magic = keyword == "ply";
+	else if( keyword == "format" )
+	{
+	    std::string format;
+	    ls >> format;
+	    supported = format == hostFormat;
+	}
+	else if( keyword == "element" )
+	{
+	    PlyElement e;
+	    ls >> e.name >> e.count;
+	    e.list = false;
+	    elements.push_back( e );
+	}
+	else if( keyword == "property" && !elements.empty() )
+	{
+	    PlyElement& e( elements.back() );
+	    std::string type, name;
+	    ls >> type;
+	    if( type == "list" )
+	    {
+		std::string sizeType;
+		ls >> sizeType >> type;
+		e.list = true;
+		supported = sizeType == "uchar" || sizeType == "uint8";
+	    }
+	    ls >> name;
+	    e.types.push_back( type );
+	    e.names.push_back( name );
+	}
+	else if( keyword == "end_header" )
+	    endHeader = true;
+	else if( keyword != "comment" && keyword != "obj_info" )
+	    supported = false;
+    }
+
+    for( size_t i=0; i<elements.size() && supported; i++ )
+    {
+	const PlyElement& e( elements[i] );
+	if( e.name == "vertex" || e.name == "normal" )
+	    supported = isVectorElement( e, "x", "y", "z" ) && (isFloat( e.types[0] ) || isDouble( e.types[0] ));
+	else if( e.name == "color" )
+	    supported = isVectorElement( e, "red", "green", "blue" ) && (e.types[0] == "uchar" || e.types[0] == "uint8");
+	else if( e.name == "face" )
+	    supported = e.list && e.names.size() == 1 && e.names[0] == "vertex_index" 
+		&& (e.types[0] == "int" || e.types[0] == "int32" || e.types[0] == "uint" || e.types[0] == "uint32");
+	else
+	    supported = false;
+    }
+
+    if( !supported || !endHeader )
+    {
+	data.clear();
+	data.seekg( start );
+	return false;
+    }
+
+    for( size_t i=0; i<elements.size(); i++ )
+    {
+	const PlyElement& e( elements[i] );
+	bool ok = true;
+	if( e.name == "vertex" )
+	    ok = readVectorBlock( data, pco_->vertices, e.count, isDouble( e.types[0] ) );
+	else if( e.name == "normal" )
+	    ok = readVectorBlock( data, pco_->getVertexData<Eigen::Vector3d>( Pointcloud::VERTEX_NORMAL ), e.count, isDouble( e.types[0] ) );
+	else if( e.name == "color" )
+	{
+	    std::vector<Eigen::Vector3d> &colors( pco_->getVertexData<Eigen::Vector3d>( Pointcloud::VERTEX_COLOR ) );
+	    std::vector<unsigned char> buffer( e.count * 3 );
+	    if( e.count )
+		data.read( reinterpret_cast<char*>( &buffer[0] ), buffer.size() );
+	    ok = static_cast<size_t>( data.gcount() ) == buffer.size() || !e.count;
+	    colors.reserve( colors.size() + e.count );
+	    for( size_t j=0; j<e.count && ok; j++ )
+		colors.push_back( Eigen::Vector3d( buffer[j*3] / 255.0, buffer[j*3+1] / 255.0, buffer[j*3+2] / 255.0 ) );
+	}
+	else if( e.name == "face" )
+	{
+	    // faces are only of interest for trimeshes, and are usually the last
+	    // element in the file
+	    if( !tmo_ && i + 1 == elements.size() )
+		break;
+
+	    if( tmo_ )
+		tmo_->faces.reserve( tmo_->faces.size() + e.count );
+	    TriMesh::triangle_t triangle( 0, 0, 0 );
+	    for( size_t j=0; j<e.count && ok; j++ )
+	    {
+		unsigned char size;
+		boost::int32_t idx[256];
+		data.read( reinterpret_cast<char*>( &size ), 1 );
+		data.read( reinterpret_cast<char*>( idx ), size * sizeof( boost::int32_t ) );
+		ok = data.good();
+		if( !tmo_ )
+		    continue;
+
+		if( size != 3 )
+		    std::cerr << "no support for faces with edgecount different to 3 (is " << (int)size << ")." << std::endl;
+		for( int k=0; k<size; k++ )
+		{
+		    if( static_cast<size_t>( idx[k] ) >= pco_->vertices.size() )
+			std::cerr << "vertex_index " << idx[k] << " is out of range!" << std::endl;
+		}
+		if( size > 0 ) triangle.get<0>() = idx[0];
+		if( size > 1 ) triangle.get<1>() = idx[1];
+		if( size > 2 ) triangle.get<2>() = idx[2];
+		tmo_->faces.push_back( triangle );
+	    }
+	}
+
+	if( !ok )
+	    throw std::runtime_error("could not parse ply file " + filename_ );
+    }
+
+    return true;
+}
+
 bool PlyFile::unserialize( Pointcloud *pointcloud , std::istream& data )
 {
     pco_ = pointcloud;
     tmo_ = dynamic_cast<TriMesh*>(pointcloud);
+
+    if( unserializeBinary( data ) )
+	return true;
     
     ply::ply_parser::flags_type ply_parser_flags = 0;
     ply::ply_parser ply_parser(ply_parser_flags);
@@ -19,7 +19,12 @@ namespace envire
 	 */
 	bool serialize(Pointcloud *pointcloud, std::ostream& os , bool const doublePrecision = true);
 
-	/** similar to serialize this will also work for derived classes */
+	/** similar to serialize this will also work for derived classes.
+	 *
+	 * Binary files in host byte order with the layout written by
+	 * serialize() are read directly in blocks. All other files are
+	 * handled by the generic ply parser.
+	 */
 	bool unserialize( Pointcloud *pointcloud, std::istream& is );
 
     private:
@@ -28,6 +33,8 @@ namespace envire
 	TriMesh* tmo_;
 
     private:
+	bool unserializeBinary( std::istream& is );
+
 	void info_callback(const std::string& filename, std::size_t line_number, const std::string& message);
 	void warning_callback(const std::string& filename, std::size_t line_number, const std::string& message);
 	void error_callback(const std::string& filename, std::size_t line_number, const std::string& message);
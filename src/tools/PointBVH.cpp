@@ -0,0 +1,154 @@
+#include "PointBVH.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <limits>
+
+using namespace envire;
+
+namespace
+{
+    struct AxisLess
+    {
+	const std::vector<Eigen::Vector3d>* points;
+	int axis;
+	bool operator()( boost::uint32_t a, boost::uint32_t b ) const
+	{
+	    return (*points)[a][axis] < (*points)[b][axis];
+	}
+    };
+
+    /** squared distance of p to the box, using the first dims axes */
+    inline double squaredDistance( const PointBVH::Box& box, const Eigen::Vector3d& p, size_t dims )
+    {
+	double d = 0;
+	for( size_t i=0; i<dims; i++ )
+	{
+	    const double e = std::max( std::max( box.min()[i] - p[i], p[i] - box.max()[i] ), 0.0 );
+	    d += e * e;
+	}
+	return d;
+    }
+
+    inline double squaredDistance( const Eigen::Vector3d& a, const Eigen::Vector3d& p, size_t dims )
+    {
+	return dims == 2 ? (a.head<2>() - p.head<2>()).squaredNorm() : (a - p).squaredNorm();
+    }
+}
+
+PointBVH::PointBVH()
+{
+}
+
+void PointBVH::clear()
+{
+    nodes.clear();
+    indices.clear();
+    points.clear();
+}
+
+void PointBVH::build( const std::vector<Eigen::Vector3d>& source, size_t leafSize )
+{
+    clear();
+    if( source.empty() )
+	return;
+    if( source.size() >= NO_CHILD )
+	throw std::runtime_error("PointBVH: too many points.");
+
+    indices.resize( source.size() );
+    for( size_t i=0; i<indices.size(); i++ )
+	indices[i] = i;
+
+    // keep the source for the splits, the points are reordered later
+    points = source;
+    nodes.reserve( 2 * source.size() / std::max( leafSize, size_t(1) ) + 1 );
+    nodes.resize( 1 );
+    build( 0, 0, source.size(), std::max( leafSize, size_t(1) ) );
+
+    for( size_t i=0; i<indices.size(); i++ )
+	points[i] = source[indices[i]];
+}
+
+void PointBVH::build( boost::uint32_t idx, size_t first, size_t last, size_t leafSize )
+{
+    Box bounds;
+    for( size_t i=first; i<last; i++ )
+	bounds.extend( points[indices[i]] );
+
+    nodes[idx].bounds = bounds;
+    nodes[idx].first = first;
+    nodes[idx].count = last - first;
+    nodes[idx].left = NO_CHILD;
+
+    if( last - first <= leafSize )
+	return;
+
+    Eigen::Vector3d::Index axis;
+    (bounds.max() - bounds.min()).maxCoeff( &axis );
+    AxisLess less;
+    less.points = &points;
+    less.axis = axis;
+    const size_t mid = (first + last) / 2;
+    std::nth_element( indices.begin() + first, indices.begin() + mid, indices.begin() + last, less );
+
+    const boost::uint32_t left = nodes.size();
+    nodes.resize( left + 2 );
+    nodes[idx].left = left;
+    build( left, first, mid, leafSize );
+    build( left + 1, mid, last, leafSize );
+}
+
+bool PointBVH::findNearest( const Eigen::Vector3d& p, double maxDist, size_t& index, Eigen::Vector3d& point, size_t dims ) const
+{
+    if( nodes.empty() )
+	return false;
+    if( dims != 2 && dims != 3 )
+	throw std::runtime_error("PointBVH: findNearest supports 2 or 3 dimensions.");
+
+    double best = maxDist * maxDist;
+    bool found = false;
+
+    boost::uint32_t stack[64];
+    int top = 0;
+    stack[top++] = 0;
+    while( top )
+    {
+	const Node& node( nodes[stack[--top]] );
+	if( squaredDistance( node.bounds, p, dims ) >= best )
+	    continue;
+
+	if( node.left == NO_CHILD )
+	{
+	    for( size_t i=node.first; i<node.first+node.count; i++ )
+	    {
+		const double d = squaredDistance( points[i], p, dims );
+		if( d < best )
+		{
+		    best = d;
+		    index = indices[i];
+		    point = points[i];
+		    found = true;
+		}
+	    }
+	}
+	else
+	{
+	    // visit the closer child first, so that the search radius
+	    // shrinks early
+	    const double dl = squaredDistance( nodes[node.left].bounds, p, dims );
+	    const double dr = squaredDistance( nodes[node.left + 1].bounds, p, dims );
+	    if( dl < dr )
+	    {
+		stack[top++] = node.left + 1;
+		stack[top++] = node.left;
+	    }
+	    else
+	    {
+		stack[top++] = node.left;
+		stack[top++] = node.left + 1;
+	    }
+	}
+    }
+
+    return found;
+}
@@ -0,0 +1,148 @@
+#ifndef ENVIRE_POINT_BVH__
+#define ENVIRE_POINT_BVH__
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <boost/cstdint.hpp>
+
+#include <vector>
+
+namespace envire
+{
+
+/**
+ * Bounding volume hierarchy over a set of 3d points.
+ *
+ * The hierarchy is built in bulk by splitting the points at the median of
+ * the longest axis, until a node has at most leafSize points. The nodes are
+ * stored in a flat array, and the points are stored in the order of the
+ * leaves, so that the queries touch consecutive memory.
+ *
+ * The hierarchy keeps a copy of the points, and needs to be rebuilt if the
+ * points change. Queries are const and don't allocate memory, so they can
+ * be used from multiple threads.
+ */
+class PointBVH
+{
+public:
+    typedef Eigen::AlignedBox<double, 3> Box;
+
+    PointBVH();
+
+    /** builds the hierarchy for the given points. The indices reported
+     * by the queries refer to this array. */
+    void build( const std::vector<Eigen::Vector3d>& points, size_t leafSize = 16 );
+
+    void clear();
+
+    bool empty() const { return nodes.empty(); }
+
+    /** @return number of points in the hierarchy */
+    size_t size() const { return points.size(); }
+
+    /** @return the bounding box of all points */
+    Box getBounds() const { return nodes.empty() ? Box() : nodes[0].bounds; }
+
+    /** calls f( index, point ) for each point inside of the box */
+    template <class F>
+    void forEachInBox( const Box& box, F& f ) const
+    {
+	BoxVisitor<F> visitor( box, f );
+	traverse( visitor );
+    }
+
+    /**
+     * Finds the point closest to p with a distance below maxDist.
+     *
+     * @param dims - 3 for the euclidean distance, 2 for the distance in the
+     *               xy plane only
+     * @param index - index of the point which was found
+     * @param point - the point which was found
+     * @return true if a point was found
+     */
+    bool findNearest( const Eigen::Vector3d& p, double maxDist, size_t& index, Eigen::Vector3d& point, size_t dims = 3 ) const;
+
+    enum Overlap { OUTSIDE, INTERSECTS, INSIDE };
+
+    /**
+     * Generic traversal, which can be used for culling. visitor.visit( box )
+     * is called for the nodes, and returns OUTSIDE to skip the node, INSIDE
+     * to accept all points of the node without further tests, or
+     * INTERSECTS to descend into the node. visitor.test( point ) is called
+     * for points of intersected leaves, and visitor( index, point ) for all
+     * accepted points.
+     */
+    template <class V>
+    void traverse( V& visitor ) const
+    {
+	if( nodes.empty() )
+	    return;
+
+	boost::uint32_t stack[64];
+	int top = 0;
+	stack[top++] = 0;
+	while( top )
+	{
+	    const Node& node( nodes[stack[--top]] );
+	    const Overlap overlap = visitor.visit( node.bounds );
+	    if( overlap == OUTSIDE )
+		continue;
+
+	    if( overlap == INSIDE )
+	    {
+		for( size_t i=node.first; i<node.first+node.count; i++ )
+		    visitor( indices[i], points[i] );
+	    }
+	    else if( node.left == NO_CHILD )
+	    {
+		for( size_t i=node.first; i<node.first+node.count; i++ )
+		    if( visitor.test( points[i] ) )
+			visitor( indices[i], points[i] );
+	    }
+	    else
+	    {
+		stack[top++] = node.left + 1;
+		stack[top++] = node.left;
+	    }
+	}
+    }
+
+private:
+    static const boost::uint32_t NO_CHILD = 0xffffffff;
+
+    struct Node
+    {
+	Box bounds;
+	/** range of the points in the node */
+	boost::uint32_t first, count;
+	/** index of the first child, the second child follows it */
+	boost::uint32_t left;
+    };
+
+    template <class F>
+    struct BoxVisitor
+    {
+	const Box& box;
+	F& f;
+	BoxVisitor( const Box& box, F& f ) : box( box ), f( f ) {}
+	Overlap visit( const Box& bounds ) const
+	{
+	    if( !( (box.min().array() <= bounds.max().array()).all() &&
+			(bounds.min().array() <= box.max().array()).all() ) )
+		return OUTSIDE;
+	    return box.contains( bounds ) ? INSIDE : INTERSECTS;
+	}
+	bool test( const Eigen::Vector3d& p ) const { return box.contains( p ); }
+	void operator()( size_t index, const Eigen::Vector3d& p ) { f( index, p ); }
+    };
+
+    void build( boost::uint32_t idx, size_t first, size_t last, size_t leafSize );
+
+    std::vector<Node> nodes;
+    std::vector<boost::uint32_t> indices;
+    std::vector<Eigen::Vector3d> points;
+};
+
+}
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef __ENVIRE_TOOLS_POINTTRANSFORM_HPP__
+#define __ENVIRE_TOOLS_POINTTRANSFORM_HPP__
+
+#include <envire/tools/Parallel.hpp>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include <algorithm>
+
+// transformations of arrays of 3d vectors. The arrays are mapped as 3xN
+// matrices, so that Eigen can use vectorized matrix products on them.
+
+namespace envire
+{
+    namespace detail
+    {
+	typedef Eigen::Map<const Eigen::Matrix<double, 3, Eigen::Dynamic> > ConstPointBlock;
+	typedef Eigen::Map<Eigen::Matrix<double, 3, Eigen::Dynamic> > PointBlock;
+
+	/** number of points which are transformed at once, so that a block
+	 * stays in the cache between the product and the translation */
+	static const size_t pointTransformBlockSize = 1024;
+
+	struct TransformPoints
+	{
+	    Eigen::Matrix3d linear;
+	    Eigen::Vector3d translation;
+	    bool translate;
+	    const Eigen::Vector3d* in;
+	    Eigen::Vector3d* out;
+
+	    void operator()( size_t begin, size_t end )
+	    {
+		for( size_t i=begin; i<end; i+=pointTransformBlockSize )
+		{
+		    const size_t n = std::min( pointTransformBlockSize, end - i );
+		    ConstPointBlock src( in[i].data(), 3, n );
+		    PointBlock dst( out[i].data(), 3, n );
+		    if( in == out )
+			dst = linear * src;
+		    else
+			dst.noalias() = linear * src;
+		    if( translate )
+			dst.colwise() += translation;
+		}
+	    }
+	};
+    }
+
+    /**
+     * Sets out[i] = t * in[i] for the n points in. Large arrays are
+     * processed on multiple threads. in and out may be the same array, but
+     * must not overlap otherwise.
+     */
+    inline void transformPoints( const Eigen::Affine3d& t, const Eigen::Vector3d* in, size_t n, Eigen::Vector3d* out )
+    {
+	detail::TransformPoints kernel;
+	kernel.linear = t.linear();
+	kernel.translation = t.translation();
+	kernel.translate = true;
+	kernel.in = in;
+	kernel.out = out;
+	parallelFor( 0, n, kernel, 64 * 1024 );
+    }
+
+    /** Sets out[i] = r * in[i] for the n vectors in, see transformPoints */
+    inline void rotateVectors( const Eigen::Matrix3d& r, const Eigen::Vector3d* in, size_t n, Eigen::Vector3d* out )
+    {
+	detail::TransformPoints kernel;
+	kernel.linear = r;
+	kernel.translation.setZero();
+	kernel.translate = false;
+	kernel.in = in;
+	kernel.out = out;
+	parallelFor( 0, n, kernel, 64 * 1024 );
+    }
+}
+
+#endif
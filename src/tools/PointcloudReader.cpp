@@ -0,0 +1,400 @@
+#include "PointcloudReader.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/cstdint.hpp>
+
+using namespace envire;
+
+namespace
+{
+    enum PlyType
+    {
+	PLY_INT8, PLY_UINT8, PLY_INT16, PLY_UINT16,
+	PLY_INT32, PLY_UINT32, PLY_FLOAT32, PLY_FLOAT64
+    };
+
+    int plyType( const std::string& name )
+    {
+	if( name == "char" || name == "int8" ) return PLY_INT8;
+	if( name == "uchar" || name == "uint8" ) return PLY_UINT8;
+	if( name == "short" || name == "int16" ) return PLY_INT16;
+	if( name == "ushort" || name == "uint16" ) return PLY_UINT16;
+	if( name == "int" || name == "int32" ) return PLY_INT32;
+	if( name == "uint" || name == "uint32" ) return PLY_UINT32;
+	if( name == "float" || name == "float32" ) return PLY_FLOAT32;
+	if( name == "double" || name == "float64" ) return PLY_FLOAT64;
+	throw std::runtime_error("unknown ply property type '" + name + "'.");
+    }
+
+    size_t plyTypeSize( int type )
+    {
+	static const size_t sizes[] = { 1, 1, 2, 2, 4, 4, 4, 8 };
+	return sizes[type];
+    }
+
+    template <class T>
+    double decode( const char* data )
+    {
+	T value;
+	memcpy( &value, data, sizeof(T) );
+	return value;
+    }
+}
+
+PointcloudReader::PointcloudReader( const std::string& filename, int sample, bool textWithColor )
+    : filename( filename ), sample( std::max( sample, 1 ) ), format( TEXT ),
+    textWithColor( textWithColor ), vertexIndex( 0 ), separateColor( false ),
+    vertexRead( 0 ), pointsRead( 0 ), fileSize( 0 ), dataStart( 0 )
+{
+    is.open( filename.c_str(), std::ios::in | std::ios::binary );
+    if( is.fail() )
+	throw std::runtime_error("Could not open file '" + filename + "'.");
+
+    is.seekg( 0, std::ios::end );
+    fileSize = is.tellg();
+    is.seekg( 0, std::ios::beg );
+
+    std::fill( propIdx, propIdx + 3, -1 );
+    std::fill( colorIdx, colorIdx + 3, -1 );
+
+    if( boost::algorithm::iends_with( filename, ".ply" ) )
+	readPlyHeader();
+}
+
+void PointcloudReader::readPlyHeader()
+{
+    std::string line;
+    std::getline( is, line );
+    boost::algorithm::trim( line );
+    if( line != "ply" )
+	throw std::runtime_error("file '" + filename + "' is not a ply file.");
+
+    bool endHeader = false;
+    while( !endHeader && std::getline( is, line ) )
+    {
+	std::istringstream ls( line );
+	std::string keyword;
+	ls >> keyword;
+	if( keyword == "format" )
+	{
+	    std::string f;
+	    ls >> f;
+	    if( f == "ascii" ) format = PLY_ASCII;
+	    else if( f == "binary_little_endian" ) format = PLY_BINARY_LE;
+	    else if( f == "binary_big_endian" ) format = PLY_BINARY_BE;
+	    else throw std::runtime_error("unknown ply format '" + f + "'.");
+	}
+	else if( keyword == "element" )
+	{
+	    Element e;
+	    ls >> e.name >> e.count;
+	    elements.push_back( e );
+	}
+	else if( keyword == "property" )
+	{
+	    if( elements.empty() )
+		throw std::runtime_error("ply property without element in '" + filename + "'.");
+	    Element& e( elements.back() );
+	    std::string type;
+	    ls >> type;
+	    Property p;
+	    if( type == "list" )
+	    {
+		std::string sizeType, valueType;
+		ls >> sizeType >> valueType >> p.name;
+		e.hasList = true;
+		p.type = plyType( valueType );
+	    }
+	    else
+	    {
+		ls >> p.name;
+		p.type = plyType( type );
+	    }
+	    p.offset = e.stride;
+	    e.stride += plyTypeSize( p.type );
+	    e.properties.push_back( p );
+	}
+	else if( keyword == "end_header" )
+	    endHeader = true;
+    }
+    if( !endHeader )
+	throw std::runtime_error("ply header of '" + filename + "' is incomplete.");
+
+    dataStart = is.tellg();
+
+    // find the vertex element and the byte offset of its data
+    std::streamoff offset = dataStart;
+    size_t lineOffset = 0;
+    bool found = false;
+    for( size_t i=0; i<elements.size() && !found; i++ )
+    {
+	if( elements[i].name == "vertex" )
+	{
+	    vertexIndex = i;
+	    found = true;
+	}
+	else
+	{
+	    if( elements[i].hasList && format != PLY_ASCII )
+		throw std::runtime_error("ply elements with lists before the vertex element are not supported.");
+	    offset += elements[i].stride * elements[i].count;
+	    lineOffset += elements[i].count;
+	}
+    }
+    if( !found )
+	throw std::runtime_error("no vertex element in ply file '" + filename + "'.");
+
+    vertex = elements[vertexIndex];
+    if( vertex.hasList )
+	throw std::runtime_error("list properties in the vertex element are not supported.");
+
+    static const char* coords[] = { "x", "y", "z" };
+    static const char* rgb[] = { "red", "green", "blue" };
+    for( size_t i=0; i<vertex.properties.size(); i++ )
+    {
+	for( int j=0; j<3; j++ )
+	{
+	    if( vertex.properties[i].name == coords[j] )
+		propIdx[j] = i;
+	    if( vertex.properties[i].name == rgb[j] )
+		colorIdx[j] = i;
+	}
+    }
+    if( propIdx[0] < 0 || propIdx[1] < 0 || propIdx[2] < 0 )
+	throw std::runtime_error("vertex element in '" + filename + "' is missing coordinates.");
+
+    if( format == PLY_ASCII )
+    {
+	for( size_t i=0; i<lineOffset; i++ )
+	    is.ignore( std::numeric_limits<std::streamsize>::max(), '\n' );
+	return;
+    }
+
+    is.seekg( offset );
+
+    // colors might be stored in a separate element of the same size, which
+    // is how PlyFile writes them. Since these elements have a fixed size in
+    // binary files, a second stream can be used to read them in parallel.
+    if( colorIdx[0] < 0 )
+    {
+	std::streamoff colorOffset = dataStart;
+	for( size_t i=0; i<elements.size(); i++ )
+	{
+	    if( elements[i].hasList )
+		break;
+	    if( elements[i].name == "color" && elements[i].count == vertex.count )
+	    {
+		color = elements[i];
+		for( size_t p=0; p<color.properties.size(); p++ )
+		    for( int j=0; j<3; j++ )
+			if( color.properties[p].name == rgb[j] )
+			    colorIdx[j] = p;
+
+		if( colorIdx[0] >= 0 && colorIdx[1] >= 0 && colorIdx[2] >= 0 )
+		{
+		    colorStream.open( filename.c_str(), std::ios::in | std::ios::binary );
+		    colorStream.seekg( colorOffset );
+		    separateColor = true;
+		}
+		else
+		    std::fill( colorIdx, colorIdx + 3, -1 );
+		break;
+	    }
+	    colorOffset += elements[i].stride * elements[i].count;
+	}
+    }
+}
+
+bool PointcloudReader::hasColor() const
+{
+    if( format == TEXT )
+	return textWithColor;
+    return colorIdx[0] >= 0 && colorIdx[1] >= 0 && colorIdx[2] >= 0;
+}
+
+size_t PointcloudReader::getPointsRead() const
+{
+    return pointsRead;
+}
+
+size_t PointcloudReader::getPointCount() const
+{
+    return format == TEXT ? 0 : vertex.count;
+}
+
+double PointcloudReader::getProgress()
+{
+    if( format != TEXT && format != PLY_ASCII )
+	return vertex.count ? double(vertexRead) / vertex.count : 1.0;
+
+    if( !is.good() || fileSize <= 0 )
+	return 1.0;
+    return double( is.tellg() ) / fileSize;
+}
+
+bool PointcloudReader::keepSample() const
+{
+    return sample == 1 || (rand() % sample == 0);
+}
+
+size_t PointcloudReader::read( std::vector<Eigen::Vector3d>& points, std::vector<Eigen::Vector3d>* colors, size_t maxPoints )
+{
+    points.clear();
+    if( colors )
+	colors->clear();
+
+    if( !hasColor() )
+	colors = NULL;
+
+    size_t n = 0;
+    switch( format )
+    {
+	case TEXT: n = readText( points, colors, maxPoints ); break;
+	case PLY_ASCII: n = readPlyAscii( points, colors, maxPoints ); break;
+	default: n = readPlyBinary( points, colors, maxPoints ); break;
+    }
+    pointsRead += n;
+    return n;
+}
+
+size_t PointcloudReader::readText( std::vector<Eigen::Vector3d>& points, std::vector<Eigen::Vector3d>* colors, size_t maxPoints )
+{
+    // this follows the behaviour of Pointcloud::readText
+    const int max_line_length = 255;
+    while( !is.eof() && points.size() < maxPoints )
+    {
+	if( keepSample() )
+	{
+	    double x, y, z, c;
+	    is >> x >> y >> z;
+	    if( textWithColor )
+	    {
+		is >> c;
+		if( colors )
+		    colors->push_back( Eigen::Vector3d::Identity() * c / 255.0 );
+	    }
+
+	    points.push_back( Eigen::Vector3d( x,y,z ) );
+	    is.ignore( max_line_length, '\n' );
+	}
+	else
+	    is.ignore( max_line_length, '\n' );
+        // check for eof bit, to avoid a copy of the last sample
+        is.peek();
+    }
+    return points.size();
+}
+
+size_t PointcloudReader::readPlyAscii( std::vector<Eigen::Vector3d>& points, std::vector<Eigen::Vector3d>* colors, size_t maxPoints )
+{
+    std::vector<double> values( vertex.properties.size() );
+    std::string line;
+    while( vertexRead < vertex.count && points.size() < maxPoints && std::getline( is, line ) )
+    {
+	vertexRead++;
+	if( !keepSample() )
+	    continue;
+
+	std::istringstream ls( line );
+	for( size_t i=0; i<values.size(); i++ )
+	    ls >> values[i];
+
+	points.push_back( Eigen::Vector3d( values[propIdx[0]], values[propIdx[1]], values[propIdx[2]] ) );
+	if( colors )
+	{
+	    Eigen::Vector3d c( values[colorIdx[0]], values[colorIdx[1]], values[colorIdx[2]] );
+	    if( vertex.properties[colorIdx[0]].type == PLY_UINT8 )
+		c /= 255.0;
+	    colors->push_back( c );
+	}
+    }
+    return points.size();
+}
+
+double PointcloudReader::getValue( const char* data, int type ) const
+{
+    char swapped[8];
+    if( format == PLY_BINARY_BE )
+    {
+	std::reverse_copy( data, data + plyTypeSize( type ), swapped );
+	data = swapped;
+    }
+
+    switch( type )
+    {
+	case PLY_INT8: return decode<boost::int8_t>( data );
+	case PLY_UINT8: return decode<boost::uint8_t>( data );
+	case PLY_INT16: return decode<boost::int16_t>( data );
+	case PLY_UINT16: return decode<boost::uint16_t>( data );
+	case PLY_INT32: return decode<boost::int32_t>( data );
+	case PLY_UINT32: return decode<boost::uint32_t>( data );
+	case PLY_FLOAT32: return decode<float>( data );
+	default: return decode<double>( data );
+    }
+}
+
+size_t PointcloudReader::readPlyBinary( std::vector<Eigen::Vector3d>& points, std::vector<Eigen::Vector3d>* colors, size_t maxPoints )
+{
+    // keep reading blocks until at least one point survived the sampling
+    while( points.empty() && vertexRead < vertex.count )
+    {
+	const size_t count = std::min( maxPoints, vertex.count - vertexRead );
+	buffer.resize( count * vertex.stride );
+	is.read( &buffer[0], buffer.size() );
+	if( static_cast<size_t>( is.gcount() ) != buffer.size() )
+	    throw std::runtime_error("unexpected end of ply file '" + filename + "'.");
+
+	const Element& ce( separateColor ? color : vertex );
+	const char* cdata = &buffer[0];
+	if( colors && separateColor )
+	{
+	    colorBuffer.resize( count * color.stride );
+	    colorStream.read( &colorBuffer[0], colorBuffer.size() );
+	    if( static_cast<size_t>( colorStream.gcount() ) != colorBuffer.size() )
+		throw std::runtime_error("unexpected end of ply file '" + filename + "'.");
+	    cdata = &colorBuffer[0];
+	}
+	vertexRead += count;
+
+	points.reserve( count );
+	if( colors )
+	    colors->reserve( count );
+
+	for( size_t i=0; i<count; i++ )
+	{
+	    if( !keepSample() )
+		continue;
+
+	    const char* v = &buffer[i * vertex.stride];
+	    Eigen::Vector3d p;
+	    for( int j=0; j<3; j++ )
+	    {
+		const Property& prop( vertex.properties[propIdx[j]] );
+		p[j] = getValue( v + prop.offset, prop.type );
+	    }
+	    points.push_back( p );
+
+	    if( colors )
+	    {
+		const char* c = cdata + i * ce.stride;
+		Eigen::Vector3d col;
+		for( int j=0; j<3; j++ )
+		{
+		    const Property& prop( ce.properties[colorIdx[j]] );
+		    col[j] = getValue( c + prop.offset, prop.type );
+		    if( prop.type == PLY_UINT8 )
+			col[j] /= 255.0;
+		}
+		colors->push_back( col );
+	    }
+	}
+    }
+    return points.size();
+}
@@ -0,0 +1,130 @@
+#ifndef __ENVIRE_POINTCLOUDREADER_HPP__
+#define __ENVIRE_POINTCLOUDREADER_HPP__
+
+#include <Eigen/Core>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace envire
+{
+    /**
+     * Sequential reader for pointcloud files, which does not need to hold the
+     * whole file in memory. Points are returned in chunks of a given maximum
+     * size, so that arbitrarily large files can be processed with bounded
+     * memory.
+     *
+     * Supported formats are ply files (ascii and binary, with the vertex
+     * coordinates as scalar properties of the vertex element) and text files
+     * with one point per line, in the same format as Pointcloud::readText.
+     * The format is chosen based on the file extension, where everything
+     * which is not ".ply" is treated as text.
+     *
+     * Colors are read from red/green/blue properties of the vertex element,
+     * or from a separate color element as written by PlyFile for binary ply
+     * files. For text files, the XYZR format of Pointcloud::readText is used
+     * when enabled.
+     */
+    class PointcloudReader
+    {
+    public:
+	/** opens the given file for reading
+	 * @param filename - path to the ply or text file
+	 * @param sample - only read every n-th point on average (same semantics
+	 *                 as the sample parameter of Pointcloud::readText)
+	 * @param textWithColor - for text files, expect a fourth column with
+	 *                 the reflectance value (XYZR format)
+	 *
+	 * @throw std::runtime_error if the file could not be opened or has an
+	 *        unsupported header
+	 */
+	PointcloudReader( const std::string& filename, int sample = 1, bool textWithColor = false );
+
+	/**
+	 * read the next chunk of points. The vectors are cleared before
+	 * reading.
+	 *
+	 * @param points - vector which receives the points
+	 * @param colors - if not NULL and the file provides colors, this vector
+	 *                 will receive the color for each point
+	 * @param maxPoints - maximum number of points to read
+	 * @return the number of points which have been read. 0 if the end of
+	 *         the file has been reached.
+	 */
+	size_t read( std::vector<Eigen::Vector3d>& points, std::vector<Eigen::Vector3d>* colors, size_t maxPoints );
+
+	/** @return true if the points in the file have color information */
+	bool hasColor() const;
+
+	/** @return the total number of points that have been read so far */
+	size_t getPointsRead() const;
+
+	/** @return the number of points in the file if known (ply files), or 0
+	 * otherwise */
+	size_t getPointCount() const;
+
+	/** @return an estimate of the progress through the file in the range
+	 * [0,1], based on the number of bytes consumed */
+	double getProgress();
+
+	const std::string& getFilename() const { return filename; }
+
+    private:
+	struct Property
+	{
+	    std::string name;
+	    int type;
+	    size_t offset;
+	};
+
+	struct Element
+	{
+	    Element() : count( 0 ), stride( 0 ), hasList( false ) {}
+
+	    std::string name;
+	    size_t count;
+	    std::vector<Property> properties;
+	    size_t stride;
+	    bool hasList;
+	};
+
+	enum Format
+	{
+	    TEXT,
+	    PLY_ASCII,
+	    PLY_BINARY_LE,
+	    PLY_BINARY_BE
+	};
+
+	void readPlyHeader();
+	size_t readText( std::vector<Eigen::Vector3d>& points, std::vector<Eigen::Vector3d>* colors, size_t maxPoints );
+	size_t readPlyAscii( std::vector<Eigen::Vector3d>& points, std::vector<Eigen::Vector3d>* colors, size_t maxPoints );
+	size_t readPlyBinary( std::vector<Eigen::Vector3d>& points, std::vector<Eigen::Vector3d>* colors, size_t maxPoints );
+	double getValue( const char* data, int type ) const;
+	bool keepSample() const;
+
+	std::string filename;
+	std::ifstream is;
+	std::ifstream colorStream;
+	int sample;
+	Format format;
+	bool textWithColor;
+
+	std::vector<Element> elements;
+	Element vertex;
+	size_t vertexIndex;
+	int propIdx[3];
+	int colorIdx[3];
+	Element color;
+	bool separateColor;
+
+	size_t vertexRead;
+	size_t pointsRead;
+	std::streamoff fileSize;
+	std::streamoff dataStart;
+	std::vector<char> buffer;
+	std::vector<char> colorBuffer;
+    };
+}
+
+#endif
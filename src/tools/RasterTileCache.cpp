@@ -0,0 +1,156 @@
+#include "RasterTileCache.hpp"
+
+#include <gdal/gdal_priv.h>
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+
+using namespace envire;
+
+RasterTileCache::RasterTileCache( const std::string& path, int bandIndex, size_t memoryBudget )
+    : dataset( NULL ), band( NULL ), path( path ), lastTile( NULL )
+{
+    GDALAllRegister();
+    dataset = (GDALDataset *) GDALOpen( path.c_str(), GA_ReadOnly );
+    if( dataset == NULL )
+	throw std::runtime_error("can not open file " + path);
+
+    if( bandIndex < 1 || dataset->GetRasterCount() < bandIndex )
+    {
+	std::stringstream strstr;
+	strstr << "file " << path << " has " << dataset->GetRasterCount()
+	    << " raster bands but the band " << bandIndex << " is required";
+	GDALClose( (GDALDatasetH) dataset );
+	throw std::runtime_error(strstr.str());
+    }
+    band = dataset->GetRasterBand( bandIndex );
+
+    cellSizeX = dataset->GetRasterXSize();
+    cellSizeY = dataset->GetRasterYSize();
+
+    // same interpretation of the geotransform as in Grid::readGridData
+    double adfGeoTransform[6];
+    if( dataset->GetGeoTransform( adfGeoTransform ) == CE_Failure )
+    {
+	adfGeoTransform[0] = 0; adfGeoTransform[1] = 1; adfGeoTransform[2] = 0;
+	adfGeoTransform[3] = 0; adfGeoTransform[4] = 0; adfGeoTransform[5] = 1;
+    }
+    scalex = fabs( adfGeoTransform[1] );
+    scaley = fabs( adfGeoTransform[5] );
+    xReversed = adfGeoTransform[1] < 0;
+    yReversed = adfGeoTransform[5] < 0;
+
+    double offsetx = adfGeoTransform[0];
+    double offsety = adfGeoTransform[3];
+    if( xReversed )
+	offsetx -= cellSizeX * scalex;
+    if( yReversed )
+	offsety -= cellSizeY * scaley;
+    transform = Transform( Eigen::Translation3d( offsetx, offsety, 0 ) );
+
+    int has_nodata = 0;
+    noData = band->GetNoDataValue( &has_nodata );
+    hasNoData = has_nodata;
+
+    // use the block size of the file for the tiles. Files which are stored
+    // in lines get tiles of multiple lines, so that a tile is not too small.
+    int blockX = 0, blockY = 0;
+    band->GetBlockSize( &blockX, &blockY );
+    tileSizeX = std::max( blockX, 1 );
+    tileSizeY = std::max( blockY, 1 );
+    const size_t minTileCells = 64 * 1024;
+    if( tileSizeX * tileSizeY < minTileCells )
+	tileSizeY *= std::max( minTileCells / (tileSizeX * tileSizeY), size_t(1) );
+    tileSizeX = std::min( tileSizeX, std::max( cellSizeX, size_t(1) ) );
+    tileSizeY = std::min( tileSizeY, std::max( cellSizeY, size_t(1) ) );
+
+    maxTiles = std::max( memoryBudget / (tileSizeX * tileSizeY * sizeof(double)), size_t(1) );
+}
+
+RasterTileCache::~RasterTileCache()
+{
+    GDALClose( (GDALDatasetH) dataset );
+}
+
+bool RasterTileCache::getNoData( double& value ) const
+{
+    if( hasNoData )
+	value = noData;
+    return hasNoData;
+}
+
+bool RasterTileCache::toGrid( double x, double y, size_t& xi, size_t& yi ) const
+{
+    const double fx = std::floor( x / scalex );
+    const double fy = std::floor( y / scaley );
+    if( fx < 0 || fy < 0 || fx >= cellSizeX || fy >= cellSizeY )
+	return false;
+
+    xi = fx;
+    yi = fy;
+    return true;
+}
+
+double RasterTileCache::get( size_t xi, size_t yi )
+{
+    if( xi >= cellSizeX || yi >= cellSizeY )
+	throw std::out_of_range("RasterTileCache: cell index is out of the raster.");
+
+    // position in the file
+    const size_t fx = xReversed ? cellSizeX - 1 - xi : xi;
+    const size_t fy = yReversed ? cellSizeY - 1 - yi : yi;
+
+    const TileIndex idx( fx / tileSizeX, fy / tileSizeY );
+    Tile* tile = lastTile;
+    if( !tile || idx != lastIndex )
+    {
+	tile = &getTile( idx );
+	lastIndex = idx;
+	lastTile = tile;
+    }
+
+    return tile->data[(fy % tileSizeY) * tileSizeX + fx % tileSizeX];
+}
+
+RasterTileCache::Tile& RasterTileCache::getTile( const TileIndex& idx )
+{
+    std::map<TileIndex, Tile>::iterator it = tiles.find( idx );
+    if( it != tiles.end() )
+    {
+	lru.splice( lru.begin(), lru, it->second.lru );
+	return it->second;
+    }
+
+    while( tiles.size() >= maxTiles )
+    {
+	lastTile = NULL;
+	tiles.erase( lru.back() );
+	lru.pop_back();
+	stats.tilesEvicted++;
+    }
+
+    // tiles at the border of the raster are smaller, but use the same
+    // line stride
+    const size_t x = idx.first * tileSizeX;
+    const size_t y = idx.second * tileSizeY;
+    const size_t width = std::min( tileSizeX, cellSizeX - x );
+    const size_t height = std::min( tileSizeY, cellSizeY - y );
+
+    Tile& tile( tiles[idx] );
+    tile.data.resize( tileSizeX * tileSizeY );
+    if( band->RasterIO( GF_Read, x, y, width, height,
+		&tile.data[0], width, height, GDT_Float64,
+		sizeof(double), sizeof(double) * tileSizeX ) == CE_Failure )
+    {
+	tiles.erase( idx );
+	throw std::runtime_error("RasterTileCache: could not read from file " + path);
+    }
+
+    lru.push_front( idx );
+    tile.lru = lru.begin();
+    stats.tilesLoaded++;
+
+    return tile;
+}
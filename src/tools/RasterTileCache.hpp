@@ -0,0 +1,124 @@
+#ifndef __ENVIRE_RASTERTILECACHE_HPP__
+#define __ENVIRE_RASTERTILECACHE_HPP__
+
+#include <envire/core/Transform.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+class GDALDataset;
+class GDALRasterBand;
+
+namespace envire
+{
+    /**
+     * Lazy access to a band of a GDAL-readable raster, which does not need
+     * to fit into memory.
+     *
+     * The raster is split into tiles, which are aligned with the blocks of
+     * the file, so a tiled GeoTiff (as written by Grid::writeGridData) can be
+     * accessed efficiently. A tile is read from the file on the first access
+     * to one of its cells, and the least recently used tiles are dropped
+     * when the memory budget is exceeded.
+     *
+     * Cell coordinates have the same orientation as the grids created by
+     * GridBase::readGridFromGdal, and getTransform() returns the same
+     * transform. The values are converted to double.
+     *
+     * Note, that this class is not thread-safe, since each access can modify
+     * the cache.
+     */
+    class RasterTileCache : boost::noncopyable
+    {
+    public:
+	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+	struct Statistics
+	{
+	    Statistics() : tilesLoaded( 0 ), tilesEvicted( 0 ) {}
+
+	    /** number of times a tile was read from the file */
+	    size_t tilesLoaded;
+	    /** number of times a tile was dropped from the cache */
+	    size_t tilesEvicted;
+	};
+
+	/**
+	 * @param path - file name of the raster
+	 * @param band - the band index in the file
+	 * @param memoryBudget - maximum size of the cached tiles in bytes. At
+	 *                       least one tile is always kept.
+	 */
+	RasterTileCache( const std::string& path, int band = 1, size_t memoryBudget = 256 * 1024 * 1024 );
+	~RasterTileCache();
+
+	size_t getCellSizeX() const { return cellSizeX; }
+	size_t getCellSizeY() const { return cellSizeY; }
+	double getScaleX() const { return scalex; }
+	double getScaleY() const { return scaley; }
+
+	/** @return the transformation of the raster frame, which has its
+	 * origin at the corner of the cell (0, 0) */
+	const Transform& getTransform() const { return transform; }
+
+	/** @return true if the band has a nodata value, which is returned in
+	 * value */
+	bool getNoData( double& value ) const;
+
+	/** converts a position in the raster frame to the cell index.
+	 * @return false if the position is outside the raster */
+	bool toGrid( double x, double y, size_t& xi, size_t& yi ) const;
+
+	/** @return the value of the cell (xi, yi) */
+	double get( size_t xi, size_t yi );
+
+	/** size of a tile in cells */
+	size_t getTileSizeX() const { return tileSizeX; }
+	size_t getTileSizeY() const { return tileSizeY; }
+
+	/** @return the number of tiles currently held in memory */
+	size_t getResidentTiles() const { return tiles.size(); }
+
+	const Statistics& getStatistics() const { return stats; }
+
+    private:
+	typedef std::pair<size_t, size_t> TileIndex;
+
+	struct Tile
+	{
+	    std::vector<double> data;
+	    std::list<TileIndex>::iterator lru;
+	};
+
+	Tile& getTile( const TileIndex& idx );
+
+	GDALDataset *dataset;
+	GDALRasterBand *band;
+	std::string path;
+
+	size_t cellSizeX, cellSizeY;
+	double scalex, scaley;
+	bool xReversed, yReversed;
+	Transform transform;
+	bool hasNoData;
+	double noData;
+
+	size_t tileSizeX, tileSizeY;
+	size_t maxTiles;
+
+	std::map<TileIndex, Tile> tiles;
+	/** tile indices, with the most recently used first */
+	std::list<TileIndex> lru;
+	/** last accessed tile, which avoids the map lookup for subsequent
+	 * accesses to the same tile */
+	TileIndex lastIndex;
+	Tile* lastTile;
+
+	Statistics stats;
+    };
+}
+
+#endif
@@ -0,0 +1,210 @@
+#include "TiledMLSBuilder.hpp"
+
+#include <envire/Core.hpp>
+
+#include <boost/filesystem.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/math/special_functions/fpclassify.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <stdexcept>
+
+using namespace envire;
+
+namespace
+{
+    /** integer division which rounds towards negative infinity */
+    inline long floorDiv( long a, long b )
+    {
+	return a >= 0 ? a / b : -((-a + b - 1) / b);
+    }
+}
+
+TiledMLSBuilder::TiledMLSBuilder( const std::string& outputDir, double resolution, size_t tileCells, size_t maxResidentTiles )
+    : outputDir( outputDir ), resolution( resolution ), tileCells( tileCells ),
+    maxResidentTiles( std::max( maxResidentTiles, size_t(1) ) ),
+    defaultUncertainty( 0.01 ), useCounter( 0 )
+{
+    if( resolution <= 0 || tileCells == 0 )
+	throw std::runtime_error("TiledMLSBuilder: resolution and tile size need to be positive.");
+
+    boost::filesystem::create_directories( outputDir );
+}
+
+std::string TiledMLSBuilder::getTileName( int tx, int ty )
+{
+    return "tile_" + boost::lexical_cast<std::string>( tx )
+	+ "_" + boost::lexical_cast<std::string>( ty );
+}
+
+Eigen::Vector2d TiledMLSBuilder::getTileOrigin( const TileIndex& idx ) const
+{
+    const double size = tileCells * resolution;
+    return Eigen::Vector2d( idx.first * size, idx.second * size );
+}
+
+size_t TiledMLSBuilder::getTileCount() const
+{
+    size_t count = storedTiles.size();
+    for( std::map<TileIndex, Tile>::const_iterator it = tiles.begin(); it != tiles.end(); it++ )
+	if( !storedTiles.count( it->first ) )
+	    count++;
+    return count;
+}
+
+TiledMLSBuilder::Tile& TiledMLSBuilder::getTile( const TileIndex& idx, bool useColor )
+{
+    std::map<TileIndex, Tile>::iterator it = tiles.find( idx );
+    if( it != tiles.end() )
+    {
+	it->second.lastUsed = ++useCounter;
+	if( useColor )
+	    it->second.grid->getConfig().useColor = true;
+	return it->second;
+    }
+
+    // make room by writing out the least recently used tiles
+    while( tiles.size() >= maxResidentTiles )
+    {
+	std::map<TileIndex, Tile>::iterator lru = tiles.begin();
+	for( std::map<TileIndex, Tile>::iterator t = tiles.begin(); t != tiles.end(); t++ )
+	    if( t->second.lastUsed < lru->second.lastUsed )
+		lru = t;
+	flushTile( lru->first );
+    }
+
+    Tile tile;
+    tile.lastUsed = ++useCounter;
+    if( storedTiles.count( idx ) )
+    {
+	const std::string path =
+	    (boost::filesystem::path( outputDir ) / getTileName( idx.first, idx.second )).string();
+	boost::scoped_ptr<Environment> env( Environment::unserialize( path ) );
+	std::vector<MLSGrid*> grids = env->getItems<MLSGrid>();
+	if( grids.size() != 1 )
+	    throw std::runtime_error("TiledMLSBuilder: tile " + path + " does not contain a single MLSGrid.");
+
+	tile.grid = grids.front();
+	env->detachItem( tile.grid.get() );
+	// a tile keeps its colors when it is loaded again
+	useColor |= tile.grid->getConfig().useColor;
+	stats.tilesLoaded++;
+    }
+    else
+    {
+	tile.grid = new MLSGrid( tileCells, tileCells, resolution, resolution );
+	stats.tilesCreated++;
+    }
+    tile.grid->getConfig() = config;
+    if( useColor )
+	tile.grid->getConfig().useColor = true;
+
+    return tiles.insert( std::make_pair( idx, tile ) ).first->second;
+}
+
+void TiledMLSBuilder::flushTile( const TileIndex& idx )
+{
+    std::map<TileIndex, Tile>::iterator it = tiles.find( idx );
+    assert( it != tiles.end() );
+
+    const Eigen::Vector2d origin = getTileOrigin( idx );
+
+    // put the grid into its own environment, so that each tile can also be
+    // used on its own
+    Environment env;
+    FrameNode *fn = new FrameNode( Transform( Eigen::Translation3d( origin.x(), origin.y(), 0 ) ) );
+    env.addChild( env.getRootNode(), fn );
+    env.attachItem( it->second.grid.get() );
+    env.setFrameNode( it->second.grid.get(), fn );
+
+    env.serialize( (boost::filesystem::path( outputDir ) / getTileName( idx.first, idx.second )).string() );
+    env.detachItem( it->second.grid.get() );
+
+    storedTiles.insert( idx );
+    tiles.erase( it );
+    stats.tilesFlushed++;
+}
+
+void TiledMLSBuilder::addPoints( const std::vector<Eigen::Vector3d>& points, const Eigen::Affine3d& transform,
+	const std::vector<double>* variances, const std::vector<Eigen::Vector3d>* colors )
+{
+    const bool hasUncertainty = variances && variances->size() == points.size();
+    if( colors && colors->size() != points.size() )
+	colors = NULL;
+
+    // sort the points into buckets for each tile first, so that each tile
+    // only needs to be accessed once per call. The order of the points
+    // within a tile is preserved.
+    std::vector<Eigen::Vector3d> transformed( points.size() );
+    std::map<TileIndex, std::vector<size_t> > buckets;
+    const long cells = tileCells;
+    for( size_t i=0; i<points.size(); i++ )
+    {
+	transformed[i] = transform * points[i];
+	if( !boost::math::isfinite( transformed[i].x() ) || !boost::math::isfinite( transformed[i].y() ) )
+	    continue;
+	const long cx = std::floor( transformed[i].x() / resolution );
+	const long cy = std::floor( transformed[i].y() / resolution );
+	buckets[TileIndex( floorDiv( cx, cells ), floorDiv( cy, cells ) )].push_back( i );
+    }
+
+    for( std::map<TileIndex, std::vector<size_t> >::iterator bit = buckets.begin(); bit != buckets.end(); bit++ )
+    {
+	MLSGrid* grid = getTile( bit->first, colors != NULL ).grid.get();
+
+	const Eigen::Vector2d origin = getTileOrigin( bit->first );
+	const long ox = bit->first.first * cells;
+	const long oy = bit->first.second * cells;
+
+	const std::vector<size_t>& idx( bit->second );
+	for( size_t n=0; n<idx.size(); n++ )
+	{
+	    const size_t i = idx[n];
+	    const Eigen::Vector3d& p( transformed[i] );
+	    const size_t xi = static_cast<long>( std::floor( p.x() / resolution ) ) - ox;
+	    const size_t yi = static_cast<long>( std::floor( p.y() / resolution ) ) - oy;
+
+	    const double p_var = hasUncertainty ? (*variances)[i] : defaultUncertainty;
+
+	    // same patch generation as in MLSProjection and MLSGrid::update
+	    MLSGrid::SurfacePatch patch( p.z(), sqrt(p_var) );
+	    if( colors )
+		patch.setColor( (*colors)[i] );
+
+	    if( config.updateModel == MLSConfiguration::SLOPE )
+	    {
+		const double xmod = p.x() - (xi * resolution + origin.x());
+		const double ymod = p.y() - (yi * resolution + origin.y());
+		patch = MLSGrid::SurfacePatch( Eigen::Vector3f( xmod, ymod, p.z() ), patch.stdev );
+	    }
+
+	    grid->updateCell( xi, yi, patch );
+	}
+	stats.points += idx.size();
+    }
+}
+
+void TiledMLSBuilder::finish()
+{
+    while( !tiles.empty() )
+	flushTile( tiles.begin()->first );
+
+    const std::string indexFile = (boost::filesystem::path( outputDir ) / "tiles.txt").string();
+    std::ofstream os( indexFile.c_str() );
+    if( os.fail() )
+	throw std::runtime_error("Could not open file '" + indexFile + "'.");
+
+    os << "# resolution tile_cells" << std::endl;
+    os << resolution << " " << tileCells << std::endl;
+    os << "# tile_x tile_y origin_x origin_y directory" << std::endl;
+    for( std::set<TileIndex>::iterator it = storedTiles.begin(); it != storedTiles.end(); it++ )
+    {
+	const Eigen::Vector2d origin = getTileOrigin( *it );
+	os << it->first << " " << it->second << " "
+	    << origin.x() << " " << origin.y() << " "
+	    << getTileName( it->first, it->second ) << std::endl;
+    }
+}
@@ -0,0 +1,127 @@
+#ifndef __ENVIRE_TILEDMLSBUILDER_HPP__
+#define __ENVIRE_TILEDMLSBUILDER_HPP__
+
+#include <envire/maps/MLSGrid.hpp>
+#include <Eigen/Geometry>
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace envire
+{
+    /**
+     * Out-of-core construction of large multi-level surface maps.
+     *
+     * The map is split into square tiles of a fixed number of cells, which
+     * are aligned to a global grid with the origin of the world frame. Each
+     * tile is an MLSGrid which is only created when points fall into it. At
+     * most maxResidentTiles tiles are held in memory at the same time. When
+     * this limit is reached, the least recently used tile is written to disk
+     * and removed from memory. If later points fall into a tile which has
+     * been written out, it is loaded again and updated.
+     *
+     * Each tile is stored as a separate environment in a sub-directory of
+     * the output directory (tile_<x>_<y>), containing a framenode with the
+     * position of the tile and the MLSGrid itself. An index file (tiles.txt)
+     * lists all the tiles together with their position in the world frame.
+     *
+     * Since each cell belongs to exactly one tile and the points are added in
+     * the order given, the resulting patches are the same as if all the
+     * points were projected into a single large MLSGrid.
+     */
+    class TiledMLSBuilder
+    {
+    public:
+	struct Statistics
+	{
+	    Statistics()
+		: points( 0 ), tilesCreated( 0 ), tilesFlushed( 0 ), tilesLoaded( 0 ) {}
+
+	    /** total number of points that have been added */
+	    size_t points;
+	    /** number of tiles that have been created */
+	    size_t tilesCreated;
+	    /** number of times a tile has been written to disk */
+	    size_t tilesFlushed;
+	    /** number of times a tile had to be read back from disk */
+	    size_t tilesLoaded;
+	};
+
+	/**
+	 * @param outputDir - directory in which the tiles are stored
+	 * @param resolution - size of a cell in m
+	 * @param tileCells - number of cells in x and y for each tile
+	 * @param maxResidentTiles - maximum number of tiles to keep in memory
+	 */
+	TiledMLSBuilder( const std::string& outputDir, double resolution, size_t tileCells = 512, size_t maxResidentTiles = 16 );
+
+	/** configuration which is used for all the tiles. Needs to be set
+	 * before the first points are added. */
+	MLSConfiguration& getConfig() { return config; }
+
+	/** uncertainty (variance) used for the points when no variances are
+	 * given in addPoints */
+	void setDefaultUncertainty( double variance ) { defaultUncertainty = variance; }
+
+	/**
+	 * Project the given points into the tiled map.
+	 *
+	 * @param points - the points in the frame given by transform
+	 * @param transform - transformation from the points frame to the world
+	 *                    frame
+	 * @param variances - optional per point variances
+	 * @param colors - optional per point colors
+	 */
+	void addPoints( const std::vector<Eigen::Vector3d>& points, const Eigen::Affine3d& transform,
+		const std::vector<double>* variances = NULL,
+		const std::vector<Eigen::Vector3d>* colors = NULL );
+
+	/** writes all the tiles which are still in memory to disk, and
+	 * generates the index file. Needs to be called after the last points
+	 * have been added. */
+	void finish();
+
+	const Statistics& getStatistics() const { return stats; }
+
+	/** @return the number of tiles which are currently held in memory */
+	size_t getResidentTiles() const { return tiles.size(); }
+
+	/** @return the total number of tiles, including the ones on disk */
+	size_t getTileCount() const;
+
+	/** @return the directory name of the tile with the given index
+	 * relative to the output directory */
+	static std::string getTileName( int tx, int ty );
+
+    private:
+	typedef std::pair<int, int> TileIndex;
+
+	struct Tile
+	{
+	    MLSGrid::Ptr grid;
+	    unsigned long lastUsed;
+	};
+
+	/** @return the tile, which is loaded or created if needed. With
+	 * useColor, the colors of the cells of the tile are enabled. */
+	Tile& getTile( const TileIndex& idx, bool useColor );
+	void flushTile( const TileIndex& idx );
+	Eigen::Vector2d getTileOrigin( const TileIndex& idx ) const;
+
+	std::string outputDir;
+	double resolution;
+	size_t tileCells;
+	size_t maxResidentTiles;
+	double defaultUncertainty;
+	MLSConfiguration config;
+
+	std::map<TileIndex, Tile> tiles;
+	std::set<TileIndex> storedTiles;
+	unsigned long useCounter;
+	Statistics stats;
+    };
+}
+
+#endif
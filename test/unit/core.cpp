@@ -5,17 +5,26 @@
 #include "envire/maps/LaserScan.hpp"
 #include "envire/maps/TriMesh.hpp"
 #include "envire/operators/ScanMeshing.hpp"
+#include "envire/operators/MergePointcloud.hpp"
+#include "envire/operators/CutPointcloud.hpp"
+#include <boost/tuple/tuple_comparison.hpp>
 
 #include "envire/core/Event.hpp"
 #include "envire/core/EventHandler.hpp"
+#include "envire/core/Instrumentation.hpp"
 
 #define BOOST_TEST_MODULE EnvireTest 
 #include <boost/test/included/unit_test.hpp>
 #include <boost/scoped_ptr.hpp>
+#include <boost/thread/thread.hpp>
 
 #include "envire/tools/GridAccess.hpp"
 #include "envire/maps/Grids.hpp"
 #include "envire/maps/ElevationGrid.hpp"
+#include "envire/maps/TraversabilityGrid.hpp"
+#ifdef ENVIRE_USE_CGAL
+#include "envire/operators/Projection.hpp"
+#endif
 
 #include "base/TimeMark.hpp"
    
@@ -187,6 +196,41 @@ BOOST_AUTO_TEST_CASE( environment )
     BOOST_CHECK( contains(env->getOutputs(o1),l3) );
 }
 
+BOOST_AUTO_TEST_CASE( frame_cache_deep_chain )
+{
+    boost::scoped_ptr<Environment> env( new Environment() );
+
+    // a chain which is too long for a recursive walk to the root. It is
+    // not longer, since detaching the frames is quadratic.
+    const int length = 20000;
+    std::vector<FrameNode*> chain;
+    FrameNode* parent = env->getRootNode();
+    for( int i = 0; i < length; i++ )
+    {
+	FrameNode* fn = new FrameNode( Eigen::Affine3d(Eigen::Translation3d( 0.0, 0.0, 0.001 )) );
+	env->addChild( parent, fn );
+	chain.push_back( fn );
+	parent = fn;
+    }
+    FrameNode* branch = new FrameNode( Eigen::Affine3d(Eigen::Translation3d( 1.0, 0.0, 0.0 )) );
+    env->addChild( chain[length / 4], branch );
+
+    BOOST_CHECK_CLOSE( env->relativeTransform( chain.back(), env->getRootNode() ).translation().z(), 0.001 * length, 1e-6 );
+    BOOST_CHECK_CLOSE( env->relativeTransform( branch, env->getRootNode() ).translation().z(), 0.001 * (length / 4 + 1), 1e-6 );
+
+    // changing a frame in the middle only affects the frames below it
+    chain[length / 2]->setTransform( Eigen::Affine3d(Eigen::Translation3d( 0.0, 0.0, 1.001 )) );
+    BOOST_CHECK_CLOSE( env->relativeTransform( chain.back(), env->getRootNode() ).translation().z(), 0.001 * length + 1.0, 1e-6 );
+    BOOST_CHECK_CLOSE( env->relativeTransform( branch, env->getRootNode() ).translation().z(), 0.001 * (length / 4 + 1), 1e-6 );
+    BOOST_CHECK_CLOSE( env->relativeTransform( chain.back(), branch ).translation().z(), 0.001 * length + 1.0 - 0.001 * (length / 4 + 1), 1e-6 );
+
+    // and so does moving a frame in the tree
+    env->removeChild( chain[length / 4], branch );
+    env->addChild( chain[length / 2], branch );
+    BOOST_CHECK_CLOSE( env->relativeTransform( branch, env->getRootNode() ).translation().z(), 0.001 * (length / 2) + 1.001, 1e-6 );
+    BOOST_CHECK_CLOSE( env->relativeTransform( branch, env->getRootNode() ).translation().x(), 1.0, 1e-6 );
+}
+
 BOOST_AUTO_TEST_CASE( functional ) 
 {
     boost::scoped_ptr<Environment> env( new Environment() );
@@ -212,6 +256,117 @@ BOOST_AUTO_TEST_CASE( functional )
     env->serialize("build/test");
 }
 
+BOOST_AUTO_TEST_CASE( incremental_meshing ) 
+{
+    boost::scoped_ptr<Environment> env( new Environment() );
+
+    // synthetic sweep of a tilting laser
+    LaserScan* scan = new LaserScan();
+    env->attachItem( scan );
+    scan->delta_psi = 0.01;
+    scan->origin_psi = -0.25;
+    scan->points_per_line = 50;
+    scan->center_offset = Eigen::Vector3d( 0, 0.05, 0.1 );
+
+    std::vector<LaserScan::scanline_t> lines;
+    for( int l=0; l<20; l++ )
+    {
+	LaserScan::scanline_t line;
+	line.delta_phi = -0.3 + l * 0.01;
+	for( int p=0; p<50; p++ )
+	    line.ranges.push_back( 2000 + (l * 7 + p * 13) % 50 + (p == 25 ? 1000 : 0) );
+	lines.push_back( line );
+    }
+
+    TriMesh* full = new TriMesh();
+    env->attachItem( full );
+    ScanMeshing* fop = new ScanMeshing();
+    env->attachItem( fop );
+    fop->addInput( scan );
+    fop->addOutput( full );
+
+    scan->lines = lines;
+    fop->updateAll();
+
+    LaserScan* iscan = new LaserScan( *scan );
+    env->attachItem( iscan );
+    iscan->lines.clear();
+    TriMesh* mesh = new TriMesh();
+    env->attachItem( mesh );
+    ScanMeshing* iop = new ScanMeshing();
+    env->attachItem( iop );
+    iop->setIncremental( true );
+    iop->addInput( iscan );
+    iop->addOutput( mesh );
+
+    // add the lines in batches and update in between
+    for( size_t l=0; l<lines.size(); l+=5 )
+    {
+	iscan->lines.insert( iscan->lines.end(), lines.begin() + l, lines.begin() + l + 5 );
+	iop->updateAll();
+    }
+
+    BOOST_CHECK( !full->faces.empty() );
+    BOOST_CHECK( mesh->vertices == full->vertices );
+    BOOST_CHECK( mesh->faces == full->faces );
+    BOOST_CHECK( mesh->getVertexData<TriMesh::vertex_attr>( TriMesh::VERTEX_ATTRIBUTES ) 
+	    == full->getVertexData<TriMesh::vertex_attr>( TriMesh::VERTEX_ATTRIBUTES ) );
+    BOOST_CHECK( mesh->getVertexData<Eigen::Vector3d>( TriMesh::VERTEX_NORMAL ) 
+	    == full->getVertexData<Eigen::Vector3d>( TriMesh::VERTEX_NORMAL ) );
+}
+
+BOOST_AUTO_TEST_CASE( incremental_meshing_shorter_lines ) 
+{
+    boost::scoped_ptr<Environment> env( new Environment() );
+
+    // the last line of the first update is longer than all the lines which
+    // are appended later
+    LaserScan* scan = new LaserScan();
+    env->attachItem( scan );
+    scan->delta_psi = 0.01;
+    scan->origin_psi = -0.25;
+    scan->points_per_line = 20;
+
+    std::vector<LaserScan::scanline_t> lines;
+    for( int l=0; l<10; l++ )
+    {
+	LaserScan::scanline_t line;
+	line.delta_phi = -0.3 + l * 0.01;
+	const int points = l == 4 ? 60 : 20;
+	for( int p=0; p<points; p++ )
+	    line.ranges.push_back( 2000 + (l * 7 + p * 13) % 50 );
+	lines.push_back( line );
+    }
+
+    TriMesh* full = new TriMesh();
+    env->attachItem( full );
+    ScanMeshing* fop = new ScanMeshing();
+    env->attachItem( fop );
+    fop->addInput( scan );
+    fop->addOutput( full );
+    scan->lines = lines;
+    fop->updateAll();
+
+    LaserScan* iscan = new LaserScan( *scan );
+    env->attachItem( iscan );
+    iscan->lines.assign( lines.begin(), lines.begin() + 5 );
+    TriMesh* mesh = new TriMesh();
+    env->attachItem( mesh );
+    ScanMeshing* iop = new ScanMeshing();
+    env->attachItem( iop );
+    iop->setIncremental( true );
+    iop->addInput( iscan );
+    iop->addOutput( mesh );
+    iop->updateAll();
+
+    iscan->lines.insert( iscan->lines.end(), lines.begin() + 5, lines.end() );
+    iop->updateAll();
+
+    BOOST_CHECK( !full->faces.empty() );
+    BOOST_CHECK( mesh->vertices == full->vertices );
+    BOOST_CHECK( mesh->faces == full->faces );
+}
+
 BOOST_AUTO_TEST_CASE( grid_access ) 
 {
     boost::scoped_ptr<Environment> env( new Environment() );
@@ -250,15 +405,86 @@ BOOST_AUTO_TEST_CASE( grid_access )
     probes.push_back( Eigen::Vector3d(6.5,0.5,0) );
     probes.push_back( Eigen::Vector3d(7.5,1.5,0) );
 
+    probes.push_back( Eigen::Vector3d(1.0,1.0,0) );
+
+    // values at the cell centers, with -1 for positions outside of the grids
+    const double expected[] = { 0, 7, -1, 1, 6, 2.5 };
+
     GridAccess ga( env.get() );
 
     for(size_t i=0;i<probes.size();i++)
     {
-        ga.getElevation( probes[i] );
-	// TODO: actually check the values here
+	Eigen::Vector3d p( probes[i] );
+	BOOST_CHECK_EQUAL( ga.getElevation( p ), expected[i] >= 0 );
+	if( expected[i] >= 0 )
+	    BOOST_CHECK_CLOSE( p.z(), expected[i], 1e-9 );
+    }
+
+    // the batched queries need to give the same results
+    std::vector<Eigen::Vector3d> batch( probes );
+    std::vector<bool> found;
+    BOOST_CHECK_EQUAL( ga.getElevations( batch, found ), 5u );
+    for(size_t i=0;i<probes.size();i++)
+    {
+	BOOST_CHECK_EQUAL( found[i], expected[i] >= 0 );
+	if( found[i] )
+	    BOOST_CHECK_CLOSE( batch[i].z(), expected[i], 1e-9 );
     }
+
+    // without interpolation the cell value is used
+    ga.setInterpolation( false );
+    Eigen::Vector3d p( probes.back() );
+    BOOST_CHECK( ga.getElevation( p ) );
+    BOOST_CHECK_EQUAL( p.z(), 5 );
 }
 
+#ifdef ENVIRE_USE_CGAL
+BOOST_AUTO_TEST_CASE( projection_interpolation ) 
+{
+    boost::scoped_ptr<Environment> env( new Environment() );
+
+    ElevationGrid* grid = new ElevationGrid( 200, 150, 0.1, 0.1 );
+    env->attachItem( grid );
+    grid->setFrameNode( env->getRootNode() );
+
+    // sparse points, so that most cells need to be interpolated
+    Pointcloud* pc = new Pointcloud();
+    env->attachItem( pc );
+    pc->setFrameNode( env->getRootNode() );
+    srand( 0 );
+    for( int i=0; i<500; i++ )
+    {
+	const double x = rand() % 2000 / 100.0, y = rand() % 1500 / 100.0;
+	pc->vertices.push_back( Eigen::Vector3d( x, y, sin( x ) + 0.1 * y ) );
+    }
+
+    Projection* proj = new Projection();
+    env->attachItem( proj );
+    proj->addInput( pc );
+    proj->addOutput( grid );
+    proj->updateElevationMap();
+
+    ElevationGrid::ArrayType& data( grid->getGridData( ElevationGrid::ELEVATION_MAX ) );
+    const ElevationGrid::ArrayType input( data );
+
+    // the blocks of the parallel version need to give the same result
+    // as a single block
+    proj->interpolateMap( ElevationGrid::ELEVATION_MAX, 1 );
+    const ElevationGrid::ArrayType serial( data );
+    data = input;
+    proj->interpolateMap( ElevationGrid::ELEVATION_MAX, 7 );
+    BOOST_CHECK( std::equal( data.data(), data.data() + data.num_elements(), serial.data() ) );
+
+    size_t before = 0, after = 0;
+    for( size_t i=0; i<data.num_elements(); i++ )
+    {
+	before += fabs( input.data()[i] ) != std::numeric_limits<double>::infinity();
+	after += fabs( data.data()[i] ) != std::numeric_limits<double>::infinity();
+    }
+    BOOST_CHECK( after > 10 * before );
+}
+#endif
+
 BOOST_AUTO_TEST_CASE( pointcloud_access ) 
 {
     boost::scoped_ptr<Environment> env( new Environment() );
@@ -290,6 +516,132 @@ BOOST_AUTO_TEST_CASE( pointcloud_access )
 	pa.getElevation( v, 0.1, 0, 0.2 );
     }
     cout << b << endl;
+
+    // compare with the closest point in the xy plane
+    std::vector<Eigen::Vector3d> positions;
+    for(int i=0;i<1000;i++)
+	positions.push_back( Eigen::Vector3d::Random() );
+    for(size_t i=0;i<positions.size();i++)
+    {
+	double best = 0.1;
+	int closest = -1;
+	for(size_t j=0;j<pc->vertices.size();j++)
+	{
+	    const double d = (pc->vertices[j] - positions[i]).head<2>().norm();
+	    if( d < best )
+	    {
+		best = d;
+		closest = j;
+	    }
+	}
+
+	v = positions[i];
+	BOOST_REQUIRE_EQUAL( pa.getElevation( v, 0.1 ), closest >= 0 );
+	if( closest >= 0 )
+	    BOOST_CHECK_CLOSE( v.z(), pc->vertices[closest].z(), 1e-4 );
+
+	v = positions[i];
+	if( pa.getElevation( v, 0.1, 0, 0.2 ) )
+	{
+	    BOOST_CHECK( fabs( v.x() - positions[i].x() ) <= 0.1 + 1e-6 );
+	    BOOST_CHECK( fabs( v.y() - positions[i].y() ) <= 0.1 + 1e-6 );
+	    BOOST_CHECK( fabs( v.z() ) < 0.2 );
+	}
+    }
+
+    // the batched queries need to give the same results
+    std::vector<Eigen::Vector3d> batch( positions );
+    std::vector<bool> found;
+    const size_t count = pa.getElevations( batch, found, 0.1 );
+    BOOST_REQUIRE_EQUAL( found.size(), positions.size() );
+    BOOST_CHECK_EQUAL( count, (size_t)std::count( found.begin(), found.end(), true ) );
+    for(size_t i=0;i<positions.size();i++)
+    {
+	v = positions[i];
+	BOOST_CHECK_EQUAL( pa.getElevation( v, 0.1 ), found[i] );
+	BOOST_CHECK( v == batch[i] );
+    }
+}
+
+BOOST_AUTO_TEST_CASE( merge_cut_pointcloud ) 
+{
+    boost::scoped_ptr<Environment> env( new Environment() );
+
+    FrameNode *fn = new FrameNode( 
+	    Eigen::Translation3d( 1.0, 2.0, 3.0 ) * Eigen::AngleAxisd( 0.5, Eigen::Vector3d::UnitZ() ) );
+    env->addChild( env->getRootNode(), fn );
+
+    Pointcloud *pc1 = new Pointcloud(), *pc2 = new Pointcloud();
+    env->setFrameNode( pc1, env->getRootNode() );
+    env->setFrameNode( pc2, fn );
+    Pointcloud* clouds[] = { pc1, pc2 };
+    for( int c=0; c<2; c++ )
+    {
+	for( int i=0; i<5000; i++ )
+	{
+	    clouds[c]->vertices.push_back( Eigen::Vector3d::Random() * 5.0 );
+	    clouds[c]->getVertexColors().push_back( Eigen::Vector3d::Random() );
+	    clouds[c]->getVertexNormals().push_back( Eigen::Vector3d::Random().normalized() );
+	}
+    }
+
+    Pointcloud *merged = new Pointcloud();
+    env->setFrameNode( merged, env->getRootNode() );
+    MergePointcloud *merge = new MergePointcloud();
+    env->attachItem( merge );
+    merge->addInput( pc1 );
+    merge->addInput( pc2 );
+    merge->addOutput( merged );
+    merge->updateAll();
+
+    const Transform t = fn->getTransform();
+    BOOST_REQUIRE_EQUAL( merged->vertices.size(), 10000 );
+    BOOST_REQUIRE_EQUAL( merged->getVertexColors().size(), 10000 );
+    BOOST_REQUIRE_EQUAL( merged->getVertexNormals().size(), 10000 );
+    BOOST_CHECK( merged->vertices[17].isApprox( pc1->vertices[17] ) );
+    BOOST_CHECK( merged->vertices[5017].isApprox( t * pc2->vertices[17] ) );
+    BOOST_CHECK( merged->getVertexNormals()[5017].isApprox( t.linear() * pc2->getVertexNormals()[17] ) );
+    BOOST_CHECK_EQUAL( merged->getVertexColors()[5017], pc2->getVertexColors()[17] );
+
+    // many exclusion boxes and one including box
+    std::vector<ExclusionBox> boxes( 200 );
+    for( size_t i=0; i<boxes.size(); i++ )
+    {
+	const Eigen::Vector3d c = Eigen::Vector3d::Random() * 6.0;
+	boxes[i].box = Eigen::AlignedBox<double,3>( c, c + Eigen::Vector3d::Constant( 0.5 ) );
+    }
+    boxes[0].box = Eigen::AlignedBox<double,3>( Eigen::Vector3d( -4, -4, -4 ), Eigen::Vector3d( 4, 4, 4 ) );
+    boxes[0].exclude = false;
+
+    Pointcloud *cut = new Pointcloud();
+    env->setFrameNode( cut, fn );
+    CutPointcloud *cutOp = new CutPointcloud();
+    env->attachItem( cutOp );
+    for( size_t i=0; i<boxes.size(); i++ )
+	cutOp->addBox( &boxes[i] );
+    cutOp->addInput( merged );
+    cutOp->addOutput( cut );
+
+    cutOp->updateAll();
+
+    std::vector<size_t> expected;
+    for( size_t i=0; i<merged->vertices.size(); i++ )
+    {
+	bool included = true;
+	for( size_t j=0; j<boxes.size(); j++ )
+	    if( boxes[j].box.contains( merged->vertices[i] ) == boxes[j].excludes() )
+		included = false;
+	if( included )
+	    expected.push_back( i );
+    }
+
+    BOOST_REQUIRE_EQUAL( cut->vertices.size(), expected.size() );
+    BOOST_REQUIRE_EQUAL( cut->getVertexColors().size(), expected.size() );
+    for( size_t i=0; i<expected.size(); i++ )
+    {
+	BOOST_CHECK( cut->vertices[i].isApprox( t.inverse() * merged->vertices[expected[i]], 1e-9 ) );
+	BOOST_CHECK_EQUAL( cut->getVertexColors()[i], merged->getVertexColors()[expected[i]] );
+    }
 }
 
 BOOST_AUTO_TEST_CASE( env_eventsync ) 
@@ -366,5 +718,473 @@ BOOST_AUTO_TEST_CASE( env_metadata )
     BOOST_CHECK( vec.front() == base::Vector3d::Zero() );
 }
 
+BOOST_AUTO_TEST_CASE( layer_copy_on_write ) 
+{
+    typedef std::vector<Eigen::Vector3d> Colors;
+    Pointcloud pc;
+    pc.vertices.resize( 2 );
+    pc.getVertexColors().resize( 2, Eigen::Vector3d::Zero() );
+
+    // the copy shares the data until it is written
+    boost::scoped_ptr<Pointcloud> copy( pc.clone() );
+    const Pointcloud &cpc( pc ), &ccopy( *copy );
+    BOOST_CHECK_EQUAL( 
+	    &cpc.getData<Colors>( Pointcloud::VERTEX_COLOR ),
+	    &ccopy.getData<Colors>( Pointcloud::VERTEX_COLOR ) );
+
+    // writing through the cached slot detaches the data of the source
+    pc.getVertexColors()[0] = Eigen::Vector3d::Ones();
+    BOOST_CHECK( 
+	    &cpc.getData<Colors>( Pointcloud::VERTEX_COLOR ) !=
+	    &ccopy.getData<Colors>( Pointcloud::VERTEX_COLOR ) );
+    BOOST_CHECK( copy->getVertexColors()[0] == Eigen::Vector3d::Zero() );
+    BOOST_CHECK( pc.getVertexColors()[0] == Eigen::Vector3d::Ones() );
+
+    // the data is not shared anymore, so writing doesn't copy
+    const Colors* colors = &ccopy.getData<Colors>( Pointcloud::VERTEX_COLOR );
+    copy->getVertexColors()[1] = Eigen::Vector3d::Ones();
+    BOOST_CHECK_EQUAL( colors, &ccopy.getData<Colors>( Pointcloud::VERTEX_COLOR ) );
+    BOOST_CHECK( pc.getVertexColors()[1] == Eigen::Vector3d::Zero() );
+
+    // assignment shares the data as well
+    Pointcloud other;
+    other = pc;
+    BOOST_CHECK_EQUAL( 
+	    &cpc.getData<Colors>( Pointcloud::VERTEX_COLOR ),
+	    &static_cast<const Pointcloud&>( other ).getData<Colors>( Pointcloud::VERTEX_COLOR ) );
+    other.getVertexColors()[0] = Eigen::Vector3d::Zero();
+    BOOST_CHECK( pc.getVertexColors()[0] == Eigen::Vector3d::Ones() );
+}
+
+class RecordingQueue : public EventQueue
+{
+public:
+    std::vector<Event> events;
+    void process( const Event& message ) { events.push_back( message ); }
+};
+
+BOOST_AUTO_TEST_CASE( event_queue_coalescing ) 
+{
+    boost::scoped_ptr<Environment> env( new Environment() );
+    RecordingQueue queue;
+    env->addEventHandler( &queue );
+    queue.flush();
+
+    const size_t items = 100, updates = 1000;
+    std::vector<Layer*> layers;
+    for( size_t i=0; i<items; i++ )
+    {
+	layers.push_back( new DummyLayer() );
+	env->attachItem( layers.back() );
+    }
+
+    for( size_t i=0; i<updates; i++ )
+	env->itemModified( layers[i % items] );
+
+    // remove every second item again, which cancels the add and
+    // invalidates the update events of the item
+    for( size_t i=0; i<items; i+=2 )
+	env->detachItem( layers[i] );
+
+    queue.flush();
+
+    // the adds stay in order, followed by the last update of each item
+    const size_t remaining = items / 2;
+    BOOST_REQUIRE_EQUAL( queue.events.size(), 2 * remaining );
+    for( size_t i=0; i<remaining; i++ )
+    {
+	const Event& add( queue.events[i] );
+	BOOST_CHECK_EQUAL( add.operation, event::ADD );
+	BOOST_CHECK_EQUAL( add.id_a, layers[2*i+1]->getUniqueId() );
+
+	const Event& update( queue.events[remaining + i] );
+	BOOST_CHECK_EQUAL( update.operation, event::UPDATE );
+	BOOST_CHECK_EQUAL( update.id_a, layers[2*i+1]->getUniqueId() );
+    }
+
+    // the index is reset by the flush
+    queue.events.clear();
+    env->itemModified( layers[1] );
+    env->itemModified( layers[1] );
+    queue.flush();
+    BOOST_CHECK_EQUAL( queue.events.size(), 1u );
+
+    env->removeEventHandler( &queue );
+}
+
+BOOST_AUTO_TEST_CASE( event_queue_snapshots ) 
+{
+    boost::scoped_ptr<Environment> env( new Environment() );
+    RecordingQueue queue;
+    queue.allowMultithreading( true );
+    env->addEventHandler( &queue );
+
+    ElevationGrid *grid = new ElevationGrid( 4, 4, 1, 1 );
+    env->attachItem( grid );
+    queue.flush();
+    queue.events.clear();
+
+    // each update is a copy, which shares the bands with the grid, so
+    // they are fetched again for each write
+    const size_t updates = 3;
+    for( size_t i=1; i<=updates; i++ )
+    {
+	const unsigned long generation = grid->getDataGeneration();
+	grid->getGridData( ElevationGrid::ELEVATION )[1][1] = i;
+	BOOST_CHECK_EQUAL( grid->getDataGeneration(), generation );
+	env->itemModified( grid );
+	BOOST_CHECK( grid->getDataGeneration() != generation );
+	queue.flush();
+    }
+
+    // the snapshots are not changed by the later writes
+    BOOST_REQUIRE_EQUAL( queue.events.size(), updates );
+    for( size_t i=0; i<updates; i++ )
+    {
+	const ElevationGrid& snapshot( dynamic_cast<const ElevationGrid&>( *queue.events[i].a ) );
+	BOOST_CHECK_EQUAL( snapshot.getGridData( ElevationGrid::ELEVATION )[1][1], i + 1 );
+    }
+
+    env->removeEventHandler( &queue );
+}
+
+struct EnvironmentReader
+{
+    Environment *env;
+    FrameNode *fn;
+    std::string gridId;
+    size_t iterations;
+    size_t *errors;
+
+    void operator()()
+    {
+	for( size_t i=0; i<iterations; i++ )
+	{
+	    double z, value;
+	    boost::scoped_ptr<ElevationGrid> copy;
+	    {
+		Environment::ReadLock lock( env->getMutex() );
+		z = env->relativeTransform( fn, env->getRootNode() ).translation().z();
+		ElevationGrid::Ptr grid = env->getItem<ElevationGrid>( gridId );
+		value = static_cast<const ElevationGrid&>( *grid ).getGridData( ElevationGrid::ELEVATION )[1][1];
+		if( i % 100 == 0 )
+		    copy.reset( grid->clone() );
+	    }
+
+	    // the writer keeps the transform and the grid consistent
+	    if( z != value )
+		(*errors)++;
+
+	    // the copy is a snapshot, which is not changed by the writer
+	    if( copy && static_cast<const ElevationGrid&>( *copy ).getGridData( ElevationGrid::ELEVATION )[1][1] != value )
+		(*errors)++;
+	}
+    }
+};
+
+BOOST_AUTO_TEST_CASE( env_concurrent_readers ) 
+{
+    boost::scoped_ptr<Environment> env( new Environment() );
+    FrameNode *fn = new FrameNode();
+    env->addChild( env->getRootNode(), fn );
+    ElevationGrid *grid = new ElevationGrid( 256, 256, 0.1, 0.1 );
+    env->attachItem( grid, fn );
+    grid->getGridData( ElevationGrid::ELEVATION )[1][1] = 0;
+
+    const size_t readers = 4;
+    std::vector<size_t> errors( readers );
+    boost::thread_group threads;
+    for( size_t i=0; i<readers; i++ )
+    {
+	EnvironmentReader reader;
+	reader.env = env.get();
+	reader.fn = fn;
+	reader.gridId = grid->getUniqueId();
+	reader.iterations = 20000;
+	reader.errors = &errors[i];
+	threads.create_thread( reader );
+    }
+
+    // single writer, which updates the transform and the grid together
+    for( int i=1; i<=2000; i++ )
+    {
+	Environment::WriteLock lock( env->getMutex() );
+	fn->setTransform( Eigen::Affine3d( Eigen::Translation3d( 0.0, 0.0, i ) ) );
+	grid->getGridData( ElevationGrid::ELEVATION )[1][1] = i;
+	env->itemModified( grid );
+    }
+    threads.join_all();
+
+    for( size_t i=0; i<readers; i++ )
+	BOOST_CHECK_EQUAL( errors[i], 0u );
+    BOOST_CHECK_EQUAL( grid->getRefCount(), 1 );
+}
+
+struct TraversabilityReader
+{
+    Environment *env;
+    std::string gridId;
+    size_t iterations;
+    size_t *errors;
+
+    void operator()()
+    {
+	for( size_t i=0; i<iterations; i++ )
+	{
+	    double a, b;
+	    boost::scoped_ptr<TraversabilityGrid> copy;
+	    {
+		Environment::ReadLock lock( env->getMutex() );
+		TraversabilityGrid::Ptr grid = env->getItem<TraversabilityGrid>( gridId );
+		const TraversabilityGrid& cgrid( *grid );
+		a = cgrid.getTraversability( 1, 1 ).getDrivability();
+		b = cgrid.getTraversability( 2, 2 ).getDrivability();
+		cgrid.getProbability( 1, 1 );
+		if( i % 50 == 0 )
+		    copy.reset( grid->clone() );
+	    }
+
+	    // the writer sets both cells together
+	    if( a != b )
+		(*errors)++;
+
+	    if( copy && copy->getTraversability( 1, 1 ).getDrivability() != a )
+		(*errors)++;
+	}
+    }
+};
+
+BOOST_AUTO_TEST_CASE( env_concurrent_traversability_readers ) 
+{
+    boost::scoped_ptr<Environment> env( new Environment() );
+    TraversabilityGrid *grid = new TraversabilityGrid( 256, 256, 0.1, 0.1 );
+    env->attachItem( grid );
+    const size_t classes = 10;
+    for( size_t i=0; i<classes; i++ )
+	grid->setTraversabilityClass( i, TraversabilityClass( i / (double)classes ) );
+
+    const size_t readers = 4;
+    std::vector<size_t> errors( readers );
+    boost::thread_group threads;
+    for( size_t i=0; i<readers; i++ )
+    {
+	TraversabilityReader reader;
+	reader.env = env.get();
+	reader.gridId = grid->getUniqueId();
+	reader.iterations = 20000;
+	reader.errors = &errors[i];
+	threads.create_thread( reader );
+    }
+
+    // the writes go through the cached band pointers of the grid, which
+    // need to be fetched again after each copy the readers take
+    for( size_t i=1; i<=2000; i++ )
+    {
+	Environment::WriteLock lock( env->getMutex() );
+	grid->setTraversabilityAndProbability( i % classes, 1.0, 1, 1 );
+	grid->setTraversabilityAndProbability( i % classes, 1.0, 2, 2 );
+	env->itemModified( grid );
+    }
+    threads.join_all();
+
+    for( size_t i=0; i<readers; i++ )
+	BOOST_CHECK_EQUAL( errors[i], 0u );
+    BOOST_CHECK_EQUAL( grid->getTraversability( 1, 1 ).getDrivability(), (2000 % classes) / (double)classes );
+}
+
+class CountingSyncHandler : public SynchronizationEventHandler
+{
+public:
+    std::vector<size_t> batches;
+    void handle( std::vector<BinaryEvent>& msgs ) { batches.push_back( msgs.size() ); }
+};
+
+#ifdef __cpp_lib_uncaught_exceptions
+/** adds a frame node in a transaction when it is destroyed */
+struct TransactionOnUnwind
+{
+    Environment* env;
+    FrameNode* parent;
+    ~TransactionOnUnwind()
+    {
+	Environment::Transaction transaction( *env );
+	env->addChild( parent, new FrameNode() );
+    }
+};
+#endif
+
+BOOST_AUTO_TEST_CASE( env_transaction ) 
+{
+    boost::scoped_ptr<Environment> env( new Environment() );
+    RecordingQueue queue;
+    env->addEventHandler( &queue );
+    queue.flush();
+    queue.events.clear();
+
+    // build a pose graph as a binary tree of frame nodes
+    const size_t nodes = 100;
+    std::vector<FrameNode*> fns;
+    std::string tmpId;
+    {
+	Environment::Transaction transaction( *env );
+	for( size_t i=0; i<nodes; i++ )
+	{
+	    FrameNode *fn = new FrameNode();
+	    env->addChild( fns.empty() ? env->getRootNode() : fns[(i-1)/2], fn );
+	    // updates of the new items are covered by the add events
+	    fn->setTransform( Eigen::Affine3d( Eigen::Translation3d( 1.0, 0.0, 0.0 ) ) );
+	    fns.push_back( fn );
+	}
+
+	// an item which is attached and detached again is not published
+	FrameNode *tmp = new FrameNode();
+	env->addChild( env->getRootNode(), tmp );
+	tmpId = tmp->getUniqueId();
+	env->detachItem( tmp );
+
+	// nested transactions don't publish anything
+	env->beginTransaction();
+	env->commitTransaction();
+	BOOST_CHECK( env->inTransaction() );
+
+	queue.flush();
+	BOOST_CHECK( queue.events.empty() );
+	transaction.commit();
+    }
+    BOOST_CHECK( !env->inTransaction() );
+
+    queue.flush();
+    BOOST_REQUIRE_EQUAL( queue.events.size(), 2 * nodes );
+    for( size_t i=0; i<nodes; i++ )
+    {
+	BOOST_CHECK_EQUAL( queue.events[2*i].type, event::ITEM );
+	BOOST_CHECK_EQUAL( queue.events[2*i].operation, event::ADD );
+	BOOST_CHECK_EQUAL( queue.events[2*i].id_a, fns[i]->getUniqueId() );
+	BOOST_CHECK_EQUAL( queue.events[2*i+1].type, event::FRAMENODE_TREE );
+	BOOST_CHECK_EQUAL( queue.events[2*i+1].id_b, fns[i]->getUniqueId() );
+    }
+    env->removeEventHandler( &queue );
+
+    // a synchronization handler receives the transaction as one batch
+    CountingSyncHandler sync;
+    env->addEventHandler( &sync );
+    sync.batches.clear();
+    {
+	Environment::Transaction transaction( *env );
+	for( size_t i=0; i<10; i++ )
+	    env->addChild( fns[i], new FrameNode() );
+	transaction.commit();
+	// further calls are ignored
+	transaction.commit();
+	transaction.abort();
+    }
+    BOOST_REQUIRE_EQUAL( sync.batches.size(), 1u );
+    BOOST_CHECK_EQUAL( sync.batches[0], 20u );
+
+    // a transaction which is left by an exception is not published
+    sync.batches.clear();
+    try
+    {
+	Environment::Transaction transaction( *env );
+	env->addChild( fns[0], new FrameNode() );
+	throw std::runtime_error( "failed" );
+    }
+    catch( const std::runtime_error& )
+    {
+    }
+    BOOST_CHECK( !env->inTransaction() );
+    BOOST_CHECK( sync.batches.empty() );
+
+    // the same for an explicit abort
+    {
+	Environment::Transaction transaction( *env );
+	env->addChild( fns[0], new FrameNode() );
+	transaction.abort();
+    }
+    BOOST_CHECK( sync.batches.empty() );
+
+#ifdef __cpp_lib_uncaught_exceptions
+    // a transaction which is only created during the stack unwinding,
+    // and goes out of scope normally, is committed
+    try
+    {
+	TransactionOnUnwind unwind;
+	unwind.env = env.get();
+	unwind.parent = fns[0];
+	throw std::runtime_error( "failed" );
+    }
+    catch( const std::runtime_error& )
+    {
+    }
+    BOOST_CHECK( !env->inTransaction() );
+    BOOST_CHECK_EQUAL( sync.batches.size(), 1u );
+#endif
+    env->removeEventHandler( &sync );
+
+    BOOST_CHECK_THROW( env->commitTransaction(), std::runtime_error );
+    BOOST_CHECK_THROW( env->abortTransaction(), std::runtime_error );
+}
+
+static void instrumentedWork( int calls )
+{
+    for( int i=0; i<calls; i++ )
+    {
+	ScopedTimer timer( "work" );
+	Instrumentation::count( Instrumentation::CELLS_TOUCHED, 2 );
+    }
+}
+
+BOOST_AUTO_TEST_CASE( instrumentation )
+{
+    Instrumentation::clear();
+
+    // nothing is recorded while disabled
+    Instrumentation::setEnabled( false );
+    {
+	ScopedTimer timer( "disabled" );
+    }
+    BOOST_CHECK( Instrumentation::endCycle().timers.empty() );
+
+    Instrumentation::clear();
+    Instrumentation::setEnabled( true );
+    boost::thread_group threads;
+    for( int i=0; i<4; i++ )
+	threads.create_thread( boost::bind( &instrumentedWork, 100 ) );
+    threads.join_all();
+    Instrumentation::count( Instrumentation::BYTES_SERIALIZED, 42 );
+
+    Instrumentation::Report report = Instrumentation::endCycle();
+    BOOST_CHECK_EQUAL( report.cycle, 0u );
+    BOOST_REQUIRE_EQUAL( report.timers.size(), 1u );
+    BOOST_REQUIRE( report.getTimer( "work" ) );
+    BOOST_CHECK_EQUAL( report.getTimer( "work" )->calls, 400u );
+    BOOST_CHECK( report.getTimer( "work" )->max <= report.getTimer( "work" )->total );
+    BOOST_CHECK_EQUAL( report.counters[Instrumentation::CELLS_TOUCHED], 800u );
+    BOOST_CHECK_EQUAL( report.counters[Instrumentation::BYTES_SERIALIZED], 42u );
+    BOOST_CHECK_EQUAL( Instrumentation::getLastReport().cycle, 0u );
+
+    // the next cycle starts empty
+    report = Instrumentation::endCycle();
+    BOOST_CHECK_EQUAL( report.cycle, 1u );
+    BOOST_CHECK( report.timers.empty() );
+    BOOST_CHECK_EQUAL( report.counters[Instrumentation::CELLS_TOUCHED], 0u );
+
+    // the trace has all the scopes and a counter event per cycle
+    std::ostringstream trace;
+    Instrumentation::writeChromeTrace( trace );
+    const std::string json = trace.str();
+    size_t scopes = 0, counters = 0;
+    for( size_t pos = json.find( "\"ph\":\"X\"" ); pos != std::string::npos; pos = json.find( "\"ph\":\"X\"", pos + 1 ) )
+	scopes++;
+    for( size_t pos = json.find( "\"ph\":\"C\"" ); pos != std::string::npos; pos = json.find( "\"ph\":\"C\"", pos + 1 ) )
+	counters++;
+    BOOST_CHECK_EQUAL( scopes, 400u );
+    BOOST_CHECK_EQUAL( counters, 2u );
+    BOOST_CHECK( json.find( "\"cells_touched\":800" ) != std::string::npos );
+
+    Instrumentation::setEnabled( false );
+    Instrumentation::clear();
+}
+
 // EOF
 //
@@ -1,11 +1,25 @@
 #define BOOST_TEST_MODULE MLSTest 
 #include <boost/test/included/unit_test.hpp>
 #include <boost/scoped_ptr.hpp>
+#include <numeric>
 
 #include <envire/maps/Grids.hpp>
 #include <envire/maps/ElevationGrid.hpp>
+#include <envire/maps/TriMesh.hpp>
+#include <envire/maps/PointcloudStorage.hpp>
+#include <boost/tuple/tuple_comparison.hpp>
 #include <envire/tools/VoxelTraversal.hpp>
 #include <envire/tools/BoxLookUpTable.hpp>
+#include <envire/tools/RasterTileCache.hpp>
+#include <envire/tools/GridFilter.hpp>
+#include <envire/tools/GridKernel.hpp>
+#include <envire/tools/MeshNormals.hpp>
+#include <envire/tools/PointcloudReader.hpp>
+#include <envire/tools/NumberParser.hpp>
+#include <envire/core/Serialization.hpp>
+#include <envire/maps/TraversabilityFootprints.hpp>
+#include <boost/filesystem.hpp>
+#include <fstream>
 
 using namespace envire;
 using namespace Eigen;
@@ -280,3 +294,647 @@ BOOST_AUTO_TEST_CASE( test_BoxLookupTable )
     }  
 }
 
+
+BOOST_AUTO_TEST_CASE( test_pointcloud_io )
+{
+    TriMesh mesh;
+    std::vector<Eigen::Vector3d> &colors( mesh.getVertexData<Eigen::Vector3d>( Pointcloud::VERTEX_COLOR ) );
+    for( int i=0; i<1000; i++ )
+    {
+	mesh.vertices.push_back( Eigen::Vector3d( i * 0.1, -i * 1e-3, i * 12345.678 ) );
+	colors.push_back( Eigen::Vector3d( (i % 256) / 255.0, 0, 1.0 ) );
+	if( i >= 2 )
+	    mesh.faces.push_back( TriMesh::triangle_t( i-2, i-1, i ) );
+    }
+
+    // binary ply round trip, which should use the direct block reading
+    {
+	std::stringstream ss;
+	mesh.writePly( "test.ply", ss );
+	TriMesh read;
+	read.readPly( "test.ply", ss );
+	BOOST_CHECK( read.vertices == mesh.vertices );
+	std::vector<Eigen::Vector3d> &rcolors( read.getVertexData<Eigen::Vector3d>( Pointcloud::VERTEX_COLOR ) );
+	BOOST_REQUIRE_EQUAL( rcolors.size(), colors.size() );
+	for( size_t i=0; i<colors.size(); i++ )
+	    BOOST_CHECK( rcolors[i] == Eigen::Vector3d( (unsigned char)(colors[i].x()*255) / 255.0, 0, 1.0 ) );
+	BOOST_CHECK( read.faces == mesh.faces );
+    }
+
+    // same for single precision
+    {
+	std::stringstream ss;
+	mesh.writePly( "test.ply", ss, false );
+	Pointcloud read;
+	read.readPly( "test.ply", ss );
+	BOOST_REQUIRE_EQUAL( read.vertices.size(), mesh.vertices.size() );
+	for( size_t i=0; i<read.vertices.size(); i++ )
+	    BOOST_CHECK( read.vertices[i] == mesh.vertices[i].cast<float>().cast<double>() );
+    }
+
+    // text data needs to give the same result as parsing with a stream
+    {
+	std::stringstream ss;
+	ss.precision( 17 );
+	for( size_t i=0; i<mesh.vertices.size(); i++ )
+	    ss << mesh.vertices[i].x() << " " << mesh.vertices[i].y() << " " << mesh.vertices[i].z() << " " << i % 256 << "\n";
+
+	Pointcloud read;
+	read.readText( ss, 1, Pointcloud::XYZR );
+	BOOST_CHECK( read.vertices == mesh.vertices );
+	std::vector<Eigen::Vector3d> &rcolors( read.getVertexData<Eigen::Vector3d>( Pointcloud::VERTEX_COLOR ) );
+	BOOST_REQUIRE_EQUAL( rcolors.size(), mesh.vertices.size() );
+	BOOST_CHECK( rcolors[10] == Eigen::Vector3d::Identity() * 10 / 255.0 );
+    }
+
+    // single numbers, including invalid ones
+    {
+	const char* valid[] = { "1", "-2.5", "+.5", "3.", "1e3", "1E-3", "2.5e+2", "0.1234567890123456789" };
+	for( size_t i=0; i<sizeof( valid ) / sizeof( valid[0] ); i++ )
+	{
+	    const std::string str( valid[i] );
+	    const char* p = str.c_str();
+	    double value, expected;
+	    BOOST_REQUIRE( parseDouble( p, str.c_str() + str.size(), value ) );
+	    BOOST_CHECK( p == str.c_str() + str.size() );
+	    std::istringstream is( str );
+	    is >> expected;
+	    BOOST_CHECK_EQUAL( value, expected );
+	}
+
+	const char* invalid[] = { "", "-", ".", "e3", "1e", "1e+", "1E-", "-.e1" };
+	for( size_t i=0; i<sizeof( invalid ) / sizeof( invalid[0] ); i++ )
+	{
+	    const std::string str( invalid[i] );
+	    const char* p = str.c_str();
+	    double value;
+	    BOOST_CHECK_MESSAGE( !parseDouble( p, str.c_str() + str.size(), value ), str );
+	    BOOST_CHECK( p == str.c_str() );
+	}
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_pointcloud_reader )
+{
+    const boost::filesystem::path dir( boost::filesystem::temp_directory_path() / boost::filesystem::unique_path() );
+    boost::filesystem::create_directories( dir );
+
+    TriMesh mesh;
+    std::vector<Eigen::Vector3d> &colors( mesh.getVertexData<Eigen::Vector3d>( Pointcloud::VERTEX_COLOR ) );
+    for( int i=0; i<1000; i++ )
+    {
+	mesh.vertices.push_back( Eigen::Vector3d( i * 0.1, -i * 1e-3, i * 12345.678 ) );
+	colors.push_back( Eigen::Vector3d( (i % 256) / 255.0, 0, 1.0 ) );
+	if( i >= 2 )
+	    mesh.faces.push_back( TriMesh::triangle_t( i-2, i-1, i ) );
+    }
+
+    // binary ply with a separate color element and faces after the
+    // vertices, read in chunks which don't divide the point count
+    {
+	const std::string file( (dir / "mesh.ply").string() );
+	{
+	    std::ofstream os( file.c_str(), std::ios::binary );
+	    mesh.writePly( file, os );
+	}
+	PointcloudReader reader( file );
+	BOOST_CHECK( reader.hasColor() );
+	BOOST_CHECK_EQUAL( reader.getPointCount(), mesh.vertices.size() );
+
+	std::vector<Eigen::Vector3d> points, rcolors, chunk, chunkColors;
+	while( reader.read( chunk, &chunkColors, 300 ) > 0 )
+	{
+	    BOOST_CHECK( chunk.size() <= 300 );
+	    BOOST_REQUIRE_EQUAL( chunk.size(), chunkColors.size() );
+	    points.insert( points.end(), chunk.begin(), chunk.end() );
+	    rcolors.insert( rcolors.end(), chunkColors.begin(), chunkColors.end() );
+	}
+	BOOST_CHECK( points == mesh.vertices );
+	BOOST_CHECK_EQUAL( reader.getPointsRead(), mesh.vertices.size() );
+	BOOST_CHECK_CLOSE( reader.getProgress(), 1.0, 1e-9 );
+	BOOST_REQUIRE_EQUAL( rcolors.size(), colors.size() );
+	for( size_t i=0; i<colors.size(); i++ )
+	    BOOST_CHECK( rcolors[i] == Eigen::Vector3d( (unsigned char)(colors[i].x()*255) / 255.0, 0, 1.0 ) );
+    }
+
+    // ascii ply with inline colors
+    {
+	const std::string file( (dir / "ascii.ply").string() );
+	{
+	    std::ofstream os( file.c_str() );
+	    os << "ply\nformat ascii 1.0\nelement vertex 3\n"
+		<< "property float x\nproperty float y\nproperty float z\n"
+		<< "property uchar red\nproperty uchar green\nproperty uchar blue\n"
+		<< "element face 1\nproperty list uchar int vertex_index\nend_header\n"
+		<< "0 1 2 255 0 0\n3 4 5 0 255 0\n6 7 8 0 0 255\n3 0 1 2\n";
+	}
+	PointcloudReader reader( file );
+	std::vector<Eigen::Vector3d> points, rcolors;
+	BOOST_REQUIRE_EQUAL( reader.read( points, &rcolors, 10 ), 3u );
+	BOOST_CHECK( points[1] == Eigen::Vector3d( 3, 4, 5 ) );
+	BOOST_CHECK( rcolors[2] == Eigen::Vector3d( 0, 0, 1 ) );
+	BOOST_CHECK_EQUAL( reader.read( points, &rcolors, 10 ), 0u );
+    }
+
+    // text files give the same result as Pointcloud::readText
+    {
+	const std::string file( (dir / "points.txt").string() );
+	{
+	    std::ofstream os( file.c_str() );
+	    os.precision( 17 );
+	    for( size_t i=0; i<mesh.vertices.size(); i++ )
+		os << mesh.vertices[i].x() << " " << mesh.vertices[i].y() << " " << mesh.vertices[i].z() << " " << i % 256 << "\n";
+	}
+	PointcloudReader reader( file, 1, true );
+	std::vector<Eigen::Vector3d> points, rcolors, chunk, chunkColors;
+	while( reader.read( chunk, &chunkColors, 333 ) > 0 )
+	{
+	    points.insert( points.end(), chunk.begin(), chunk.end() );
+	    rcolors.insert( rcolors.end(), chunkColors.begin(), chunkColors.end() );
+	}
+	BOOST_CHECK( points == mesh.vertices );
+	BOOST_REQUIRE_EQUAL( rcolors.size(), mesh.vertices.size() );
+	BOOST_CHECK( rcolors[10] == Eigen::Vector3d::Identity() * 10 / 255.0 );
+    }
+
+    // the map files of an environment, which is read without its map data
+    {
+	const boost::filesystem::path sceneDir( dir / "env" );
+	Environment env;
+	TriMesh* stored = new TriMesh();
+	stored->vertices = mesh.vertices;
+	stored->faces = mesh.faces;
+	env.attachItem( stored );
+	env.setFrameNode( stored, env.getRootNode() );
+	env.serialize( sceneDir.string() );
+
+	FileSerialization so;
+	so.setSceneDir( sceneDir.string() );
+	so.setSkipMapData( true );
+	boost::scoped_ptr<Environment> structure( so.readFromFile( (sceneDir / FileSerialization::STRUCTURE_FILE).string() ) );
+	std::vector<Pointcloud*> pcs = structure->getItems<Pointcloud>();
+	BOOST_REQUIRE_EQUAL( pcs.size(), 1u );
+	BOOST_CHECK( pcs.front()->vertices.empty() );
+
+	PointcloudReader reader( (sceneDir / (pcs.front()->getMapFileName() + ".ply")).string() );
+	std::vector<Eigen::Vector3d> points;
+	BOOST_CHECK_EQUAL( reader.read( points, NULL, 2000 ), mesh.vertices.size() );
+	BOOST_CHECK( points == mesh.vertices );
+    }
+
+    boost::filesystem::remove_all( dir );
+}
+
+struct CollectInBox
+{
+    std::vector<size_t> indices;
+    void operator()( size_t index, const Eigen::Vector3d& ) { indices.push_back( index ); }
+};
+
+BOOST_AUTO_TEST_CASE( test_pointcloud_bvh )
+{
+    Pointcloud pc;
+    srand( 42 );
+    for( int i=0; i<20000; i++ )
+	pc.vertices.push_back( Eigen::Vector3d::Random() * 10.0 );
+
+    // the cached extents need to follow the changes of the vertices
+    Pointcloud::Extents extents;
+    for( size_t i=0; i<pc.vertices.size(); i++ )
+	extents.extend( pc.vertices[i] );
+    BOOST_CHECK( pc.getExtents().isApprox( extents ) );
+    pc.vertices.push_back( Eigen::Vector3d( 20, 0, 0 ) );
+    BOOST_CHECK_EQUAL( pc.getExtents().max().x(), 20 );
+    pc.vertices.back().x() = 30;
+    BOOST_CHECK_EQUAL( pc.getExtents().max().x(), 20 );
+    pc.invalidateCaches();
+    BOOST_CHECK_EQUAL( pc.getExtents().max().x(), 30 );
+
+    boost::shared_ptr<const PointBVH> bvh = pc.getBVH();
+    BOOST_CHECK( bvh == pc.getBVH() );
+    BOOST_CHECK_EQUAL( bvh->size(), pc.vertices.size() );
+
+    // box queries
+    PointBVH::Box box( Eigen::Vector3d( -2, -5, -1 ), Eigen::Vector3d( 3, 1, 4 ) );
+    CollectInBox collect;
+    bvh->forEachInBox( box, collect );
+    std::sort( collect.indices.begin(), collect.indices.end() );
+    std::vector<size_t> expected;
+    for( size_t i=0; i<pc.vertices.size(); i++ )
+	if( box.contains( pc.vertices[i] ) )
+	    expected.push_back( i );
+    BOOST_CHECK( collect.indices == expected );
+
+    // nearest point queries in 3d and in the xy plane
+    for( int q=0; q<100; q++ )
+    {
+	const Eigen::Vector3d p = Eigen::Vector3d::Random() * 12.0;
+	for( size_t dims=2; dims<=3; dims++ )
+	{
+	    double best = 1.0;
+	    bool found = false;
+	    for( size_t i=0; i<pc.vertices.size(); i++ )
+	    {
+		const Eigen::Vector3d d = pc.vertices[i] - p;
+		const double dist = dims == 2 ? d.head<2>().norm() : d.norm();
+		if( dist < best )
+		{
+		    best = dist;
+		    found = true;
+		}
+	    }
+
+	    size_t index;
+	    Eigen::Vector3d point;
+	    BOOST_REQUIRE_EQUAL( bvh->findNearest( p, 1.0, index, point, dims ), found );
+	    if( found )
+	    {
+		const Eigen::Vector3d d = pc.vertices[index] - p;
+		BOOST_CHECK_CLOSE( dims == 2 ? d.head<2>().norm() : d.norm(), best, 1e-9 );
+		BOOST_CHECK( point == pc.vertices[index] );
+	    }
+	}
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_trimesh_normals )
+{
+    // two faces sharing the edge 0-1, where the large one has normal z and
+    // the small one normal x
+    TriMesh mesh;
+    mesh.vertices.push_back( Eigen::Vector3d( 0, 0, 0 ) );
+    mesh.vertices.push_back( Eigen::Vector3d( 0, 1, 0 ) );
+    mesh.vertices.push_back( Eigen::Vector3d( 3, 0, 0 ) );
+    mesh.vertices.push_back( Eigen::Vector3d( 0, 0, 1 ) );
+    mesh.vertices.push_back( Eigen::Vector3d( 5, 5, 5 ) );
+    mesh.faces.push_back( TriMesh::triangle_t( 2, 0, 1 ) );
+    mesh.faces.push_back( TriMesh::triangle_t( 1, 0, 3 ) );
+    mesh.calcVertexNormals();
+
+    std::vector<Eigen::Vector3d>& normals( mesh.getVertexData<Eigen::Vector3d>( TriMesh::VERTEX_NORMAL ) );
+    BOOST_REQUIRE_EQUAL( normals.size(), mesh.vertices.size() );
+    // the shared vertices are weighted by the areas 1.5 and 0.5
+    BOOST_CHECK( normals[0].isApprox( Eigen::Vector3d( 1, 0, 3 ).normalized() ) );
+    BOOST_CHECK( normals[1].isApprox( normals[0] ) );
+    BOOST_CHECK( normals[2].isApprox( Eigen::Vector3d::UnitZ() ) );
+    BOOST_CHECK( normals[3].isApprox( Eigen::Vector3d::UnitX() ) );
+    BOOST_CHECK( normals[4] == Eigen::Vector3d::Zero() );
+
+    // a larger mesh gives the same result for any number of threads, and
+    // when the faces are added incrementally
+    TriMesh grid;
+    const int size = 200;
+    srand( 42 );
+    for( int y=0; y<size; y++ )
+	for( int x=0; x<size; x++ )
+	    grid.vertices.push_back( Eigen::Vector3d( x, y, rand() % 100 * 0.01 ) );
+    for( int y=0; y<size-1; y++ )
+    {
+	for( int x=0; x<size-1; x++ )
+	{
+	    const int i = y * size + x;
+	    grid.faces.push_back( TriMesh::triangle_t( i, i + 1, i + size ) );
+	    grid.faces.push_back( TriMesh::triangle_t( i + 1, i + size + 1, i + size ) );
+	}
+    }
+
+    MeshNormals meshNormals;
+    meshNormals.build( grid.vertices.size(), grid.faces );
+    BOOST_CHECK_EQUAL( meshNormals.getFaceCount( 0 ), 1u );
+    BOOST_CHECK_EQUAL( meshNormals.getFaceCount( size + 1 ), 6u );
+    std::vector<Eigen::Vector3d> single, multi;
+    meshNormals.compute( grid.vertices, grid.faces, single, 1 );
+    meshNormals.compute( grid.vertices, grid.faces, multi, 4 );
+    BOOST_CHECK( single == multi );
+
+    TriMesh incremental;
+    incremental.vertices = grid.vertices;
+    incremental.faces.assign( grid.faces.begin(), grid.faces.begin() + grid.faces.size() / 2 );
+    incremental.calcVertexNormals();
+    const size_t firstFace = incremental.faces.size();
+    incremental.faces = grid.faces;
+    incremental.calcVertexNormals( firstFace );
+    BOOST_CHECK( incremental.getVertexData<Eigen::Vector3d>( TriMesh::VERTEX_NORMAL ) == single );
+
+    // the adjacency extended in small steps is the same as a full build
+    MeshNormals extended;
+    std::vector<TriMesh::triangle_t> faces( grid.faces.begin(), grid.faces.begin() + grid.faces.size() / 4 );
+    extended.build( grid.vertices.size(), faces );
+    for( size_t i=faces.size(); i<grid.faces.size(); i+=1000 )
+    {
+	faces.insert( faces.end(), grid.faces.begin() + i, grid.faces.begin() + std::min( i + 1000, grid.faces.size() ) );
+	extended.extend( grid.vertices.size(), faces );
+    }
+    BOOST_CHECK_EQUAL( extended.getMeshFaceCount(), grid.faces.size() );
+    BOOST_CHECK_EQUAL( extended.getFaceCount( size + 1 ), 6u );
+    std::vector<Eigen::Vector3d> extendedNormals;
+    extended.compute( grid.vertices, grid.faces, extendedNormals );
+    BOOST_CHECK( extendedNormals == single );
+
+    BOOST_CHECK_THROW( meshNormals.build( 3, mesh.faces ), std::runtime_error );
+}
+
+BOOST_AUTO_TEST_CASE( test_pointcloud_view )
+{
+    Pointcloud pc;
+    for( int i=0; i<10; i++ )
+	pc.vertices.push_back( Eigen::Vector3d( i, 2*i, 3*i ) );
+
+    // the slots refer to the same data as getVertexData
+    std::vector<Eigen::Vector3d> &colors( pc.getVertexColors() );
+    BOOST_CHECK_EQUAL( &colors, &pc.getVertexData<Eigen::Vector3d>( Pointcloud::VERTEX_COLOR ) );
+    colors.resize( pc.vertices.size(), Eigen::Vector3d( 1, 0, 0 ) );
+    pc.getVertexVariances().resize( 5, 0.1 );
+
+    PointcloudView view( pc.getView() );
+    BOOST_CHECK_EQUAL( view.size(), pc.vertices.size() );
+    BOOST_CHECK( view.hasColors() );
+    BOOST_CHECK( !view.hasNormals() );
+    // variances don't have the right size
+    BOOST_CHECK( !view.hasVariances() );
+    for( size_t i=0; i<view.size(); i++ )
+    {
+	BOOST_CHECK( view.point( i ) == pc.vertices[i] );
+	BOOST_CHECK( view.color( i ) == colors[i] );
+    }
+
+    // removing the data invalidates the slot
+    pc.removeData( Pointcloud::VERTEX_COLOR );
+    BOOST_CHECK( !pc.getView().hasColors() );
+    BOOST_CHECK( pc.getVertexColors().empty() );
+
+    // copies have their own slots
+    pc.getVertexAttributes().resize( pc.vertices.size(), Pointcloud::SCAN_EDGE );
+    Pointcloud copy( pc );
+    BOOST_CHECK( &copy.getVertexAttributes() != &pc.getVertexAttributes() );
+    BOOST_CHECK( copy.getVertexAttributes() == pc.getVertexAttributes() );
+    BOOST_CHECK_EQUAL( copy.getView().attribute( 3 ), Pointcloud::SCAN_EDGE );
+
+    // float data through a view with a stride
+    std::vector<float> data;
+    for( int i=0; i<10; i++ )
+    {
+	data.push_back( i ); data.push_back( 2*i ); data.push_back( 3*i ); data.push_back( 0 );
+    }
+    PointcloudViewf fview( &data[0], 10, 4 );
+    for( size_t i=0; i<fview.size(); i++ )
+	BOOST_CHECK( fview.point( i ).cast<double>() == pc.vertices[i] );
+}
+
+BOOST_AUTO_TEST_CASE( test_pointcloud_storage )
+{
+    Pointcloud pc;
+    for( int i=0; i<10; i++ )
+	pc.vertices.push_back( Eigen::Vector3d( i, 2*i, 0.1*i ) );
+    pc.getVertexColors().resize( pc.vertices.size(), Eigen::Vector3d( 1, 0.5, 0 ) );
+    pc.getVertexVariances().resize( pc.vertices.size(), 0.01 );
+
+    // single precision copy of the pointcloud, which only has the columns
+    // with data
+    PointcloudStoragef storage;
+    storage.assign( pc );
+    BOOST_CHECK_EQUAL( storage.size(), pc.vertices.size() );
+    BOOST_CHECK_EQUAL( storage.getColumns(), PointcloudStoragef::COLORS | PointcloudStoragef::VARIANCES );
+    BOOST_CHECK_EQUAL( sizeof( PointcloudStoragef::Vector3 ), 3 * sizeof( float ) );
+
+    PointcloudViewf view( storage.getView() );
+    BOOST_CHECK( view.hasColors() && view.hasVariances() && !view.hasNormals() );
+    for( size_t i=0; i<view.size(); i++ )
+    {
+	BOOST_CHECK( view.point( i ) == pc.vertices[i].cast<float>() );
+	BOOST_CHECK( view.color( i ) == Eigen::Vector3f( 1, 0.5, 0 ) );
+	BOOST_CHECK_EQUAL( view.variance( i ), 0.01f );
+    }
+
+    // appending and enabling columns
+    storage.push_back( Eigen::Vector3f( 1, 2, 3 ) );
+    storage.setColumns( storage.getColumns() | PointcloudStoragef::ATTRIBUTES );
+    storage.attribute( 10 ) = Pointcloud::SCAN_EDGE;
+    BOOST_CHECK( storage.color( 10 ) == Eigen::Vector3f::Zero() );
+    BOOST_CHECK_EQUAL( storage.attribute( 0 ), 0 );
+
+    // and back to a pointcloud, where the normals are removed since the
+    // storage doesn't have them
+    pc.getVertexNormals().resize( pc.vertices.size() );
+    storage.copyTo( pc );
+    BOOST_REQUIRE_EQUAL( pc.vertices.size(), 11u );
+    BOOST_CHECK( !pc.hasData( Pointcloud::VERTEX_NORMAL ) );
+    BOOST_CHECK( pc.vertices[3] == Eigen::Vector3f( 3, 6, 0.3f ).cast<double>() );
+    BOOST_CHECK( pc.vertices[10] == Eigen::Vector3d( 1, 2, 3 ) );
+    BOOST_CHECK_EQUAL( pc.getVertexAttributes()[10], Pointcloud::SCAN_EDGE );
+    BOOST_CHECK_EQUAL( pc.getVertexVariances().size(), 11u );
+    PointcloudView pview( pc.getView() );
+    BOOST_CHECK( pview.hasColors() && pview.hasVariances() && pview.hasAttributes() );
+}
+
+BOOST_AUTO_TEST_CASE( test_grid_window )
+{
+    const size_t size = 300;
+    Grid<float>::Ptr grid = new Grid<float>( size, size, 0.5, 0.5 );
+    Grid<float>::ArrayType& data( grid->getGridData() );
+    for( size_t y=0; y<size; y++ )
+	for( size_t x=0; x<size; x++ )
+	    data[y][x] = y * size + x;
+
+    const std::string path( (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path( "%%%%-%%%%-%%%%-%%%%.tiff" )).string() );
+    grid->writeGridData( Grid<float>::GRID_DATA, path );
+
+    // only read a window of the file
+    Grid<float>::Ptr window = new Grid<float>( 0, 0, 0.5, 0.5 );
+    window->readGridWindow( Grid<float>::GRID_DATA, path, 250, 100, 40, 30 );
+    BOOST_REQUIRE_EQUAL( window->getCellSizeX(), 40 );
+    BOOST_REQUIRE_EQUAL( window->getCellSizeY(), 30 );
+    for( size_t y=0; y<30; y++ )
+	for( size_t x=0; x<40; x++ )
+	    BOOST_CHECK_EQUAL( window->getGridData()[y][x], data[y + 100][x + 250] );
+
+    BOOST_CHECK_THROW( window->readGridWindow( Grid<float>::GRID_DATA, path, 280, 0, 40, 30 ), std::runtime_error );
+
+    // lazy access with a budget of a single tile
+    {
+	RasterTileCache cache( path, 1, 1 );
+	BOOST_REQUIRE_EQUAL( cache.getCellSizeX(), size );
+	BOOST_REQUIRE_EQUAL( cache.getCellSizeY(), size );
+	for( size_t y=0; y<size; y+=7 )
+	    for( size_t x=0; x<size; x+=13 )
+		BOOST_CHECK_EQUAL( cache.get( x, y ), data[y][x] );
+	BOOST_CHECK_EQUAL( cache.getResidentTiles(), 1 );
+	BOOST_CHECK( cache.getStatistics().tilesEvicted > 0 );
+    }
+
+    boost::filesystem::remove( path );
+}
+
+BOOST_AUTO_TEST_CASE( test_box_filter )
+{
+    const int w = 53, h = 41;
+    boost::multi_array<double,2> input( boost::extents[h][w] ), output( boost::extents[h][w] );
+    const double nodata = -1.0;
+    for( int y=0; y<h; y++ )
+	for( int x=0; x<w; x++ )
+	    input[y][x] = (x * 7 + y * 13) % 17 == 0 ? nodata : sin( x * 0.3 ) + y;
+
+    const int windows[][2] = { { 0, 0 }, { 1, 1 }, { 3, 2 }, { 15, 15 }, { 40, 39 } };
+    for( size_t i=0; i<sizeof(windows)/sizeof(windows[0]); i++ )
+    {
+	const int before = windows[i][0], after = windows[i][1];
+	boxFilter( input, output, before, after, &nodata );
+
+	for( int y=0; y<h; y++ )
+	    for( int x=0; x<w; x++ )
+	    {
+		double sum = 0;
+		int count = 0;
+		for( int yy=std::max( y-before, 0 ); yy<=std::min( y+after, h-1 ); yy++ )
+		    for( int xx=std::max( x-before, 0 ); xx<=std::min( x+after, w-1 ); xx++ )
+			if( input[yy][xx] != nodata )
+			{
+			    sum += input[yy][xx];
+			    count++;
+			}
+
+		if( input[y][x] == nodata )
+		    BOOST_CHECK_EQUAL( output[y][x], nodata );
+		else
+		    BOOST_CHECK_CLOSE( output[y][x], sum / count, 1e-9 );
+	    }
+    }
+}
+
+struct CountCells
+{
+    size_t count;
+    CountCells() : count(0) {}
+    void operator()(size_t x, size_t y) { count++; }
+};
+
+BOOST_AUTO_TEST_CASE( test_traversability_footprints )
+{
+    TraversabilityGrid tr(200, 200, 0.1, 0.1);
+    tr.setTraversabilityClass(0, TraversabilityClass(1.0));
+    tr.setTraversabilityClass(1, TraversabilityClass(0.5));
+    tr.setTraversabilityClass(2, TraversabilityClass(0.0));
+
+    TraversabilityGrid::ArrayType &data(tr.getGridData(TraversabilityGrid::TRAVERSABILITY));
+    std::fill(data.data(), data.data() + data.num_elements(), 0);
+    // obstacle 0.8m in front of the pose at (10.05, 10.05)
+    data[100][108] = 2;
+    // rough terrain 3m behind it
+    data[100][70] = 1;
+
+    const double sizeX = 2.0, sizeY = 1.0;
+    TraversabilityFootprints footprints(tr, sizeX, sizeY);
+
+    base::Pose2D front(Eigen::Vector2d(10.05, 10.05), 0);
+    TraversabilityFootprints::Result r = footprints.query(front);
+    BOOST_CHECK( r.valid );
+    BOOST_CHECK_EQUAL( r.worstClass, 2 );
+    BOOST_CHECK_EQUAL( r.worstClass, &tr.getWorstTraversabilityClassInRectangle(front, sizeX, sizeY) - &tr.getTraversabilityClasses()[0] );
+
+    // turned by 90 degrees the obstacle is outside of the footprint
+    base::Pose2D side(Eigen::Vector2d(10.05, 10.05), M_PI / 2.0);
+    r = footprints.query(side);
+    BOOST_CHECK_EQUAL( r.worstClass, 0 );
+    BOOST_CHECK_CLOSE( r.worstDrivability, 1.0, 1e-9 );
+
+    base::Pose2D back(Eigen::Vector2d(7.05, 10.05), M_PI);
+    r = footprints.query(back);
+    BOOST_CHECK_EQUAL( r.worstClass, 1 );
+    BOOST_CHECK_EQUAL( r.worstClass, &tr.getWorstTraversabilityClassInRectangle(back, sizeX, sizeY) - &tr.getTraversabilityClasses()[0] );
+
+    CountCells counter;
+    BOOST_CHECK( footprints.forEachCell(back, counter) );
+    BOOST_CHECK_EQUAL( counter.count, r.cells );
+
+    std::vector<size_t> histogram;
+    BOOST_CHECK( footprints.getHistogram(back, histogram) );
+    BOOST_CHECK_EQUAL( histogram[1], 1 );
+    BOOST_CHECK_EQUAL( histogram[0] + histogram[1], r.cells );
+
+    BOOST_CHECK( !footprints.query(base::Pose2D(Eigen::Vector2d(-1.0, 5.0), 0)).valid );
+
+    // batch results are the same as single queries
+    srand(0);
+    std::vector<base::Pose2D> poses;
+    for(size_t i = 0; i < 2000; i++)
+    {
+        poses.push_back(base::Pose2D(Eigen::Vector2d(rand() * 20.0 / RAND_MAX, rand() * 20.0 / RAND_MAX), 
+                    rand() * 2.0 * M_PI / RAND_MAX - M_PI));
+    }
+
+    std::vector<TraversabilityFootprints::Result> results;
+    footprints.query(poses, results);
+    BOOST_REQUIRE_EQUAL( results.size(), poses.size() );
+    for(size_t i = 0; i < poses.size(); i++)
+    {
+        TraversabilityFootprints::Result single = footprints.query(poses[i]);
+        BOOST_CHECK_EQUAL( results[i].valid, single.valid );
+        BOOST_CHECK_EQUAL( results[i].worstClass, single.worstClass );
+        BOOST_CHECK_EQUAL( results[i].cells, single.cells );
+    }
+}
+
+struct SetIndex
+{
+    boost::multi_array<int,2>* data;
+    void operator()(size_t x, size_t y) { (*data)[y][x] = y * 1000 + x; }
+};
+
+struct RowSum
+{
+    const boost::multi_array<float,2>* data;
+    std::vector<double>* sums;
+    void operator()(size_t x, size_t y) { (*sums)[y] += (*data)[y][x]; }
+};
+
+float scaleCell(float v) { return v * 2.0f + 1.0f; }
+float addCells(float a, float b) { return a + b; }
+
+BOOST_AUTO_TEST_CASE( test_grid_kernel )
+{
+    boost::multi_array<int,2> index( boost::extents[30][40] );
+    std::fill( index.data(), index.data() + index.num_elements(), -1 );
+    SetIndex setIndex;
+    setIndex.data = &index;
+    forEachCell( 5, 3, 35, 20, setIndex, 4 );
+    for( int y=0; y<30; y++ )
+	for( int x=0; x<40; x++ )
+	{
+	    if( x >= 5 && x < 35 && y >= 3 && y < 20 )
+		BOOST_CHECK_EQUAL( index[y][x], y * 1000 + x );
+	    else
+		BOOST_CHECK_EQUAL( index[y][x], -1 );
+	}
+
+    // compare with a column major loop, on a grid which is split into
+    // several blocks of rows
+    const size_t size = 1024;
+    boost::multi_array<float,2> a( boost::extents[size][size] ), b( boost::extents[size][size] );
+    for( size_t y=0; y<size; y++ )
+	for( size_t x=0; x<size; x++ )
+	    a[y][x] = (x + y) % 13;
+
+    for( size_t x=0; x<size; x++ )
+	for( size_t y=0; y<size; y++ )
+	    b[y][x] = scaleCell( a[y][x] );
+    boost::multi_array<float,2> c( boost::extents[size][size] );
+    transformCells( a, c, scaleCell );
+    BOOST_CHECK( b == c );
+    std::fill( c.data(), c.data() + c.num_elements(), 0.0f );
+    transformCells( a, c, scaleCell, 0 );
+    BOOST_CHECK( b == c );
+
+    zipCells( a, b, c, addCells, 0 );
+    for( size_t y=0; y<size; y+=97 )
+	for( size_t x=0; x<size; x+=89 )
+	    BOOST_CHECK_EQUAL( c[y][x], a[y][x] + b[y][x] );
+
+    // each thread works on separate rows
+    std::vector<double> sums( size );
+    RowSum rowSum;
+    rowSum.data = &a;
+    rowSum.sums = &sums;
+    forEachCell( a, rowSum, 0 );
+    for( size_t y=0; y<size; y+=101 )
+	BOOST_CHECK_EQUAL( sums[y], std::accumulate( a[y].begin(), a[y].end(), 0.0 ) );
+}
@@ -1,14 +1,19 @@
 #define BOOST_TEST_MODULE MLSTest 
 #include <boost/test/included/unit_test.hpp>
 #include <boost/scoped_ptr.hpp>
+#include <boost/filesystem.hpp>
 
 #include "envire/Core.hpp"
 
 #include "envire/maps/MLSGrid.hpp"
 #include "envire/operators/MLSProjection.hpp"
 #include "envire/operators/MergeMLS.hpp"
+#include "envire/operators/GridFloatToMLS.hpp"
+#include "envire/operators/TraversabilityGrassfire.hpp"
 
 #include "envire/tools/ListGrid.hpp"
+#include "envire/tools/TiledMLSBuilder.hpp"
+#include "envire/tools/MLSFreeSpace.hpp"
 
 #include <base/TimeMark.hpp>
 
@@ -215,6 +220,64 @@ BOOST_AUTO_TEST_CASE( list_grid )
     }
 }
 
+/** counts the live instances, to check that the elements of a ListGrid are
+ * constructed and destroyed */
+struct Counted
+{
+    static int instances;
+    std::string name;
+    Counted( const std::string& name ) : name( name ) { instances++; }
+    Counted( const Counted& other ) : name( other.name ) { instances++; }
+    ~Counted() { instances--; }
+};
+int Counted::instances = 0;
+
+BOOST_AUTO_TEST_CASE( list_grid_construction )
+{
+    {
+	ListGrid<Counted> lg( 10, 10 );
+	lg.insertHead( 0, 0, Counted( "head" ) );
+	lg.insertTail( 0, 0, Counted( "tail" ) );
+
+	ListGrid<Counted>::Block block = lg.allocate( 3 );
+	for( size_t i=0; i<3; i++ )
+	    lg.setCell( i + 1, 0, block, i, Counted( std::string( 20, 'a' + i ) ) );
+	BOOST_CHECK_EQUAL( Counted::instances, 5 );
+	BOOST_CHECK_EQUAL( lg.beginCell( 2, 0 )->name, std::string( 20, 'b' ) );
+
+	lg.erase( lg.beginCell( 0, 0 ) );
+	lg.erase( lg.beginCell( 3, 0 ) );
+	BOOST_CHECK_EQUAL( Counted::instances, 3 );
+	BOOST_CHECK_EQUAL( lg.beginCell( 0, 0 )->name, "tail" );
+    }
+    BOOST_CHECK_EQUAL( Counted::instances, 0 );
+}
+
+BOOST_AUTO_TEST_CASE( mls_copy_on_write )
+{
+    MLSGrid mls( 10, 10, 0.1, 0.1 );
+    mls.insertHead( 1, 1, MLSGrid::SurfacePatch( 1.0, 0.1 ) );
+
+    // the copy shares the patches until either grid is written
+    boost::scoped_ptr<MLSGrid> copy( mls.clone() );
+    const MLSGrid &cmls( mls ), &ccopy( *copy );
+    BOOST_CHECK( &*cmls.beginCell( 1, 1 ) == &*ccopy.beginCell( 1, 1 ) );
+
+    // writing detaches the source and leaves the copy unchanged
+    mls.beginCell( 1, 1 )->mean = 2.0;
+    mls.insertHead( 2, 2, MLSGrid::SurfacePatch( 3.0, 0.1 ) );
+    BOOST_CHECK( &*cmls.beginCell( 1, 1 ) != &*ccopy.beginCell( 1, 1 ) );
+    BOOST_CHECK_EQUAL( ccopy.beginCell( 1, 1 )->mean, 1.0 );
+    BOOST_CHECK( ccopy.beginCell( 2, 2 ) == ccopy.endCell() );
+    BOOST_CHECK_EQUAL( cmls.beginCell( 1, 1 )->mean, 2.0 );
+
+    // clearing a shared grid doesn't touch the copy
+    MLSGrid other( mls );
+    other.clear();
+    BOOST_CHECK( other.beginCell( 1, 1 ) == other.endCell() );
+    BOOST_CHECK_EQUAL( cmls.beginCell( 1, 1 )->mean, 2.0 );
+}
+
 BOOST_AUTO_TEST_CASE( mls_patch )
 {
     {
@@ -244,3 +307,314 @@ BOOST_AUTO_TEST_CASE( mls_patch )
 }
 
 
+
+BOOST_AUTO_TEST_CASE( tiled_mls_builder )
+{
+    // points on a slanted plane, some of them in the same cells
+    std::vector<Eigen::Vector3d> points;
+    srand(0);
+    for( int i=0; i<5000; i++ )
+    {
+	Eigen::Vector3d p( rand() % 3000 / 1000.0, rand() % 3000 / 1000.0, 0 );
+	p.z() = 0.1 * p.x() + rand() % 100 / 1000.0;
+	points.push_back( p );
+    }
+
+    // reference is a single grid covering the whole area
+    MLSGrid::Ptr ref( new MLSGrid( 30, 30, 0.1, 0.1 ) );
+    for( size_t i=0; i<points.size(); i++ )
+	ref->update( points[i].head<2>(), MLSGrid::SurfacePatch( points[i].z(), 0.1 ) );
+
+    // only allowing a single resident tile, will force a lot of flushes and
+    // reloads between the chunks
+    const std::string path( (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()).string() );
+    TiledMLSBuilder builder( path, 0.1, 8, 1 );
+    builder.setDefaultUncertainty( 0.01 );
+    for( size_t i=0; i<points.size(); i+=500 )
+    {
+	std::vector<Eigen::Vector3d> chunk( points.begin() + i, points.begin() + i + 500 );
+	builder.addPoints( chunk, Eigen::Affine3d::Identity() );
+    }
+    builder.finish();
+
+    BOOST_CHECK_EQUAL( builder.getStatistics().points, points.size() );
+    BOOST_CHECK_EQUAL( builder.getTileCount(), 16 );
+    BOOST_CHECK( builder.getStatistics().tilesLoaded > 0 );
+
+    for( int tx=0; tx<4; tx++ )
+    {
+	for( int ty=0; ty<4; ty++ )
+	{
+	    boost::scoped_ptr<Environment> env( 
+		    Environment::unserialize( path + "/" + TiledMLSBuilder::getTileName( tx, ty ) ) );
+	    MLSGrid* tile = env->getItems<MLSGrid>().front();
+	    for( size_t x=0; x<8; x++ )
+	    {
+		for( size_t y=0; y<8; y++ )
+		{
+		    const size_t rx = tx * 8 + x, ry = ty * 8 + y;
+		    if( rx >= 30 || ry >= 30 )
+			continue;
+
+		    MLSGrid::iterator rit = ref->beginCell( rx, ry );
+		    MLSGrid::iterator tit = tile->beginCell( x, y );
+		    for( ; rit != ref->endCell() && tit != tile->endCell(); rit++, tit++ )
+			BOOST_CHECK_CLOSE( rit->mean, tit->mean, 1e-3 );
+		    BOOST_CHECK( rit == ref->endCell() && tit == tile->endCell() );
+		}
+	    }
+	}
+    }
+
+    boost::filesystem::remove_all( path );
+
+    // the colors are kept in the first tile of a colored cloud
+    const std::string colorPath( (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()).string() );
+    TiledMLSBuilder colorBuilder( colorPath, 0.1, 8, 1 );
+    std::vector<Eigen::Vector3d> colorPoints( 1, Eigen::Vector3d( 0.05, 0.05, 0 ) ), colors( 1, Eigen::Vector3d( 1.0, 0, 0 ) );
+    colorBuilder.addPoints( colorPoints, Eigen::Affine3d::Identity(), NULL, &colors );
+    colorBuilder.finish();
+    {
+	boost::scoped_ptr<Environment> env( 
+		Environment::unserialize( colorPath + "/" + TiledMLSBuilder::getTileName( 0, 0 ) ) );
+	MLSGrid* tile = env->getItems<MLSGrid>().front();
+	BOOST_CHECK( tile->getConfig().useColor );
+	BOOST_REQUIRE( tile->beginCell( 0, 0 ) != tile->endCell() );
+	BOOST_CHECK_CLOSE( tile->beginCell( 0, 0 )->getColor().x(), 1.0, 1.0 );
+	BOOST_CHECK( !colorBuilder.getConfig().useColor );
+    }
+    boost::filesystem::remove_all( colorPath );
+}
+
+BOOST_AUTO_TEST_CASE( mls_free_space )
+{
+    MLSGrid grid( 50, 50, 0.1, 0.1 );
+    grid.updateCell( 40, 25, MLSGrid::SurfacePatch( 0.0, 0.1 ) );
+
+    // the ray from the patch to the origin at a height of 1
+    MLSFreeSpace freeSpace( grid, GridBase::Position( 10, 25 ), 1.0 );
+    freeSpace.addCell( grid, GridBase::Position( 40, 25 ) );
+    BOOST_CHECK_EQUAL( freeSpace.getCellCount(), 30u );
+    freeSpace.apply();
+    BOOST_CHECK_EQUAL( freeSpace.getCellCount(), 0u );
+
+    // the cell itself is not changed
+    BOOST_REQUIRE( grid.beginCell( 40, 25 ) != grid.endCell() );
+    BOOST_CHECK( grid.beginCell( 40, 25 )->isHorizontal() );
+    BOOST_CHECK( ++grid.beginCell( 40, 25 ) == grid.endCell() );
+
+    // the negative patches go from the height of the origin down to the
+    // patch
+    double last = 1.1;
+    for( size_t x=10; x<40; x++ )
+    {
+	MLSGrid::iterator it = grid.beginCell( x, 25 );
+	BOOST_REQUIRE( it != grid.endCell() );
+	BOOST_CHECK( it->isNegative() );
+	BOOST_CHECK( it->mean < last );
+	last = it->mean;
+	BOOST_CHECK( ++it == grid.endCell() );
+    }
+    BOOST_CHECK_CLOSE( grid.beginCell( 10, 25 )->mean, 1.0, 1e-4 );
+    BOOST_CHECK( grid.beginCell( 10, 26 ) == grid.endCell() );
+}
+
+BOOST_AUTO_TEST_CASE( grid_float_to_mls )
+{
+    boost::scoped_ptr<Environment> env( new Environment() );
+    const size_t width = 300, height = 200;
+    Grid<float>* grid = new Grid<float>( width, height, 0.1, 0.1 );
+    Grid<float>::ArrayType& data( grid->getGridData() );
+    grid->setNoData( -1 );
+    for( size_t y=0; y<height; y++ )
+	for( size_t x=0; x<width; x++ )
+	    data[y][x] = (x * y) % 7 ? 0.01 * x + y : -1;
+    data[150][20] = std::numeric_limits<float>::quiet_NaN();
+    env->attachItem( grid );
+    env->setFrameNode( grid, env->getRootNode() );
+
+    // empty target, which uses the bulk import
+    MLSGrid* mls = new MLSGrid( width, height, 0.1, 0.1 );
+    env->attachItem( mls );
+    env->setFrameNode( mls, env->getRootNode() );
+
+    GridFloatToMLS* op = new GridFloatToMLS();
+    env->attachItem( op );
+    op->setInput( grid );
+    op->setOutput( mls );
+    op->updateAll();
+
+    size_t count = 0;
+    for( size_t y=0; y<height; y++ )
+    {
+	for( size_t x=0; x<width; x++ )
+	{
+	    MLSGrid::iterator it = mls->beginCell( x, y );
+	    const float value = data[y][x];
+	    if( value == -1 || value != value )
+	    {
+		BOOST_CHECK( it == mls->endCell() );
+		continue;
+	    }
+
+	    // same patch as created by updateCell
+	    MLSGrid::SurfacePatch ref( value, 0 );
+	    BOOST_REQUIRE( it != mls->endCell() );
+	    BOOST_CHECK_EQUAL( it->mean, ref.mean );
+	    BOOST_CHECK_EQUAL( it->stdev, ref.stdev );
+	    BOOST_CHECK( it->isHorizontal() );
+	    BOOST_CHECK( ++it == mls->endCell() );
+	    count++;
+	}
+    }
+    BOOST_CHECK_EQUAL( mls->getCellCount(), count );
+    BOOST_CHECK( mls->getCellExtents().min() == Eigen::Vector2i( 1, 1 ) );
+    BOOST_CHECK( mls->getCellExtents().max() == Eigen::Vector2i( width - 1, height - 1 ) );
+
+    // the patches can be removed again individually
+    mls->erase( mls->beginCell( 1, 1 ) );
+    BOOST_CHECK( mls->beginCell( 1, 1 ) == mls->endCell() );
+    BOOST_CHECK_EQUAL( mls->getCellCount(), count - 1 );
+
+    // a second conversion merges into the existing patches
+    op->updateAll();
+    BOOST_CHECK_EQUAL( mls->getCellCount(), count );
+}
+
+/** sets up a grassfire on a 20x20 MLS with 0.1m cells, starting in the
+ * cell (5, 10) */
+struct GrassfireFixture
+{
+    boost::scoped_ptr<Environment> env;
+    MLSGrid* mls;
+    TraversabilityGrid* trav;
+    TraversabilityGrassfire* op;
+
+    GrassfireFixture( double maxSlope = 0.5 )
+	: env( new Environment() )
+    {
+	mls = new MLSGrid( 20, 20, 0.1, 0.1 );
+	env->attachItem( mls );
+	env->setFrameNode( mls, env->getRootNode() );
+	op = addGrassfire( maxSlope );
+	trav = op->getOutput<TraversabilityGrid*>();
+    }
+
+    TraversabilityGrassfire* addGrassfire( double maxSlope )
+    {
+	TraversabilityGrid* grid = new TraversabilityGrid( 20, 20, 0.1, 0.1 );
+	env->attachItem( grid );
+	env->setFrameNode( grid, env->getRootNode() );
+
+	TraversabilityGrassfire::Config config;
+	config.maxStepHeight = 0.2;
+	config.maxSlope = maxSlope;
+	config.robotHeight = 1.0;
+	config.numTraversabilityClasses = 10;
+
+	TraversabilityGrassfire* grassfire = new TraversabilityGrassfire();
+	env->attachItem( grassfire );
+	grassfire->addInput( mls );
+	grassfire->addOutput( grid );
+	grassfire->setConfig( config );
+	grassfire->setStartPosition( Eigen::Vector3d( 0.55, 1.05, 0.0 ) );
+	return grassfire;
+    }
+
+    uint8_t getClass( size_t x, size_t y ) const
+    {
+	return static_cast<const TraversabilityGrid&>( *trav ).getGridData( TraversabilityGrid::TRAVERSABILITY )[y][x];
+    }
+};
+
+BOOST_AUTO_TEST_CASE( grassfire_classification )
+{
+    // flat floor with a wall in column 10, which the grassfire can't pass
+    GrassfireFixture f;
+    for( size_t y=0; y<20; y++ )
+	for( size_t x=0; x<20; x++ )
+	    f.mls->insertHead( x, y, MLSGrid::SurfacePatch( x == 10 ? 1.0 : 0.0, 0 ) );
+    f.op->updateAll();
+
+    // UNKNOWN is 0, OBSTACLE 1 and the flat floor gets the best class
+    const uint8_t unknown = 0, obstacle = 1, best = 11;
+    for( size_t y=0; y<20; y++ )
+    {
+	for( size_t x=0; x<20; x++ )
+	{
+	    uint8_t expected;
+	    if( x > 10 )
+		expected = unknown;	// not reached
+	    else if( x >= 9 )
+		expected = obstacle;	// step to or from the wall
+	    else if( x == 0 && (y == 0 || y == 19) )
+		expected = unknown;	// less than 5 neighbours
+	    else
+		expected = best;
+	    BOOST_CHECK_EQUAL( (int)f.getClass( x, y ), (int)expected );
+	}
+    }
+
+    const TraversabilityGrassfire::Statistics& stats( f.op->getStatistics() );
+    BOOST_CHECK_EQUAL( stats.total, 400u );
+    BOOST_CHECK_EQUAL( stats.stepTooHigh, 40u );
+    BOOST_CHECK_EQUAL( stats.slopeTooHigh, 0u );
+    BOOST_CHECK_EQUAL( stats.drivable, 178u );
+}
+
+BOOST_AUTO_TEST_CASE( grassfire_slope_statistics )
+{
+    // plane with a slope of atan(0.5), about 0.46 rad
+    for( int i=0; i<2; i++ )
+    {
+	const double maxSlope = i ? 0.4 : 0.5;
+	GrassfireFixture f( maxSlope );
+	for( size_t y=0; y<20; y++ )
+	    for( size_t x=0; x<20; x++ )
+		f.mls->insertHead( x, y, MLSGrid::SurfacePatch( 0.05 * x, 0 ) );
+	f.op->setStartPosition( Eigen::Vector3d( 0.55, 1.05, 0.25 ) );
+	f.op->updateAll();
+
+	// all cells but the corners are classified
+	const TraversabilityGrassfire::Statistics& stats( f.op->getStatistics() );
+	BOOST_CHECK_EQUAL( stats.total, 400u );
+	BOOST_CHECK_EQUAL( stats.stepTooHigh, 0u );
+	BOOST_CHECK_EQUAL( stats.slopeTooHigh, i ? 396u : 0u );
+	BOOST_CHECK_EQUAL( stats.drivable, i ? 0u : 396u );
+
+	// drivability 1 - 0.46 / 0.5 is in the lowest of the 10 classes
+	BOOST_CHECK_EQUAL( (int)f.getClass( 5, 5 ), i ? 1 : 2 );
+	BOOST_CHECK_EQUAL( (int)f.getClass( 0, 0 ), 0 );
+    }
+}
+
+BOOST_AUTO_TEST_CASE( grassfire_incremental )
+{
+    // uneven floor, which is classified by an incremental and a full
+    // grassfire
+    GrassfireFixture f;
+    for( size_t y=0; y<20; y++ )
+	for( size_t x=0; x<20; x++ )
+	    f.mls->insertHead( x, y, MLSGrid::SurfacePatch( 0.01 * ((x * 7 + y * 3) % 5), 0 ) );
+    f.op->setIncremental( true );
+    TraversabilityGrassfire* full = f.addGrassfire( 0.5 );
+    const TraversabilityGrid& fullGrid( *full->getOutput<TraversabilityGrid*>() );
+    const TraversabilityGrid& incGrid( *f.trav );
+
+    f.op->updateAll();
+    full->updateAll();
+    BOOST_CHECK( incGrid.getGridData( TraversabilityGrid::TRAVERSABILITY ) 
+	    == fullGrid.getGridData( TraversabilityGrid::TRAVERSABILITY ) );
+
+    // a local change only reclassifies the 3x3 neighbourhood
+    f.mls->beginCell( 12, 7 )->mean = 0.35;
+    f.op->updateAll();
+    full->updateAll();
+    BOOST_CHECK_EQUAL( f.op->getStatistics().total, 9u );
+    BOOST_CHECK_EQUAL( full->getStatistics().total, 400u );
+    BOOST_CHECK( incGrid.getGridData( TraversabilityGrid::TRAVERSABILITY ) 
+	    == fullGrid.getGridData( TraversabilityGrid::TRAVERSABILITY ) );
+    BOOST_CHECK( incGrid.getGridData( TraversabilityGrid::PROBABILITY ) 
+	    == fullGrid.getGridData( TraversabilityGrid::PROBABILITY ) );
+    BOOST_CHECK_EQUAL( (int)f.getClass( 12, 7 ), 1 );
+}
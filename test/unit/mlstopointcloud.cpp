@@ -212,3 +212,96 @@ BOOST_AUTO_TEST_CASE( test_negative_gap_double )
 	}
 }
 
+
+BOOST_AUTO_TEST_CASE( test_patch_selection_and_dirty_tiles )
+{
+	boost::shared_ptr<Environment> env(new Environment);
+	MLSGrid* mls_grid = new MLSGrid(200, 150, 0.1, 0.1);
+	Pointcloud* pc = new Pointcloud();
+	MLSToPointCloud* mlsToPCptr = new MLSToPointCloud();
+	
+	env->attachItem( mls_grid );
+	env->attachItem( pc );
+	
+	FrameNode* fm = new FrameNode();
+	env->getRootNode()->addChild( fm );
+	mls_grid->setFrameNode( fm );
+	pc->setFrameNode( fm );
+	
+	env->addInput(mlsToPCptr, mls_grid);
+	env->addOutput(mlsToPCptr, pc);
+	
+	// two horizontal patches in every second cell, one in the others
+	size_t cells = 0;
+	for(size_t x = 0; x < mls_grid->getCellSizeX(); x++)
+	{
+		for(size_t y = 0; y < mls_grid->getCellSizeY(); y++)
+		{
+			MLSGrid::SurfacePatch patch( x * 0.01, 0.05 );
+			patch.update_idx = 1;
+			mls_grid->insertTail(x, y, patch);
+			if( (x + y) % 2 )
+			{
+				patch.mean += 5;
+				mls_grid->insertTail(x, y, patch);
+			}
+			cells++;
+		}
+	}
+	
+	mlsToPCptr->updateAll();
+	BOOST_CHECK_EQUAL( pc->vertices.size(), mls_grid->getCellCount() );
+
+	mlsToPCptr->setPatchSelection( MLSExtraction::TOP_PATCH );
+	mlsToPCptr->updateAll();
+	BOOST_REQUIRE_EQUAL( pc->vertices.size(), cells );
+	for(size_t i = 0; i < pc->vertices.size(); i++)
+	{
+		size_t x, y;
+		BOOST_REQUIRE( mls_grid->toGrid( pc->vertices[i].x(), pc->vertices[i].y(), x, y ) );
+		BOOST_CHECK_CLOSE( pc->vertices[i].z(), x * 0.01 + ((x + y) % 2 ? 5 : 0), 1e-3 );
+	}
+
+	// only the tile with the changed update index is converted again
+	mlsToPCptr->setMinUpdateIndex( 2 );
+	mls_grid->beginCell( 0, 0 )->mean = 100;
+	mls_grid->beginCell( 150, 120 )->mean = 100;
+	mls_grid->beginCell( 150, 120 )->update_idx = 2;
+	mlsToPCptr->updateAll();
+	BOOST_REQUIRE_EQUAL( pc->vertices.size(), cells );
+	size_t updated = 0;
+	for(size_t i = 0; i < pc->vertices.size(); i++)
+	{
+		if( pc->vertices[i].z() == 100 )
+		{
+			size_t x, y;
+			mls_grid->toGrid( pc->vertices[i].x(), pc->vertices[i].y(), x, y );
+			BOOST_CHECK( x == 150 && y == 120 );
+			updated++;
+		}
+	}
+	BOOST_CHECK_EQUAL( updated, 1u );
+
+	// moving the grid invalidates the points of the clean tiles, which
+	// are in the old pose
+	fm->setTransform( Eigen::Affine3d( Eigen::Translation3d( 0, 0, 1 ) ) );
+	mlsToPCptr->updateAll();
+	BOOST_REQUIRE_EQUAL( pc->vertices.size(), cells );
+	updated = 0;
+	for(size_t i = 0; i < pc->vertices.size(); i++)
+	{
+		if( pc->vertices[i].z() == 101 )
+			updated++;
+	}
+	BOOST_CHECK_EQUAL( updated, 2u );
+
+	// the grid output uses the same extraction
+	MLSExtraction extraction( *mls_grid );
+	boost::multi_array<double, 2> elevation( boost::extents[150][200] );
+	extraction.setPatchSelection( MLSExtraction::TOP_PATCH );
+	extraction.extractElevation( elevation );
+	BOOST_CHECK_CLOSE( elevation[10][21], 21 * 0.01 + 5, 1e-3 );
+	extraction.setPatchSelection( MLSExtraction::HORIZONTAL_PATCHES );
+	extraction.extractElevation( elevation );
+	BOOST_CHECK_EQUAL( elevation[0][0], 100 );
+}
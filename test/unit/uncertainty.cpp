@@ -74,3 +74,89 @@ BOOST_AUTO_TEST_CASE( test_relative_uncertainty )
 //    std::cout << t1r.getCovariance() << std::endl;
     
 }
+
+BOOST_AUTO_TEST_CASE( test_point_uncertainty_propagator ) 
+{
+    Eigen::Matrix<double,6,6> lt = Eigen::Matrix<double,6,6>::Identity() * 0.01;
+    lt(0,3) = lt(3,0) = 0.005;
+    lt(2,2) = 0.1;
+
+    // without rotation, the Jacobian of the point is [-[x] I]
+    TransformWithUncertainty t( Eigen::Affine3d( Eigen::Translation3d( 1, 2, 3 ) ), lt );
+    const Eigen::Vector3d x( 2, -1, 0.5 );
+    Eigen::Matrix3d Sx;
+    Sx << 0, -x.z(), x.y(),
+       x.z(), 0, -x.x(),
+       -x.y(), x.x(), 0;
+    Eigen::Matrix<double,3,6> J;
+    J << -Sx, Eigen::Matrix3d::Identity();
+
+    PointWithUncertainty p = t * PointWithUncertainty( x, Eigen::Matrix3d::Zero() );
+    BOOST_CHECK( p.getPoint().isApprox( t.getTransform() * x ) );
+    BOOST_CHECK( p.getCovariance().isApprox( J * lt * J.transpose(), 1e-12 ) );
+
+    // the batch version gives the same results as the single points
+    TransformWithUncertainty tr( 
+	    Eigen::Affine3d( Eigen::Translation3d( 1, 0, 0 ) * Eigen::AngleAxisd( 0.5, Eigen::Vector3d( 1, 1, 0 ).normalized() ) ), lt );
+    std::vector<PointWithUncertainty> points, result;
+    for( int i=0; i<10; i++ )
+	points.push_back( PointWithUncertainty( Eigen::Vector3d( i, -i, 0.5 * i ), Eigen::Matrix3d::Identity() * 0.01 * i ) );
+    PointUncertaintyPropagator( tr ).transform( points, result );
+    BOOST_REQUIRE_EQUAL( result.size(), points.size() );
+    for( size_t i=0; i<points.size(); i++ )
+    {
+	PointWithUncertainty pi = tr * points[i];
+	BOOST_CHECK( result[i].getPoint().isApprox( pi.getPoint() ) );
+	BOOST_CHECK( result[i].getCovariance().isApprox( pi.getCovariance() ) );
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_cached_frame_chain ) 
+{
+    Environment env;
+    Eigen::Matrix<double,6,6> lt = Eigen::Matrix<double,6,6>::Identity() * 0.01;
+
+    // a chain of frames with uncertainty
+    std::vector<FrameNode*> chain;
+    std::vector<TransformWithUncertainty, Eigen::aligned_allocator<TransformWithUncertainty> > transforms;
+    FrameNode *parent = env.getRootNode();
+    for( int i=0; i<5; i++ )
+    {
+	TransformWithUncertainty t( 
+		Eigen::Affine3d( Eigen::Translation3d( 1, 0, 0.1 * i ) * Eigen::AngleAxisd( 0.2 * i, Eigen::Vector3d::UnitZ() ) ), lt );
+	FrameNode *fn = new FrameNode( t );
+	env.addChild( parent, fn );
+	chain.push_back( fn );
+	transforms.push_back( t );
+	parent = fn;
+    }
+    FrameNode *other = new FrameNode( TransformWithUncertainty( Eigen::Affine3d( Eigen::Translation3d( 0, 5, 0 ) ), lt ) );
+    env.addChild( env.getRootNode(), other );
+
+    const double sigma = 1e-9;
+    for( int round=0; round<2; round++ )
+    {
+	// compare with the explicit composition of the chain
+	TransformWithUncertainty expected = transforms[0];
+	for( size_t i=1; i<transforms.size(); i++ )
+	    expected = expected * transforms[i];
+	expected = other->getTransformWithUncertainty().inverse() * expected;
+
+	TransformWithUncertainty result = env.relativeTransformWithUncertainty( chain.back(), other );
+	BOOST_CHECK( result.getTransform().matrix().isApprox( expected.getTransform().matrix(), sigma ) );
+	BOOST_CHECK( result.getCovariance().isApprox( expected.getCovariance(), sigma ) );
+	BOOST_CHECK( env.relativeTransform( chain.back(), other ).matrix().isApprox( expected.getTransform().matrix(), sigma ) );
+
+	// changing a frame in the middle of the chain updates the result
+	transforms[2] = TransformWithUncertainty( Eigen::Affine3d( Eigen::Translation3d( 0, 0, 2 ) ), lt * 2.0 );
+	chain[2]->setTransform( transforms[2] );
+    }
+
+    // moving a subtree to another parent
+    env.addChild( other, chain[3] );
+    TransformWithUncertainty expected = 
+	other->getTransformWithUncertainty() * transforms[3] * transforms[4];
+    TransformWithUncertainty result = env.relativeTransformWithUncertainty( chain[4], env.getRootNode() );
+    BOOST_CHECK( result.getTransform().matrix().isApprox( expected.getTransform().matrix(), sigma ) );
+    BOOST_CHECK( result.getCovariance().isApprox( expected.getCovariance(), sigma ) );
+}
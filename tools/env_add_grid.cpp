@@ -2,6 +2,7 @@
 #include <envire/maps/GridBase.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <boost/tuple/tuple.hpp>
+#include <boost/lexical_cast.hpp>
 
 #include <iostream>
 
@@ -20,12 +21,25 @@ void usage(int exit_code = 0)
         << "  finally, if none is given, a new map is created and added to the environment's root frame"
         << "\n"
         << "  files with multiple bands are not supported yet\n"
+        << "\n"
+        << "  all forms accept -window <x> <y> <width> <height> as the last argument, in which case only\n"
+        << "  the given window (in cells) of the file is loaded\n"
         << std::endl;
     exit(exit_code);
 }
 
 int main(int argc, char* argv[])
 {
+    size_t window[4] = { 0, 0, 0, 0 };
+    bool use_window = false;
+    if (argc > 5 && std::string(argv[argc - 5]) == "-window")
+    {
+        for (int i = 0; i < 4; ++i)
+            window[i] = boost::lexical_cast<size_t>(argv[argc - 4 + i]);
+        use_window = true;
+        argc -= 5;
+    }
+
     if (argc < 4 || argc > 6 )
         usage(1);
 
@@ -36,7 +50,11 @@ int main(int argc, char* argv[])
     boost::scoped_ptr<envire::Environment> env(Environment::unserialize(env_path));
     envire::GridBase::Ptr input;
     Transform transform;
-    boost::tie(input, transform) = GridBase::readGridFromGdal(grid_file, target_band);
+    if (use_window)
+        boost::tie(input, transform) = GridBase::readGridWindowFromGdal(grid_file, target_band,
+                window[0], window[1], window[2], window[3]);
+    else
+        boost::tie(input, transform) = GridBase::readGridFromGdal(grid_file, target_band);
 
     std::string frame_id = "", map_id = "";
     std::string map_type;
@@ -2,21 +2,150 @@
 #include "icp/icp.hpp"
 
 #include "envire/Core.hpp"
+#include "envire/core/Serialization.hpp"
 #include "envire/maps/TriMesh.hpp"
 #include "envire/maps/MLSGrid.hpp"
 #include "envire/operators/MLSProjection.hpp"
+#include "envire/tools/PointcloudReader.hpp"
+#include "envire/tools/TiledMLSBuilder.hpp"
 
 #include "boost/scoped_ptr.hpp"
+#include "boost/filesystem.hpp"
 #include <sstream>
+#include <iomanip>
 
 using namespace envire;
 using namespace std;
+
+void printProgress( const std::string& name, double progress, const TiledMLSBuilder& builder, const base::Time& start )
+{
+    const size_t points = builder.getStatistics().points;
+    const double seconds = (base::Time::now() - start).toSeconds();
+    std::cout << name << ": " << std::fixed << std::setprecision(1) << progress * 100.0 << "% "
+	<< points << " points "
+	<< std::setprecision(0) << (seconds > 0 ? points / seconds : 0.0) << " points/s "
+	<< builder.getResidentTiles() << "/" << builder.getTileCount() << " tiles in memory" << std::endl;
+}
+
+/** 
+ * streaming mode, which reads the pointclouds one at a time in chunks and
+ * builds a tiled mls, of which only a limited number of tiles is kept in
+ * memory.
+ */
+int streamMain( int argc, char* argv[] )
+{
+    double res = 0.05;
+    double var = -1;
+    double gapSize = 0.5;
+    double patchThickness = -1;
+    size_t tileCells = 512;
+    size_t maxTiles = 16;
+    size_t chunkSize = 1000000;
+    int sample = 1;
+    bool withColor = false;
+
+    std::vector<std::string> inputs;
+    std::string output;
+    for( int i=2; i<argc; i++ )
+    {
+	const std::string arg( argv[i] );
+	if( i+1 < argc && arg == "--resolution" ) res = boost::lexical_cast<double>( argv[++i] );
+	else if( i+1 < argc && arg == "--variance" ) var = boost::lexical_cast<double>( argv[++i] );
+	else if( i+1 < argc && arg == "--gap-size" ) gapSize = boost::lexical_cast<double>( argv[++i] );
+	else if( i+1 < argc && arg == "--patch-thickness" ) patchThickness = boost::lexical_cast<double>( argv[++i] );
+	else if( i+1 < argc && arg == "--tile-cells" ) tileCells = boost::lexical_cast<size_t>( argv[++i] );
+	else if( i+1 < argc && arg == "--max-tiles" ) maxTiles = boost::lexical_cast<size_t>( argv[++i] );
+	else if( i+1 < argc && arg == "--chunk-size" ) chunkSize = boost::lexical_cast<size_t>( argv[++i] );
+	else if( i+1 < argc && arg == "--sample" ) sample = boost::lexical_cast<int>( argv[++i] );
+	else if( arg == "--xyzr" ) withColor = true;
+	else if( output.empty() ) output = arg;
+	else inputs.push_back( arg );
+    }
+    if( output.empty() || inputs.empty() )
+    {
+	std::cout << "missing output or input for streaming mode." << std::endl;
+	return 1;
+    }
+    if( var < 0 ) var = res;
+    if( patchThickness < 0 ) patchThickness = res;
+
+    TiledMLSBuilder builder( output, res, tileCells, maxTiles );
+    builder.getConfig().gapSize = gapSize;
+    builder.getConfig().thickness = patchThickness;
+    builder.setDefaultUncertainty( var );
+
+    const base::Time start = base::Time::now();
+    std::vector<Eigen::Vector3d> points, colors;
+    for( size_t i=0; i<inputs.size(); i++ )
+    {
+	if( boost::filesystem::is_directory( inputs[i] ) )
+	{
+	    // the input is an environment. Only its structure is read, and the
+	    // map files of the pointclouds are streamed in chunks one after the
+	    // other. Operators are not updated, so only the pointclouds which
+	    // are stored in the environment are used.
+	    const boost::filesystem::path sceneDir( inputs[i] );
+	    FileSerialization serialization;
+	    serialization.setSceneDir( sceneDir.string() );
+	    serialization.setSkipMapData( true );
+	    boost::scoped_ptr<Environment> env( 
+		    serialization.readFromFile( (sceneDir / FileSerialization::STRUCTURE_FILE).string() ) );
+
+	    std::vector<envire::Pointcloud*> meshes = env->getItems<envire::Pointcloud>();
+	    for( size_t m=0; m<meshes.size(); m++ )
+	    {
+		envire::Pointcloud *pc = meshes[m];
+		const Eigen::Affine3d pc2world = env->relativeTransform( pc->getFrameNode(), env->getRootNode() );
+
+		boost::filesystem::path file( sceneDir / (pc->getMapFileName() + ".ply") );
+		if( !boost::filesystem::exists( file ) )
+		    file = sceneDir / (pc->getMapFileName() + ".txt");
+		if( !boost::filesystem::exists( file ) )
+		{
+		    std::cout << "no map file for " << pc->getUniqueId() << " in " << inputs[i] << std::endl;
+		    continue;
+		}
+
+		PointcloudReader reader( file.string(), sample, withColor );
+		while( reader.read( points, &colors, chunkSize ) > 0 )
+		{
+		    builder.addPoints( points, pc2world, NULL, reader.hasColor() ? &colors : NULL );
+		    printProgress( inputs[i], (m + reader.getProgress()) / meshes.size(), builder, start );
+		}
+	    }
+	}
+	else
+	{
+	    PointcloudReader reader( inputs[i], sample, withColor );
+	    while( reader.read( points, &colors, chunkSize ) > 0 )
+	    {
+		builder.addPoints( points, Eigen::Affine3d::Identity(), NULL, reader.hasColor() ? &colors : NULL );
+		printProgress( inputs[i], reader.getProgress(), builder, start );
+	    }
+	}
+    }
+
+    builder.finish();
+
+    const TiledMLSBuilder::Statistics& stats( builder.getStatistics() );
+    std::cout << "wrote " << builder.getTileCount() << " tiles to " << output 
+	<< " (" << stats.tilesFlushed << " tile writes, " << stats.tilesLoaded << " tile reloads)." << std::endl;
+    printProgress( "total", 1.0, builder, start );
+
+    return 0;
+}
      
 int main( int argc, char* argv[] )
 {
+    if( argc >= 2 && std::string( argv[1] ) == "--stream" )
+	return streamMain( argc, argv );
+
     if( argc < 3 ) 
     {
 	std::cout << "usage: env_mls input output [resolution] [variance] [gap_size] [patch_thickness] [\"min_x min_y max_x max_y\"]" << std::endl;
+	std::cout << "       env_mls --stream output [--resolution r] [--variance v] [--gap-size g] [--patch-thickness t]" << std::endl;
+	std::cout << "               [--tile-cells n] [--max-tiles n] [--chunk-size n] [--sample n] [--xyzr] input..." << std::endl;
+	std::cout << "       in streaming mode, inputs can be ply files, text files or environments." << std::endl;
 	exit(0);
     }
     boost::scoped_ptr<Environment> env(Environment::unserialize( argv[1] ));
@@ -83,12 +83,15 @@ void PointcloudVisualization::updateNode(envire::EnvironmentItem* item, osg::Gro
 	pointColor = osg::Vec4( ((col*88734)%256)/255.0, ((col*398482)%256)/255.0, ((col*36784787)%256)/255.0, 1.0 ); 
     }
 
+    const envire::PointcloudView view( pointcloud->getView() );
+
     // create color
-    if( pointcloud->hasData(envire::Pointcloud::VERTEX_COLOR) )
+    if( view.hasColors() )
     {
-	std::vector<Eigen::Vector3d> &pc_color(pointcloud->getVertexData<Eigen::Vector3d>(envire::Pointcloud::VERTEX_COLOR));
-	for(std::vector<Eigen::Vector3d>::const_iterator it = pc_color.begin(); it != pc_color.end(); it++) {
-	    color->push_back(osg::Vec4(it->x(),it->y(), it->z(), 1.0));
+	color->resize( view.size() );
+	for(size_t i=0;i<view.size();i++) {
+	    const envire::PointcloudView::ConstVector3 c( view.color( i ) );
+	    (*color)[i] = osg::Vec4(c.x(), c.y(), c.z(), 1.0);
 	}
 
 	geom->setColorArray(color.get());
@@ -103,10 +106,11 @@ void PointcloudVisualization::updateNode(envire::EnvironmentItem* item, osg::Gro
     }
     
     // create vertices
-    osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array;
+    osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array( view.size() );
     
-    for(std::vector<Eigen::Vector3d>::const_iterator it = pointcloud->vertices.begin(); it != pointcloud->vertices.end(); it++) {
-	vertices->push_back(osg::Vec3(it->x(),it->y(), it->z()));
+    for(size_t i=0;i<view.size();i++) {
+	const envire::PointcloudView::ConstVector3 p( view.point( i ) );
+	(*vertices)[i] = osg::Vec3(p.x(), p.y(), p.z());
     }
     
     //attach vertivces to geometry
@@ -121,7 +125,7 @@ void PointcloudVisualization::updateNode(envire::EnvironmentItem* item, osg::Gro
     point->setMaxSize( 5.0 );
     geom->getOrCreateStateSet()->setAttribute( point, osg::StateAttribute::ON );
 
-    if( pointcloud->hasData(envire::Pointcloud::VERTEX_NORMAL) && showNormals )
+    if( view.hasNormals() && showNormals )
     {
 	osg::ref_ptr<osg::Geometry> ngeom = new osg::Geometry;
 	osg::ref_ptr<osg::Vec4Array> ncolor = new osg::Vec4Array;
@@ -129,15 +133,13 @@ void PointcloudVisualization::updateNode(envire::EnvironmentItem* item, osg::Gro
 	ngeom->setColorArray(ncolor.get());
 	ngeom->setColorBinding( osg::Geometry::BIND_OVERALL );
 
-	osg::ref_ptr<osg::Vec3Array> nvertices = new osg::Vec3Array;
-
-	std::vector<Eigen::Vector3d> &normals(pointcloud->getVertexData<Eigen::Vector3d>(envire::Pointcloud::VERTEX_NORMAL));
+	osg::ref_ptr<osg::Vec3Array> nvertices = new osg::Vec3Array( view.size() * 2 );
 
-	for(size_t n=0;n<pointcloud->vertices.size();n++) {
-	    Eigen::Vector3d &point( pointcloud->vertices[n] );
-	    Eigen::Vector3d normal( normals[n] * normalScaling );
-	    nvertices->push_back(osg::Vec3(point.x(),point.y(), point.z()));
-	    nvertices->push_back(osg::Vec3(point.x()+normal.x(),point.y()+normal.y(), point.z()+normal.z()));
+	for(size_t n=0;n<view.size();n++) {
+	    const Eigen::Vector3d point( view.point( n ) );
+	    const Eigen::Vector3d normal( view.normal( n ) * normalScaling );
+	    (*nvertices)[2*n] = osg::Vec3(point.x(),point.y(), point.z());
+	    (*nvertices)[2*n+1] = osg::Vec3(point.x()+normal.x(),point.y()+normal.y(), point.z()+normal.z());
 	}
 
 	//attach vertivces to geometry
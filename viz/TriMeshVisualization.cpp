@@ -4,6 +4,7 @@
 #include <osg/Geometry>
 #include <envire/Core.hpp>
 #include <envire/maps/TriMesh.hpp>
+#include <envire/tools/MeshNormals.hpp>
 #include <osg/Drawable>
 #include <osg/ShapeDrawable>
 
@@ -70,12 +71,22 @@ void TriMeshVisualization::updateNode(envire::EnvironmentItem* item, osg::Group*
     //attach vertivces to geometry
     geom->setVertexArray(vertices);
     
+    // use the normals of the mesh, or calculate them if there are none
+    std::vector<Eigen::Vector3d> meshNormals;
     if( triMesh->hasData( envire::Pointcloud::VERTEX_NORMAL ) )
+	meshNormals = triMesh->getVertexData<Eigen::Vector3d>( envire::Pointcloud::VERTEX_NORMAL );
+    else if( !triMesh->faces.empty() )
     {
-	osg::ref_ptr<osg::Vec3Array> normals = new osg::Vec3Array;
-	std::vector<Eigen::Vector3d> &normals_(triMesh->getVertexData<Eigen::Vector3d>( envire::Pointcloud::VERTEX_NORMAL ) );
+	envire::MeshNormals calc;
+	calc.build( triMesh->vertices.size(), triMesh->faces );
+	calc.compute( triMesh->vertices, triMesh->faces, meshNormals );
+    }
 
-	for(std::vector<Eigen::Vector3d>::const_iterator it = normals_.begin(); it != normals_.end(); it++) {
+    if( !meshNormals.empty() )
+    {
+	osg::ref_ptr<osg::Vec3Array> normals = new osg::Vec3Array;
+	normals->reserve( meshNormals.size() );
+	for(std::vector<Eigen::Vector3d>::const_iterator it = meshNormals.begin(); it != meshNormals.end(); it++) {
 	    normals->push_back(osg::Vec3(it->x(),it->y(), it->z()));
 	}
 	geom->setNormalArray(normals);